@@ -4,6 +4,11 @@
  * This file provides control and monitoring of the power supply battery via the @ref c_battery and
  * the Data Hub.
  *
+ * It is the battery backend for the LTC2942 battery monitor and BQ24190 charger.  Everything that
+ * doesn't depend on this hardware (the ma_battery API, the sampler thread, the pushes to the Data
+ * Hub and the state kept in the Config Tree) is implemented by batteryCore.  This file reads the
+ * driver files, and runs the state machine that makes sense of the readings.
+ *
  * Beware that the battery charger will report "Good" health and "Full" charge status when the
  * battery is disconnected and the system is running on external power.  Therefore, a presence
  * check must be performed before reporting battery health.
@@ -20,8 +25,8 @@
  *
  * Configuration settings are stored in the Config Tree.  In addition, when a battery is known to
  * exist and the calibration procedure has completed, the battery percent level is periodically
- * stored in the Config Tree so that we don't have to run the calibration procedure again after
- * a reboot.
+ * saved (see core_SavePercentage()) so that we don't have to run the calibration procedure again
+ * after a reboot.
  *
  * <hr>
  *
@@ -30,51 +35,103 @@
 
 #include "legato.h"
 #include "interfaces.h"
+#include "batteryCore.h"
 #include "batteryUtils.h"
+#include "powerSupply.h"
+#include "socEstimator.h"
+#include "ocvTable.h"
+#include "stateOfHealth.h"
+#include "trace.h"
+#include <math.h>
 
 #define DEFAULT_BATTERY_SAMPLE_INTERVAL_MS 10000
+#define DEFAULT_MIN_SAMPLE_INTERVAL_MS 2000
+#define DEFAULT_MAX_SAMPLE_INTERVAL_MS 300000
 #define STABILIZATION_TIME_MS 5000
 
-static const char HealthFilePath[]  = "/sys/class/power_supply/bq24190-charger/health";
-static const char StatusFilePath[]  = "/sys/class/power_supply/bq24190-battery/status";
-static const char MonitorDirPath[] = "/sys/class/power_supply/LTC2942";
+/// Timer interval used while replaying a trace (ms).  Each expiry reads the next recorded sample,
+/// whose recorded time drives the clock, so the replay runs as fast as the samples can be taken.
+#define REPLAY_TIMER_INTERVAL_MS 1
+
+/// Shortest time over which the change of the charge counter is measured, to derive the current
+/// flow and to tell whether a battery is present.  The LTC2942 counts in steps of about 85 uAh,
+/// which is about 31 mA over this window (but 153 mA over the 2 s minimum sample interval).
+#define COUNTER_WINDOW_MS 10000
+
+/// Current flow (mA, either direction) above which the battery is considered heavily loaded.
+/// That is at least three counter steps per COUNTER_WINDOW_MS.
+#define FAST_SAMPLE_CURRENT_MA 100.0
+
+/// Current flow (mA, either direction) below which the battery is considered idle.  A single
+/// counter step per COUNTER_WINDOW_MS is still idle.
+#define IDLE_CURRENT_MA 40.0
+
+#define MS_PER_HOUR (1000 * 60 * 60)
+
+/// Time the current must stay below IDLE_CURRENT_MA for the battery voltage to relax.
+#define REST_TIME_MS 600000
+
+/// Uncertainty of the charge level when the charger reports "Full" (% of capacity).
+#define FULL_UNCERTAINTY_PERCENT 1
+
+/// Uncertainty of a charge level percentage saved in the Config Tree (% of capacity).
+#define SAVED_UNCERTAINTY_PERCENT 10
+
+/// Distance (in percent) from an alarm threshold within which we sample at the fastest rate.
+#define ALARM_PROXIMITY_PERCENT 2
+
+// Sysfs paths, relative to the sysfs root (see util_GetSysfsRoot()).
+static const char HealthFilePath[]  = "class/power_supply/bq24190-charger/health";
+static const char StatusFilePath[]  = "class/power_supply/bq24190-battery/status";
+static const char MonitorDirPath[] = "class/power_supply/LTC2942";
 static const char VoltageFileName[] = "voltage_now";
 static const char TempFileName[]    = "temp";
 static const char ChargeNowFileName[] = "charge_now";
 static const char CounterFileName[]  = "charge_counter";
 
-static le_mem_PoolRef_t LevelAlarmPool;
-static le_ref_MapRef_t LevelAlarmRefMap;
-
-static le_mem_PoolRef_t ChargingStatusRegPool;
-static le_ref_MapRef_t ChargingStatusRegRefMap;
-
-static le_mem_PoolRef_t HealthStatusRegPool;
-static le_ref_MapRef_t HealthStatusRegRefMap;
+/// Handles of the sysfs files that are read on every sample.  Opened once in COMPONENT_INIT.
+static util_FileRef_t HealthFile;
+static util_FileRef_t StatusFile;
+static util_FileRef_t VoltageFile;
+static util_FileRef_t TempFile;
+static util_FileRef_t ChargeNowFile;
+static util_FileRef_t CounterFile;
 
 // Output resources (configuration settings).
 #define RES_PATH_TECH        "tech"     ///< String name of the battery technology (e.g., "LiPo")
 #define RES_PATH_CAPACITY    "capacity" ///< Capacity of the battery in mAh
 #define RES_PATH_NOM_VOLTAGE "nominalVoltage"   ///< Nominal battery voltage in Volts
 #define RES_PATH_PERIOD      "period"   ///< Sampling period in seconds
+#define RES_PATH_MIN_PERIOD  "minPeriod" ///< Shortest adaptive sampling period in seconds
+#define RES_PATH_MAX_PERIOD  "maxPeriod" ///< Longest adaptive sampling period in seconds
 
-/// Input resource path
-#define RES_PATH_VALUE       "value"
-
-/// Example JSON value
-#define JSON_EXAMPLE "{\"health\":\"good\",\"%EL\":100,\"mAh\":2200,\"charging\":true,"\
-                      "\"mA\":2.838,\"V\":3.7,\"degC\":32.1}"
 /// Not a number
 #ifndef NAN
     #define NAN  (0.0 / 0.0)
 #endif
 
+/// true if the battery monitor was found, and this is the backend that implements the API.
+static bool IsSelected = false;
+
 /// The timer used to trigger polling of the battery monitor.
 static le_timer_Ref_t Timer = NULL;
 
+/// The interval the timer was last started with (ms).  Differs from the timer's actual interval
+/// while replaying a trace.
+static uint32_t TimerInterval = DEFAULT_BATTERY_SAMPLE_INTERVAL_MS;
+
 /// The normal polling period in ms.
 static uint32_t PollingPeriod = DEFAULT_BATTERY_SAMPLE_INTERVAL_MS;
 
+/// The polling period used while the battery state is changing quickly (ms).
+static uint32_t MinPollingPeriod = DEFAULT_MIN_SAMPLE_INTERVAL_MS;
+
+/// The longest polling period that idle back-off can reach (ms).
+static uint32_t MaxPollingPeriod = DEFAULT_MAX_SAMPLE_INTERVAL_MS;
+
+/// The percentage of the most recent tick, or -1 if none yet.
+static int LastPercentage = -1;
+
 /// Battery capacity (mAh), or -1 if not configured.
 static int32_t Capacity = -1;
 
@@ -87,53 +144,66 @@ static int32_t ChargeCounter = 0;
 /// The value read before the last read value of the Charge Counter.
 static int32_t OldChargeCounter = 0;
 
-/// The current flowing into or out of the battery (mA).
-static double CurrentFlow = 0;
+/// When ChargeCounter was read (monotonic clock).
+static le_clk_Time_t ChargeCounterTime;
 
+/// When OldChargeCounter was read (monotonic clock).
+static le_clk_Time_t OldChargeCounterTime;
 
-/// Enumeration of possible types of alarm.
-typedef enum
-{
-    LEVEL_HIGH, ///< Level was higher than high alarm threshold.
-    LEVEL_LOW,  ///< Level was lower that low alarm threshold.
-    LEVEL_NONE, ///< No alarm.
-}
-LevelAlarmType_t;
+/// Charge counter at the start of the current measurement window (see COUNTER_WINDOW_MS).
+static int32_t WindowStartCounter = 0;
 
+/// When the current measurement window started (monotonic clock).
+static le_clk_Time_t WindowStartTime;
 
-/// Holds percentage level alarm call-back registration information.
-typedef struct
-{
-    uint8_t percentageHigh;
-    uint8_t percentageLow;
-    LevelAlarmType_t lastAlarmType;
+/// Change of the charge counter over the last complete measurement window (uAh).
+static int32_t WindowCounterDelta = 0;
 
-    ma_battery_LevelPercentageHandlerFunc_t handler;
-    void *clientContext;
-    le_msg_SessionRef_t clientSessionRef;
-}
-LevelAlarmReg_t;
+/// true if the last tick completed a measurement window, so WindowCounterDelta is new.
+static bool IsWindowComplete = false;
 
+/// The current flowing into or out of the battery (mA).
+static double CurrentFlow = 0;
 
-/// Holds charging status change notification call-back registration information.
-typedef struct
-{
-    ma_battery_ChargingStatusHandlerFunc_t handler;
-    void *clientContext;
-    le_msg_SessionRef_t clientSessionRef;
-}
-ChargingStatusReg_t;
+/// Estimate of the charge remaining, valid in the CALIBRATING and NOMINAL states.
+static util_SocEstimator_t SocEstimator;
 
+/// When the current last dropped below IDLE_CURRENT_MA (monotonic clock), if IsAtRest.
+static le_clk_Time_t RestStartTime;
 
-/// Holds health status change notification call-back registration information.
+/// true while the current is below IDLE_CURRENT_MA.
+static bool IsAtRest = false;
+
+/// true if the estimate has been corrected from the rest voltage since the battery came to rest.
+static bool IsRestCorrected = false;
+
+/// Open-circuit voltage table for the battery technology, or NULL if there is none.
+static const util_OcvTable_t *OcvTablePtr = NULL;
+
+/// Battery voltage (V) in the sample of the current tick, or NAN if it couldn't be read.
+static double TickVoltage = NAN;
+
+/// Holds one reading of each of the driver files, taken by the sampler thread.  Each value is only
+/// valid if its result is LE_OK (or LE_NOT_FOUND, for the status and health).
 typedef struct
 {
-    ma_battery_HealthHandlerFunc_t handler;
-    void *clientContext;
-    le_msg_SessionRef_t clientSessionRef;
+    le_result_t counterResult;
+    int32_t counter;                    ///< Charge counter (uAh)
+    le_result_t statusResult;
+    util_PowerSupplyStatus_t status;
+    le_result_t healthResult;
+    util_PowerSupplyHealth_t health;
+    le_result_t voltageResult;
+    int32_t voltage;                    ///< uV
+    le_result_t tempResult;
+    int32_t temp;                       ///< centidegrees C
+    le_result_t chargeNowResult;
+    int32_t chargeNow;                  ///< uAh
 }
-HealthStatusReg_t;
+Sample_t;
 
+/// The main thread, which serves the API and runs the state machine.
+static le_thread_Ref_t MainThread;
 
 /// Enumerates all states that the battery service can be in.
 static enum
@@ -159,620 +229,408 @@ Event_t;
 
 //--------------------------------------------------------------------------------------------------
 /**
- * Get a printable string describing a health status code.
- *
- * @return Ptr to the null-terminated string.
+ * Read each driver file once into a sample.  Runs in the sampler thread (or in
+ * core_StartSampling(), before the sampler thread is started).
  */
 //--------------------------------------------------------------------------------------------------
-static const char* GetHealthStr
+static void ReadSample
 (
-    ma_battery_HealthStatus_t healthCode
+    void *samplePtr     ///< [out] Sample_t
 )
 {
-    switch (healthCode)
-    {
-        case MA_BATTERY_OVERVOLTAGE:        return "overvoltage";
-        case MA_BATTERY_GOOD:               return "good";
-        case MA_BATTERY_COLD:               return "cold";
-        case MA_BATTERY_HOT:                return "hot";
-        case MA_BATTERY_DISCONNECTED:       return "disconnected";
-        case MA_BATTERY_HEALTH_UNKNOWN:     return "unknown";
-        case MA_BATTERY_HEALTH_ERROR:       return "error";
-    }
-
-    LE_CRIT("Unexpected health code %d.", healthCode);
-
-    return "unknown";
+    Sample_t *sPtr = samplePtr;
+
+    sPtr->counterResult = util_ReadIntFromHandle(CounterFile, &sPtr->counter);
+    sPtr->statusResult = util_ReadPowerSupplyStatus(StatusFile, &sPtr->status);
+    sPtr->healthResult = util_ReadPowerSupplyHealth(HealthFile, &sPtr->health);
+    sPtr->voltageResult = util_ReadIntFromHandle(VoltageFile, &sPtr->voltage);
+    sPtr->tempResult = util_ReadIntFromHandle(TempFile, &sPtr->temp);
+    sPtr->chargeNowResult = util_ReadIntFromHandle(ChargeNowFile, &sPtr->chargeNow);
 }
 
+
 //--------------------------------------------------------------------------------------------------
 /**
- * Register a callback function to be called when the Percentage Level changes as follows:
- *
- * If the level goes above levelHigh raise an alarm, if the level goes below levelLow raise
- * an alarm.
+ * Called in the main thread after the charge level has been written to the battery monitoring
+ * driver, with the charge counter value read right after the write.
  */
 //--------------------------------------------------------------------------------------------------
-ma_battery_LevelPercentageHandlerRef_t ma_battery_AddLevelPercentageHandler
+static void ChargeLevelWritten
 (
-    uint8_t percentageLow,  ///< Low percentage trigger threshold (0 = no low level alarm)
-    uint8_t percentageHigh, ///< High percentage trigger threshold (>=100 means no high alm)
-    ma_battery_LevelPercentageHandlerFunc_t handler,
-    void *context
+    void *param1Ptr,    ///< Charge counter (uAh)
+    void *param2Ptr     ///< unused
 )
 {
-    if (percentageHigh > 100)
-    {
-        LE_ERROR("High percentage can't be higher than 100");
-        return NULL;
-    }
-    else if (percentageHigh < percentageLow)
-    {
-        LE_ERROR("High percentage can't be less than low percentage");
-        return NULL;
-    }
-
-    LevelAlarmReg_t *reg = le_mem_ForceAlloc(LevelAlarmPool);
-    reg->percentageLow                 = percentageLow;
-    reg->percentageHigh                = percentageHigh;
-    reg->lastAlarmType                 = LEVEL_NONE;
-    reg->handler                       = handler;
-    reg->clientContext                 = context;
-    reg->clientSessionRef              = ma_battery_GetClientSessionRef();
+    // Writing the charge level moves the charge counter, so take a new baseline to keep the
+    // jump out of the next current flow measurement.
+    int32_t counter = (int32_t)(intptr_t)param1Ptr;
 
-    return le_ref_CreateRef(LevelAlarmRefMap, reg);
+    WindowStartCounter += counter - ChargeCounter;
+    ChargeCounter = counter;
 }
 
 
 //--------------------------------------------------------------------------------------------------
 /**
- * Deregister a callback function registered using ma_battery_AddLevelPercentageHandler().
+ * Write a charge level to the battery monitoring driver.  Runs in the sampler thread.
  */
 //--------------------------------------------------------------------------------------------------
-void ma_battery_RemoveLevelPercentageHandler
+static void WriteChargeLevel
 (
-    ma_battery_LevelPercentageHandlerRef_t handlerRef
+    void *param1Ptr,    ///< Charge level (uAh)
+    void *param2Ptr     ///< unused
 )
 {
-    LevelAlarmReg_t *reg = le_ref_Lookup(LevelAlarmRefMap, handlerRef);
-    if (reg == NULL)
+    util_WriteIntToHandle(ChargeNowFile, (int)(intptr_t)param1Ptr);
+
+    int32_t counter;
+    if (util_ReadIntFromHandle(CounterFile, &counter) == LE_OK)
     {
-        LE_ERROR("Failed to lookup event based on handle");
+        le_event_QueueFunctionToThread(MainThread,
+                                       ChargeLevelWritten,
+                                       (void *)(intptr_t)counter,
+                                       NULL);
     }
     else
     {
-        if (reg->clientSessionRef == ma_battery_GetClientSessionRef())
-        {
-            le_ref_DeleteRef(LevelAlarmRefMap, handlerRef);
-            le_mem_Release(reg);
-        }
-        else
-        {
-            LE_ERROR("Remove invalid event handleRef");
-        }
+        LE_ERROR("Failed to read file '%s'.", util_GetFilePath(CounterFile));
     }
 }
 
 
 //--------------------------------------------------------------------------------------------------
 /**
- * Checks the list of registered battery level alarm thresholds to see if an alarm event should be
- * reported.  If so, reports them.
+ * Write the present charge level to the battery monitoring driver.
+ *
+ * This is only done to correct the monitoring driver's idea of how much charge is presently stored
+ * in the battery.  Normally the driver updates this itself as the battery drains and charges.
  */
 //--------------------------------------------------------------------------------------------------
-static void ReportBatteryLevelAlarms
-(
-    uint8_t percentage
-)
-{
-    le_ref_IterRef_t it = le_ref_GetIterator(LevelAlarmRefMap);
-    bool finished = (le_ref_NextNode(it) != LE_OK);
-    while (!finished)
-    {
-        LevelAlarmReg_t *reg = le_ref_GetValue(it);
-        LE_ASSERT(reg != NULL);
-        if ((percentage > reg->percentageHigh) && (reg->lastAlarmType != LEVEL_HIGH))
-        {
-            reg->handler(percentage, reg->percentageHigh, true, reg->clientContext);
-            reg->lastAlarmType = LEVEL_HIGH;
-        }
-        else if ((percentage < reg->percentageLow) && (reg->lastAlarmType != LEVEL_LOW))
-        {
-            reg->handler(percentage, reg->percentageLow, false, reg->clientContext);
-            reg->lastAlarmType = LEVEL_LOW;
-        }
-
-        finished = (le_ref_NextNode(it) != LE_OK);
-    }
-}
-
-
-ma_battery_ChargingStatusChangeHandlerRef_t ma_battery_AddChargingStatusChangeHandler
+static void UpdateChargeLevel
 (
-    ma_battery_ChargingStatusHandlerFunc_t handler,
-    void *context
+    int mAh
 )
 {
-    ChargingStatusReg_t *reg = le_mem_ForceAlloc(ChargingStatusRegPool);
-
-    reg->handler                        = handler;
-    reg->clientContext                  = context;
-    reg->clientSessionRef               = ma_battery_GetClientSessionRef();
+    LE_DEBUG("Charge level = %d mAh.", mAh);
 
-    return le_ref_CreateRef(ChargingStatusRegRefMap, reg);
-}
+    if (mAh > 0)
+    {
+        int uAh = mAh * 1000;
 
+        LE_DEBUG("battery %d", uAh);
 
-void ma_battery_RemoveChargingStatusChangeHandler
-(
-    ma_battery_ChargingStatusChangeHandlerRef_t handlerRef
-)
-{
-    ChargingStatusReg_t *reg = le_ref_Lookup(ChargingStatusRegRefMap, handlerRef);
-    if (reg == NULL)
-    {
-        LE_ERROR("Failed to lookup event based on handle %p", handlerRef);
+        // The write is done by the sampler thread, queued behind any sample it is taking.
+        core_QueueToSampler(WriteChargeLevel, (void *)(intptr_t)uAh, NULL);
     }
     else
     {
-        if (reg->clientSessionRef == ma_battery_GetClientSessionRef())
-        {
-            le_ref_DeleteRef(ChargingStatusRegRefMap, handlerRef);
-            le_mem_Release(reg);
-        }
-        else
-        {
-            LE_ERROR("Attempt to remove another client's Alarm Health event handleRef %p",
-                     handlerRef);
-        }
+        LE_ERROR("Charge level invalid. (%d mAh)", mAh);
     }
 }
 
 
 //--------------------------------------------------------------------------------------------------
 /**
- * Report a change in the charging status to any registered charging status handlers.
+ * Set the charge level at an anchor point (e.g., the battery is full), both in the battery
+ * monitoring driver and in the charge estimate.
  */
 //--------------------------------------------------------------------------------------------------
-static void ReportChargingStatusChange
+static void SetChargeLevel
 (
-    void
+    int mAh,
+    double uncertainty          ///< mAh
 )
 {
-    static ma_battery_ChargingStatus_t oldStatus = MA_BATTERY_CHARGING_UNKNOWN;
-
-    ma_battery_ChargingStatus_t chargingStatus = ma_battery_GetChargingStatus();
+    UpdateChargeLevel(mAh);
 
-    if (oldStatus != chargingStatus)
-    {
-        oldStatus = chargingStatus;
-
-        le_ref_IterRef_t it = le_ref_GetIterator(ChargingStatusRegRefMap);
-        bool finished       = le_ref_NextNode(it) != LE_OK;
-        while (!finished)
-        {
-            ChargingStatusReg_t *reg = le_ref_GetValue(it);
-            LE_ASSERT(reg != NULL);
-
-            reg->handler(chargingStatus, reg->clientContext);
-            finished = (le_ref_NextNode(it) != LE_OK);
-        }
-    }
+    util_SetSocEstimate(&SocEstimator, mAh, uncertainty);
 }
 
 
-ma_battery_HealthChangeHandlerRef_t ma_battery_AddHealthChangeHandler
+//--------------------------------------------------------------------------------------------------
+/**
+ * Select the open-circuit voltage table matching the battery technology.
+ */
+//--------------------------------------------------------------------------------------------------
+static void SelectOcvTable
 (
-    ma_battery_HealthHandlerFunc_t handler,
-    void *context
+    const char *tech
 )
 {
-    HealthStatusReg_t *reg = le_mem_ForceAlloc(HealthStatusRegPool);
-    reg->handler                        = handler;
-    reg->clientContext                  = context;
-    reg->clientSessionRef               = ma_battery_GetClientSessionRef();
-
-    return le_ref_CreateRef(HealthStatusRegRefMap, reg);
-}
+    OcvTablePtr = util_GetOcvTable(tech);
 
-
-void ma_battery_RemoveHealthChangeHandler
-(
-    ma_battery_HealthChangeHandlerRef_t handlerRef
-)
-{
-    HealthStatusReg_t *reg = le_ref_Lookup(HealthStatusRegRefMap, handlerRef);
-    if (reg == NULL)
+    if (OcvTablePtr == NULL)
     {
-        LE_ERROR("Failed to lookup event based on handle %p", handlerRef);
-    }
-    else
-    {
-        if (reg->clientSessionRef == ma_battery_GetClientSessionRef())
-        {
-            le_ref_DeleteRef(HealthStatusRegRefMap, handlerRef);
-            le_mem_Release(reg);
-        }
-        else
-        {
-            LE_ERROR("Attempt to remove another client's Alarm Health event handleRef %p",
-                     handlerRef);
-        }
+        LE_WARN("No open-circuit voltage table for battery technology '%s'."
+                " Please fully charge to calibrate.",
+                tech);
     }
 }
 
+
 //--------------------------------------------------------------------------------------------------
 /**
- * A handler for client disconnects which frees all resources associated with the client.
+ * Check whether the battery has been at rest long enough for its voltage to relax to the
+ * open-circuit voltage, and hasn't been corrected from it since it came to rest.
+ *
+ * @return true if the rest voltage can be used.
  */
 //--------------------------------------------------------------------------------------------------
-/*static void ClientSessionClosedHandler
+static bool IsRested
 (
-    le_msg_SessionRef_t clientSession,
-    void *context
+    void
 )
 {
-    RemoveAllLevelAlarmHandlersOwnedByClient(clientSession);
-    RemoveAllChargeAlarmHandlersOwnedByClient(clientSession);
-    RemoveAllHealthAlarmHandlersOwnedByClient(clientSession);
+    return (   (OcvTablePtr != NULL)
+            && IsAtRest
+            && !IsRestCorrected
+            && (util_MsSince(RestStartTime) >= REST_TIME_MS)  );
 }
-*/
+
 
 //--------------------------------------------------------------------------------------------------
 /**
- * Reports a change in the health status to any registered health status change event handlers.
+ * Update the charge estimate with the latest charge counter reading, and keep track of how long
+ * the battery has been at rest.
  */
 //--------------------------------------------------------------------------------------------------
-static void ReportHealthStatusChange
+static void UpdateSocEstimate
 (
-    ma_battery_HealthStatus_t healthStatus
+    uint64_t elapsedMs      ///< Time between the last two charge counter reads.
 )
 {
-    static ma_battery_HealthStatus_t oldStatus = MA_BATTERY_HEALTH_UNKNOWN;
+    util_CountSocCharge(&SocEstimator, ChargeCounter, elapsedMs);
 
-    if (oldStatus != healthStatus)
+    if (fabs(CurrentFlow) >= IDLE_CURRENT_MA)
     {
-        oldStatus = healthStatus;
-
-        le_ref_IterRef_t it = le_ref_GetIterator(HealthStatusRegRefMap);
-        bool finished       = le_ref_NextNode(it) != LE_OK;
-        while (!finished)
-        {
-            HealthStatusReg_t *reg = le_ref_GetValue(it);
-            LE_ASSERT(reg != NULL);
-            reg->handler(healthStatus, reg->clientContext);
-            finished = le_ref_NextNode(it) != LE_OK;
-        }
+        IsAtRest = false;
+    }
+    else if (!IsAtRest)
+    {
+        IsAtRest = true;
+        IsRestCorrected = false;
+        RestStartTime = ChargeCounterTime;
     }
 }
 
 
 //--------------------------------------------------------------------------------------------------
 /**
- * @return true if charging, false if not or if unknown.
+ * Correct the charge estimate from the battery voltage, once per rest period, when the battery has
+ * been at rest long enough for its voltage to relax.
  */
 //--------------------------------------------------------------------------------------------------
-static bool IsCharging
+static void CorrectAtRest
 (
     void
 )
 {
-    ma_battery_ChargingStatus_t status = ma_battery_GetChargingStatus();
+    if (IsRested() && !isnan(TickVoltage))
+    {
+        double charge = util_CorrectSocFromRestVoltage(&SocEstimator, OcvTablePtr, TickVoltage);
+        util_SetSohAnchor(core_GetStateOfHealth(), charge / Capacity);
 
-    // Note: The battery monitor shows FULL only when on external power.
-    return ((status == MA_BATTERY_CHARGING) || (status == MA_BATTERY_FULL));
+        IsRestCorrected = true;
+    }
 }
 
+
 //--------------------------------------------------------------------------------------------------
 /**
- * Compute the percentage of battery charge given the energy charge level.
+ * Seed the charge level from the battery voltage, when the battery has been at rest long enough
+ * for its voltage to relax.
  *
- * @return The percentage.
+ * @return true if the charge level was seeded.
  */
 //--------------------------------------------------------------------------------------------------
-static unsigned int ComputePercentage
+static bool SeedFromRestVoltage
 (
-    unsigned int mAh
+    void
 )
 {
-    // Compute the battery charge percentage, rounding up from half a percent or higher.
-    uint32_t percentTimesTen = 1000UL * mAh / Capacity;
-    unsigned int percentage = (percentTimesTen / 10);
-    if ((percentTimesTen % 10) >= 5)
+    double voltage = TickVoltage;
+    if ((!IsRested()) || isnan(voltage))
     {
-        percentage += 1;
+        return false;
     }
 
-    // Clamp at 100%
-    if (percentage > 100)
-    {
-        LE_WARN("Battery monitor reports available charge (%u mAh) higher than maximum of %u mAh.",
-                mAh,
-                (unsigned int)Capacity);
-        percentage = 100;
-    }
+    double charge;
+    double uncertainty;
+    util_GetOcvCharge(OcvTablePtr, Capacity, voltage, &charge, &uncertainty);
 
-    return percentage;
+    LE_INFO("Battery level calibrated from rest voltage %.3lf V: %.0lf mAh (+/- %.0lf mAh).",
+            voltage,
+            charge,
+            uncertainty);
+
+    SetChargeLevel((int)lround(charge), uncertainty);
+    util_SetSohAnchor(core_GetStateOfHealth(), charge / Capacity);
+    IsRestCorrected = true;
+
+    return true;
 }
 
 
 //--------------------------------------------------------------------------------------------------
 /**
- * Save the percentage level.
+ * Set the charge level to the full capacity, when the charger reports that the battery is full.
  */
 //--------------------------------------------------------------------------------------------------
-static void SavePercentage
+static void SetFullChargeLevel
 (
-    unsigned int percentage
+    void
 )
 {
-    le_cfg_QuickSetInt("batteryInfo/percent", percentage);
+    SetChargeLevel(Capacity, (double)Capacity * FULL_UNCERTAINTY_PERCENT / 100);
+    util_SetSohAnchor(core_GetStateOfHealth(), 1.0);
 }
 
 
 //--------------------------------------------------------------------------------------------------
 /**
- * Delete the saved percentage level.
+ * Updates the ChargingStatus variable from the battery charging status in a sample.
  */
 //--------------------------------------------------------------------------------------------------
-static void DeletePercentage
+static void UpdateChargingStatus
 (
-    void
+    const Sample_t *samplePtr
 )
 {
-    le_cfg_QuickDeleteNode("batteryInfo/percent");
+    le_result_t r = samplePtr->statusResult;
+
+    if ((r == LE_OK) || (r == LE_NOT_FOUND))
+    {
+        LE_DEBUG("Charging status = %d.", samplePtr->status);
+
+        ChargingStatus = core_GetChargingStatusCode(samplePtr->status);
+    }
+    else
+    {
+        LE_ERROR("failed to read the charging status (%s).", LE_RESULT_TXT(r));
+
+        ChargingStatus = MA_BATTERY_CHARGING_ERROR;
+    }
 }
 
 
 //--------------------------------------------------------------------------------------------------
 /**
- * Load the saved percentage level.
- *
- * @return The percentage, or -1 if not found.
+ * Update the ChargeCounter and OldChargeCounter variables from the value of the battery current
+ * monitor's charge counter in a sample.
  */
 //--------------------------------------------------------------------------------------------------
-static int LoadPercentage
+static void UpdateChargeCounter
 (
-    void
+    const Sample_t *samplePtr,
+    le_clk_Time_t time          ///< When the sample was taken (monotonic clock).
 )
 {
-    return le_cfg_QuickGetInt("batteryInfo/percent", -1);
+    if (samplePtr->counterResult != LE_OK)
+    {
+        LE_FATAL("Failed to read file '%s' (%s).",
+                 util_GetFilePath(CounterFile),
+                 LE_RESULT_TXT(samplePtr->counterResult));
+    }
+
+    LE_DEBUG("Charge counter = %d.", samplePtr->counter);
+
+    OldChargeCounter = ChargeCounter;
+    OldChargeCounterTime = ChargeCounterTime;
+    ChargeCounter = samplePtr->counter;
+    ChargeCounterTime = time;
 }
 
 
 //--------------------------------------------------------------------------------------------------
 /**
- * Push an update to the value resource in the Data Hub.
+ * Start a new charge counter measurement window at the last read value of the charge counter.
  */
 //--------------------------------------------------------------------------------------------------
-static void PushToDataHub
+static void StartCounterWindow
 (
-    ma_battery_HealthStatus_t healthStatus,
-    unsigned int percentage,
-    unsigned int mAh
+    void
 )
-//--------------------------------------------------------------------------------------------------
-
 {
-    // Get the battery voltage.
-    double voltage;
-    le_result_t r = ma_battery_GetVoltage(&voltage);
-    if (r != LE_OK)
-    {
-        LE_FATAL("Failed to read battery voltage (%s).", LE_RESULT_TXT(r));
-    }
-
-    // Get the temperature reading.
-    double temperature;
-    r = ma_battery_GetTemp(&temperature);
-    if (r != LE_OK)
-    {
-        LE_FATAL("Failed to read temperature (%s).", LE_RESULT_TXT(r));
-    }
-
-    // If the health is not known, or the battery is definitely disconnected, then the
-    // charge levels are meaningless and should be zeroed.
-    if (   (healthStatus == MA_BATTERY_DISCONNECTED)
-        || (healthStatus == MA_BATTERY_HEALTH_ERROR)
-        || (healthStatus == MA_BATTERY_HEALTH_UNKNOWN)  )
-    {
-        mAh = 0;
-        percentage = 0;
-    }
-
-    // Generate a JSON value.
-    char value[DHUBIO_MAX_STRING_VALUE_LEN + 1];
-    int len = snprintf(value,
-                       sizeof(value),
-                       "{\"health\":\"%s\","
-                       "\"%%EL\":%u,"
-                       "\"mAh\":%u,"
-                       "\"charging\":%s,"
-                       "\"mA\": %.3lf,"
-                       "\"V\":%.2lf,"
-                       "\"degC\":%.2lf}",
-                       GetHealthStr(healthStatus),
-                       percentage,
-                       mAh,
-                       IsCharging() ? "true" : "false",
-                       CurrentFlow,
-                       voltage,
-                       temperature);
-    if (len >= sizeof(value))
-    {
-        LE_ERROR("JSON value too big for Data Hub (%d characters).", len);
-    }
-    else
-    {
-        LE_DEBUG("'%s'", value);
-        dhubIO_PushJson(RES_PATH_VALUE, DHUBIO_NOW, value);
-    }
+    WindowStartCounter = ChargeCounter;
+    WindowStartTime = ChargeCounterTime;
+    IsWindowComplete = false;
 }
 
+
 //--------------------------------------------------------------------------------------------------
 /**
- * Report all types of alarms and status updates.
+ * Complete the charge counter measurement window if it has lasted at least COUNTER_WINDOW_MS:
+ * derive the current flow from the counter change over the window, and start the next one.
+ *
+ * The sample interval can be much shorter than the time the counter takes to step at a low
+ * current, so the change between two samples can't be used on its own.
  */
 //--------------------------------------------------------------------------------------------------
-static void ReportAll
+static void UpdateCounterWindow
 (
     void
 )
 {
-    // Get the Energy Level.
-    uint16_t mAh = 0;
-    if (State != STATE_DISCONNECTED)
-    {
-        le_result_t r = ma_battery_GetChargeRemaining(&mAh);
-        if (r != LE_OK)
-        {
-            LE_FATAL("Failed to read battery charge level (%s).", LE_RESULT_TXT(r));
-        }
-    }
-
-    unsigned int percentage = ComputePercentage(mAh);
+    le_clk_Time_t elapsed = le_clk_Sub(ChargeCounterTime, WindowStartTime);
+    double ms = (double)elapsed.sec * 1000 + (double)elapsed.usec / 1000;
 
-    // In the NOMINAL state, whenever the percentage changes, save it in the Config Tree
-    // so we don't have to re-calibrate whenever there's a reboot.
-    static int oldPercentage = -1;
-    if (State == STATE_NOMINAL)
+    IsWindowComplete = (ms >= COUNTER_WINDOW_MS);
+    if (IsWindowComplete)
     {
-        if (percentage != oldPercentage)
-        {
-            SavePercentage(percentage);
+        // ChargeCounter counts uAh. Counting upward = charging, downward = draining.
+        WindowCounterDelta = ChargeCounter - WindowStartCounter;
+        CurrentFlow = ((double)WindowCounterDelta / 1000) / (ms / MS_PER_HOUR);
 
-            oldPercentage = percentage;
-        }
+        WindowStartCounter = ChargeCounter;
+        WindowStartTime = ChargeCounterTime;
     }
-    else
-    {
-        oldPercentage = -1;
-    }
-
-    // Get the health status.
-    ma_battery_HealthStatus_t healthStatus = ma_battery_GetHealthStatus();
-
-    ReportBatteryLevelAlarms((uint8_t)percentage);
-    ReportChargingStatusChange();
-    ReportHealthStatusChange(healthStatus);
-    PushToDataHub(healthStatus, percentage, mAh);
 }
 
 
 //--------------------------------------------------------------------------------------------------
 /**
- * Write the present charge level to the battery monitoring driver.
- *
- * This is only done to correct the monitoring driver's idea of how much charge is presently stored
- * in the battery.  Normally the driver updates this itself as the battery drains and charges.
+ * @return true if the charge counter moved over the measurement window completed by the last tick.
  */
 //--------------------------------------------------------------------------------------------------
-static void UpdateChargeLevel
+static bool HasCounterMoved
 (
-    int mAh
+    void
 )
 {
-    LE_DEBUG("Charge level = %d mAh.", mAh);
-
-    if (mAh > 0)
-    {
-        int uAh = mAh * 1000;
-
-        LE_DEBUG("battery %d", uAh);
-
-        char path[256];
-        int len = snprintf(path, sizeof(path), "%s/%s", MonitorDirPath, ChargeNowFileName);
-        LE_ASSERT(len < sizeof(path));
-        util_WriteIntToFile(path, uAh);
-    }
-    else
-    {
-        LE_ERROR("Charge level invalid. (%d mAh)", mAh);
-    }
+    return IsWindowComplete && (WindowCounterDelta != 0);
 }
 
 
 //--------------------------------------------------------------------------------------------------
 /**
- * Reads the battery charging status and updates the ChargingStatus variable.
+ * @return true if the charge counter stood still over the measurement window completed by the
+ *         last tick.
  */
 //--------------------------------------------------------------------------------------------------
-static void ReadChargingStatus
+static bool HasCounterStopped
 (
     void
 )
 {
-    char chargingStatus[512];
-    le_result_t r = util_ReadStringFromFile(StatusFilePath, chargingStatus, sizeof(chargingStatus));
-
-    if (r == LE_OK)
-    {
-        LE_DEBUG("Charging status = '%s'.", chargingStatus);
-
-        if (strcmp(chargingStatus, "Discharging") == 0)
-        {
-            ChargingStatus = MA_BATTERY_DISCHARGING;
-        }
-        else if (strcmp(chargingStatus, "Charging") == 0)
-        {
-            ChargingStatus = MA_BATTERY_CHARGING;
-        }
-        else if (strcmp(chargingStatus, "Full") == 0)
-        {
-            ChargingStatus = MA_BATTERY_FULL;
-        }
-        else if (strcmp(chargingStatus, "Not charging") == 0)
-        {
-            ChargingStatus = MA_BATTERY_NOT_CHARGING;
-        }
-        else if (strcmp(chargingStatus, "Unknown") == 0)
-        {
-            ChargingStatus = MA_BATTERY_CHARGING_UNKNOWN;
-        }
-        else
-        {
-            LE_ERROR("Unrecognized charging status '%s'.", chargingStatus);
-
-            ChargingStatus = MA_BATTERY_CHARGING_ERROR;
-        }
-    }
-    else
-    {
-        LE_ERROR("failed to read the charging status (%s).", LE_RESULT_TXT(r));
-
-        ChargingStatus = MA_BATTERY_CHARGING_ERROR;
-    }
+    return IsWindowComplete && (WindowCounterDelta == 0);
 }
 
 
 //--------------------------------------------------------------------------------------------------
 /**
- * Read the value of the battery current monitor's charge counter and update the
- * ChargeCounter and OldChargeCounter variables.
+ * (Re)start the polling timer with a new interval.
  */
 //--------------------------------------------------------------------------------------------------
-static void ReadChargeCounter
+static void StartTimer
 (
-    void
+    uint32_t intervalMs
 )
 {
-    char path[PATH_MAX];
-
-    int pathLen = snprintf(path, sizeof(path), "%s/%s", MonitorDirPath, CounterFileName);
-    LE_ASSERT(pathLen < sizeof(path));
+    TimerInterval = intervalMs;
 
-    int32_t counter;
-    le_result_t result = util_ReadIntFromFile(path, &counter);
-
-    if (result != LE_OK)
-    {
-        LE_FATAL("Failed to read file '%s' (%s).", path, LE_RESULT_TXT(result));
-    }
-
-    LE_DEBUG("Charge counter = %d.", counter);
-
-    OldChargeCounter = ChargeCounter;
-    ChargeCounter = counter;
+    le_timer_Stop(Timer);
+    le_timer_SetMsInterval(Timer, util_IsReplaying() ? REPLAY_TIMER_INTERVAL_MS : intervalMs);
+    le_timer_Start(Timer);
 }
 
 
@@ -792,9 +650,7 @@ static void StartStabilization
 {
     State = STATE_STABILIZING;
 
-    le_timer_Stop(Timer);
-    le_timer_SetMsInterval(Timer, STABILIZATION_TIME_MS);
-    le_timer_Start(Timer);
+    StartTimer(STABILIZATION_TIME_MS);
 }
 
 
@@ -818,7 +674,8 @@ static void StartCalibration
 
         // Tell the battery monitoring driver that battery's present charge level is
         // equal to the maximum configured capacity.
-        UpdateChargeLevel(Capacity);
+        util_InitSocEstimator(&SocEstimator, Capacity);
+        SetFullChargeLevel();
 
         State = STATE_NOMINAL;
     }
@@ -828,19 +685,19 @@ static void StartCalibration
         // Since we have no way of knowing what the actual charge level of the battery
         // is, tell the battery monitoring driver the battery's present charge is half its
         // maximum capacity.  When the battery charger later signals a "full" condition,
-        // we'll update this again.  Otherwise, we let the battery monitoring driver update
-        // it as the battery charges and drains.
+        // we'll update this again, or when the battery has rested long enough to read the
+        // level from its voltage.  Until then, the charge estimate counts the charge flowing
+        // in and out.
         LE_WARN("Battery level unknown. Assuming 50%% for now. Please fully charge to calibrate.");
 
+        util_InitSocEstimator(&SocEstimator, Capacity);
         UpdateChargeLevel(Capacity / 2);
 
         State = STATE_CALIBRATING;  // Battery is known to exist but charge level is unknown.
     }
 
     // Reset the timer to run at the normal polling frequency.
-    le_timer_Stop(Timer);
-    le_timer_SetMsInterval(Timer, PollingPeriod);
-    le_timer_Start(Timer);
+    StartTimer(PollingPeriod);
 }
 
 
@@ -894,9 +751,7 @@ static void StabilizingState
             // Enter the DETECTING_PRESENCE state, starting the timer to tell us when we should
             // check the flow counter and charging status again to see if we have a battery.
             State = STATE_DETECTING_PRESENCE;
-            le_timer_Stop(Timer);
-            le_timer_SetMsInterval(Timer, PollingPeriod);
-            le_timer_Start(Timer);
+            StartTimer(PollingPeriod);
             break;
 
         case EVENT_CAPACITY_CHANGED:
@@ -924,7 +779,7 @@ static void DetectingPresenceState
         case EVENT_TIMER_EXPIRED:
         {
             // If the charge counter has changed, then we know there's a battery connected.
-            if (ChargeCounter != OldChargeCounter)
+            if (HasCounterMoved())
             {
                 // Start battery level calibration.
                 State = STATE_CALIBRATING;
@@ -932,7 +787,7 @@ static void DetectingPresenceState
             }
             // If the charge counter has not changed, and we've seen "Charging" (instead of "Full"),
             // then we know that a battery is NOT connected.
-            else if (ChargingStatus == MA_BATTERY_CHARGING)
+            else if (HasCounterStopped() && (ChargingStatus == MA_BATTERY_CHARGING))
             {
                 State = STATE_DISCONNECTED;
             }
@@ -964,7 +819,7 @@ static void DisconnectedState
         case EVENT_TIMER_EXPIRED:
         {
             // If the charge counter has changed, then we know there's a battery connected.
-            if (ChargeCounter != OldChargeCounter)
+            if (HasCounterMoved())
             {
                 // Start battery level calibration.
                 State = STATE_CALIBRATING;
@@ -1001,18 +856,24 @@ static void CalibratingState
             // 100%.  Update the battery monitor and switch to the NOMINAL state.
             if (ChargingStatus == MA_BATTERY_FULL)
             {
-                UpdateChargeLevel(Capacity);
+                SetFullChargeLevel();
 
                 State = STATE_NOMINAL;
             }
             // Otherwise, if the charge counter has not changed, but the hardware still thinks
             // it's charging, then the battery must have been disconnected.
-            else if ((ChargeCounter == OldChargeCounter) && (ChargingStatus == MA_BATTERY_CHARGING))
+            else if (HasCounterStopped() && (ChargingStatus == MA_BATTERY_CHARGING))
             {
                 State = STATE_DISCONNECTED;
 
                 // Forget the old percent level, if it's stored in the Config Tree.
-                DeletePercentage();
+                core_DeletePercentage();
+            }
+            // Otherwise, if the battery has been at rest long enough, its voltage tells us the
+            // level, so we're done calibrating.
+            else if (SeedFromRestVoltage())
+            {
+                State = STATE_NOMINAL;
             }
 
             break;
@@ -1043,18 +904,22 @@ static void NominalState
         {
             // If the charge counter has not changed, but the hardware still thinks
             // it's charging, then the battery must have been disconnected.
-            if ((ChargeCounter == OldChargeCounter) && (ChargingStatus == MA_BATTERY_CHARGING))
+            if (HasCounterStopped() && (ChargingStatus == MA_BATTERY_CHARGING))
             {
                 State = STATE_DISCONNECTED;
 
                 // Forget the old percent level, if it's stored in the Config Tree.
-                DeletePercentage();
+                core_DeletePercentage();
             }
             // Else, if the charger is reporting that the battery is full,
             // re-calibrate the charge monitor to 100%.
             else if (ChargingStatus == MA_BATTERY_FULL)
             {
-                UpdateChargeLevel(Capacity);
+                SetFullChargeLevel();
+            }
+            else
+            {
+                CorrectAtRest();
             }
 
             break;
@@ -1111,8 +976,6 @@ static void RunStateMachine
             NominalState(event);
             break;
     }
-
-    ReportAll();
 }
 
 
@@ -1131,6 +994,8 @@ static void SetTechnology
 //--------------------------------------------------------------------------------------------------
 {
     le_cfg_QuickSetString("batteryInfo/type", tech);
+
+    SelectOcvTable(tech);
 }
 
 
@@ -1158,11 +1023,13 @@ static void SetCapacity
 
         le_cfg_QuickSetInt("batteryInfo/capacity", (int32_t)capacity);
 
-        // Forget the old percent level, if it's stored in the Config Tree.
-        DeletePercentage();
+        // Forget the old percent level and state of health, if stored in the Config Tree.
+        core_DeletePercentage();
+        core_ResetStateOfHealth(Capacity);
 
-        // Notify the state machine that the capacity setting changed.
+        // Notify the state machine that the capacity setting changed, and report the new state.
         RunStateMachine(EVENT_CAPACITY_CHANGED);
+        core_RequestSample(CORE_SAMPLE_FOR_REPORT);
     }
 }
 
@@ -1211,13 +1078,79 @@ static void SetPeriod
     }
     else
     {
-        le_timer_SetMsInterval(Timer, (uint32_t)(period * 1000));
+        PollingPeriod = (uint32_t)(period * 1000);
+
+        // The adaptive period bounds always enclose the normal period.
+        if (MinPollingPeriod > PollingPeriod)
+        {
+            MinPollingPeriod = PollingPeriod;
+        }
+        if (MaxPollingPeriod < PollingPeriod)
+        {
+            MaxPollingPeriod = PollingPeriod;
+        }
+
+        if ((State != STATE_UNCONFIGURED) && (State != STATE_STABILIZING))
+        {
+            StartTimer(PollingPeriod);
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Set the shortest period used by the adaptive sampling scheduler.
+ */
+//--------------------------------------------------------------------------------------------------
+
+static void SetMinPeriod
+(
+    double timestamp,
+    double period,  ///< seconds
+    void* contextPtr ///< unused
+)
+//--------------------------------------------------------------------------------------------------
+{
+    if ((period <= 0) || ((uint32_t)(period * 1000) > PollingPeriod))
+    {
+        LE_ERROR("Minimum period of %lf seconds is out of range.", period);
+    }
+    else
+    {
+        MinPollingPeriod = (uint32_t)(period * 1000);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Set the longest period that the adaptive sampling scheduler can back off to.
+ */
+//--------------------------------------------------------------------------------------------------
+
+static void SetMaxPeriod
+(
+    double timestamp,
+    double period,  ///< seconds
+    void* contextPtr ///< unused
+)
+//--------------------------------------------------------------------------------------------------
+{
+    if ((period <= 0) || ((uint32_t)(period * 1000) < PollingPeriod))
+    {
+        LE_ERROR("Maximum period of %lf seconds is out of range.", period);
+    }
+    else
+    {
+        MaxPollingPeriod = (uint32_t)(period * 1000);
     }
 }
 
 //--------------------------------------------------------------------------------------------------
 /**
  * Set the battery technology as set by the battery manufacturer
+ *
+ * Ignored if this board doesn't have the battery monitor, as the service is then provided by
+ * another backend.
  */
 //--------------------------------------------------------------------------------------------------
 void ma_adminbattery_SetTechnology
@@ -1227,6 +1160,12 @@ void ma_adminbattery_SetTechnology
     uint32_t milliVolts
 )
 {
+    if (!IsSelected)
+    {
+        LE_WARN("No battery monitor for the battery technology. Ignored.");
+        return;
+    }
+
     LE_DEBUG(" Create battery configuration");
 
     // Create a write transaction so we can update the tree
@@ -1234,6 +1173,7 @@ void ma_adminbattery_SetTechnology
 
     // Set the battery technology.
     le_cfg_SetString(iteratorRef, "type", batteryType);
+    SelectOcvTable(batteryType);
 
     // Set the battery capacity as set by the manufacturer
     le_cfg_SetInt(iteratorRef, "capacity", mAh);
@@ -1254,10 +1194,12 @@ void ma_adminbattery_SetTechnology
     {
         Capacity = mAh;
 
-        // Forget the old percent level, if it's stored in the Config Tree.
-        DeletePercentage();
+        // Forget the old percent level and state of health, if stored in the Config Tree.
+        core_DeletePercentage();
+        core_ResetStateOfHealth(Capacity);
 
         RunStateMachine(EVENT_CAPACITY_CHANGED);
+        core_RequestSample(CORE_SAMPLE_FOR_REPORT);
     }
 }
 
@@ -1267,7 +1209,7 @@ void ma_adminbattery_SetTechnology
  * Get the battery technology as set by the battery manufacturer
  */
 //--------------------------------------------------------------------------------------------------
-le_result_t ma_battery_GetTechnology
+static le_result_t GetTechnology
 (
     char *batteryType,
     size_t batteryTypeSize, ///< Size of buffer pointed to by batteryType (bytes).
@@ -1325,14 +1267,14 @@ le_result_t ma_battery_GetTechnology
 
 //--------------------------------------------------------------------------------------------------
 /**
- * Provides battery health status
+ * Get the battery health status from a sample.
  *
  * @return Health status code.
  */
 //--------------------------------------------------------------------------------------------------
-ma_battery_HealthStatus_t ma_battery_GetHealthStatus
+static ma_battery_HealthStatus_t HealthFromSample
 (
-    void
+    const Sample_t *samplePtr
 )
 {
     if (State == STATE_DISCONNECTED)
@@ -1340,37 +1282,25 @@ ma_battery_HealthStatus_t ma_battery_GetHealthStatus
         return MA_BATTERY_DISCONNECTED;
     }
 
-    char healthValue[32];
-    le_result_t r = util_ReadStringFromFile(HealthFilePath, healthValue, sizeof(healthValue));
+    le_result_t r = samplePtr->healthResult;
 
-    if (r == LE_OK)
+    if (r == LE_NOT_FOUND)
     {
-        if (strcmp(healthValue, "Good") == 0)
-        {
-            if ((State != STATE_CALIBRATING) && (State != STATE_NOMINAL))
-            {
-                return MA_BATTERY_HEALTH_UNKNOWN;
-            }
-            return MA_BATTERY_GOOD;
-        }
-        else if (strcmp(healthValue, "Overvoltage") == 0)
-        {
-            return MA_BATTERY_OVERVOLTAGE;
-        }
-        else if (strcmp(healthValue, "Cold") == 0)
-        {
-            return MA_BATTERY_COLD;
-        }
+        // The driver reported a health that isn't recognized.
+        return MA_BATTERY_HEALTH_UNKNOWN;
+    }
+    else if (r == LE_OK)
+    {
+        ma_battery_HealthStatus_t healthStatus = core_GetHealthStatusCode(samplePtr->health);
 
-        else if (strcmp(healthValue, "Overheat") == 0)
-        {
-            return MA_BATTERY_HOT;
-        }
-        else
+        // The health is only known to be good once the battery has been detected.
+        if (   (healthStatus == MA_BATTERY_GOOD)
+            && (State != STATE_CALIBRATING)
+            && (State != STATE_NOMINAL)  )
         {
-            LE_ERROR("Unrecognized health string from driver: '%s'.", healthValue);
             return MA_BATTERY_HEALTH_UNKNOWN;
         }
+        return healthStatus;
     }
     else
     {
@@ -1386,7 +1316,7 @@ ma_battery_HealthStatus_t ma_battery_GetHealthStatus
  * @return Charging status code.
  */
 //--------------------------------------------------------------------------------------------------
-ma_battery_ChargingStatus_t ma_battery_GetChargingStatus
+static ma_battery_ChargingStatus_t GetChargingStatus
 (
     void
 )
@@ -1412,27 +1342,22 @@ ma_battery_ChargingStatus_t ma_battery_GetChargingStatus
 
 //--------------------------------------------------------------------------------------------------
 /**
- * Get battery voltage (in Volts)
+ * Get the battery voltage (in Volts) from a sample.
  *
  * @return
  *      - LE_OK on success.
  */
 //--------------------------------------------------------------------------------------------------
-le_result_t ma_battery_GetVoltage
+static le_result_t VoltageFromSample
 (
+    const Sample_t *samplePtr,
     double *volt
 )
 {
-    char path[256];
-
-    int pathLen = snprintf(path, sizeof(path), "%s/%s", MonitorDirPath, VoltageFileName);
-    LE_ASSERT(pathLen < sizeof(path));
-
-    int32_t uV;
-    le_result_t r = util_ReadIntFromFile(path, &uV);
+    le_result_t r = samplePtr->voltageResult;
     if (r == LE_OK)
     {
-        *volt = ((double)uV) / 1000000.0;
+        *volt = ((double)samplePtr->voltage) / 1000000.0;
     }
 
     return r;
@@ -1441,156 +1366,435 @@ le_result_t ma_battery_GetVoltage
 
 //--------------------------------------------------------------------------------------------------
 /**
- * Get battery current (in mA)
+ * Get the battery temperature in degrees Celcius from a sample.
  *
  * @return
  *      - LE_OK on success.
  */
 //--------------------------------------------------------------------------------------------------
-le_result_t ma_battery_GetCurrent
+static le_result_t TempFromSample
 (
-    double *current ///< Battery current in mA, if LE_OK is returned.
+    const Sample_t *samplePtr,
+    double *temp    ///< degrees C
 )
 {
-    return LE_NOT_IMPLEMENTED;
+    le_result_t r = samplePtr->tempResult;
+    if (r == LE_OK)
+    {
+        *temp = ((double)samplePtr->temp) / 100.0;    // From centidegrees Celcius.
+    }
+
+    return r;
 }
 
 
 //--------------------------------------------------------------------------------------------------
 /**
- * Get battery temperature in degrees Celcius
+ * Get the charge remaining in mAh, from a sample if it isn't being estimated.
  *
  * @return
- *      - LE_OK on success.
+ *      - LE_OK
+ *      - LE_IO_ERROR
  */
 //--------------------------------------------------------------------------------------------------
-le_result_t ma_battery_GetTemp
+static le_result_t ChargeFromSample
 (
-    double *temp    ///< degrees C
+    const Sample_t *samplePtr,
+    uint16_t *charge    ///< mAh
 )
 {
-    char path[256];
+    // While the battery is known to be present, the charge is estimated from the charge counter.
+    if ((State == STATE_CALIBRATING) || (State == STATE_NOMINAL))
+    {
+        *charge = (uint16_t)lround(util_GetSocCharge(&SocEstimator));
 
-    int pathLen = snprintf(path, sizeof(path), "%s/%s", MonitorDirPath, TempFileName);
-    LE_ASSERT(pathLen < sizeof(path));
+        LE_DEBUG("Charge level = %u mAh.", *charge);
 
-    int32_t tempcalc;  // In centidegrees Celcius.
-    le_result_t r = util_ReadIntFromFile(path, &tempcalc);
+        return LE_OK;
+    }
+
+    le_result_t r = samplePtr->chargeNowResult;
     if (r == LE_OK)
     {
-        *temp = ((double)tempcalc) / 100.0;
+        *charge = samplePtr->chargeNow / 1000;
     }
 
+    LE_DEBUG("Charge level = %uh mAh.", *charge);
+
     return r;
 }
 
 
 //--------------------------------------------------------------------------------------------------
 /**
- * Get Charge Remaining in mAh
+ * Get the confidence in the charge remaining.
  *
  * @return
  *      - LE_OK
- *      - LE_IO_ERROR
+ *      - LE_NOT_FOUND if the charge level is not being estimated.
  */
 //--------------------------------------------------------------------------------------------------
-le_result_t ma_battery_GetChargeRemaining
+static le_result_t GetPercentConfidence
 (
-    uint16_t *charge    ///< mAh
+    uint8_t *confidence     ///< 0 to 100.
 )
 {
-    char path[256];
+    if ((State != STATE_CALIBRATING) && (State != STATE_NOMINAL))
+    {
+        return LE_NOT_FOUND;
+    }
 
-    int pathLen = snprintf(path, sizeof(path), "%s/%s", MonitorDirPath, ChargeNowFileName);
-    LE_ASSERT(pathLen < sizeof(path));
+    *confidence = util_GetSocConfidence(&SocEstimator);
 
-    int32_t uAh;
-    le_result_t r = util_ReadIntFromFile(path, &uAh);
-    if (r == LE_OK)
+    return LE_OK;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Map a sample to the battery values.  The charging status, the current and the charge levels
+ * depend on what the state machine knows about the battery, as of the latest tick.
+ */
+//--------------------------------------------------------------------------------------------------
+static void GetValues
+(
+    const void *samplePtr,      ///< Sample_t
+    core_Values_t *valuesPtr    ///< [out]
+)
+{
+    const Sample_t *sPtr = samplePtr;
+    ma_battery_SnapshotField_t validFields = 0;
+
+    // Values that can't be read are reported as zero.
+    memset(valuesPtr, 0, sizeof(*valuesPtr));
+
+    valuesPtr->chargingStatus = GetChargingStatus();
+    if (valuesPtr->chargingStatus != MA_BATTERY_CHARGING_ERROR)
     {
-        *charge = uAh / 1000;
+        validFields |= MA_BATTERY_FIELD_CHARGING_STATUS;
     }
 
-    LE_DEBUG("Charge level = %uh mAh.", *charge);
+    valuesPtr->health = HealthFromSample(sPtr);
+    if (valuesPtr->health != MA_BATTERY_HEALTH_ERROR)
+    {
+        validFields |= MA_BATTERY_FIELD_HEALTH;
+    }
 
-    return r;
+    if (VoltageFromSample(sPtr, &valuesPtr->voltage) == LE_OK)
+    {
+        validFields |= MA_BATTERY_FIELD_VOLTAGE;
+    }
+
+    // The current is derived from the charge counter, which is only tracked while a battery is
+    // known to be present.
+    if ((State == STATE_CALIBRATING) || (State == STATE_NOMINAL))
+    {
+        valuesPtr->current = CurrentFlow;
+        validFields |= MA_BATTERY_FIELD_CURRENT;
+    }
+
+    if (TempFromSample(sPtr, &valuesPtr->temp) == LE_OK)
+    {
+        validFields |= MA_BATTERY_FIELD_TEMP;
+    }
+
+    if (   (State != STATE_DISCONNECTED)
+        && (ChargeFromSample(sPtr, &valuesPtr->charge) == LE_OK))
+    {
+        validFields |= MA_BATTERY_FIELD_CHARGE;
+
+        if (   (Capacity >= 0)
+            && (State != STATE_STABILIZING)
+            && (State != STATE_DETECTING_PRESENCE)  )
+        {
+            valuesPtr->percent = core_ComputePercentage(valuesPtr->charge, Capacity);
+            validFields |= MA_BATTERY_FIELD_PERCENT;
+        }
+    }
+
+    if (Capacity > 0)
+    {
+        valuesPtr->fullCharge = (uint16_t)Capacity;
+    }
+
+    valuesPtr->validFields = validFields;
 }
 
 
 //--------------------------------------------------------------------------------------------------
 /**
- * Get charge remaining, in percentage
+ * Check whether a percentage is close to one of the registered level alarm thresholds.
  *
- * @return
- *      - LE_OK
- *      - LE_IO_ERROR
- *      - LE_NOT_FOUND
+ * @return true if within ALARM_PROXIMITY_PERCENT of a threshold.
  */
 //--------------------------------------------------------------------------------------------------
-le_result_t ma_battery_GetPercentRemaining
+static bool IsNearAlarmThreshold
 (
-    uint16_t *percentage
+    int percentage
 )
 {
-    if (Capacity < 0)
-    {
-        LE_WARN("Battery capacity not configured");
-        return LE_NOT_FOUND;
-    }
-    else if (   (State == STATE_DISCONNECTED)
-             || (State == STATE_STABILIZING)
-             || (State == STATE_DETECTING_PRESENCE))
+    return core_IsNearLevelAlarm(percentage, ALARM_PROXIMITY_PERCENT);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Choose the interval until the next sample, based on how quickly the battery state is changing.
+ *
+ * - Sample at MinPollingPeriod while the battery is charging, heavily loaded, changing percentage
+ *   or close to an alarm threshold.
+ * - Back off exponentially towards MaxPollingPeriod while the battery is idle, full or
+ *   disconnected.
+ * - Otherwise, sample at the normal PollingPeriod.
+ *
+ * Outside of the CALIBRATING, NOMINAL and DISCONNECTED states the normal period is always used.
+ */
+//--------------------------------------------------------------------------------------------------
+static void ScheduleNextSample
+(
+    void
+)
+{
+    static int oldPercentage = -1;
+
+    uint32_t interval = TimerInterval;
+    uint32_t newInterval = PollingPeriod;
+
+    if ((State == STATE_UNCONFIGURED) || (State == STATE_STABILIZING))
     {
-        return LE_NOT_FOUND;
+        // The timer is managed by the state machine in these states.
+        return;
     }
-    else
+
+    if (   (State == STATE_DISCONNECTED)
+        || (   (State == STATE_NOMINAL)
+            && (ChargingStatus == MA_BATTERY_FULL) )
+        || (   ((State == STATE_NOMINAL) || (State == STATE_CALIBRATING))
+            && (fabs(CurrentFlow) < IDLE_CURRENT_MA)
+            && (LastPercentage == oldPercentage) )  )
     {
-        uint16_t remaining;
-        le_result_t r = ma_battery_GetChargeRemaining(&remaining);
-        if (r == LE_OK)
+        // Idle: back off.
+        newInterval = (interval < PollingPeriod) ? PollingPeriod : interval * 2;
+        if ((newInterval > MaxPollingPeriod) || (newInterval < interval))
         {
-            *percentage = ComputePercentage(remaining);
+            newInterval = MaxPollingPeriod;
         }
+    }
+    else if (   (State != STATE_DETECTING_PRESENCE)
+             && (   (ChargingStatus == MA_BATTERY_CHARGING)
+                 || (fabs(CurrentFlow) >= FAST_SAMPLE_CURRENT_MA)
+                 || (LastPercentage != oldPercentage)
+                 || IsNearAlarmThreshold(LastPercentage)  )  )
+    {
+        newInterval = MinPollingPeriod;
+    }
 
-        return r;
+    oldPercentage = LastPercentage;
+
+    if (newInterval != interval)
+    {
+        LE_DEBUG("Sample interval %u ms -> %u ms.", interval, newInterval);
+
+        StartTimer(newInterval);
     }
 }
 
 
 //--------------------------------------------------------------------------------------------------
 /**
- * Timer handler will monitor information on the battery charge status
+ * Monitor information on the battery charge status from a sample taken on a timer tick.
  * If indication is that battery is full, then it will update the LTC charge register to
  * maximum battery charge capacity in mAh
  */
 //--------------------------------------------------------------------------------------------------
-static void BatteryTimerExpiryHandler
+static void Tick
 (
-    le_timer_Ref_t batteryTimerRef  ///< not used (MAY BE NULL)
+    const Sample_t *samplePtr,
+    le_clk_Time_t time          ///< When the sample was taken (monotonic clock).
 )
 {
     // Update the charge flow counter.
     // Note: The charge counters must only be updated on a timer tick so that we can accurately
     //       derive the current flow over time.
-    ReadChargeCounter();
+    UpdateChargeCounter(samplePtr, time);
+
+    // Compute the current flow over the measurement window, once it is long enough.
+    UpdateCounterWindow();
+
+    le_clk_Time_t elapsed = le_clk_Sub(ChargeCounterTime, OldChargeCounterTime);
+    double ms = (double)elapsed.sec * 1000 + (double)elapsed.usec / 1000;
+
+    // The charge is only meaningful while a battery is known to be present.
+    if ((State == STATE_CALIBRATING) || (State == STATE_NOMINAL))
+    {
+        util_CountSohCharge(core_GetStateOfHealth(),
+                            (double)(ChargeCounter - OldChargeCounter) / 1000);
+    }
+    else
+    {
+        util_ClearSohAnchor(core_GetStateOfHealth());
+    }
+
+    UpdateSocEstimate((uint64_t)ms);
 
-    // Compute the current flow.
-    // ChargeCounter counts uAh. Counting upward = charging, downward = draining.
-    #define MS_PER_HOUR (1000 * 60 * 60)
-    double mAh = (double)(ChargeCounter - OldChargeCounter) / 1000;
-    double h = (double)le_timer_GetMsInterval(batteryTimerRef) / MS_PER_HOUR;
-    CurrentFlow = ( mAh / h );
+    if (VoltageFromSample(samplePtr, &TickVoltage) != LE_OK)
+    {
+        TickVoltage = NAN;
+    }
 
     // Update the charging status.
-    ReadChargingStatus();
+    UpdateChargingStatus(samplePtr);
 
     RunStateMachine(EVENT_TIMER_EXPIRED);
+
+    core_Values_t values;
+    GetValues(samplePtr, &values);
+    LastPercentage = (values.validFields & MA_BATTERY_FIELD_PERCENT) ? values.percent : 0;
+
+    // In the NOMINAL state, save the percentage so we don't have to re-calibrate whenever there's
+    // a reboot.
+    if (State == STATE_NOMINAL)
+    {
+        core_SavePercentage(LastPercentage);
+    }
+
+    ScheduleNextSample();
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Update the state of the battery from a sample, before batteryCore reports and pushes it.  A
+ * sample taken on a timer tick runs the state machine, and any other only updates the charging
+ * status.
+ *
+ * @return false while unconfigured, as the values mean nothing until the capacity is known.
+ */
+//--------------------------------------------------------------------------------------------------
+static bool ProcessSample
+(
+    const void *samplePtr,      ///< Sample_t
+    le_clk_Time_t time,         ///< When the sample was taken (monotonic clock).
+    uint32_t reasons            ///< Sample request flags.
+)
+{
+    if (reasons & CORE_SAMPLE_FOR_PUSH)
+    {
+        Tick(samplePtr, time);
+    }
+    else
+    {
+        UpdateChargingStatus(samplePtr);
+    }
+
+    return (State != STATE_UNCONFIGURED);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Timer handler.  Requests a sample, which is processed by Tick() once it has been taken, and then
+ * reported and pushed by batteryCore.
+ */
+//--------------------------------------------------------------------------------------------------
+static void BatteryTimerExpiryHandler
+(
+    le_timer_Ref_t batteryTimerRef  ///< not used (MAY BE NULL)
+)
+{
+    core_RequestSample(CORE_SAMPLE_FOR_PUSH);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Handler for power_supply uevents from the kernel.  The charger sends these when the charging
+ * status or health changes, e.g., when a battery is plugged in, so re-sample and report right
+ * away instead of waiting for the timer.
+ *
+ * Once the state machine is running, the sample is also a tick, and the sample interval goes back
+ * to MinPollingPeriod: it may have backed off to MaxPollingPeriod while the battery was idle or
+ * disconnected, and the change is worth following closely.
+ */
+//--------------------------------------------------------------------------------------------------
+static void PowerSupplyEventHandler
+(
+    const char *supplyName,
+    void *contextPtr    ///< unused
+)
+{
+    if ((State == STATE_UNCONFIGURED) || (State == STATE_STABILIZING))
+    {
+        // The timer is managed by the state machine in these states.
+        core_RequestSample(CORE_SAMPLE_FOR_REPORT);
+        return;
+    }
+
+    StartTimer(MinPollingPeriod);
+
+    core_RequestSample(CORE_SAMPLE_FOR_PUSH);
 }
 
 
+//--------------------------------------------------------------------------------------------------
+/**
+ * Open a handle for a file in the battery monitor's sysfs directory.
+ *
+ * @return The file handle.
+ */
+//--------------------------------------------------------------------------------------------------
+static util_FileRef_t OpenMonitorFile
+(
+    const char *fileName,
+    int flags
+)
+{
+    char path[PATH_MAX];
+
+    int pathLen = snprintf(path, sizeof(path), "%s/%s", MonitorDirPath, fileName);
+    LE_ASSERT(pathLen < sizeof(path));
+
+    return util_OpenSysfsFile(path, flags);
+}
+
+
+/// power_supply class devices of the LTC2942 battery monitor and the BQ24190 charger.
+static const char *const SupplyNames[] = { "bq24190-charger", "bq24190-battery", "LTC2942", NULL };
+
+/// The functions that read and interpret this hardware for batteryCore.
+static const core_Backend_t Backend =
+{
+    .name = "LTC2942+BQ24190",
+    .supplyNames = SupplyNames,
+    .sampleSize = sizeof(Sample_t),
+    .readSample = ReadSample,
+    .processSample = ProcessSample,
+    .getValues = GetValues,
+    .getPercentConfidence = GetPercentConfidence,
+    .notificationsChanged = NULL,
+};
+
+
 COMPONENT_INIT
 {
-   // le_msg_AddServiceCloseHandler(ma_battery_GetServiceRef(), ClientSessionClosedHandler, NULL);
+    // Stay idle if this isn't the hardware we're running on.
+    if (core_SetBackend(&Backend) != LE_OK)
+    {
+        return;
+    }
+    IsSelected = true;
+
+    // Open the sysfs files that are sampled periodically.
+    HealthFile    = util_OpenSysfsFile(HealthFilePath, O_RDONLY);
+    StatusFile    = util_OpenSysfsFile(StatusFilePath, O_RDONLY);
+    VoltageFile   = OpenMonitorFile(VoltageFileName, O_RDONLY);
+    TempFile      = OpenMonitorFile(TempFileName, O_RDONLY);
+    ChargeNowFile = OpenMonitorFile(ChargeNowFileName, O_RDWR);
+    CounterFile   = OpenMonitorFile(CounterFileName, O_RDONLY);
+
+    // After this, the driver files are only accessed by the sampler thread.
+    core_StartSampling();
+    MainThread = le_thread_GetCurrent();
 
     // String describing the battery technology.
     LE_ASSERT(LE_OK == dhubIO_CreateOutput(RES_PATH_TECH, DHUBIO_DATA_TYPE_STRING, ""));
@@ -1611,22 +1815,26 @@ COMPONENT_INIT
     dhubIO_AddNumericPushHandler(RES_PATH_PERIOD, SetPeriod, NULL);
     dhubIO_SetNumericDefault(RES_PATH_PERIOD, ((double)DEFAULT_BATTERY_SAMPLE_INTERVAL_MS) / 1000);
 
-    // Sensor data flowing into the Data Hub as a JSON structure.
-    LE_ASSERT(LE_OK == dhubIO_CreateInput(RES_PATH_VALUE, DHUBIO_DATA_TYPE_JSON, ""));
-    dhubIO_SetJsonExample(RES_PATH_VALUE, JSON_EXAMPLE);
-
-    LevelAlarmPool   = le_mem_CreatePool("batt_events", sizeof(LevelAlarmReg_t));
-    LevelAlarmRefMap = le_ref_CreateMap("batt_events", 4);
+    // Bounds of the adaptive sample period (seconds).
+    LE_ASSERT(LE_OK == dhubIO_CreateOutput(RES_PATH_MIN_PERIOD, DHUBIO_DATA_TYPE_NUMERIC, "s"));
+    dhubIO_AddNumericPushHandler(RES_PATH_MIN_PERIOD, SetMinPeriod, NULL);
+    dhubIO_SetNumericDefault(RES_PATH_MIN_PERIOD, ((double)DEFAULT_MIN_SAMPLE_INTERVAL_MS) / 1000);
+    dhubIO_MarkOptional(RES_PATH_MIN_PERIOD);
 
-    ChargingStatusRegPool   = le_mem_CreatePool("charge_events", sizeof(ChargingStatusReg_t));
-    ChargingStatusRegRefMap = le_ref_CreateMap("charge_events", 4);
+    LE_ASSERT(LE_OK == dhubIO_CreateOutput(RES_PATH_MAX_PERIOD, DHUBIO_DATA_TYPE_NUMERIC, "s"));
+    dhubIO_AddNumericPushHandler(RES_PATH_MAX_PERIOD, SetMaxPeriod, NULL);
+    dhubIO_SetNumericDefault(RES_PATH_MAX_PERIOD, ((double)DEFAULT_MAX_SAMPLE_INTERVAL_MS) / 1000);
+    dhubIO_MarkOptional(RES_PATH_MAX_PERIOD);
 
-    HealthStatusRegPool   = le_mem_CreatePool("health_events", sizeof(HealthStatusReg_t));
-    HealthStatusRegRefMap = le_ref_CreateMap("health_events", 4);
+    // Get notified by the kernel as soon as the charger status or health changes.
+    if (util_AddPowerSupplyEventHandler(PowerSupplyEventHandler, NULL) != LE_OK)
+    {
+        LE_WARN("Power supply uevents unavailable. Changes will only be seen when polling.");
+    }
 
     // Set up the timer, but don't start it until we know we are configured.
     Timer = le_timer_Create("Battery Service Timer");
-    le_timer_SetMsInterval(Timer, DEFAULT_BATTERY_SAMPLE_INTERVAL_MS);
+    le_timer_SetMsInterval(Timer, util_IsReplaying() ? REPLAY_TIMER_INTERVAL_MS : TimerInterval);
     le_timer_SetRepeat(Timer, 0);
     le_timer_SetHandler(Timer, BatteryTimerExpiryHandler);
 
@@ -1634,7 +1842,7 @@ COMPONENT_INIT
     char type[MA_BATTERY_MAX_BATT_TYPE_STR_LEN + 1];
     uint16_t mAh; // mAh
     uint16_t mV; // mV
-    le_result_t result = ma_battery_GetTechnology(type, sizeof(type), &mAh, &mV);
+    le_result_t result = GetTechnology(type, sizeof(type), &mAh, &mV);
     if (result != LE_OK)
     {
         LE_ERROR("Battery monitor is not configured.");
@@ -1644,10 +1852,17 @@ COMPONENT_INIT
     else
     {
         Capacity = mAh;
-
-        // Read the charge counter and remember the value to be compared against later.
-        ReadChargeCounter();
+        SelectOcvTable(type);
+        core_LoadStateOfHealth(Capacity);
+
+        // Take the charge counter from the first sample and remember the value to be compared
+        // against later.
+        Sample_t sample;
+        le_clk_Time_t time = core_GetLatestSample(&sample);
+        UpdateChargeCounter(&sample, time);
         OldChargeCounter = ChargeCounter;   // To prevent wild mA measurements on subsequent reads.
+        OldChargeCounterTime = ChargeCounterTime;
+        StartCounterWindow();
 
         // Set the default values of the configuration settings resources in the Data Hub.
         if (type[0] != '\0')
@@ -1661,11 +1876,13 @@ COMPONENT_INIT
         dhubIO_SetNumericDefault(RES_PATH_CAPACITY, Capacity);
 
         // Read the charge level percentage from the config tree.
-        int percent = LoadPercentage();
+        int percent = core_LoadPercentage();
         if (percent >= 0)
         {
             // Tell the battery monitor what level we think the battery is at.
-            UpdateChargeLevel(Capacity * percent / 100);
+            util_InitSocEstimator(&SocEstimator, Capacity);
+            SetChargeLevel(Capacity * percent / 100,
+                           (double)Capacity * SAVED_UNCERTAINTY_PERCENT / 100);
 
             // Enter the NOMINAL state.
             State = STATE_NOMINAL;
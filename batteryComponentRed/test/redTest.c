@@ -0,0 +1,184 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file redTest.c
+ *
+ * Host test of the Red backend (LTC2942 battery monitor and BQ24190 charger), built against the
+ * Legato shim (see CMakeLists.txt at the top of the tree).  The driver files are stood in for by a
+ * temporary sysfs directory, which BATTERY_SYSFS_ROOT points at, and the battery technology and
+ * charge level saved before a restart are put in the Config Tree.
+ *
+ * Exits with status 0 if all the tests pass.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#include "legato.h"
+#include "interfaces.h"
+#include "admin_interface.h"
+#include "hostTest.h"
+
+/// Driver directories of the battery monitor and the charger.
+#define CHARGER_DIR "class/power_supply/bq24190-charger/"
+#define BATTERY_DIR "class/power_supply/bq24190-battery/"
+#define MONITOR_DIR "class/power_supply/LTC2942/"
+
+/// Initialization functions of batteryCore and of the backend (see CMakeLists.txt).
+void _batteryCore_COMPONENT_INIT(void);
+void _batteryComponentRed_COMPONENT_INIT(void);
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Create the driver files of a discharging battery, and configure a 1000 mAh LiPo battery that
+ * was 60% charged when the service last saved its level.
+ */
+//--------------------------------------------------------------------------------------------------
+static void CreateHardware
+(
+    void
+)
+{
+    test_WriteSysfsFile(CHARGER_DIR "type", "USB\n");
+    test_WriteSysfsFile(CHARGER_DIR "health", "Good\n");
+
+    test_WriteSysfsFile(BATTERY_DIR "type", "Battery\n");
+    test_WriteSysfsFile(BATTERY_DIR "status", "Discharging\n");
+
+    test_WriteSysfsFile(MONITOR_DIR "type", "Battery\n");
+    test_WriteSysfsFile(MONITOR_DIR "voltage_now", "3900000\n");
+    test_WriteSysfsFile(MONITOR_DIR "temp", "2500\n");
+    test_WriteSysfsFile(MONITOR_DIR "charge_now", "0\n");
+    test_WriteSysfsFile(MONITOR_DIR "charge_counter", "500000\n");
+
+    le_cfg_QuickSetString("batteryInfo/type", "LiPo");
+    le_cfg_QuickSetInt("batteryInfo/capacity", 1000);
+    le_cfg_QuickSetInt("batteryInfo/voltage", 3700);
+    le_cfg_QuickSetInt("batteryInfo/percent", 60);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * @return true once the saved charge level has been written to the battery monitor.
+ */
+//--------------------------------------------------------------------------------------------------
+static bool IsChargeLevelWritten
+(
+    void
+)
+{
+    return (test_ReadSysfsInt(MONITOR_DIR "charge_now") != 0);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * @return true once the charge level percentage has been pushed to the Data Hub.
+ */
+//--------------------------------------------------------------------------------------------------
+static bool IsPercentPushed
+(
+    void
+)
+{
+    double timestamp, value;
+
+    return (dhubIO_GetNumericValue("percent", &timestamp, &value) == LE_OK);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * The saved charge level is restored, and written to the battery monitor by the sampler thread.
+ */
+//--------------------------------------------------------------------------------------------------
+static void TestRestore
+(
+    void
+)
+{
+    CHECK(test_RunUntil(IsChargeLevelWritten, 5000));
+    CHECK(test_ReadSysfsInt(MONITOR_DIR "charge_now") == 600000);
+
+    double voltage, temp;
+    uint16_t percent, charge;
+    uint8_t confidence;
+
+    CHECK(ma_battery_GetHealthStatus() == MA_BATTERY_GOOD);
+    CHECK_RESULT(ma_battery_GetVoltage(&voltage), LE_OK);
+    CHECK(voltage == 3.9);
+    CHECK_RESULT(ma_battery_GetTemp(&temp), LE_OK);
+    CHECK(temp == 25.0);
+    CHECK_RESULT(ma_battery_GetChargeRemaining(&charge), LE_OK);
+    CHECK(charge == 600);
+    CHECK_RESULT(ma_battery_GetPercentRemaining(&percent), LE_OK);
+    CHECK(percent == 60);
+    CHECK_RESULT(ma_battery_GetPercentConfidence(&confidence), LE_OK);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Each tick of the polling timer runs the state machine on a new sample, which is then pushed to
+ * the Data Hub.
+ */
+//--------------------------------------------------------------------------------------------------
+static void TestTick
+(
+    void
+)
+{
+    CHECK(!IsPercentPushed());
+
+    admin_PushNumeric("/app/battery/period", 0, 0.01);
+    CHECK(test_RunUntil(IsPercentPushed, 5000));
+
+    double timestamp, value;
+    CHECK_RESULT(dhubIO_GetNumericValue("percent", &timestamp, &value), LE_OK);
+    CHECK(value == 60);
+    CHECK_RESULT(dhubIO_GetNumericValue("V", &timestamp, &value), LE_OK);
+    CHECK(value == 3.9);
+
+    CHECK(ma_battery_GetChargingStatus() == MA_BATTERY_DISCHARGING);
+    CHECK(le_cfg_QuickGetInt("batteryInfo/percent", -1) == 60);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Configuring a different battery forgets the saved charge level, which is unknown until the new
+ * battery has been detected.
+ */
+//--------------------------------------------------------------------------------------------------
+static void TestNewBattery
+(
+    void
+)
+{
+    ma_adminbattery_SetTechnology("LiIon", 2000, 3600);
+
+    CHECK(le_cfg_QuickGetInt("batteryInfo/capacity", -1) == 2000);
+    CHECK(le_cfg_QuickGetInt("batteryInfo/percent", -1) == -1);
+
+    uint16_t percent;
+    CHECK_RESULT(ma_battery_GetPercentRemaining(&percent), LE_NOT_FOUND);
+    CHECK(ma_battery_GetChargingStatus() == MA_BATTERY_CHARGING_UNKNOWN);
+}
+
+
+int main
+(
+    void
+)
+{
+    test_CreateSysfsRoot("redTest");
+    CreateHardware();
+
+    _batteryCore_COMPONENT_INIT();
+    _batteryComponentRed_COMPONENT_INIT();
+
+    TestRestore();
+    TestTick();
+    TestNewBattery();
+
+    return test_Finish();
+}
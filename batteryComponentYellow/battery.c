@@ -5,9 +5,11 @@
  * This file provides control and monitoring of the power supply battery via the @ref c_battery and
  * the Data Hub.
  *
- * This module operates as a state machine.  See the State variable definition.
- *
- * Data Hub integration uses the Data Hub's psensor component.
+ * It is the battery backend for the BQ27426 fuel gauge and BQ25601 charger.  Everything that
+ * doesn't depend on this hardware (the ma_battery API, the sampler thread, the pushes to the Data
+ * Hub and the state kept in the Config Tree) is implemented by batteryCore.  This file reads the
+ * driver files, and requests a sample to push once per period (the "period" Data Hub config
+ * resource).
  *
  * <hr>
  *
@@ -16,456 +18,74 @@
 
 #include "legato.h"
 #include "interfaces.h"
-// This is necessary because we can't alias a types-only API due to a bug in Legato.
-#define dhubIO_DataType_t io_DataType_t
-#include "periodicSensor.h"
+#include "batteryCore.h"
 #include "batteryUtils.h"
-
-/// Example JSON value
-#define JSON_EXAMPLE "{\"health\":\"good\",\"percent\":100,\"mAh\":2200,"\
-                      "\"charging\":true,\"mA\":2.838,\"V\":3.7,\"degC\":32.1}"
+#include "powerSupply.h"
+#include "stateOfHealth.h"
+#include "trace.h"
 
 #define WORST_CASE_ALARM_LAG_MS 5000
 
+/// Default time between pushes to the Data Hub (ms).
+#define DEFAULT_PUSH_PERIOD_MS 10000
+
+/// Push interval used while replaying a trace (ms).  Each push reads the next recorded sample,
+/// whose recorded time drives the clock, so the replay runs as fast as the samples can be taken
+/// instead of at the push period's pace.
+#define REPLAY_TIMER_INTERVAL_MS 1
+
+/// Time between pushes in seconds.
+#define RES_PATH_PERIOD "period"
+
+#define MS_PER_HOUR (1000 * 60 * 60)
+
 // Sysfs file paths used to interface with the battery charger and fuel gauge kernel drivers.
-static const char HealthFilePath[]  = "/sys/class/power_supply/bq25601-battery/health";
-static const char StatusFilePath[]  = "/sys/class/power_supply/bq25601-battery/status";
-#define MONITOR_DIR_PATH "/sys/class/power_supply/BQ27246"
+// These are relative to the sysfs root (see util_GetSysfsRoot()).
+static const char HealthFilePath[]  = "class/power_supply/bq25601-battery/health";
+static const char StatusFilePath[]  = "class/power_supply/bq25601-battery/status";
+#define MONITOR_DIR_PATH "class/power_supply/BQ27246"
 static const char VoltageFilePath[] = MONITOR_DIR_PATH "/voltage_now";
 static const char TempFilePath[]    = MONITOR_DIR_PATH "/temp";
 static const char ChargeNowFilePath[] = MONITOR_DIR_PATH "/charge_now";
 static const char CurrentNowFilePath[]  = MONITOR_DIR_PATH "/current_now";
 static const char PresentFilePath[] = MONITOR_DIR_PATH "/present";
 static const char ChargeMaxFilePath[] = MONITOR_DIR_PATH "/charge_full";
-
-static le_mem_PoolRef_t LevelAlarmPool;
-static le_ref_MapRef_t LevelAlarmRefMap;
-
-static le_mem_PoolRef_t ChargingStatusRegPool;
-static le_ref_MapRef_t ChargingStatusRegRefMap;
-
-static le_mem_PoolRef_t HealthStatusRegPool;
-static le_ref_MapRef_t HealthStatusRegRefMap;
+static const char ChargeDesignFilePath[] = MONITOR_DIR_PATH "/charge_full_design";
+
+/// Handles of the sysfs files listed above.  Opened once in COMPONENT_INIT and kept open.
+static util_FileRef_t HealthFile;
+static util_FileRef_t StatusFile;
+static util_FileRef_t VoltageFile;
+static util_FileRef_t TempFile;
+static util_FileRef_t ChargeNowFile;
+static util_FileRef_t CurrentNowFile;
+static util_FileRef_t PresentFile;
+static util_FileRef_t ChargeMaxFile;
 
 /// Timer used to ensure that alarms and other notifications requested via the Battery API don't
 /// get sampled slower than WORST_CASE_ALARM_LAG_MS.
 static le_timer_Ref_t ApiCallbackCheckTimer;
 
-/// Enumeration of possible types of alarm.
-typedef enum
-{
-    LEVEL_HIGH, ///< Level was higher than high alarm threshold.
-    LEVEL_LOW,  ///< Level was lower that low alarm threshold.
-    LEVEL_NONE, ///< No alarm.
-}
-LevelAlarmType_t;
-
-/// Holds percentage level alarm call-back registration information.
-typedef struct
-{
-    uint8_t percentageHigh;
-    uint8_t percentageLow;
-    LevelAlarmType_t lastAlarmType;
-
-    ma_battery_LevelPercentageHandlerFunc_t handler;
-    void *clientContext;
-    le_msg_SessionRef_t clientSessionRef;
-}
-LevelAlarmReg_t;
-
-/// Holds charging status change notification call-back registration information.
+/// Holds one sample of all battery values, captured in a single pass over the driver files.
 typedef struct
 {
-    ma_battery_ChargingStatusHandlerFunc_t handler;
-    void *clientContext;
-    le_msg_SessionRef_t clientSessionRef;
-}
-ChargingStatusReg_t;
-
-/// Holds health status change notification call-back registration information.
-typedef struct
-{
-    ma_battery_HealthHandlerFunc_t handler;
-    void *clientContext;
-    le_msg_SessionRef_t clientSessionRef;
-}
-HealthStatusReg_t;
-
-
-//--------------------------------------------------------------------------------------------------
-/**
- * Get a printable string describing a health status code.
- *
- * @return Ptr to the null-terminated string.
- */
-//--------------------------------------------------------------------------------------------------
-static const char* GetHealthStr
-(
-    ma_battery_HealthStatus_t healthCode
-)
-{
-    switch (healthCode)
-    {
-        case MA_BATTERY_OVERVOLTAGE:        return "overvoltage";
-        case MA_BATTERY_GOOD:               return "good";
-        case MA_BATTERY_COLD:               return "cold";
-        case MA_BATTERY_HOT:                return "hot";
-        case MA_BATTERY_DISCONNECTED:       return "disconnected";
-        case MA_BATTERY_HEALTH_UNKNOWN:     return "unknown";
-        case MA_BATTERY_HEALTH_ERROR:       return "error";
-    }
-
-    LE_CRIT("Unexpected health code %d.", healthCode);
-
-    return "unknown";
+    bool isPresent;                         ///< true if a battery is connected.
+    ma_battery_HealthStatus_t health;       ///< DISCONNECTED if the battery is not present.
+    ma_battery_ChargingStatus_t chargingStatus; ///< CHARGING_UNKNOWN if not present.
+    uint charge;                            ///< Charge remaining (mAh).
+    uint capacity;                          ///< Estimated full charge (mAh).
+    uint percentage;                        ///< Charge remaining (%).
+    double voltage;                         ///< Battery voltage (V).
+    double current;                         ///< Current flow (mA).
+    double temperature;                     ///< Battery temperature (degrees C).
 }
+Snapshot_t;
 
+/// Timer that requests the samples to push to the Data Hub.
+static le_timer_Ref_t PushTimer;
 
-//--------------------------------------------------------------------------------------------------
-/**
- * Stop the API Callback Check Timer if no callbacks are currently registered.
- */
-//--------------------------------------------------------------------------------------------------
-static void StopTimerIfNoCallbacksRegistered
-(
-    void
-)
-{
-    if (   (le_ref_NextNode(le_ref_GetIterator(HealthStatusRegRefMap)) != LE_OK)
-        && (le_ref_NextNode(le_ref_GetIterator(LevelAlarmRefMap)) != LE_OK)
-        && (le_ref_NextNode(le_ref_GetIterator(ChargingStatusRegRefMap)) != LE_OK)  )
-    {
-        le_timer_Stop(ApiCallbackCheckTimer);
-    }
-}
-
-
-//--------------------------------------------------------------------------------------------------
-/**
- * Register a callback function to be called when the Percentage Level changes as follows:
- *
- * Notify the client via call-back if the level goes above percentageHigh or below percentageLow.
- */
-//--------------------------------------------------------------------------------------------------
-ma_battery_LevelPercentageHandlerRef_t ma_battery_AddLevelPercentageHandler
-(
-    uint8_t percentageLow,  ///< Low percentage trigger threshold (0 = no low level alarm)
-    uint8_t percentageHigh, ///< High percentage trigger threshold (>=100 means no high alm)
-    ma_battery_LevelPercentageHandlerFunc_t handler,
-    void *context
-)
-{
-    if (percentageHigh > 100)
-    {
-        LE_ERROR("High percentage can't be higher than 100");
-        return NULL;
-    }
-    else if (percentageHigh < percentageLow)
-    {
-        LE_ERROR("High percentage can't be less than low percentage");
-        return NULL;
-    }
-
-    LevelAlarmReg_t *reg = le_mem_ForceAlloc(LevelAlarmPool);
-    reg->percentageLow                 = percentageLow;
-    reg->percentageHigh                = percentageHigh;
-    reg->lastAlarmType                 = LEVEL_NONE;
-    reg->handler                       = handler;
-    reg->clientContext                 = context;
-    reg->clientSessionRef              = ma_battery_GetClientSessionRef();
-
-    void* safeRef = le_ref_CreateRef(LevelAlarmRefMap, reg);
-
-    // Start the API callback check timer if it isn't already running.
-    (void)le_timer_Start(ApiCallbackCheckTimer);
-
-    return safeRef;
-}
-
-
-//--------------------------------------------------------------------------------------------------
-/**
- * Deregister a callback function registered using ma_battery_AddLevelPercentageHandler().
- */
-//--------------------------------------------------------------------------------------------------
-void ma_battery_RemoveLevelPercentageHandler
-(
-    ma_battery_LevelPercentageHandlerRef_t handlerRef
-)
-{
-    LevelAlarmReg_t *reg = le_ref_Lookup(LevelAlarmRefMap, handlerRef);
-    if (reg == NULL)
-    {
-        LE_ERROR("Failed to lookup event based on handle");
-    }
-    else
-    {
-        if (reg->clientSessionRef == ma_battery_GetClientSessionRef())
-        {
-            le_ref_DeleteRef(LevelAlarmRefMap, handlerRef);
-            le_mem_Release(reg);
-
-            StopTimerIfNoCallbacksRegistered();
-        }
-        else
-        {
-            LE_ERROR("Remove invalid event handleRef");
-        }
-    }
-}
-
-
-//--------------------------------------------------------------------------------------------------
-/**
- * Checks the list of registered battery level alarm thresholds to see if an alarm event should be
- * reported.  If so, reports them.
- */
-//--------------------------------------------------------------------------------------------------
-static void ReportBatteryLevelAlarms
-(
-    uint8_t percentage
-)
-{
-    le_ref_IterRef_t it = le_ref_GetIterator(LevelAlarmRefMap);
-    bool finished = (le_ref_NextNode(it) != LE_OK);
-    while (!finished)
-    {
-        LevelAlarmReg_t *reg = le_ref_GetValue(it);
-        LE_ASSERT(reg != NULL);
-        if ((percentage > reg->percentageHigh) && (reg->lastAlarmType != LEVEL_HIGH))
-        {
-            reg->handler(percentage, reg->percentageHigh, true, reg->clientContext);
-            reg->lastAlarmType = LEVEL_HIGH;
-        }
-        else if ((percentage < reg->percentageLow) && (reg->lastAlarmType != LEVEL_LOW))
-        {
-            reg->handler(percentage, reg->percentageLow, false, reg->clientContext);
-            reg->lastAlarmType = LEVEL_LOW;
-        }
-
-        finished = (le_ref_NextNode(it) != LE_OK);
-    }
-}
-
-
-//--------------------------------------------------------------------------------------------------
-/**
- * Add handler function for EVENT 'ma_battery_ChargingStatusChange'
- *
- * Register a callback function to be called when there is a change in battery charging status.
- */
-//--------------------------------------------------------------------------------------------------
-ma_battery_ChargingStatusChangeHandlerRef_t ma_battery_AddChargingStatusChangeHandler
-(
-    ma_battery_ChargingStatusHandlerFunc_t handler,
-    void *context
-)
-{
-    ChargingStatusReg_t *reg = le_mem_ForceAlloc(ChargingStatusRegPool);
-
-    reg->handler                        = handler;
-    reg->clientContext                  = context;
-    reg->clientSessionRef               = ma_battery_GetClientSessionRef();
-
-    void* safeRef = le_ref_CreateRef(ChargingStatusRegRefMap, reg);
-
-    // Start the API callback check timer if it isn't already running.
-    (void)le_timer_Start(ApiCallbackCheckTimer);
-
-    return safeRef;
-}
-
-
-//--------------------------------------------------------------------------------------------------
-/**
- * Remove handler function for EVENT 'ma_battery_ChargingStatusChange'
- */
-//--------------------------------------------------------------------------------------------------
-void ma_battery_RemoveChargingStatusChangeHandler
-(
-    ma_battery_ChargingStatusChangeHandlerRef_t handlerRef
-)
-{
-    ChargingStatusReg_t *reg = le_ref_Lookup(ChargingStatusRegRefMap, handlerRef);
-    if (reg == NULL)
-    {
-        LE_ERROR("Failed to lookup event based on handle %p", handlerRef);
-    }
-    else
-    {
-        if (reg->clientSessionRef == ma_battery_GetClientSessionRef())
-        {
-            le_ref_DeleteRef(ChargingStatusRegRefMap, handlerRef);
-            le_mem_Release(reg);
-
-            StopTimerIfNoCallbacksRegistered();
-        }
-        else
-        {
-            LE_ERROR("Attempt to remove another client's Alarm Health event handleRef %p",
-                     handlerRef);
-        }
-    }
-}
-
-
-//--------------------------------------------------------------------------------------------------
-/**
- * Report a change in the charging status to any registered charging status handlers.
- */
-//--------------------------------------------------------------------------------------------------
-static void ReportChargingStatusChange
-(
-    ma_battery_ChargingStatus_t status
-)
-{
-    static ma_battery_ChargingStatus_t oldStatus = MA_BATTERY_CHARGING_UNKNOWN;
-
-    if (oldStatus != status)
-    {
-        oldStatus = status;
-
-        le_ref_IterRef_t it = le_ref_GetIterator(ChargingStatusRegRefMap);
-        bool finished       = le_ref_NextNode(it) != LE_OK;
-        while (!finished)
-        {
-            ChargingStatusReg_t *reg = le_ref_GetValue(it);
-            LE_ASSERT(reg != NULL);
-
-            reg->handler(status, reg->clientContext);
-            finished = (le_ref_NextNode(it) != LE_OK);
-        }
-    }
-}
-
-
-//--------------------------------------------------------------------------------------------------
-/**
- * Add handler function for EVENT 'ma_battery_HealthChange'
- *
- * Register a callback function to be called when there is a change in battery health status.
- */
-//--------------------------------------------------------------------------------------------------
-ma_battery_HealthChangeHandlerRef_t ma_battery_AddHealthChangeHandler
-(
-    ma_battery_HealthHandlerFunc_t handler,
-    void *context
-)
-{
-    HealthStatusReg_t *reg = le_mem_ForceAlloc(HealthStatusRegPool);
-    reg->handler                        = handler;
-    reg->clientContext                  = context;
-    reg->clientSessionRef               = ma_battery_GetClientSessionRef();
-
-    void* safeRef = le_ref_CreateRef(HealthStatusRegRefMap, reg);
-
-    // Start the API callback check timer if it isn't already running.
-    (void)le_timer_Start(ApiCallbackCheckTimer);
-
-    return safeRef;
-}
-
-
-//--------------------------------------------------------------------------------------------------
-/**
- * Remove handler function for EVENT 'ma_battery_HealthChange'
- */
-//--------------------------------------------------------------------------------------------------
-void ma_battery_RemoveHealthChangeHandler
-(
-    ma_battery_HealthChangeHandlerRef_t handlerRef
-)
-{
-    HealthStatusReg_t *reg = le_ref_Lookup(HealthStatusRegRefMap, handlerRef);
-    if (reg == NULL)
-    {
-        LE_ERROR("Failed to lookup event based on handle %p", handlerRef);
-    }
-    else
-    {
-        if (reg->clientSessionRef == ma_battery_GetClientSessionRef())
-        {
-            le_ref_DeleteRef(HealthStatusRegRefMap, handlerRef);
-            le_mem_Release(reg);
-
-            StopTimerIfNoCallbacksRegistered();
-        }
-        else
-        {
-            LE_ERROR("Attempt to remove another client's Alarm Health event handleRef %p",
-                     handlerRef);
-        }
-    }
-}
-
-
-//--------------------------------------------------------------------------------------------------
-/**
- * Reports a change in the health status to any registered health status change event handlers.
- */
-//--------------------------------------------------------------------------------------------------
-static void ReportHealthStatusChange
-(
-    ma_battery_HealthStatus_t healthStatus
-)
-{
-    static ma_battery_HealthStatus_t oldStatus = MA_BATTERY_HEALTH_UNKNOWN;
-
-    if (oldStatus != healthStatus)
-    {
-        oldStatus = healthStatus;
-
-        le_ref_IterRef_t it = le_ref_GetIterator(HealthStatusRegRefMap);
-        while (le_ref_NextNode(it) == LE_OK)
-        {
-            HealthStatusReg_t *reg = le_ref_GetValue(it);
-            LE_ASSERT(reg != NULL);
-            reg->handler(healthStatus, reg->clientContext);
-        }
-    }
-}
-
-
-//--------------------------------------------------------------------------------------------------
-/**
- * Compute the percentage of battery charge given the energy charge level and the capacity.
- *
- * @return The percentage.
- */
-//--------------------------------------------------------------------------------------------------
-static uint ComputePercentage
-(
-    uint charge,
-    uint capacity
-)
-{
-    uint percentage = 0;
-
-    // Clamp at 100%
-    if (charge > capacity)
-    {
-        LE_ERROR("Battery monitor reports available charge (%u mAh) higher than maximum of %u mAh.",
-                 charge,
-                 capacity);
-        percentage = 100;
-    }
-    else if (capacity == 0) // Catch a zero capacity to avoid a divide by zero.
-    {
-        percentage = 0;
-    }
-    else
-    {
-        // Compute the battery charge percentage, rounding up from half a percent or higher.
-        uint percentTimesTen = 1000 * charge / capacity;
-        percentage = (percentTimesTen / 10);
-        if ((percentTimesTen % 10) >= 5)
-        {
-            percentage += 1;
-        }
-    }
-
-    return percentage;
-}
+/// Capacity of the battery when new (mAh), as configured in the fuel gauge, or 0 if unknown.
+static uint DesignCapacity;
 
 
 //--------------------------------------------------------------------------------------------------
@@ -481,10 +101,12 @@ static bool BatteryPresent
 )
 {
     int present;
-    le_result_t result = util_ReadIntFromFile(PresentFilePath, &present);
+    le_result_t result = util_ReadIntFromHandle(PresentFile, &present);
     if (result != LE_OK)
     {
-        LE_FATAL("Failed to read file '%s' (%s).", PresentFilePath, LE_RESULT_TXT(result));
+        LE_FATAL("Failed to read file '%s' (%s).",
+                 util_GetFilePath(PresentFile),
+                 LE_RESULT_TXT(result));
     }
 
     LE_DEBUG("Battery presence= %d.", present);
@@ -505,39 +127,14 @@ static ma_battery_ChargingStatus_t ReadChargingStatus
     void
 )
 {
-    char chargingStatus[512];
-    le_result_t r = util_ReadStringFromFile(StatusFilePath, chargingStatus, sizeof(chargingStatus));
+    util_PowerSupplyStatus_t status;
+    le_result_t r = util_ReadPowerSupplyStatus(StatusFile, &status);
 
-    if (r == LE_OK)
+    if ((r == LE_OK) || (r == LE_NOT_FOUND))
     {
-        LE_DEBUG("Charging status = '%s'.", chargingStatus);
+        LE_DEBUG("Charging status = %d.", status);
 
-        if (strcmp(chargingStatus, "Discharging") == 0)
-        {
-            return MA_BATTERY_DISCHARGING;
-        }
-        else if (strcmp(chargingStatus, "Charging") == 0)
-        {
-            return MA_BATTERY_CHARGING;
-        }
-        else if (strcmp(chargingStatus, "Full") == 0)
-        {
-            return MA_BATTERY_FULL;
-        }
-        else if (strcmp(chargingStatus, "Not charging") == 0)
-        {
-            return MA_BATTERY_NOT_CHARGING;
-        }
-        else if (strcmp(chargingStatus, "Unknown") == 0)
-        {
-            return MA_BATTERY_CHARGING_UNKNOWN;
-        }
-        else
-        {
-            LE_ERROR("Unrecognized charging status '%s'.", chargingStatus);
-
-            return MA_BATTERY_CHARGING_ERROR;
-        }
+        return core_GetChargingStatusCode(status);
     }
     else
     {
@@ -561,11 +158,13 @@ static uint ReadCapacity
 )
 {
     int uAhCapacity;
-    le_result_t result = util_ReadIntFromFile(ChargeMaxFilePath, &uAhCapacity);
+    le_result_t result = util_ReadIntFromHandle(ChargeMaxFile, &uAhCapacity);
 
     if (result != LE_OK)
     {
-        LE_FATAL("Failed to read file '%s' (%s).", ChargeMaxFilePath, LE_RESULT_TXT(result));
+        LE_FATAL("Failed to read file '%s' (%s).",
+                 util_GetFilePath(ChargeMaxFile),
+                 LE_RESULT_TXT(result));
     }
 
     if (uAhCapacity < 0)
@@ -584,86 +183,63 @@ static uint ReadCapacity
 
 //--------------------------------------------------------------------------------------------------
 /**
- * Read the battery health status from the driver.
+ * Read the capacity of the battery when new, as configured in the battery monitor.
  *
- * @return the battery health status code.
+ * @return Design capacity in mAh, or 0 if it can't be read.
  */
 //--------------------------------------------------------------------------------------------------
-static ma_battery_HealthStatus_t ReadHealthStatus
+static uint ReadDesignCapacity
 (
     void
 )
 {
-    char healthValue[32];
-    le_result_t r = util_ReadStringFromFile(HealthFilePath, healthValue, sizeof(healthValue));
+    util_FileRef_t fileRef = util_OpenSysfsFile(ChargeDesignFilePath, O_RDONLY);
 
-    if (r == LE_OK)
+    int uAhCapacity;
+    le_result_t result = util_ReadIntFromHandle(fileRef, &uAhCapacity);
+
+    if (result != LE_OK)
     {
-        if (strcmp(healthValue, "Good") == 0)
-        {
-            return MA_BATTERY_GOOD;
-        }
-        else if (strcmp(healthValue, "Overvoltage") == 0)
-        {
-            return MA_BATTERY_OVERVOLTAGE;
-        }
-        else if (strcmp(healthValue, "Cold") == 0)
-        {
-            return MA_BATTERY_COLD;
-        }
-        else if (strcmp(healthValue, "Overheat") == 0)
-        {
-            return MA_BATTERY_HOT;
-        }
-        else
-        {
-            LE_ERROR("Unrecognized health string from driver: '%s'.", healthValue);
-            return MA_BATTERY_HEALTH_ERROR;
-        }
+        LE_WARN("Failed to read file '%s' (%s). State of health won't be tracked.",
+                util_GetFilePath(fileRef),
+                LE_RESULT_TXT(result));
+        uAhCapacity = 0;
     }
-    else
+    else if (uAhCapacity < 0)
     {
-        return MA_BATTERY_HEALTH_ERROR;
+        LE_ERROR("Design capacity of battery is negative? (%d uAh)", uAhCapacity);
+        uAhCapacity = 0;
     }
-}
 
+    util_CloseFile(fileRef);
 
-//--------------------------------------------------------------------------------------------------
-/**
- * Provides battery health status
- *
- * @return Health status code.
- */
-//--------------------------------------------------------------------------------------------------
-ma_battery_HealthStatus_t ma_battery_GetHealthStatus
-(
-    void
-)
-{
-    return ReadHealthStatus();
+    return (uint)uAhCapacity / 1000;
 }
 
 
 //--------------------------------------------------------------------------------------------------
 /**
- * Provides battery charging status
+ * Read the battery health status from the driver.
  *
- * @return Charging status code.
+ * @return the battery health status code.
  */
 //--------------------------------------------------------------------------------------------------
-ma_battery_ChargingStatus_t ma_battery_GetChargingStatus
+static ma_battery_HealthStatus_t ReadHealthStatus
 (
     void
 )
 {
-    ma_battery_ChargingStatus_t status = MA_BATTERY_CHARGING_UNKNOWN;
+    util_PowerSupplyHealth_t health;
+    le_result_t r = util_ReadPowerSupplyHealth(HealthFile, &health);
 
-    if (BatteryPresent())
+    if ((r == LE_OK) || (r == LE_NOT_FOUND))
     {
-        status = ReadChargingStatus();
+        return core_GetHealthStatusCode(health);
+    }
+    else
+    {
+        return MA_BATTERY_HEALTH_ERROR;
     }
-
-    return status;
 }
 
 
@@ -680,42 +256,18 @@ static double ReadVoltage
 )
 {
     int uV;
-    le_result_t result = util_ReadIntFromFile(VoltageFilePath, &uV);
+    le_result_t result = util_ReadIntFromHandle(VoltageFile, &uV);
     if (result != LE_OK)
     {
-        LE_FATAL("Failed to read file '%s' (%s).", VoltageFilePath, LE_RESULT_TXT(result));
+        LE_FATAL("Failed to read file '%s' (%s).",
+                 util_GetFilePath(VoltageFile),
+                 LE_RESULT_TXT(result));
     }
 
     return ((double)uV) / 1000000.0;
 }
 
 
-//--------------------------------------------------------------------------------------------------
-/**
- * Get battery voltage (in Volts)
- *
- * @return
- *      - LE_OK on success.
- */
-//--------------------------------------------------------------------------------------------------
-le_result_t ma_battery_GetVoltage
-(
-    double *volt    ///< [out] The battery voltage, in V, if LE_OK is returned.
-)
-{
-    if (BatteryPresent())
-    {
-        *volt = ReadVoltage();
-
-        return LE_OK;
-    }
-    else
-    {
-        return LE_NOT_FOUND;
-    }
-}
-
-
 //--------------------------------------------------------------------------------------------------
 /**
  * Read from the driver the electrical current flow in/out of the battery at this time.
@@ -729,10 +281,12 @@ static double ReadCurrent
 )
 {
     int uACurrent;
-    le_result_t result = util_ReadIntFromFile(CurrentNowFilePath, &uACurrent);
+    le_result_t result = util_ReadIntFromHandle(CurrentNowFile, &uACurrent);
     if (result != LE_OK)
     {
-        LE_FATAL("Failed to read file '%s' (%s).", CurrentNowFilePath, LE_RESULT_TXT(result));
+        LE_FATAL("Failed to read file '%s' (%s).",
+                 util_GetFilePath(CurrentNowFile),
+                 LE_RESULT_TXT(result));
     }
 
     double mA = ((double)uACurrent) / 1000.0;
@@ -743,31 +297,6 @@ static double ReadCurrent
 }
 
 
-//--------------------------------------------------------------------------------------------------
-/**
- * Get current now (in mA)
- *
- * @return
- *      - LE_OK on success.
- */
-//--------------------------------------------------------------------------------------------------
-le_result_t ma_battery_GetCurrent
-(
-    double *current ///< [out] The current, in mA, if LE_OK is returned.
-)
-{
-    if (BatteryPresent())
-    {
-        *current = ReadCurrent();
-        return LE_OK;
-    }
-    else
-    {
-        return LE_NOT_FOUND;
-    }
-}
-
-
 //--------------------------------------------------------------------------------------------------
 /**
  * Read the battery temperature from the driver.
@@ -782,40 +311,15 @@ static double ReadTemperature
 {
     int deciDegs;  // Tenths of a degree Celcius.
 
-    le_result_t r = util_ReadIntFromFile(TempFilePath, &deciDegs);
+    le_result_t r = util_ReadIntFromHandle(TempFile, &deciDegs);
 
-    LE_FATAL_IF(r != LE_OK, "Unable to read from file (%s): %s", TempFilePath, LE_RESULT_TXT(r));
+    LE_FATAL_IF(r != LE_OK, "Unable to read from file (%s): %s",
+                util_GetFilePath(TempFile), LE_RESULT_TXT(r));
 
     return ((double)deciDegs) / 10.0;
 }
 
 
-//--------------------------------------------------------------------------------------------------
-/**
- * Get battery temperature in degrees Celcius
- *
- * @return
- *      - LE_OK on success.
- */
-//--------------------------------------------------------------------------------------------------
-le_result_t ma_battery_GetTemp
-(
-    double *temp    ///< [out] The battery temperature, in degrees C, if LE_OK is returned.
-)
-{
-    if (BatteryPresent())
-    {
-        *temp = ReadTemperature();
-
-        return LE_OK;
-    }
-    else
-    {
-        return LE_NOT_FOUND;
-    }
-}
-
-
 //--------------------------------------------------------------------------------------------------
 /**
  * Read the charge remaining in the battery from the driver.
@@ -830,10 +334,12 @@ static uint ReadChargeRemaining
 {
     int uAh;
 
-    le_result_t r = util_ReadIntFromFile(ChargeNowFilePath, &uAh);
+    le_result_t r = util_ReadIntFromHandle(ChargeNowFile, &uAh);
     if (r != LE_OK)
     {
-        LE_FATAL("Failed (%s) to read file (%s).", LE_RESULT_TXT(r), ChargeNowFilePath);
+        LE_FATAL("Failed (%s) to read file (%s).",
+                 LE_RESULT_TXT(r),
+                 util_GetFilePath(ChargeNowFile));
     }
 
     if (uAh < 0)
@@ -852,140 +358,173 @@ static uint ReadChargeRemaining
 
 //--------------------------------------------------------------------------------------------------
 /**
- * Get Charge Remaining in mAh
+ * Take a new snapshot of the battery state, reading each driver file once.  Runs in the sampler
+ * thread (or in core_StartSampling(), before the sampler thread is started).
  *
- * @return
- *      - LE_OK if successful.
+ * If the battery is not present, only the presence file is read and the other values are zeroed.
  */
 //--------------------------------------------------------------------------------------------------
-le_result_t ma_battery_GetChargeRemaining
+static void ReadSample
 (
-    uint16_t *charge    ///< The battery charge remaining, in mAh, if LE_OK is returned.
+    void *samplePtr     ///< [out] Snapshot_t
 )
 {
-    if (BatteryPresent())
-    {
-        *charge = ReadChargeRemaining();
-        return LE_OK;
-    }
-    else
+    Snapshot_t *snapPtr = samplePtr;
+
+    memset(snapPtr, 0, sizeof(*snapPtr));
+    snapPtr->health = MA_BATTERY_DISCONNECTED;
+    snapPtr->chargingStatus = MA_BATTERY_CHARGING_UNKNOWN;
+
+    snapPtr->isPresent = BatteryPresent();
+    if (snapPtr->isPresent)
     {
-        return LE_NOT_FOUND;
+        snapPtr->health = ReadHealthStatus();
+        snapPtr->chargingStatus = ReadChargingStatus();
+        snapPtr->charge = ReadChargeRemaining();
+        snapPtr->capacity = ReadCapacity();
+        snapPtr->percentage = core_ComputePercentage(snapPtr->charge, snapPtr->capacity);
+        snapPtr->voltage = ReadVoltage();
+        snapPtr->current = ReadCurrent();
+        snapPtr->temperature = ReadTemperature();
     }
 }
 
 
 //--------------------------------------------------------------------------------------------------
 /**
- * Get charge remaining, in percentage
+ * Count the charge drawn since the last snapshot in the state of health, from the current, before
+ * batteryCore reports and pushes the snapshot.
  *
- * @return
- *      - LE_OK if successful
- *      - LE_IO_ERROR
- *      - LE_NOT_FOUND
+ * @return true, as every snapshot can be reported.
  */
 //--------------------------------------------------------------------------------------------------
-le_result_t ma_battery_GetPercentRemaining
+static bool ProcessSample
 (
-    uint16_t *percentage    ///< [out] The percent of charge remaining, if LE_OK is returned.
+    const void *samplePtr,      ///< Snapshot_t
+    le_clk_Time_t time,         ///< When the snapshot was taken (monotonic clock).
+    uint32_t reasons            ///< Sample request flags.
 )
 {
-    le_result_t result = LE_NOT_FOUND;
+    static bool wasPresent = false;
+    static le_clk_Time_t lastTime;
 
-    if (BatteryPresent())
-    {
-        uint capacity = ReadCapacity();
+    const Snapshot_t *snapPtr = samplePtr;
+    util_StateOfHealth_t *sohPtr = core_GetStateOfHealth();
 
-        // If the capacity is not known, then
-        if (capacity == 0)
+    if (snapPtr->isPresent)
+    {
+        if (wasPresent)
         {
-            LE_WARN("Battery capacity unknown.");
+            le_clk_Time_t elapsed = le_clk_Sub(time, lastTime);
+            double ms = (double)elapsed.sec * 1000 + (double)elapsed.usec / 1000;
+            util_CountSohCharge(sohPtr, snapPtr->current * ms / MS_PER_HOUR);
         }
-        else
-        {
-            uint remaining = ReadChargeRemaining();
-
-            *percentage = ComputePercentage(remaining, capacity);
+        util_SetSohFullCapacity(sohPtr, snapPtr->capacity);
+    }
+    wasPresent = snapPtr->isPresent;
+    lastTime = time;
 
-            result = LE_OK;
-        }
+    if (reasons & CORE_SAMPLE_FOR_PUSH)
+    {
+        // Restart the timer that is used to ensure a minimum polling frequency for the
+        // alarms and status change reports for API clients.
+        le_timer_Restart(ApiCallbackCheckTimer);
     }
 
-    return result;
+    return true;
 }
 
 
 //--------------------------------------------------------------------------------------------------
 /**
- * Push an update to the value resource in the Data Hub.
+ * Map a snapshot to the battery values.  Only the status is known while the battery is not
+ * present.
  */
 //--------------------------------------------------------------------------------------------------
-static void PushToDataHub
+static void GetValues
 (
-    psensor_Ref_t psensorRef,
-    void *context
+    const void *samplePtr,      ///< Snapshot_t
+    core_Values_t *valuesPtr    ///< [out]
 )
-//--------------------------------------------------------------------------------------------------
 {
-    ma_battery_HealthStatus_t healthStatus = MA_BATTERY_DISCONNECTED;
-    ma_battery_ChargingStatus_t chargingStatus = MA_BATTERY_CHARGING_UNKNOWN;
-    bool isCharging = false;
-    uint charge = 0;
-    uint percentage = 0;
-    double voltage = 0.0;
-    double current = 0.0;
-    double temperature = 0.0;
-
-    if (BatteryPresent())
+    const Snapshot_t *snapPtr = samplePtr;
+
+    ma_battery_SnapshotField_t validFields = MA_BATTERY_FIELD_CHARGING_STATUS
+                                           | MA_BATTERY_FIELD_HEALTH;
+
+    if (snapPtr->isPresent)
     {
-        healthStatus = ReadHealthStatus();
-        chargingStatus = ReadChargingStatus();
-        // Note: The battery monitor shows FULL only when on external power.
-        isCharging = (   (chargingStatus == MA_BATTERY_CHARGING)
-                      || (chargingStatus == MA_BATTERY_FULL)  );
-        charge = ReadChargeRemaining();
-        percentage = ComputePercentage(charge, ReadCapacity());
-        voltage = ReadVoltage();
-        current = ReadCurrent();
-        temperature = ReadTemperature();
+        validFields |= MA_BATTERY_FIELD_VOLTAGE
+                     | MA_BATTERY_FIELD_CURRENT
+                     | MA_BATTERY_FIELD_TEMP
+                     | MA_BATTERY_FIELD_CHARGE;
+
+        if (snapPtr->capacity != 0)
+        {
+            validFields |= MA_BATTERY_FIELD_PERCENT;
+        }
     }
 
-    // Generate a JSON value.
-    char value[IO_MAX_STRING_VALUE_LEN + 1];
-    int len = snprintf(value,
-                       sizeof(value),
-                       "{\"health\":\"%s\","
-                       "\"percent\":%u,"
-                       "\"mAh\":%u,"
-                       "\"charging\":%s,"
-                       "\"mA\": %.3lf,"
-                       "\"V\":%.2lf,"
-                       "\"degC\":%.2lf}",
-                       GetHealthStr(healthStatus),
-                       percentage,
-                       charge,
-                       isCharging ? "true" : "false",
-                       current,
-                       voltage,
-                       temperature);
-    LE_DEBUG("'%s'", value);
-    if (len >= sizeof(value))
+    valuesPtr->validFields = validFields;
+    valuesPtr->chargingStatus = snapPtr->chargingStatus;
+    valuesPtr->health = snapPtr->health;
+    valuesPtr->voltage = snapPtr->voltage;
+    valuesPtr->current = snapPtr->current;
+    valuesPtr->temp = snapPtr->temperature;
+    valuesPtr->percent = snapPtr->percentage;
+    valuesPtr->charge = snapPtr->charge;
+
+    // The full charge estimated by the fuel gauge, or the design capacity if it has none.
+    if (snapPtr->isPresent && (snapPtr->capacity > 0))
     {
-        LE_ERROR("JSON value too big for Data Hub (%d characters).", len);
+        valuesPtr->fullCharge = snapPtr->capacity;
     }
     else
     {
-        psensor_PushJson(psensorRef, IO_NOW, value);
+        valuesPtr->fullCharge = DesignCapacity;
     }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Push timer handler.  Requests a snapshot, which is pushed to the Data Hub (unless nothing has
+ * changed by more than its deadband) and reported to API clients once it has been taken.
+ */
+//--------------------------------------------------------------------------------------------------
+static void PushTimerExpiryHandler
+(
+    le_timer_Ref_t timerRef
+)
+{
+    core_RequestSample(CORE_SAMPLE_FOR_PUSH);
+}
 
-    // Report alarms and status changes that API clients have registered to receive.
-    ReportHealthStatusChange(healthStatus);
-    ReportChargingStatusChange(chargingStatus);
-    ReportBatteryLevelAlarms(percentage);
 
-    // Restart the timer that is used to ensure a minimum polling frequency for the
-    // alarms and status change reports for API clients.
-    le_timer_Restart(ApiCallbackCheckTimer);
+//--------------------------------------------------------------------------------------------------
+/**
+ * Set the time between pushes to the Data Hub.
+ */
+//--------------------------------------------------------------------------------------------------
+
+static void SetPeriod
+(
+    double timestamp,
+    double period,  ///< seconds
+    void* contextPtr ///< unused
+)
+//--------------------------------------------------------------------------------------------------
+{
+    if (period <= 0)
+    {
+        LE_ERROR("Period of %lf seconds is out of range.", period);
+    }
+    else if (!util_IsReplaying())
+    {
+        le_timer_Stop(PushTimer);
+        le_timer_SetMsInterval(PushTimer, (uint32_t)(period * 1000));
+        le_timer_Start(PushTimer);
+    }
 }
 
 
@@ -995,7 +534,7 @@ static void PushToDataHub
  * someone has registered for notification callbacks for battery condition changes, level alarms,
  * etc., and the data hub is receiving periodic updates slower than the minimum amount of time
  * we consider acceptable for these notifications (i.e., if more than WORST_CASE_ALARM_LAG_MS
- * passes before PushToDataHub() is called, then this timer will expire).
+ * passes before a sample is pushed, then this timer will expire).
  */
 //--------------------------------------------------------------------------------------------------
 static void AlarmCheckTimerExpiryHandler
@@ -1003,38 +542,86 @@ static void AlarmCheckTimerExpiryHandler
     le_timer_Ref_t batteryTimerRef
 )
 {
-    ma_battery_HealthStatus_t healthStatus = MA_BATTERY_DISCONNECTED;
-    ma_battery_ChargingStatus_t chargingStatus = MA_BATTERY_CHARGING_UNKNOWN;
-    uint percentage = 0;
+    core_RequestSample(CORE_SAMPLE_FOR_REPORT);
+
+    // NOTE: We don't need to restart the timer, because the timer is a repeating timer.
+}
 
-    if (BatteryPresent())
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Start the API Callback Check Timer when a client registers the first callback, and stop it when
+ * the last one is removed.
+ */
+//--------------------------------------------------------------------------------------------------
+static void NotificationsChanged
+(
+    bool isAnyRegistered
+)
+{
+    if (isAnyRegistered)
     {
-        healthStatus = ReadHealthStatus();
-        chargingStatus = ReadChargingStatus();
-        uint charge = ReadChargeRemaining();
-        percentage = ComputePercentage(charge, ReadCapacity());
+        // Start the API callback check timer if it isn't already running.
+        (void)le_timer_Start(ApiCallbackCheckTimer);
     }
+    else
+    {
+        le_timer_Stop(ApiCallbackCheckTimer);
+    }
+}
 
-    ReportHealthStatusChange(healthStatus);
-    ReportChargingStatusChange(chargingStatus);
-    ReportBatteryLevelAlarms(percentage);
 
-    // NOTE: We don't need to restart the timer, because the timer is a repeating timer.
+//--------------------------------------------------------------------------------------------------
+/**
+ * Handler for power_supply uevents from the kernel.  The charger sends these when the charging
+ * status or health changes, so re-sample and report to API clients right away instead of waiting
+ * for the next Data Hub sample or API callback check timer expiry.
+ */
+//--------------------------------------------------------------------------------------------------
+static void PowerSupplyEventHandler
+(
+    const char *supplyName,
+    void *contextPtr    ///< unused
+)
+{
+    core_RequestSample(CORE_SAMPLE_FOR_REPORT);
 }
 
 
-COMPONENT_INIT
+/// power_supply class devices of the BQ27426 fuel gauge and the BQ25601 charger.
+static const char *const SupplyNames[] = { "bq25601-battery", "BQ27246", NULL };
+
+/// The functions that read and interpret this hardware for batteryCore.  The fuel gauge does its
+/// own charge estimation and doesn't report how confident it is.
+static const core_Backend_t Backend =
 {
-    LevelAlarmPool   = le_mem_CreatePool("batt_events", sizeof(LevelAlarmReg_t));
-    LevelAlarmRefMap = le_ref_CreateMap("batt_events", 4);
+    .name = "BQ27426+BQ25601",
+    .supplyNames = SupplyNames,
+    .sampleSize = sizeof(Snapshot_t),
+    .readSample = ReadSample,
+    .processSample = ProcessSample,
+    .getValues = GetValues,
+    .getPercentConfidence = NULL,
+    .notificationsChanged = NotificationsChanged,
+};
 
-    ChargingStatusRegPool   = le_mem_CreatePool("charge_events", sizeof(ChargingStatusReg_t));
-    ChargingStatusRegRefMap = le_ref_CreateMap("charge_events", 4);
 
-    HealthStatusRegPool   = le_mem_CreatePool("health_events", sizeof(HealthStatusReg_t));
-    HealthStatusRegRefMap = le_ref_CreateMap("health_events", 4);
+COMPONENT_INIT
+{
+    // Stay idle if this isn't the hardware we're running on.
+    if (core_SetBackend(&Backend) != LE_OK)
+    {
+        return;
+    }
 
-    psensor_CreateJson("", JSON_EXAMPLE, PushToDataHub, NULL);
+    HealthFile     = util_OpenSysfsFile(HealthFilePath, O_RDONLY);
+    StatusFile     = util_OpenSysfsFile(StatusFilePath, O_RDONLY);
+    VoltageFile    = util_OpenSysfsFile(VoltageFilePath, O_RDONLY);
+    TempFile       = util_OpenSysfsFile(TempFilePath, O_RDONLY);
+    ChargeNowFile  = util_OpenSysfsFile(ChargeNowFilePath, O_RDONLY);
+    CurrentNowFile = util_OpenSysfsFile(CurrentNowFilePath, O_RDONLY);
+    PresentFile    = util_OpenSysfsFile(PresentFilePath, O_RDONLY);
+    ChargeMaxFile  = util_OpenSysfsFile(ChargeMaxFilePath, O_RDONLY);
 
     // Create a timer for checking if a client of the battery API has asked for notification
     // callbacks. But don't run it until someone registers a callback.
@@ -1043,5 +630,30 @@ COMPONENT_INIT
     le_timer_SetRepeat(ApiCallbackCheckTimer, 0 /* repeat forever */);
     le_timer_SetHandler(ApiCallbackCheckTimer, AlarmCheckTimerExpiryHandler);
 
+    DesignCapacity = ReadDesignCapacity();
+    core_LoadStateOfHealth(DesignCapacity);
+
+    // After this, the driver files are only accessed by the sampler thread.
+    core_StartSampling();
+
+    // Time between pushes (seconds).  While replaying, the pushes are driven by the replayed
+    // trace's clock rather than by the period.
+    PushTimer = le_timer_Create("PushTimer");
+    le_timer_SetMsInterval(PushTimer,
+                           util_IsReplaying() ? REPLAY_TIMER_INTERVAL_MS : DEFAULT_PUSH_PERIOD_MS);
+    le_timer_SetRepeat(PushTimer, 0 /* repeat forever */);
+    le_timer_SetHandler(PushTimer, PushTimerExpiryHandler);
+    le_timer_Start(PushTimer);
+
+    LE_ASSERT(LE_OK == dhubIO_CreateOutput(RES_PATH_PERIOD, DHUBIO_DATA_TYPE_NUMERIC, "s"));
+    dhubIO_AddNumericPushHandler(RES_PATH_PERIOD, SetPeriod, NULL);
+    dhubIO_SetNumericDefault(RES_PATH_PERIOD, ((double)DEFAULT_PUSH_PERIOD_MS) / 1000);
+
+    // Get notified by the kernel as soon as the charger status or health changes.
+    if (util_AddPowerSupplyEventHandler(PowerSupplyEventHandler, NULL) != LE_OK)
+    {
+        LE_WARN("Power supply uevents unavailable. Changes will only be seen when polling.");
+    }
+
     LE_INFO("---------------------- Battery Service started");
 }
@@ -0,0 +1,188 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file yellowTest.c
+ *
+ * Host test of the Yellow backend (BQ27426 fuel gauge and BQ25601 charger), built against the
+ * Legato shim (see CMakeLists.txt at the top of the tree).  The driver files are stood in for by a
+ * temporary sysfs directory, which BATTERY_SYSFS_ROOT points at, and the test changes them to play
+ * the hardware.
+ *
+ * Exits with status 0 if all the tests pass.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#include "legato.h"
+#include "interfaces.h"
+#include "admin_interface.h"
+#include "hostTest.h"
+
+/// Driver directories of the fuel gauge and the charger.
+#define CHARGER_DIR "class/power_supply/bq25601-battery/"
+#define GAUGE_DIR   "class/power_supply/BQ27246/"
+
+/// Initialization functions of batteryCore and of the backend (see CMakeLists.txt).
+void _batteryCore_COMPONENT_INIT(void);
+void _batteryComponentYellow_COMPONENT_INIT(void);
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Create the driver files of a half-charged battery, discharging at 250 mA, whose fuel gauge
+ * estimates its capacity at 1000 mAh of the 1200 mAh it had when new.
+ */
+//--------------------------------------------------------------------------------------------------
+static void CreateHardware
+(
+    void
+)
+{
+    test_WriteSysfsFile(CHARGER_DIR "type", "Battery\n");
+    test_WriteSysfsFile(CHARGER_DIR "health", "Good\n");
+    test_WriteSysfsFile(CHARGER_DIR "status", "Discharging\n");
+
+    test_WriteSysfsFile(GAUGE_DIR "type", "Battery\n");
+    test_WriteSysfsFile(GAUGE_DIR "present", "1\n");
+    test_WriteSysfsFile(GAUGE_DIR "voltage_now", "3800000\n");
+    test_WriteSysfsFile(GAUGE_DIR "current_now", "-250000\n");
+    test_WriteSysfsFile(GAUGE_DIR "temp", "250\n");
+    test_WriteSysfsFile(GAUGE_DIR "charge_now", "500000\n");
+    test_WriteSysfsFile(GAUGE_DIR "charge_full", "1000000\n");
+    test_WriteSysfsFile(GAUGE_DIR "charge_full_design", "1200000\n");
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * @return true once the charge level percentage has been pushed to the Data Hub.
+ */
+//--------------------------------------------------------------------------------------------------
+static bool IsPercentPushed
+(
+    void
+)
+{
+    double timestamp, value;
+
+    return (dhubIO_GetNumericValue("percent", &timestamp, &value) == LE_OK);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * The API getters return the values of the sample taken at start-up.
+ */
+//--------------------------------------------------------------------------------------------------
+static void TestValues
+(
+    void
+)
+{
+    double voltage, current, temp;
+    uint16_t percent, charge;
+    uint8_t confidence;
+
+    CHECK(ma_battery_GetHealthStatus() == MA_BATTERY_GOOD);
+    CHECK(ma_battery_GetChargingStatus() == MA_BATTERY_DISCHARGING);
+    CHECK_RESULT(ma_battery_GetVoltage(&voltage), LE_OK);
+    CHECK(voltage == 3.8);
+    CHECK_RESULT(ma_battery_GetCurrent(&current), LE_OK);
+    CHECK(current == -250.0);
+    CHECK_RESULT(ma_battery_GetTemp(&temp), LE_OK);
+    CHECK(temp == 25.0);
+    CHECK_RESULT(ma_battery_GetChargeRemaining(&charge), LE_OK);
+    CHECK(charge == 500);
+    CHECK_RESULT(ma_battery_GetPercentRemaining(&percent), LE_OK);
+    CHECK(percent == 50);
+
+    // The fuel gauge doesn't report how confident it is.
+    CHECK_RESULT(ma_battery_GetPercentConfidence(&confidence), LE_NOT_IMPLEMENTED);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * The samples taken once per period are pushed to the Data Hub, and feed the run time prediction
+ * and the state of health.
+ */
+//--------------------------------------------------------------------------------------------------
+static void TestPush
+(
+    void
+)
+{
+    CHECK(!IsPercentPushed());
+
+    admin_PushNumeric("/app/battery/period", 0, 0.01);
+    CHECK(test_RunUntil(IsPercentPushed, 5000));
+
+    double timestamp, value;
+    CHECK_RESULT(dhubIO_GetNumericValue("percent", &timestamp, &value), LE_OK);
+    CHECK(value == 50);
+    CHECK_RESULT(dhubIO_GetNumericValue("mA", &timestamp, &value), LE_OK);
+    CHECK(value == -250.0);
+
+    char json[DHUBIO_MAX_STRING_VALUE_LEN + 1];
+    CHECK_RESULT(dhubIO_GetJsonValue("value", &timestamp, json, sizeof(json)), LE_OK);
+    CHECK(strstr(json, "\"percent\":50") != NULL);
+
+    uint32_t seconds, cycles;
+    CHECK_RESULT(ma_battery_GetTimeToEmpty(&seconds), LE_OK);
+    CHECK(seconds == 7200);
+    CHECK_RESULT(ma_battery_GetTimeToFull(&seconds), LE_NOT_FOUND);
+
+    uint8_t health;
+    uint16_t fullCapacity;
+    CHECK_RESULT(ma_battery_GetStateOfHealth(&health, &fullCapacity), LE_OK);
+    CHECK((health == 83) && (fullCapacity == 1000));
+    CHECK_RESULT(ma_battery_GetCycleCount(&cycles), LE_OK);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Once the battery is removed, only its status is known.
+ */
+//--------------------------------------------------------------------------------------------------
+static void TestRemoved
+(
+    void
+)
+{
+    test_WriteSysfsFile(GAUGE_DIR "present", "0\n");
+    usleep(2000);
+
+    uint64_t timestamp;
+    ma_battery_SnapshotField_t validFields;
+    ma_battery_ChargingStatus_t chargingStatus;
+    ma_battery_HealthStatus_t health;
+    double voltage, current, temp;
+    uint16_t percent, charge;
+    CHECK_RESULT(ma_battery_GetSnapshot(0, &timestamp, &validFields, &chargingStatus, &health,
+                                        &voltage, &current, &temp, &percent, &charge),
+                 LE_OK);
+    CHECK(validFields == (MA_BATTERY_FIELD_CHARGING_STATUS | MA_BATTERY_FIELD_HEALTH));
+    CHECK(health == MA_BATTERY_DISCONNECTED);
+    CHECK(chargingStatus == MA_BATTERY_CHARGING_UNKNOWN);
+
+    CHECK_RESULT(ma_battery_GetPercentRemaining(&percent), LE_NOT_FOUND);
+    CHECK(ma_battery_GetHealthStatus() == MA_BATTERY_DISCONNECTED);
+}
+
+
+int main
+(
+    void
+)
+{
+    test_CreateSysfsRoot("yellowTest");
+    CreateHardware();
+
+    _batteryCore_COMPONENT_INIT();
+    _batteryComponentYellow_COMPONENT_INIT();
+
+    TestValues();
+    TestPush();
+    TestRemoved();
+
+    return test_Finish();
+}
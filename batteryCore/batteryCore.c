@@ -0,0 +1,2064 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file batteryCore.c
+ *
+ * Board-independent part of the Battery Service.  Implements the ma_battery API on top of the
+ * battery backend selected by core_SetBackend() (see batteryCore.h).
+ *
+ * The core keeps the client registrations for level alarms and status change notifications, and
+ * reports to them each time a sample is processed (see sampling.h).  It also keeps the history of
+ * the processed samples, and reports on the power supplies other than the backend's battery (see
+ * supplies.h).  The API getters map the latest sample through the backend's getValues() function.
+ *
+ * <hr>
+ *
+ * Copyright (C) Sierra Wireless Inc.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#include "legato.h"
+#include "interfaces.h"
+#include "batteryCore.h"
+#include "batteryUtils.h"
+#include "levelAlarms.h"
+#include "history.h"
+#include "supplies.h"
+#include "sampling.h"
+#include "push.h"
+#include "persist.h"
+
+/// Maximum age of the values combined by GetAggregate() (ms).
+#define AGGREGATE_MAX_AGE_MS 1000
+
+/// Charging status code for each value of the power_supply "status" attribute.
+static const ma_battery_ChargingStatus_t ChargingStatusCodes[] =
+{
+    [UTIL_STATUS_UNKNOWN]       = MA_BATTERY_CHARGING_UNKNOWN,
+    [UTIL_STATUS_CHARGING]      = MA_BATTERY_CHARGING,
+    [UTIL_STATUS_DISCHARGING]   = MA_BATTERY_DISCHARGING,
+    [UTIL_STATUS_NOT_CHARGING]  = MA_BATTERY_NOT_CHARGING,
+    [UTIL_STATUS_FULL]          = MA_BATTERY_FULL,
+    [UTIL_STATUS_UNRECOGNIZED]  = MA_BATTERY_CHARGING_ERROR,
+};
+
+/// Health status code for each value of the power_supply "health" attribute.  Failures that have
+/// no health status code of their own are reported as unknown health.
+static const ma_battery_HealthStatus_t HealthStatusCodes[] =
+{
+    [UTIL_HEALTH_UNKNOWN]                = MA_BATTERY_HEALTH_UNKNOWN,
+    [UTIL_HEALTH_GOOD]                   = MA_BATTERY_GOOD,
+    [UTIL_HEALTH_OVERHEAT]               = MA_BATTERY_HOT,
+    [UTIL_HEALTH_DEAD]                   = MA_BATTERY_HEALTH_UNKNOWN,
+    [UTIL_HEALTH_OVERVOLTAGE]            = MA_BATTERY_OVERVOLTAGE,
+    [UTIL_HEALTH_UNSPEC_FAILURE]         = MA_BATTERY_HEALTH_UNKNOWN,
+    [UTIL_HEALTH_COLD]                   = MA_BATTERY_COLD,
+    [UTIL_HEALTH_WATCHDOG_TIMER_EXPIRE]  = MA_BATTERY_HEALTH_UNKNOWN,
+    [UTIL_HEALTH_SAFETY_TIMER_EXPIRE]    = MA_BATTERY_HEALTH_UNKNOWN,
+    [UTIL_HEALTH_OVERCURRENT]            = MA_BATTERY_HEALTH_UNKNOWN,
+    [UTIL_HEALTH_CALIBRATION_REQUIRED]   = MA_BATTERY_HEALTH_UNKNOWN,
+    [UTIL_HEALTH_WARM]                   = MA_BATTERY_GOOD,
+    [UTIL_HEALTH_COOL]                   = MA_BATTERY_GOOD,
+    [UTIL_HEALTH_HOT]                    = MA_BATTERY_HOT,
+    [UTIL_HEALTH_NO_BATTERY]             = MA_BATTERY_DISCONNECTED,
+    [UTIL_HEALTH_UNRECOGNIZED]           = MA_BATTERY_HEALTH_ERROR,
+};
+
+/// The backend that provides the battery values, or NULL if no battery hardware was found.
+static const core_Backend_t *BackendPtr = NULL;
+
+/// true if any notification handler was registered when the backend was last told.
+static bool IsAnyHandlerRegistered = false;
+
+static le_mem_PoolRef_t LevelAlarmPool;
+static le_ref_MapRef_t LevelAlarmRefMap;
+static util_LevelAlarmIndex_t LevelAlarmIndex;
+
+static le_mem_PoolRef_t ChargingStatusRegPool;
+static le_ref_MapRef_t ChargingStatusRegRefMap;
+
+static le_mem_PoolRef_t HealthStatusRegPool;
+static le_ref_MapRef_t HealthStatusRegRefMap;
+
+static le_mem_PoolRef_t SupplyStatusRegPool;
+static le_ref_MapRef_t SupplyStatusRegRefMap;
+
+static le_mem_PoolRef_t SupplyLevelRegPool;
+static le_ref_MapRef_t SupplyLevelRegRefMap;
+static util_LevelAlarmIndex_t SupplyLevelAlarmIndexes[CORE_MAX_SUPPLIES + 1]; ///< By supply index.
+
+static le_mem_PoolRef_t ClientSessionPool;
+static le_hashmap_Ref_t ClientSessionMap;   ///< Maps session references to ClientSession_t.
+
+/// History of battery samples, for the GetHistory() and GetRecentHistory() API functions.
+static util_History_t History;
+
+/// Holds the registrations made by one client session, so they can be removed in bulk when the
+/// session closes.
+typedef struct
+{
+    le_msg_SessionRef_t sessionRef;
+    le_dls_List_t levelAlarmList;       ///< LevelAlarmReg_t objects.
+    le_dls_List_t chargingStatusList;   ///< ChargingStatusReg_t objects.
+    le_dls_List_t healthStatusList;     ///< HealthStatusReg_t objects.
+    le_dls_List_t supplyStatusList;     ///< SupplyStatusReg_t objects.
+    le_dls_List_t supplyLevelList;      ///< SupplyLevelReg_t objects.
+}
+ClientSession_t;
+
+/// Holds percentage level alarm call-back registration information.
+typedef struct
+{
+    util_LevelAlarm_t alarm;    ///< Thresholds and state, linked into LevelAlarmIndex.
+
+    ma_battery_LevelPercentageHandlerFunc_t handler;
+    void *clientContext;
+    le_msg_SessionRef_t clientSessionRef;
+    ClientSession_t *sessionPtr;    ///< Session record that this registration is listed in.
+    le_dls_Link_t sessionLink;      ///< Link in one of the session record's lists.
+    void *safeRef;                  ///< Reference handed out to the client.
+}
+LevelAlarmReg_t;
+
+/// Holds charging status change notification call-back registration information.
+typedef struct
+{
+    ma_battery_ChargingStatusHandlerFunc_t handler;
+    void *clientContext;
+    le_msg_SessionRef_t clientSessionRef;
+    ClientSession_t *sessionPtr;    ///< Session record that this registration is listed in.
+    le_dls_Link_t sessionLink;      ///< Link in one of the session record's lists.
+    void *safeRef;                  ///< Reference handed out to the client.
+}
+ChargingStatusReg_t;
+
+/// Holds health status change notification call-back registration information.
+typedef struct
+{
+    ma_battery_HealthHandlerFunc_t handler;
+    void *clientContext;
+    le_msg_SessionRef_t clientSessionRef;
+    ClientSession_t *sessionPtr;    ///< Session record that this registration is listed in.
+    le_dls_Link_t sessionLink;      ///< Link in one of the session record's lists.
+    void *safeRef;                  ///< Reference handed out to the client.
+}
+HealthStatusReg_t;
+
+/// Holds power supply status change notification call-back registration information.
+typedef struct
+{
+    ma_battery_SupplyStatusHandlerFunc_t handler;
+    void *clientContext;
+    le_msg_SessionRef_t clientSessionRef;
+    ClientSession_t *sessionPtr;    ///< Session record that this registration is listed in.
+    le_dls_Link_t sessionLink;      ///< Link in one of the session record's lists.
+    void *safeRef;                  ///< Reference handed out to the client.
+}
+SupplyStatusReg_t;
+
+/// Holds power supply percentage level alarm call-back registration information.
+typedef struct
+{
+    util_LevelAlarm_t alarm;    ///< Thresholds and state, linked into the supply's alarm index.
+    uint32_t supplyIndex;       ///< 0 = the backend's battery.
+
+    ma_battery_SupplyLevelPercentageHandlerFunc_t handler;
+    void *clientContext;
+    le_msg_SessionRef_t clientSessionRef;
+    ClientSession_t *sessionPtr;    ///< Session record that this registration is listed in.
+    le_dls_Link_t sessionLink;      ///< Link in one of the session record's lists.
+    void *safeRef;                  ///< Reference handed out to the client.
+}
+SupplyLevelReg_t;
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get a printable string describing a health status code.
+ *
+ * @return Ptr to the null-terminated string.
+ */
+//--------------------------------------------------------------------------------------------------
+const char *core_GetHealthStr
+(
+    ma_battery_HealthStatus_t healthCode
+)
+{
+    switch (healthCode)
+    {
+        case MA_BATTERY_OVERVOLTAGE:        return "overvoltage";
+        case MA_BATTERY_GOOD:               return "good";
+        case MA_BATTERY_COLD:               return "cold";
+        case MA_BATTERY_HOT:                return "hot";
+        case MA_BATTERY_DISCONNECTED:       return "disconnected";
+        case MA_BATTERY_HEALTH_UNKNOWN:     return "unknown";
+        case MA_BATTERY_HEALTH_ERROR:       return "error";
+    }
+
+    LE_CRIT("Unexpected health code %d.", healthCode);
+
+    return "unknown";
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the charging status code for a value of the power_supply "status" attribute.
+ *
+ * @return The charging status code.
+ */
+//--------------------------------------------------------------------------------------------------
+ma_battery_ChargingStatus_t core_GetChargingStatusCode
+(
+    util_PowerSupplyStatus_t status
+)
+{
+    return ChargingStatusCodes[status];
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the health status code for a value of the power_supply "health" attribute.
+ *
+ * @return The health status code.
+ */
+//--------------------------------------------------------------------------------------------------
+ma_battery_HealthStatus_t core_GetHealthStatusCode
+(
+    util_PowerSupplyHealth_t health
+)
+{
+    return HealthStatusCodes[health];
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Tell the backend when the first notification handler has been added or the last one removed.
+ */
+//--------------------------------------------------------------------------------------------------
+static void HandlersChanged
+(
+    void
+)
+{
+    bool isAnyRegistered =
+        (   (le_ref_NextNode(le_ref_GetIterator(HealthStatusRegRefMap)) == LE_OK)
+         || (le_ref_NextNode(le_ref_GetIterator(LevelAlarmRefMap)) == LE_OK)
+         || (le_ref_NextNode(le_ref_GetIterator(ChargingStatusRegRefMap)) == LE_OK)
+         || (le_ref_NextNode(le_ref_GetIterator(SupplyStatusRegRefMap)) == LE_OK)
+         || (le_ref_NextNode(le_ref_GetIterator(SupplyLevelRegRefMap)) == LE_OK)  );
+
+    if (isAnyRegistered != IsAnyHandlerRegistered)
+    {
+        IsAnyHandlerRegistered = isAnyRegistered;
+
+        if ((BackendPtr != NULL) && (BackendPtr->notificationsChanged != NULL))
+        {
+            BackendPtr->notificationsChanged(isAnyRegistered);
+        }
+    }
+}
+
+
+/// Selects one of the registration lists in a ClientSession_t.
+typedef enum
+{
+    SESSION_LIST_LEVEL_ALARM,
+    SESSION_LIST_CHARGING_STATUS,
+    SESSION_LIST_HEALTH_STATUS,
+    SESSION_LIST_SUPPLY_STATUS,
+    SESSION_LIST_SUPPLY_LEVEL,
+}
+SessionList_t;
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get one of the registration lists in a client session record.
+ *
+ * @return Ptr to the list.
+ */
+//--------------------------------------------------------------------------------------------------
+static le_dls_List_t *GetSessionList
+(
+    ClientSession_t *sessionPtr,
+    SessionList_t list
+)
+{
+    switch (list)
+    {
+        case SESSION_LIST_LEVEL_ALARM:      return &sessionPtr->levelAlarmList;
+        case SESSION_LIST_CHARGING_STATUS:  return &sessionPtr->chargingStatusList;
+        case SESSION_LIST_HEALTH_STATUS:    return &sessionPtr->healthStatusList;
+        case SESSION_LIST_SUPPLY_STATUS:    return &sessionPtr->supplyStatusList;
+        case SESSION_LIST_SUPPLY_LEVEL:     return &sessionPtr->supplyLevelList;
+    }
+
+    LE_FATAL("Invalid session list %d.", list);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Add a registration to the record of the client session that made it, creating the record if
+ * this is the session's first registration.
+ */
+//--------------------------------------------------------------------------------------------------
+static void AddToClientSession
+(
+    le_msg_SessionRef_t sessionRef,
+    ClientSession_t **sessionPtrPtr,    ///< [OUT] Set to the session record.
+    SessionList_t list,
+    le_dls_Link_t *linkPtr
+)
+{
+    static const le_dls_List_t emptyList = LE_DLS_LIST_INIT;
+    static const le_dls_Link_t unlinkedLink = LE_DLS_LINK_INIT;
+
+    ClientSession_t *sessionPtr = le_hashmap_Get(ClientSessionMap, sessionRef);
+    if (sessionPtr == NULL)
+    {
+        sessionPtr = le_mem_ForceAlloc(ClientSessionPool);
+        sessionPtr->sessionRef = sessionRef;
+        sessionPtr->levelAlarmList = emptyList;
+        sessionPtr->chargingStatusList = emptyList;
+        sessionPtr->healthStatusList = emptyList;
+        sessionPtr->supplyStatusList = emptyList;
+        sessionPtr->supplyLevelList = emptyList;
+        le_hashmap_Put(ClientSessionMap, sessionRef, sessionPtr);
+    }
+
+    *linkPtr = unlinkedLink;
+    le_dls_Queue(GetSessionList(sessionPtr, list), linkPtr);
+    *sessionPtrPtr = sessionPtr;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Remove a registration from its client session record, deleting the record if it was the
+ * session's last registration.
+ */
+//--------------------------------------------------------------------------------------------------
+static void RemoveFromClientSession
+(
+    ClientSession_t *sessionPtr,
+    SessionList_t list,
+    le_dls_Link_t *linkPtr
+)
+{
+    le_dls_Remove(GetSessionList(sessionPtr, list), linkPtr);
+
+    if (   le_dls_IsEmpty(&sessionPtr->levelAlarmList)
+        && le_dls_IsEmpty(&sessionPtr->chargingStatusList)
+        && le_dls_IsEmpty(&sessionPtr->healthStatusList)
+        && le_dls_IsEmpty(&sessionPtr->supplyStatusList)
+        && le_dls_IsEmpty(&sessionPtr->supplyLevelList)  )
+    {
+        le_hashmap_Remove(ClientSessionMap, sessionPtr->sessionRef);
+        le_mem_Release(sessionPtr);
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Register a callback function to be called when the Percentage Level changes as follows:
+ *
+ * Notify the client via call-back if the level goes above percentageHigh or below percentageLow.
+ */
+//--------------------------------------------------------------------------------------------------
+ma_battery_LevelPercentageHandlerRef_t ma_battery_AddLevelPercentageHandler
+(
+    uint8_t percentageLow,  ///< Low percentage trigger threshold (0 = no low level alarm)
+    uint8_t percentageHigh, ///< High percentage trigger threshold (>=100 means no high alm)
+    ma_battery_LevelPercentageHandlerFunc_t handler,
+    void *context
+)
+{
+    if (percentageHigh > 100)
+    {
+        LE_ERROR("High percentage can't be higher than 100");
+        return NULL;
+    }
+    else if (percentageHigh < percentageLow)
+    {
+        LE_ERROR("High percentage can't be less than low percentage");
+        return NULL;
+    }
+
+    LevelAlarmReg_t *reg = le_mem_ForceAlloc(LevelAlarmPool);
+    reg->handler                       = handler;
+    reg->clientContext                 = context;
+    reg->clientSessionRef              = ma_battery_GetClientSessionRef();
+    util_AddLevelAlarm(&LevelAlarmIndex, &reg->alarm, percentageLow, percentageHigh);
+
+    void* safeRef = le_ref_CreateRef(LevelAlarmRefMap, reg);
+    reg->safeRef = safeRef;
+    AddToClientSession(reg->clientSessionRef, &reg->sessionPtr, SESSION_LIST_LEVEL_ALARM,
+                       &reg->sessionLink);
+
+    HandlersChanged();
+
+    return safeRef;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Deregister a callback function registered using ma_battery_AddLevelPercentageHandler().
+ */
+//--------------------------------------------------------------------------------------------------
+void ma_battery_RemoveLevelPercentageHandler
+(
+    ma_battery_LevelPercentageHandlerRef_t handlerRef
+)
+{
+    LevelAlarmReg_t *reg = le_ref_Lookup(LevelAlarmRefMap, handlerRef);
+    if (reg == NULL)
+    {
+        LE_ERROR("Failed to lookup event based on handle");
+    }
+    else
+    {
+        if (reg->clientSessionRef == ma_battery_GetClientSessionRef())
+        {
+            le_ref_DeleteRef(LevelAlarmRefMap, handlerRef);
+            util_RemoveLevelAlarm(&LevelAlarmIndex, &reg->alarm);
+            RemoveFromClientSession(reg->sessionPtr, SESSION_LIST_LEVEL_ALARM, &reg->sessionLink);
+            le_mem_Release(reg);
+
+            HandlersChanged();
+        }
+        else
+        {
+            LE_ERROR("Remove invalid event handleRef");
+        }
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Calls a client's level alarm handler when its alarm fires.
+ */
+//--------------------------------------------------------------------------------------------------
+static void LevelAlarmFired
+(
+    util_LevelAlarm_t *alarmPtr,
+    uint8_t percentage,
+    bool isHighLevel
+)
+{
+    LevelAlarmReg_t *reg = CONTAINER_OF(alarmPtr, LevelAlarmReg_t, alarm);
+
+    reg->handler(percentage,
+                 isHighLevel ? alarmPtr->percentageHigh : alarmPtr->percentageLow,
+                 isHighLevel,
+                 reg->clientContext);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Checks the registered battery level alarm thresholds to see if an alarm event should be
+ * reported.  If so, reports them.  Only the registrations whose thresholds were crossed since
+ * the last check are visited.
+ */
+//--------------------------------------------------------------------------------------------------
+static void ReportBatteryLevelAlarms
+(
+    uint8_t percentage
+)
+{
+    util_CheckLevelAlarms(&LevelAlarmIndex, percentage, LevelAlarmFired);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Add handler function for EVENT 'ma_battery_ChargingStatusChange'
+ *
+ * Register a callback function to be called when there is a change in battery charging status.
+ */
+//--------------------------------------------------------------------------------------------------
+ma_battery_ChargingStatusChangeHandlerRef_t ma_battery_AddChargingStatusChangeHandler
+(
+    ma_battery_ChargingStatusHandlerFunc_t handler,
+    void *context
+)
+{
+    ChargingStatusReg_t *reg = le_mem_ForceAlloc(ChargingStatusRegPool);
+
+    reg->handler                        = handler;
+    reg->clientContext                  = context;
+    reg->clientSessionRef               = ma_battery_GetClientSessionRef();
+
+    void* safeRef = le_ref_CreateRef(ChargingStatusRegRefMap, reg);
+    reg->safeRef = safeRef;
+    AddToClientSession(reg->clientSessionRef, &reg->sessionPtr, SESSION_LIST_CHARGING_STATUS,
+                       &reg->sessionLink);
+
+    HandlersChanged();
+
+    return safeRef;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Remove handler function for EVENT 'ma_battery_ChargingStatusChange'
+ */
+//--------------------------------------------------------------------------------------------------
+void ma_battery_RemoveChargingStatusChangeHandler
+(
+    ma_battery_ChargingStatusChangeHandlerRef_t handlerRef
+)
+{
+    ChargingStatusReg_t *reg = le_ref_Lookup(ChargingStatusRegRefMap, handlerRef);
+    if (reg == NULL)
+    {
+        LE_ERROR("Failed to lookup event based on handle %p", handlerRef);
+    }
+    else
+    {
+        if (reg->clientSessionRef == ma_battery_GetClientSessionRef())
+        {
+            le_ref_DeleteRef(ChargingStatusRegRefMap, handlerRef);
+            RemoveFromClientSession(reg->sessionPtr,
+                                    SESSION_LIST_CHARGING_STATUS,
+                                    &reg->sessionLink);
+            le_mem_Release(reg);
+
+            HandlersChanged();
+        }
+        else
+        {
+            LE_ERROR("Attempt to remove another client's Alarm Health event handleRef %p",
+                     handlerRef);
+        }
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Report a change in the charging status to any registered charging status handlers.
+ */
+//--------------------------------------------------------------------------------------------------
+static void ReportChargingStatusChange
+(
+    ma_battery_ChargingStatus_t status
+)
+{
+    static ma_battery_ChargingStatus_t oldStatus = MA_BATTERY_CHARGING_UNKNOWN;
+
+    if (oldStatus != status)
+    {
+        oldStatus = status;
+
+        le_ref_IterRef_t it = le_ref_GetIterator(ChargingStatusRegRefMap);
+        bool finished       = le_ref_NextNode(it) != LE_OK;
+        while (!finished)
+        {
+            ChargingStatusReg_t *reg = le_ref_GetValue(it);
+            LE_ASSERT(reg != NULL);
+
+            reg->handler(status, reg->clientContext);
+            finished = (le_ref_NextNode(it) != LE_OK);
+        }
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Add handler function for EVENT 'ma_battery_HealthChange'
+ *
+ * Register a callback function to be called when there is a change in battery health status.
+ */
+//--------------------------------------------------------------------------------------------------
+ma_battery_HealthChangeHandlerRef_t ma_battery_AddHealthChangeHandler
+(
+    ma_battery_HealthHandlerFunc_t handler,
+    void *context
+)
+{
+    HealthStatusReg_t *reg = le_mem_ForceAlloc(HealthStatusRegPool);
+    reg->handler                        = handler;
+    reg->clientContext                  = context;
+    reg->clientSessionRef               = ma_battery_GetClientSessionRef();
+
+    void* safeRef = le_ref_CreateRef(HealthStatusRegRefMap, reg);
+    reg->safeRef = safeRef;
+    AddToClientSession(reg->clientSessionRef, &reg->sessionPtr, SESSION_LIST_HEALTH_STATUS,
+                       &reg->sessionLink);
+
+    HandlersChanged();
+
+    return safeRef;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Remove handler function for EVENT 'ma_battery_HealthChange'
+ */
+//--------------------------------------------------------------------------------------------------
+void ma_battery_RemoveHealthChangeHandler
+(
+    ma_battery_HealthChangeHandlerRef_t handlerRef
+)
+{
+    HealthStatusReg_t *reg = le_ref_Lookup(HealthStatusRegRefMap, handlerRef);
+    if (reg == NULL)
+    {
+        LE_ERROR("Failed to lookup event based on handle %p", handlerRef);
+    }
+    else
+    {
+        if (reg->clientSessionRef == ma_battery_GetClientSessionRef())
+        {
+            le_ref_DeleteRef(HealthStatusRegRefMap, handlerRef);
+            RemoveFromClientSession(reg->sessionPtr, SESSION_LIST_HEALTH_STATUS, &reg->sessionLink);
+            le_mem_Release(reg);
+
+            HandlersChanged();
+        }
+        else
+        {
+            LE_ERROR("Attempt to remove another client's Alarm Health event handleRef %p",
+                     handlerRef);
+        }
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * A handler for client disconnects which frees all resources associated with the client.
+ */
+//--------------------------------------------------------------------------------------------------
+static void ClientSessionClosedHandler
+(
+    le_msg_SessionRef_t clientSession,
+    void *context
+)
+{
+    ClientSession_t *sessionPtr = le_hashmap_Remove(ClientSessionMap, clientSession);
+    if (sessionPtr == NULL)
+    {
+        return;
+    }
+
+    le_dls_Link_t *linkPtr;
+
+    while ((linkPtr = le_dls_Pop(&sessionPtr->levelAlarmList)) != NULL)
+    {
+        LevelAlarmReg_t *reg = CONTAINER_OF(linkPtr, LevelAlarmReg_t, sessionLink);
+        le_ref_DeleteRef(LevelAlarmRefMap, reg->safeRef);
+        util_RemoveLevelAlarm(&LevelAlarmIndex, &reg->alarm);
+        le_mem_Release(reg);
+    }
+
+    while ((linkPtr = le_dls_Pop(&sessionPtr->chargingStatusList)) != NULL)
+    {
+        ChargingStatusReg_t *reg = CONTAINER_OF(linkPtr, ChargingStatusReg_t, sessionLink);
+        le_ref_DeleteRef(ChargingStatusRegRefMap, reg->safeRef);
+        le_mem_Release(reg);
+    }
+
+    while ((linkPtr = le_dls_Pop(&sessionPtr->healthStatusList)) != NULL)
+    {
+        HealthStatusReg_t *reg = CONTAINER_OF(linkPtr, HealthStatusReg_t, sessionLink);
+        le_ref_DeleteRef(HealthStatusRegRefMap, reg->safeRef);
+        le_mem_Release(reg);
+    }
+
+    while ((linkPtr = le_dls_Pop(&sessionPtr->supplyStatusList)) != NULL)
+    {
+        SupplyStatusReg_t *reg = CONTAINER_OF(linkPtr, SupplyStatusReg_t, sessionLink);
+        le_ref_DeleteRef(SupplyStatusRegRefMap, reg->safeRef);
+        le_mem_Release(reg);
+    }
+
+    while ((linkPtr = le_dls_Pop(&sessionPtr->supplyLevelList)) != NULL)
+    {
+        SupplyLevelReg_t *reg = CONTAINER_OF(linkPtr, SupplyLevelReg_t, sessionLink);
+        le_ref_DeleteRef(SupplyLevelRegRefMap, reg->safeRef);
+        util_RemoveLevelAlarm(&SupplyLevelAlarmIndexes[reg->supplyIndex], &reg->alarm);
+        le_mem_Release(reg);
+    }
+
+    le_mem_Release(sessionPtr);
+
+    HandlersChanged();
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Reports a change in the health status to any registered health status change event handlers.
+ */
+//--------------------------------------------------------------------------------------------------
+static void ReportHealthStatusChange
+(
+    ma_battery_HealthStatus_t healthStatus
+)
+{
+    static ma_battery_HealthStatus_t oldStatus = MA_BATTERY_HEALTH_UNKNOWN;
+
+    if (oldStatus != healthStatus)
+    {
+        oldStatus = healthStatus;
+
+        le_ref_IterRef_t it = le_ref_GetIterator(HealthStatusRegRefMap);
+        while (le_ref_NextNode(it) == LE_OK)
+        {
+            HealthStatusReg_t *reg = le_ref_GetValue(it);
+            LE_ASSERT(reg != NULL);
+            reg->handler(healthStatus, reg->clientContext);
+        }
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Add handler function for EVENT 'ma_battery_SupplyStatusChange'
+ *
+ * Register a callback function to be called when a power supply is connected or disconnected,
+ * or its charging or health status changes.
+ */
+//--------------------------------------------------------------------------------------------------
+ma_battery_SupplyStatusChangeHandlerRef_t ma_battery_AddSupplyStatusChangeHandler
+(
+    ma_battery_SupplyStatusHandlerFunc_t handler,
+    void *context
+)
+{
+    SupplyStatusReg_t *reg = le_mem_ForceAlloc(SupplyStatusRegPool);
+    reg->handler                        = handler;
+    reg->clientContext                  = context;
+    reg->clientSessionRef               = ma_battery_GetClientSessionRef();
+
+    void* safeRef = le_ref_CreateRef(SupplyStatusRegRefMap, reg);
+    reg->safeRef = safeRef;
+    AddToClientSession(reg->clientSessionRef, &reg->sessionPtr, SESSION_LIST_SUPPLY_STATUS,
+                       &reg->sessionLink);
+
+    HandlersChanged();
+
+    return safeRef;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Remove handler function for EVENT 'ma_battery_SupplyStatusChange'
+ */
+//--------------------------------------------------------------------------------------------------
+void ma_battery_RemoveSupplyStatusChangeHandler
+(
+    ma_battery_SupplyStatusChangeHandlerRef_t handlerRef
+)
+{
+    SupplyStatusReg_t *reg = le_ref_Lookup(SupplyStatusRegRefMap, handlerRef);
+    if (reg == NULL)
+    {
+        LE_ERROR("Failed to lookup event based on handle %p", handlerRef);
+    }
+    else
+    {
+        if (reg->clientSessionRef == ma_battery_GetClientSessionRef())
+        {
+            le_ref_DeleteRef(SupplyStatusRegRefMap, handlerRef);
+            RemoveFromClientSession(reg->sessionPtr, SESSION_LIST_SUPPLY_STATUS, &reg->sessionLink);
+            le_mem_Release(reg);
+
+            HandlersChanged();
+        }
+        else
+        {
+            LE_ERROR("Attempt to remove another client's Supply Status event handleRef %p",
+                     handlerRef);
+        }
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Report a change in the status of a power supply to any registered supply status handlers.
+ */
+//--------------------------------------------------------------------------------------------------
+static void ReportSupplyStatusChange
+(
+    uint32_t index,     ///< 0 = the backend's battery.
+    bool isOnline,
+    ma_battery_ChargingStatus_t chargingStatus,
+    ma_battery_HealthStatus_t health
+)
+{
+    le_ref_IterRef_t it = le_ref_GetIterator(SupplyStatusRegRefMap);
+    while (le_ref_NextNode(it) == LE_OK)
+    {
+        SupplyStatusReg_t *reg = le_ref_GetValue(it);
+        LE_ASSERT(reg != NULL);
+        reg->handler(index, isOnline, chargingStatus, health, reg->clientContext);
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Report a change in the status of the backend's battery as a change of supply 0.
+ */
+//--------------------------------------------------------------------------------------------------
+static void ReportMainSupplyStatus
+(
+    ma_battery_HealthStatus_t health,
+    ma_battery_ChargingStatus_t chargingStatus
+)
+{
+    static ma_battery_HealthStatus_t oldHealth = MA_BATTERY_HEALTH_UNKNOWN;
+    static ma_battery_ChargingStatus_t oldChargingStatus = MA_BATTERY_CHARGING_UNKNOWN;
+
+    if ((health != oldHealth) || (chargingStatus != oldChargingStatus))
+    {
+        oldHealth = health;
+        oldChargingStatus = chargingStatus;
+
+        ReportSupplyStatusChange(0, (health != MA_BATTERY_DISCONNECTED), chargingStatus, health);
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Add handler function for EVENT 'ma_battery_SupplyLevelPercentage'
+ *
+ * Register a callback function to be called when the level of a power supply goes above
+ * percentageHigh or below percentageLow.
+ */
+//--------------------------------------------------------------------------------------------------
+ma_battery_SupplyLevelPercentageHandlerRef_t ma_battery_AddSupplyLevelPercentageHandler
+(
+    uint32_t index,         ///< 0 = the backend's battery.
+    uint8_t percentageLow,  ///< Low percentage trigger threshold (0 = no low level alarm)
+    uint8_t percentageHigh, ///< High percentage trigger threshold (>=100 means no high alm)
+    ma_battery_SupplyLevelPercentageHandlerFunc_t handler,
+    void *context
+)
+{
+    if (index >= ma_battery_GetSupplyCount())
+    {
+        LE_ERROR("No power supply with index %" PRIu32, index);
+        return NULL;
+    }
+    else if (percentageHigh > 100)
+    {
+        LE_ERROR("High percentage can't be higher than 100");
+        return NULL;
+    }
+    else if (percentageHigh < percentageLow)
+    {
+        LE_ERROR("High percentage can't be less than low percentage");
+        return NULL;
+    }
+
+    SupplyLevelReg_t *reg = le_mem_ForceAlloc(SupplyLevelRegPool);
+    reg->supplyIndex                   = index;
+    reg->handler                       = handler;
+    reg->clientContext                 = context;
+    reg->clientSessionRef              = ma_battery_GetClientSessionRef();
+    util_AddLevelAlarm(&SupplyLevelAlarmIndexes[index], &reg->alarm, percentageLow, percentageHigh);
+
+    void* safeRef = le_ref_CreateRef(SupplyLevelRegRefMap, reg);
+    reg->safeRef = safeRef;
+    AddToClientSession(reg->clientSessionRef, &reg->sessionPtr, SESSION_LIST_SUPPLY_LEVEL,
+                       &reg->sessionLink);
+
+    HandlersChanged();
+
+    return safeRef;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Remove handler function for EVENT 'ma_battery_SupplyLevelPercentage'
+ */
+//--------------------------------------------------------------------------------------------------
+void ma_battery_RemoveSupplyLevelPercentageHandler
+(
+    ma_battery_SupplyLevelPercentageHandlerRef_t handlerRef
+)
+{
+    SupplyLevelReg_t *reg = le_ref_Lookup(SupplyLevelRegRefMap, handlerRef);
+    if (reg == NULL)
+    {
+        LE_ERROR("Failed to lookup event based on handle %p", handlerRef);
+    }
+    else
+    {
+        if (reg->clientSessionRef == ma_battery_GetClientSessionRef())
+        {
+            le_ref_DeleteRef(SupplyLevelRegRefMap, handlerRef);
+            util_RemoveLevelAlarm(&SupplyLevelAlarmIndexes[reg->supplyIndex], &reg->alarm);
+            RemoveFromClientSession(reg->sessionPtr, SESSION_LIST_SUPPLY_LEVEL, &reg->sessionLink);
+            le_mem_Release(reg);
+
+            HandlersChanged();
+        }
+        else
+        {
+            LE_ERROR("Attempt to remove another client's Supply Level event handleRef %p",
+                     handlerRef);
+        }
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Calls a client's supply level alarm handler when its alarm fires.
+ */
+//--------------------------------------------------------------------------------------------------
+static void SupplyLevelAlarmFired
+(
+    util_LevelAlarm_t *alarmPtr,
+    uint8_t percentage,
+    bool isHighLevel
+)
+{
+    SupplyLevelReg_t *reg = CONTAINER_OF(alarmPtr, SupplyLevelReg_t, alarm);
+
+    reg->handler(reg->supplyIndex,
+                 percentage,
+                 isHighLevel ? alarmPtr->percentageHigh : alarmPtr->percentageLow,
+                 isHighLevel,
+                 reg->clientContext);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Called by the supplies module with the level of one of its supplies after each sweep.
+ */
+//--------------------------------------------------------------------------------------------------
+static void SupplyLevelChanged
+(
+    size_t index,   ///< Index in the supplies module.
+    uint8_t percentage
+)
+{
+    util_CheckLevelAlarms(&SupplyLevelAlarmIndexes[index + 1], percentage, SupplyLevelAlarmFired);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Called by the supplies module when the status of one of its supplies changes.
+ */
+//--------------------------------------------------------------------------------------------------
+static void SupplyChanged
+(
+    size_t index,   ///< Index in the supplies module.
+    const core_SupplySample_t *samplePtr
+)
+{
+    LE_INFO("Power supply '%s' is %s, %s.",
+            core_GetSupplyName(index),
+            samplePtr->isOnline ? "online" : "offline",
+            core_GetHealthStr(samplePtr->health));
+
+    ReportSupplyStatusChange(index + 1,
+                             samplePtr->isOnline,
+                             samplePtr->chargingStatus,
+                             samplePtr->health);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Compute the percentage of battery charge given the energy charge level and the capacity.
+ *
+ * @return The percentage.
+ */
+//--------------------------------------------------------------------------------------------------
+unsigned int core_ComputePercentage
+(
+    unsigned int charge,    ///< mAh
+    unsigned int capacity   ///< mAh
+)
+{
+    unsigned int percentage = 0;
+
+    // Clamp at 100%
+    if (charge > capacity)
+    {
+        LE_ERROR("Battery monitor reports available charge (%u mAh) higher than maximum of %u mAh.",
+                 charge,
+                 capacity);
+        percentage = 100;
+    }
+    else if (capacity == 0) // Catch a zero capacity to avoid a divide by zero.
+    {
+        percentage = 0;
+    }
+    else
+    {
+        // Compute the battery charge percentage, rounding up from half a percent or higher.
+        unsigned int percentTimesTen = 1000 * charge / capacity;
+        percentage = (percentTimesTen / 10);
+        if ((percentTimesTen % 10) >= 5)
+        {
+            percentage += 1;
+        }
+    }
+
+    return percentage;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Report alarms and status changes that API clients have registered to receive.  Called each time
+ * a sample is processed.
+ */
+//--------------------------------------------------------------------------------------------------
+void core_Report
+(
+    ma_battery_HealthStatus_t health,
+    ma_battery_ChargingStatus_t chargingStatus,
+    int percentage          ///< -1 if unknown, which leaves the level alarms as they are.
+)
+{
+    ReportHealthStatusChange(health);
+    ReportChargingStatusChange(chargingStatus);
+    ReportMainSupplyStatus(health, chargingStatus);
+    if (percentage >= 0)
+    {
+        ReportBatteryLevelAlarms((uint8_t)percentage);
+        util_CheckLevelAlarms(&SupplyLevelAlarmIndexes[0], (uint8_t)percentage,
+                              SupplyLevelAlarmFired);
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Check whether any level alarm registration of the backend's battery has a threshold within a
+ * given distance of a percentage.
+ *
+ * @return true if a low or high threshold lies in [percentage - distance, percentage + distance].
+ */
+//--------------------------------------------------------------------------------------------------
+bool core_IsNearLevelAlarm
+(
+    int percentage,
+    int distance
+)
+{
+    return (   util_IsNearLevelAlarm(&LevelAlarmIndex, percentage, distance)
+            || util_IsNearLevelAlarm(&SupplyLevelAlarmIndexes[0], percentage, distance));
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Add a sample to the history returned by the GetHistory() and GetRecentHistory() API functions.
+ */
+//--------------------------------------------------------------------------------------------------
+void core_AddHistorySample
+(
+    uint64_t timestamp,     ///< When the values were read (ms since the Epoch).
+    ma_battery_HealthStatus_t health,
+    ma_battery_ChargingStatus_t chargingStatus,
+    unsigned int percentage,
+    unsigned int charge,    ///< mAh
+    double current,         ///< mA
+    double voltage,         ///< V
+    double temperature      ///< degrees C
+)
+{
+    util_AddHistorySample(&History,
+                          timestamp,
+                          health,
+                          chargingStatus,
+                          percentage,
+                          charge,
+                          current,
+                          voltage,
+                          temperature);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Select the backend that provides the battery values.  The backend is only accepted if all of
+ * its power_supply class devices are present, so a backend built for other hardware can tell
+ * that it should stay idle.
+ *
+ * @return
+ *      - LE_OK if the backend was selected.
+ *      - LE_NOT_FOUND if its hardware is not present.
+ *      - LE_DUPLICATE if another backend has already been selected.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t core_SetBackend
+(
+    const core_Backend_t *backendPtr
+)
+{
+    if (BackendPtr != NULL)
+    {
+        LE_ERROR("Battery backend '%s' already selected. Ignoring '%s'.",
+                 BackendPtr->name,
+                 backendPtr->name);
+        return LE_DUPLICATE;
+    }
+
+    for (const char *const *namePtr = backendPtr->supplyNames; *namePtr != NULL; namePtr++)
+    {
+        if (!util_IsPowerSupplyPresent(*namePtr))
+        {
+            LE_INFO("Power supply '%s' not found. Battery backend '%s' not used.",
+                    *namePtr,
+                    backendPtr->name);
+            return LE_NOT_FOUND;
+        }
+    }
+
+    LE_INFO("Using battery backend '%s'.", backendPtr->name);
+
+    BackendPtr = backendPtr;
+
+    core_InitSupplies(backendPtr->supplyNames, SupplyChanged, SupplyLevelChanged);
+    core_InitPush();
+    core_InitPersistence();
+    core_InitSampling(backendPtr);
+
+    if ((BackendPtr->notificationsChanged != NULL) && IsAnyHandlerRegistered)
+    {
+        BackendPtr->notificationsChanged(true);
+    }
+
+    return LE_OK;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Provides battery health status
+ *
+ * @return Health status code.
+ */
+//--------------------------------------------------------------------------------------------------
+ma_battery_HealthStatus_t ma_battery_GetHealthStatus
+(
+    void
+)
+{
+    if (BackendPtr == NULL)
+    {
+        return MA_BATTERY_HEALTH_UNKNOWN;
+    }
+
+    core_Values_t values;
+    core_GetLatestValues(&values);
+
+    return values.health;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Provides battery charging status
+ *
+ * @return Charging status code.
+ */
+//--------------------------------------------------------------------------------------------------
+ma_battery_ChargingStatus_t ma_battery_GetChargingStatus
+(
+    void
+)
+{
+    if (BackendPtr == NULL)
+    {
+        return MA_BATTERY_CHARGING_UNKNOWN;
+    }
+
+    core_Values_t values;
+    core_GetLatestValues(&values);
+
+    return values.chargingStatus;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get battery voltage (in Volts)
+ *
+ * @return
+ *      - LE_OK on success.
+ *      - LE_NOT_FOUND if no battery hardware was found, or the value couldn't be read.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t ma_battery_GetVoltage
+(
+    double *volt
+)
+{
+    if (BackendPtr == NULL)
+    {
+        return LE_NOT_FOUND;
+    }
+
+    core_Values_t values;
+    core_GetLatestValues(&values);
+    if (!(values.validFields & MA_BATTERY_FIELD_VOLTAGE))
+    {
+        return LE_NOT_FOUND;
+    }
+
+    *volt = values.voltage;
+
+    return LE_OK;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get battery current (in mA)
+ *
+ * @return
+ *      - LE_OK on success.
+ *      - LE_NOT_FOUND if no battery hardware was found, or the value couldn't be read.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t ma_battery_GetCurrent
+(
+    double *current ///< Battery current in mA, if LE_OK is returned.
+)
+{
+    if (BackendPtr == NULL)
+    {
+        return LE_NOT_FOUND;
+    }
+
+    core_Values_t values;
+    core_GetLatestValues(&values);
+    if (!(values.validFields & MA_BATTERY_FIELD_CURRENT))
+    {
+        return LE_NOT_FOUND;
+    }
+
+    *current = values.current;
+
+    return LE_OK;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get battery temperature in degrees Celcius
+ *
+ * @return
+ *      - LE_OK on success.
+ *      - LE_NOT_FOUND if no battery hardware was found, or the value couldn't be read.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t ma_battery_GetTemp
+(
+    double *temp    ///< degrees C
+)
+{
+    if (BackendPtr == NULL)
+    {
+        return LE_NOT_FOUND;
+    }
+
+    core_Values_t values;
+    core_GetLatestValues(&values);
+    if (!(values.validFields & MA_BATTERY_FIELD_TEMP))
+    {
+        return LE_NOT_FOUND;
+    }
+
+    *temp = values.temp;
+
+    return LE_OK;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get charge remaining, in percentage
+ *
+ * @return
+ *      - LE_OK
+ *      - LE_IO_ERROR
+ *      - LE_NOT_FOUND
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t ma_battery_GetPercentRemaining
+(
+    uint16_t *percentage
+)
+{
+    if (BackendPtr == NULL)
+    {
+        return LE_NOT_FOUND;
+    }
+
+    core_Values_t values;
+    core_GetLatestValues(&values);
+    if (!(values.validFields & MA_BATTERY_FIELD_PERCENT))
+    {
+        return LE_NOT_FOUND;
+    }
+
+    *percentage = values.percent;
+
+    return LE_OK;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the confidence in the charge remaining.
+ *
+ * @return
+ *      - LE_OK
+ *      - LE_NOT_FOUND if the charge level is not being estimated.
+ *      - LE_NOT_IMPLEMENTED if the battery monitor doesn't provide it.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t ma_battery_GetPercentConfidence
+(
+    uint8_t *confidence     ///< 0 to 100.
+)
+{
+    if (BackendPtr == NULL)
+    {
+        return LE_NOT_FOUND;
+    }
+
+    if (BackendPtr->getPercentConfidence == NULL)
+    {
+        return LE_NOT_IMPLEMENTED;
+    }
+
+    return BackendPtr->getPercentConfidence(confidence);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get Charge Remaining in mAh
+ *
+ * @return
+ *      - LE_OK
+ *      - LE_IO_ERROR
+ *      - LE_NOT_FOUND if no battery hardware was found.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t ma_battery_GetChargeRemaining
+(
+    uint16_t *charge    ///< mAh
+)
+{
+    if (BackendPtr == NULL)
+    {
+        return LE_NOT_FOUND;
+    }
+
+    core_Values_t values;
+    core_GetLatestValues(&values);
+    if (!(values.validFields & MA_BATTERY_FIELD_CHARGE))
+    {
+        return LE_NOT_FOUND;
+    }
+
+    *charge = values.charge;
+
+    return LE_OK;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the predicted time until the battery is empty.
+ *
+ * @return
+ *      - LE_OK
+ *      - LE_NOT_FOUND if not discharging or the charge level is not being estimated.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t ma_battery_GetTimeToEmpty
+(
+    uint32_t *seconds
+)
+{
+    if (BackendPtr == NULL)
+    {
+        return LE_NOT_FOUND;
+    }
+
+    core_Values_t values;
+    core_GetLatestValues(&values);
+
+    return core_GetTimeToEmpty(&values, seconds);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the predicted time until the battery is full.
+ *
+ * @return
+ *      - LE_OK
+ *      - LE_NOT_FOUND if not charging or the charge level is not being estimated.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t ma_battery_GetTimeToFull
+(
+    uint32_t *seconds
+)
+{
+    if (BackendPtr == NULL)
+    {
+        return LE_NOT_FOUND;
+    }
+
+    core_Values_t values;
+    core_GetLatestValues(&values);
+
+    return core_GetTimeToFull(&values, seconds);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the state of health of the battery.
+ *
+ * @return
+ *      - LE_OK
+ *      - LE_NOT_FOUND if the capacity of the battery has not been estimated yet.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t ma_battery_GetStateOfHealth
+(
+    uint8_t *health,            ///< % of the design capacity.
+    uint16_t *fullCapacity      ///< mAh
+)
+{
+    if (BackendPtr == NULL)
+    {
+        return LE_NOT_FOUND;
+    }
+
+    return core_GetSohPercent(health, fullCapacity);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the number of equivalent full charge cycles.
+ *
+ * @return
+ *      - LE_OK
+ *      - LE_NOT_FOUND if the capacity is not known.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t ma_battery_GetCycleCount
+(
+    uint32_t *cycles
+)
+{
+    if (BackendPtr == NULL)
+    {
+        return LE_NOT_FOUND;
+    }
+
+    return core_GetCycleCount(cycles);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get all of the battery values in one call.
+ *
+ * @return
+ *      - LE_OK
+ *      - LE_NOT_FOUND if no battery hardware was found.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t ma_battery_GetSnapshot
+(
+    uint32_t maxAge,            ///< Maximum age of the values (ms).
+    uint64_t *timestampPtr,     ///< [out] When the values were read (ms since the Epoch).
+    ma_battery_SnapshotField_t *validFieldsPtr, ///< [out] Which of the values are valid.
+    ma_battery_ChargingStatus_t *chargingStatusPtr,
+    ma_battery_HealthStatus_t *healthPtr,
+    double *voltagePtr,         ///< [out] V
+    double *currentPtr,         ///< [out] mA
+    double *tempPtr,            ///< [out] degrees C
+    uint16_t *percentPtr,
+    uint16_t *chargePtr         ///< [out] mAh
+)
+{
+    if (BackendPtr == NULL)
+    {
+        return LE_NOT_FOUND;
+    }
+
+    core_Values_t values;
+    core_GetSnapshotValues(maxAge, timestampPtr, &values);
+
+    *validFieldsPtr = values.validFields;
+    *chargingStatusPtr = values.chargingStatus;
+    *healthPtr = values.health;
+    *voltagePtr = values.voltage;
+    *currentPtr = values.current;
+    *tempPtr = values.temp;
+    *percentPtr = values.percent;
+    *chargePtr = values.charge;
+
+    return LE_OK;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the number of power supplies: the backend's battery, and the supplies found besides it.
+ *
+ * @return The number of supplies (0 if no battery hardware was found).
+ */
+//--------------------------------------------------------------------------------------------------
+uint32_t ma_battery_GetSupplyCount
+(
+    void
+)
+{
+    if (BackendPtr == NULL)
+    {
+        return 0;
+    }
+
+    return 1 + core_GetNumSupplies();
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the name, type and online state of a power supply.
+ *
+ * @return
+ *      - LE_OK
+ *      - LE_OUT_OF_RANGE if there is no supply with that index.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t ma_battery_GetSupplyInfo
+(
+    uint32_t index,                 ///< 0 = the backend's battery.
+    char *name,                     ///< [out]
+    size_t nameSize,
+    ma_battery_SupplyType_t *typePtr,
+    bool *isOnlinePtr
+)
+{
+    if (index >= ma_battery_GetSupplyCount())
+    {
+        return LE_OUT_OF_RANGE;
+    }
+
+    if (index == 0)
+    {
+        (void)le_utf8_Copy(name, BackendPtr->name, nameSize, NULL);
+        *typePtr = MA_BATTERY_SUPPLY_BATTERY;
+        *isOnlinePtr = (ma_battery_GetHealthStatus() != MA_BATTERY_DISCONNECTED);
+        return LE_OK;
+    }
+
+    core_SupplySample_t sample;
+    core_GetSupplySample(index - 1, &sample);
+
+    (void)le_utf8_Copy(name, core_GetSupplyName(index - 1), nameSize, NULL);
+    switch (core_GetSupplyType(index - 1))
+    {
+        case UTIL_SUPPLY_BATTERY:   *typePtr = MA_BATTERY_SUPPLY_BATTERY;   break;
+        case UTIL_SUPPLY_MAINS:     *typePtr = MA_BATTERY_SUPPLY_MAINS;     break;
+        case UTIL_SUPPLY_USB:       *typePtr = MA_BATTERY_SUPPLY_USB;       break;
+        default:                    *typePtr = MA_BATTERY_SUPPLY_OTHER;     break;
+    }
+    *isOnlinePtr = sample.isOnline;
+
+    return LE_OK;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get all of the values of a power supply in one call.
+ *
+ * The other supplies are read in the same sweep as the backend's battery, so if their sample is
+ * older than maxAge, the hardware is read again.
+ *
+ * @return
+ *      - LE_OK
+ *      - LE_OUT_OF_RANGE if there is no supply with that index.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t ma_battery_GetSupplySnapshot
+(
+    uint32_t index,             ///< 0 = the backend's battery.
+    uint32_t maxAge,            ///< Maximum age of the values (ms).
+    uint64_t *timestampPtr,     ///< [out] When the values were read (ms since the Epoch).
+    ma_battery_SnapshotField_t *validFieldsPtr, ///< [out] Which of the values are valid.
+    ma_battery_ChargingStatus_t *chargingStatusPtr,
+    ma_battery_HealthStatus_t *healthPtr,
+    double *voltagePtr,         ///< [out] V
+    double *currentPtr,         ///< [out] mA
+    double *tempPtr,            ///< [out] degrees C
+    uint16_t *percentPtr,
+    uint16_t *chargePtr         ///< [out] mAh
+)
+{
+    if (index >= ma_battery_GetSupplyCount())
+    {
+        return LE_OUT_OF_RANGE;
+    }
+
+    if (index == 0)
+    {
+        return ma_battery_GetSnapshot(maxAge,
+                                      timestampPtr,
+                                      validFieldsPtr,
+                                      chargingStatusPtr,
+                                      healthPtr,
+                                      voltagePtr,
+                                      currentPtr,
+                                      tempPtr,
+                                      percentPtr,
+                                      chargePtr);
+    }
+
+    core_SupplySample_t sample;
+    core_GetSupplySample(index - 1, &sample);
+
+    uint64_t now = util_GetEpochMs();
+    if ((now > sample.timestamp) && (now - sample.timestamp > maxAge))
+    {
+        core_Refresh();
+        core_GetSupplySample(index - 1, &sample);
+    }
+
+    *timestampPtr = sample.timestamp;
+    *validFieldsPtr = sample.validFields;
+    *chargingStatusPtr = sample.chargingStatus;
+    *healthPtr = sample.health;
+    *voltagePtr = sample.voltage;
+    *currentPtr = sample.current;
+    *tempPtr = sample.temp;
+    *percentPtr = sample.percent;
+    *chargePtr = sample.charge;
+
+    return LE_OK;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the charge remaining in a power supply, in percentage.
+ *
+ * @return
+ *      - LE_OK
+ *      - LE_OUT_OF_RANGE if there is no supply with that index.
+ *      - LE_NOT_FOUND if the supply doesn't report its charge level.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t ma_battery_GetSupplyPercentRemaining
+(
+    uint32_t index,             ///< 0 = the backend's battery.
+    uint16_t *percentPtr
+)
+{
+    if (index >= ma_battery_GetSupplyCount())
+    {
+        return LE_OUT_OF_RANGE;
+    }
+
+    if (index == 0)
+    {
+        return ma_battery_GetPercentRemaining(percentPtr);
+    }
+
+    core_SupplySample_t sample;
+    core_GetSupplySample(index - 1, &sample);
+    if (!(sample.validFields & MA_BATTERY_FIELD_PERCENT))
+    {
+        return LE_NOT_FOUND;
+    }
+
+    *percentPtr = sample.percent;
+
+    return LE_OK;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the charge remaining in a power supply, in mAh.
+ *
+ * @return
+ *      - LE_OK
+ *      - LE_OUT_OF_RANGE if there is no supply with that index.
+ *      - LE_NOT_FOUND if the supply doesn't report its charge.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t ma_battery_GetSupplyChargeRemaining
+(
+    uint32_t index,             ///< 0 = the backend's battery.
+    uint16_t *chargePtr         ///< [out] mAh
+)
+{
+    if (index >= ma_battery_GetSupplyCount())
+    {
+        return LE_OUT_OF_RANGE;
+    }
+
+    if (index == 0)
+    {
+        return ma_battery_GetChargeRemaining(chargePtr);
+    }
+
+    core_SupplySample_t sample;
+    core_GetSupplySample(index - 1, &sample);
+    if (!(sample.validFields & MA_BATTERY_FIELD_CHARGE))
+    {
+        return LE_NOT_FOUND;
+    }
+
+    *chargePtr = sample.charge;
+
+    return LE_OK;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the combined state of all of the batteries.  Batteries whose full charge is unknown, and
+ * those that are not present, are left out.  The full charge of the backend's battery is the one
+ * learned by its state of health, or its configured or design capacity until that is known.
+ *
+ * @return
+ *      - LE_OK
+ *      - LE_NOT_FOUND if no battery with a known full charge is present.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t ma_battery_GetAggregate
+(
+    uint32_t *numBatteriesPtr,
+    uint16_t *percentPtr,
+    uint32_t *chargePtr,        ///< [out] mAh
+    uint32_t *fullChargePtr,    ///< [out] mAh
+    bool *isExternalPowerPtr
+)
+{
+    if (BackendPtr == NULL)
+    {
+        return LE_NOT_FOUND;
+    }
+
+    uint32_t numBatteries = 0;
+    uint32_t charge = 0;
+    uint32_t fullCharge = 0;
+    bool isExternalPower = false;
+
+    // The backend's battery.
+    uint64_t timestamp;
+    core_Values_t values;
+    core_GetSnapshotValues(AGGREGATE_MAX_AGE_MS, &timestamp, &values);
+
+    // The charger only charges from an external supply.
+    isExternalPower = (   (values.validFields & MA_BATTERY_FIELD_CHARGING_STATUS)
+                       && (   (values.chargingStatus == MA_BATTERY_CHARGING)
+                           || (values.chargingStatus == MA_BATTERY_FULL)  )  );
+
+    uint8_t stateOfHealth;
+    uint16_t mainFullCharge;
+    if (   (core_GetSohPercent(&stateOfHealth, &mainFullCharge) != LE_OK)
+        || (mainFullCharge == 0)  )
+    {
+        mainFullCharge = values.fullCharge;
+    }
+
+    if (   (values.validFields & MA_BATTERY_FIELD_CHARGE)
+        && (values.health != MA_BATTERY_DISCONNECTED)
+        && (mainFullCharge > 0)  )
+    {
+        numBatteries++;
+        charge += values.charge;
+        fullCharge += mainFullCharge;
+    }
+
+    // The other supplies.
+    for (size_t i = 0; i < core_GetNumSupplies(); i++)
+    {
+        core_SupplySample_t sample;
+        core_GetSupplySample(i, &sample);
+
+        if (!sample.isOnline)
+        {
+            continue;
+        }
+
+        switch (core_GetSupplyType(i))
+        {
+            case UTIL_SUPPLY_BATTERY:
+                if ((sample.validFields & MA_BATTERY_FIELD_CHARGE) && (sample.fullCharge > 0))
+                {
+                    numBatteries++;
+                    charge += sample.charge;
+                    fullCharge += sample.fullCharge;
+                }
+                break;
+
+            case UTIL_SUPPLY_MAINS:
+            case UTIL_SUPPLY_USB:
+                isExternalPower = true;
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    if (numBatteries == 0)
+    {
+        return LE_NOT_FOUND;
+    }
+
+    *numBatteriesPtr = numBatteries;
+    *percentPtr = core_ComputePercentage(charge, fullCharge);
+    *chargePtr = charge;
+    *fullChargePtr = fullCharge;
+    *isExternalPowerPtr = isExternalPower;
+
+    return LE_OK;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Copy samples out of the history into the arrays of a GetHistory() or GetRecentHistory() call.
+ *
+ * @return
+ *      - LE_OK on success.
+ *      - LE_OVERFLOW if copying a range and more samples remain in the range.
+ *      - LE_NOT_FOUND if there were no samples to copy.
+ */
+//--------------------------------------------------------------------------------------------------
+static le_result_t CopyHistory
+(
+    bool isRange,               ///< true = copy a time range, false = copy the most recent samples.
+    uint64_t startTime,         ///< ms since the Epoch (only if isRange).
+    uint64_t endTime,           ///< ms since the Epoch (only if isRange).
+    uint64_t *timestampPtr,
+    size_t *timestampSizePtr,
+    uint8_t *percentPtr,
+    size_t *percentSizePtr,
+    uint16_t *chargePtr,
+    size_t *chargeSizePtr,
+    double *currentPtr,
+    size_t *currentSizePtr,
+    double *voltagePtr,
+    size_t *voltageSizePtr,
+    double *tempPtr,
+    size_t *tempSizePtr,
+    uint8_t *chargingStatusPtr,
+    size_t *chargingStatusSizePtr,
+    uint8_t *healthPtr,
+    size_t *healthSizePtr
+)
+{
+    size_t *sizePtrs[] = { timestampSizePtr, percentSizePtr, chargeSizePtr, currentSizePtr,
+                           voltageSizePtr, tempSizePtr, chargingStatusSizePtr, healthSizePtr };
+
+    // Don't copy more samples than will fit in the smallest array.
+    size_t maxCount = SIZE_MAX;
+    for (int i = 0; i < NUM_ARRAY_MEMBERS(sizePtrs); i++)
+    {
+        if (*sizePtrs[i] < maxCount)
+        {
+            maxCount = *sizePtrs[i];
+        }
+    }
+
+    const util_HistoryColumns_t columns =
+    {
+        .timestampPtr = timestampPtr,
+        .percentPtr = percentPtr,
+        .chargePtr = chargePtr,
+        .currentPtr = currentPtr,
+        .voltagePtr = voltagePtr,
+        .tempPtr = tempPtr,
+        .chargingStatusPtr = chargingStatusPtr,
+        .healthPtr = healthPtr,
+    };
+
+    le_result_t result = LE_OK;
+    size_t count;
+    if (isRange)
+    {
+        bool isMore;
+        count = util_GetHistoryRange(&History, startTime, endTime, &columns, maxCount, &isMore);
+        if (isMore)
+        {
+            result = LE_OVERFLOW;
+        }
+    }
+    else
+    {
+        count = util_GetRecentHistory(&History, &columns, maxCount);
+    }
+
+    for (int i = 0; i < NUM_ARRAY_MEMBERS(sizePtrs); i++)
+    {
+        *sizePtrs[i] = count;
+    }
+
+    if (count == 0)
+    {
+        result = LE_NOT_FOUND;
+    }
+
+    return result;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the recorded battery samples time-stamped within a range, oldest first.
+ *
+ * @return
+ *      - LE_OK on success.
+ *      - LE_OVERFLOW if the arrays were filled but more samples remain in the range.
+ *      - LE_NOT_FOUND if there are no samples in the range.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t ma_battery_GetHistory
+(
+    uint64_t startTime,         ///< ms since the Epoch (inclusive).
+    uint64_t endTime,           ///< ms since the Epoch (inclusive).
+    uint64_t *timestampPtr,
+    size_t *timestampSizePtr,
+    uint8_t *percentPtr,
+    size_t *percentSizePtr,
+    uint16_t *chargePtr,
+    size_t *chargeSizePtr,
+    double *currentPtr,
+    size_t *currentSizePtr,
+    double *voltagePtr,
+    size_t *voltageSizePtr,
+    double *tempPtr,
+    size_t *tempSizePtr,
+    uint8_t *chargingStatusPtr,
+    size_t *chargingStatusSizePtr,
+    uint8_t *healthPtr,
+    size_t *healthSizePtr
+)
+{
+    return CopyHistory(true,
+                       startTime,
+                       endTime,
+                       timestampPtr, timestampSizePtr,
+                       percentPtr, percentSizePtr,
+                       chargePtr, chargeSizePtr,
+                       currentPtr, currentSizePtr,
+                       voltagePtr, voltageSizePtr,
+                       tempPtr, tempSizePtr,
+                       chargingStatusPtr, chargingStatusSizePtr,
+                       healthPtr, healthSizePtr);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the most recently recorded battery samples, oldest first.
+ *
+ * @return
+ *      - LE_OK on success.
+ *      - LE_NOT_FOUND if no samples have been recorded yet.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t ma_battery_GetRecentHistory
+(
+    uint64_t *timestampPtr,
+    size_t *timestampSizePtr,
+    uint8_t *percentPtr,
+    size_t *percentSizePtr,
+    uint16_t *chargePtr,
+    size_t *chargeSizePtr,
+    double *currentPtr,
+    size_t *currentSizePtr,
+    double *voltagePtr,
+    size_t *voltageSizePtr,
+    double *tempPtr,
+    size_t *tempSizePtr,
+    uint8_t *chargingStatusPtr,
+    size_t *chargingStatusSizePtr,
+    uint8_t *healthPtr,
+    size_t *healthSizePtr
+)
+{
+    return CopyHistory(false,
+                       0,
+                       0,
+                       timestampPtr, timestampSizePtr,
+                       percentPtr, percentSizePtr,
+                       chargePtr, chargeSizePtr,
+                       currentPtr, currentSizePtr,
+                       voltagePtr, voltageSizePtr,
+                       tempPtr, tempSizePtr,
+                       chargingStatusPtr, chargingStatusSizePtr,
+                       healthPtr, healthSizePtr);
+}
+
+
+COMPONENT_INIT
+{
+    LevelAlarmPool   = le_mem_CreatePool("batt_events", sizeof(LevelAlarmReg_t));
+    LevelAlarmRefMap = le_ref_CreateMap("batt_events", 4);
+    util_InitLevelAlarmIndex(&LevelAlarmIndex);
+
+    ChargingStatusRegPool   = le_mem_CreatePool("charge_events", sizeof(ChargingStatusReg_t));
+    ChargingStatusRegRefMap = le_ref_CreateMap("charge_events", 4);
+
+    HealthStatusRegPool   = le_mem_CreatePool("health_events", sizeof(HealthStatusReg_t));
+    HealthStatusRegRefMap = le_ref_CreateMap("health_events", 4);
+
+    SupplyStatusRegPool   = le_mem_CreatePool("supply_events", sizeof(SupplyStatusReg_t));
+    SupplyStatusRegRefMap = le_ref_CreateMap("supply_events", 4);
+
+    SupplyLevelRegPool   = le_mem_CreatePool("supply_level_events", sizeof(SupplyLevelReg_t));
+    SupplyLevelRegRefMap = le_ref_CreateMap("supply_level_events", 4);
+    for (size_t i = 0; i < NUM_ARRAY_MEMBERS(SupplyLevelAlarmIndexes); i++)
+    {
+        util_InitLevelAlarmIndex(&SupplyLevelAlarmIndexes[i]);
+    }
+
+    ClientSessionPool = le_mem_CreatePool("client_sessions", sizeof(ClientSession_t));
+    ClientSessionMap  = le_hashmap_Create("client_sessions",
+                                          4,
+                                          le_hashmap_HashVoidPointer,
+                                          le_hashmap_EqualsVoidPointer);
+
+    util_InitHistory(&History);
+
+    le_msg_AddServiceCloseHandler(ma_battery_GetServiceRef(), ClientSessionClosedHandler, NULL);
+}
@@ -0,0 +1,107 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file batteryCore.h
+ *
+ * Interface between the Battery Service core and the battery backends.
+ *
+ * The core implements everything that doesn't depend on the battery hardware: the ma_battery API
+ * with its client registrations and history, the sampler thread, the pushes to the Data Hub, the
+ * run time prediction, and the saving of the charge level and state of health in the Config Tree.
+ * A backend only reads its hardware and tells the core what the readings mean, through a table of
+ * functions that it hands to core_SetBackend() when it has found its hardware:
+ *
+ *  - readSample() reads the driver files into a sample of the backend's own layout.  It is called
+ *    in the sampler thread, so it is the only function that accesses the hardware.
+ *  - processSample() updates the backend's own state (e.g., its state machine) from a sample, in
+ *    the main thread, before the sample is reported to API clients and pushed to the Data Hub.
+ *  - getValues() maps a sample to the battery values, in the main thread.  The API getters, the
+ *    reports and the pushes all go through it.
+ *
+ * The backend then calls core_StartSampling() once it can read its hardware, and requests samples
+ * with core_RequestSample() (e.g., from its own polling timer).  The other power supplies of the
+ * board are read in the same sweep as each sample.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#ifndef BATTERY_CORE_H
+#define BATTERY_CORE_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include "powerSupply.h"
+#include "stateOfHealth.h"
+
+/// Largest sample that a backend can read (bytes).
+#define CORE_MAX_SAMPLE_SIZE 256
+
+// Reasons for taking a sample (sample request flags, see core_RequestSample()).
+#define CORE_SAMPLE_FOR_PUSH   0x1  ///< Report to API clients and push to the Data Hub.
+#define CORE_SAMPLE_FOR_REPORT 0x2  ///< Report to API clients only.
+
+/// Battery values that a backend maps one of its samples to.  Values that aren't valid are 0.
+typedef struct
+{
+    ma_battery_SnapshotField_t validFields; ///< Which of the following values are valid.
+    ma_battery_ChargingStatus_t chargingStatus;
+    ma_battery_HealthStatus_t health;
+    double voltage;             ///< V
+    double current;             ///< mA
+    double temp;                ///< degrees C
+    uint16_t percent;
+    uint16_t charge;            ///< mAh
+    uint16_t fullCharge;        ///< Configured or estimated full charge (mAh), or 0 if unknown.
+}
+core_Values_t;
+
+/// Functions implemented by a battery backend.
+typedef struct
+{
+    const char *name;               ///< Name of the hardware, for the logs.
+    const char *const *supplyNames; ///< power_supply class devices that must be present,
+                                    ///< terminated by NULL.
+    size_t sampleSize;              ///< Size of the backend's sample (CORE_MAX_SAMPLE_SIZE max).
+
+    /// Read the hardware into a sample.  Called in the sampler thread (and once in
+    /// core_StartSampling()).
+    void (*readSample)(void *samplePtr);
+
+    /// Update the backend's state from a sample taken for the given reasons (sample request
+    /// flags), when it was taken (monotonic clock).  Returns false if the sample must not be
+    /// reported or pushed.  May be NULL.
+    bool (*processSample)(const void *samplePtr, le_clk_Time_t time, uint32_t reasons);
+
+    /// Map a sample to the battery values.
+    void (*getValues)(const void *samplePtr, core_Values_t *valuesPtr);
+
+    /// Implements ma_battery_GetPercentConfidence().  May be NULL if the hardware estimates the
+    /// charge level without reporting a confidence.
+    le_result_t (*getPercentConfidence)(uint8_t *confidencePtr);
+
+    /// Called when the first notification handler is added, and when the last one is removed.
+    /// May be NULL.
+    void (*notificationsChanged)(bool isAnyRegistered);
+}
+core_Backend_t;
+
+LE_SHARED le_result_t core_SetBackend(const core_Backend_t *backendPtr);
+LE_SHARED void core_StartSampling(void);
+LE_SHARED void core_RequestSample(uint32_t reasons);
+LE_SHARED le_clk_Time_t core_GetLatestSample(void *samplePtr);
+LE_SHARED void core_QueueToSampler(le_event_DeferredFunc_t func, void *param1Ptr,
+                                   void *param2Ptr);
+
+LE_SHARED util_StateOfHealth_t *core_GetStateOfHealth(void);
+LE_SHARED void core_LoadStateOfHealth(double designCapacity);
+LE_SHARED void core_ResetStateOfHealth(double designCapacity);
+
+LE_SHARED int core_LoadPercentage(void);
+LE_SHARED void core_SavePercentage(unsigned int percentage);
+LE_SHARED void core_DeletePercentage(void);
+
+LE_SHARED bool core_IsNearLevelAlarm(int percentage, int distance);
+LE_SHARED unsigned int core_ComputePercentage(unsigned int charge, unsigned int capacity);
+LE_SHARED const char *core_GetHealthStr(ma_battery_HealthStatus_t healthCode);
+LE_SHARED ma_battery_ChargingStatus_t core_GetChargingStatusCode(util_PowerSupplyStatus_t status);
+LE_SHARED ma_battery_HealthStatus_t core_GetHealthStatusCode(util_PowerSupplyHealth_t health);
+
+#endif // BATTERY_CORE_H
@@ -0,0 +1,310 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file persist.c
+ *
+ * State of the battery kept in the Config Tree across restarts (see persist.h):
+ *
+ *  - batteryInfo/percent: the charge level percentage, for a backend that estimates the charge
+ *    itself and would otherwise have to calibrate again after a reboot.  Saves are coalesced,
+ *    because each one is a Config Tree transaction (and a flash write).  The shortest time between
+ *    saves is served as the "saveInterval" Data Hub config resource (seconds).
+ *  - batteryInfo/soh: the state of health counters, saved at most once per interval.
+ *
+ * Both are saved right away when the process is stopped (see sampling.c).
+ *
+ * <hr>
+ *
+ * Copyright (C) Sierra Wireless Inc.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#include "legato.h"
+#include "interfaces.h"
+#include "batteryCore.h"
+#include "batteryUtils.h"
+#include "stateOfHealth.h"
+#include "persist.h"
+#include <math.h>
+
+/// Default shortest time between saves of the charge level percentage to the Config Tree.
+#define DEFAULT_PERCENT_SAVE_INTERVAL_MS 600000
+
+/// Change in the charge level percentage that is saved without waiting for the save interval.
+#define PERCENT_SAVE_DELTA 5
+
+/// Shortest time between saves of the percentage in seconds.
+#define RES_PATH_SAVE_INTERVAL "saveInterval"
+
+/// Shortest time between saves of the charge level percentage to the Config Tree (ms).
+static uint32_t PercentSaveInterval = DEFAULT_PERCENT_SAVE_INTERVAL_MS;
+
+/// The charge level percentage, as held in RAM and as last saved to the Config Tree.
+static struct
+{
+    int value;                  ///< Latest percentage.
+    int savedValue;             ///< Percentage in the Config Tree, or -1 if none.
+    bool isDirty;               ///< true if value hasn't been saved.
+    le_clk_Time_t saveTime;     ///< When the percentage was last saved (monotonic clock).
+}
+Percent = { -1, -1, false, { 0, 0 } };
+
+/// Cycle count and capacity fade of the battery.
+static util_StateOfHealth_t StateOfHealth;
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Set the shortest time between saves of the charge level percentage.
+ */
+//--------------------------------------------------------------------------------------------------
+
+static void SetSaveInterval
+(
+    double timestamp,
+    double period,  ///< seconds
+    void* contextPtr ///< unused
+)
+//--------------------------------------------------------------------------------------------------
+{
+    if (period < 0)
+    {
+        LE_ERROR("Save interval of %lf seconds is out of range.", period);
+    }
+    else
+    {
+        PercentSaveInterval = (uint32_t)(period * 1000);
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Write the percentage level to the Config Tree, if it hasn't been saved yet.
+ */
+//--------------------------------------------------------------------------------------------------
+void core_FlushPercentage
+(
+    void
+)
+{
+    if (Percent.isDirty)
+    {
+        le_cfg_QuickSetInt("batteryInfo/percent", Percent.value);
+
+        Percent.savedValue = Percent.value;
+        Percent.isDirty = false;
+        Percent.saveTime = util_GetRelativeTime();
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Save the percentage level.  It is written to the Config Tree right away if there is nothing
+ * saved yet or it changed by PERCENT_SAVE_DELTA or more, otherwise at most once per
+ * PercentSaveInterval.
+ */
+//--------------------------------------------------------------------------------------------------
+void core_SavePercentage
+(
+    unsigned int percentage
+)
+{
+    if ((int)percentage != Percent.value)
+    {
+        Percent.value = percentage;
+        Percent.isDirty = (Percent.value != Percent.savedValue);
+    }
+
+    if (   Percent.isDirty
+        && (   (Percent.savedValue < 0)
+            || (abs(Percent.value - Percent.savedValue) >= PERCENT_SAVE_DELTA)
+            || (util_MsSince(Percent.saveTime) >= PercentSaveInterval)  )  )
+    {
+        core_FlushPercentage();
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Delete the saved percentage level, e.g., when the battery is disconnected.
+ */
+//--------------------------------------------------------------------------------------------------
+void core_DeletePercentage
+(
+    void
+)
+{
+    le_cfg_QuickDeleteNode("batteryInfo/percent");
+
+    Percent.value = -1;
+    Percent.savedValue = -1;
+    Percent.isDirty = false;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Load the saved percentage level.
+ *
+ * @return The percentage, or -1 if not found.
+ */
+//--------------------------------------------------------------------------------------------------
+int core_LoadPercentage
+(
+    void
+)
+{
+    Percent.savedValue = le_cfg_QuickGetInt("batteryInfo/percent", -1);
+    Percent.value = Percent.savedValue;
+    Percent.isDirty = false;
+    Percent.saveTime = util_GetRelativeTime();
+
+    return Percent.savedValue;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the state of health counters, for the backend to count the charge drawn from the battery
+ * and to set its anchor points or full charge capacity.  Only to be used in the main thread.
+ *
+ * @return Pointer to the counters.
+ */
+//--------------------------------------------------------------------------------------------------
+util_StateOfHealth_t *core_GetStateOfHealth
+(
+    void
+)
+{
+    return &StateOfHealth;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Save the state of health counters, if they changed and weren't saved too recently.
+ */
+//--------------------------------------------------------------------------------------------------
+void core_SaveStateOfHealth
+(
+    uint32_t intervalMs     ///< Shortest time since the last save (0 to save any change now).
+)
+{
+    if (util_IsSohSaveDue(&StateOfHealth, intervalMs))
+    {
+        le_cfg_IteratorRef_t iteratorRef = le_cfg_CreateWriteTxn("batteryInfo/soh");
+        le_cfg_SetInt(iteratorRef, "fullCapacity", (int32_t)lround(StateOfHealth.fullCapacity));
+        le_cfg_SetInt(iteratorRef, "cycles", (int32_t)StateOfHealth.cycleCount);
+        le_cfg_SetInt(iteratorRef, "cycleCharge", (int32_t)lround(StateOfHealth.cycleCharge));
+        le_cfg_CommitTxn(iteratorRef);
+
+        util_MarkSohSaved(&StateOfHealth);
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Load the state of health counters saved for the battery.
+ */
+//--------------------------------------------------------------------------------------------------
+void core_LoadStateOfHealth
+(
+    double designCapacity   ///< Capacity of the battery when new (mAh), or 0 if unknown.
+)
+{
+    util_InitStateOfHealth(&StateOfHealth,
+                           designCapacity,
+                           le_cfg_QuickGetInt("batteryInfo/soh/fullCapacity", 0),
+                           le_cfg_QuickGetInt("batteryInfo/soh/cycles", 0),
+                           le_cfg_QuickGetInt("batteryInfo/soh/cycleCharge", 0));
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Forget the state of health counters, when a different battery is configured.
+ */
+//--------------------------------------------------------------------------------------------------
+void core_ResetStateOfHealth
+(
+    double designCapacity   ///< Capacity of the new battery (mAh), or 0 if unknown.
+)
+{
+    le_cfg_QuickDeleteNode("batteryInfo/soh");
+
+    util_InitStateOfHealth(&StateOfHealth, designCapacity, 0, 0, 0);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the state of health of the battery.
+ *
+ * @return
+ *      - LE_OK
+ *      - LE_NOT_FOUND if the capacity of the battery has not been estimated yet.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t core_GetSohPercent
+(
+    uint8_t *percentPtr,        ///< [out] % of the design capacity.
+    uint16_t *fullCapacityPtr   ///< [out] mAh
+)
+{
+    le_result_t result = util_GetSohPercent(&StateOfHealth, percentPtr);
+    if (result == LE_OK)
+    {
+        *fullCapacityPtr = (uint16_t)lround(StateOfHealth.fullCapacity);
+    }
+
+    return result;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the number of equivalent full charge cycles.
+ *
+ * @return
+ *      - LE_OK
+ *      - LE_NOT_FOUND if the design capacity of the battery is unknown.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t core_GetCycleCount
+(
+    uint32_t *cyclesPtr
+)
+{
+    if (StateOfHealth.designCapacity <= 0)
+    {
+        return LE_NOT_FOUND;
+    }
+
+    *cyclesPtr = StateOfHealth.cycleCount;
+
+    return LE_OK;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Create the config resource of the percentage save interval, and start with empty state of
+ * health counters until the backend loads them.  Called once the backend is selected.
+ */
+//--------------------------------------------------------------------------------------------------
+void core_InitPersistence
+(
+    void
+)
+{
+    util_InitStateOfHealth(&StateOfHealth, 0, 0, 0, 0);
+
+    LE_ASSERT(LE_OK == dhubIO_CreateOutput(RES_PATH_SAVE_INTERVAL, DHUBIO_DATA_TYPE_NUMERIC, "s"));
+    dhubIO_AddNumericPushHandler(RES_PATH_SAVE_INTERVAL, SetSaveInterval, NULL);
+    dhubIO_SetNumericDefault(RES_PATH_SAVE_INTERVAL,
+                             ((double)DEFAULT_PERCENT_SAVE_INTERVAL_MS) / 1000);
+    dhubIO_MarkOptional(RES_PATH_SAVE_INTERVAL);
+}
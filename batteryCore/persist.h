@@ -0,0 +1,24 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file persist.h
+ *
+ * State of the battery that is kept in the Config Tree across restarts: the charge level
+ * percentage (for backends that estimate it themselves) and the state of health counters.  Only
+ * used inside batteryCore.  The backend loads, saves and forgets them through the functions in
+ * batteryCore.h.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#ifndef PERSIST_H
+#define PERSIST_H
+
+#include "legato.h"
+#include "interfaces.h"
+
+void core_InitPersistence(void);
+void core_FlushPercentage(void);
+void core_SaveStateOfHealth(uint32_t intervalMs);
+le_result_t core_GetSohPercent(uint8_t *percentPtr, uint16_t *fullCapacityPtr);
+le_result_t core_GetCycleCount(uint32_t *cyclesPtr);
+
+#endif // PERSIST_H
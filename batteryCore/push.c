@@ -0,0 +1,577 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file push.c
+ *
+ * Pushes of the battery values to the Data Hub.  Each processed sample taken for a push goes to:
+ *
+ *  - value: a JSON object with every value, pushed when a value has changed by more than its
+ *    deadband since the last push, or when the heartbeat has expired.
+ *  - percent, mAh, mA, V, degC, charging, health: one resource per value, each pushed when that
+ *    value changes (by more than its deadband, for those that have one).
+ *
+ * Every processed sample, whether taken for a push or a report, is also added to the batch while
+ * batching is on, and the batch is pushed to batch/value as one JSON value (see batch.h).
+ *
+ * The settings of the pushes are served as Data Hub config resources of the Battery Service app:
+ *
+ *  - deadband/percent, deadband/V, deadband/degC, deadband/mA: change of a value that forces a
+ *    push before the heartbeat.
+ *  - heartbeat: longest time between pushes when nothing changes (seconds).
+ *  - batch/size: samples per batch push (0 = no batches).
+ *  - batch/maxAge: longest time a sample waits in a batch (seconds).
+ *
+ * <hr>
+ *
+ * Copyright (C) Sierra Wireless Inc.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#include "legato.h"
+#include "interfaces.h"
+#include "batteryUtils.h"
+#include "jsonWriter.h"
+#include "batch.h"
+#include "push.h"
+#include "sampling.h"
+#include "persist.h"
+
+// Default change-suppression deadbands for Data Hub pushes.
+#define DEFAULT_PERCENT_DEADBAND 1.0    ///< %
+#define DEFAULT_VOLTAGE_DEADBAND 0.01   ///< V
+#define DEFAULT_TEMP_DEADBAND    0.5    ///< degrees C
+#define DEFAULT_CURRENT_DEADBAND 5.0    ///< mA
+
+/// Default longest time between Data Hub pushes when nothing changes (ms).
+#define DEFAULT_PUSH_HEARTBEAT_MS 300000
+
+/// Default longest time a sample is held in a batch before the batch is pushed (ms).
+#define DEFAULT_BATCH_MAX_AGE_MS 60000
+
+// Output resources (configuration settings).
+#define RES_PATH_PERCENT_DEADBAND "deadband/percent" ///< Change in % that forces a push
+#define RES_PATH_VOLTAGE_DEADBAND "deadband/V"       ///< Change in V that forces a push
+#define RES_PATH_TEMP_DEADBAND    "deadband/degC"    ///< Change in degrees C that forces a push
+#define RES_PATH_CURRENT_DEADBAND "deadband/mA"      ///< Change in mA that forces a push
+#define RES_PATH_HEARTBEAT   "heartbeat" ///< Longest time between pushes in seconds
+#define RES_PATH_BATCH_SIZE  "batch/size"   ///< Samples per batch push (0 = no batches)
+#define RES_PATH_BATCH_MAX_AGE "batch/maxAge" ///< Longest time a sample waits in a batch in seconds
+
+/// Input resource paths
+#define RES_PATH_VALUE       "value"
+#define RES_PATH_BATCH       "batch/value"  ///< Batches of samples (see batch.h)
+
+// Input resources holding one field of the value each, pushed only when the field changes.
+#define RES_PATH_PERCENT     "percent"  ///< Charge remaining in %
+#define RES_PATH_CHARGE      "mAh"      ///< Charge remaining in mAh
+#define RES_PATH_CURRENT     "mA"       ///< Current flow in mA
+#define RES_PATH_VOLTAGE     "V"        ///< Battery voltage in Volts
+#define RES_PATH_TEMP        "degC"     ///< Temperature in degrees C
+#define RES_PATH_CHARGING    "charging" ///< true if charging (or full on external power)
+#define RES_PATH_HEALTH      "health"   ///< Health string (e.g., "good")
+
+/// Example JSON value
+#define JSON_EXAMPLE "{\"health\":\"good\",\"percent\":100,\"mAh\":2200,"\
+                      "\"charging\":true,\"mA\":2.838,\"V\":3.7,\"degC\":32.1,"\
+                      "\"timeToFull\":5400,\"soh\":96,\"cycles\":42}"
+
+/// Size of the buffer the JSON value is rendered into.  Comfortably larger than the longest
+/// possible value; util_JsonEnd() reports the exact length if it ever isn't.
+#define JSON_VALUE_BUFFER_SIZE 256
+
+/// Example batch value
+#define BATCH_JSON_EXAMPLE "{\"t0\":1700000000000,\"dt\":[0,1000],\"percent\":[80,80],"\
+                            "\"mAh\":[1760,1759],\"mA\":[-120.512,-121.003],"\
+                            "\"V\":[3.912,3.911],\"degC\":[31.20,31.25]}"
+
+/// The current settings.
+static core_PushSettings_t Settings =
+{
+    .percentDeadband = DEFAULT_PERCENT_DEADBAND,
+    .voltageDeadband = DEFAULT_VOLTAGE_DEADBAND,
+    .tempDeadband    = DEFAULT_TEMP_DEADBAND,
+    .currentDeadband = DEFAULT_CURRENT_DEADBAND,
+    .heartbeat       = DEFAULT_PUSH_HEARTBEAT_MS,
+    .batchSize       = 0,
+    .batchMaxAge     = DEFAULT_BATCH_MAX_AGE_MS,
+};
+
+/// The values last pushed to the value resource.
+static struct
+{
+    bool isValid;                       ///< false until the first push.
+    le_clk_Time_t time;                 ///< When the last push happened (monotonic clock).
+    ma_battery_HealthStatus_t health;
+    bool isCharging;
+    unsigned int percentage;
+    double voltage;
+    double current;
+    double temperature;
+}
+LastPush;
+
+/// The values last pushed to the per-field resources.  Each field is pushed on its own, when it
+/// changes by at least its deadband (or at all, for those without one).
+static struct
+{
+    bool isValid;                       ///< false until the first push.
+    ma_battery_HealthStatus_t health;
+    bool isCharging;
+    unsigned int percentage;
+    unsigned int charge;                ///< mAh
+    double voltage;
+    double current;
+    double temperature;
+}
+LastFieldPush;
+
+/// Samples collected for the next batch push.
+static util_Batch_t Batch;
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Set one of the Data Hub push deadbands.  The context pointer points to the deadband variable.
+ */
+//--------------------------------------------------------------------------------------------------
+
+static void SetDeadband
+(
+    double timestamp,
+    double deadband,
+    void* contextPtr ///< Ptr to the deadband variable to update.
+)
+//--------------------------------------------------------------------------------------------------
+{
+    if (deadband < 0)
+    {
+        LE_ERROR("Deadband of %lf is out of range.", deadband);
+    }
+    else
+    {
+        *((double *)contextPtr) = deadband;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Set the longest time allowed between Data Hub pushes.
+ */
+//--------------------------------------------------------------------------------------------------
+
+static void SetHeartbeat
+(
+    double timestamp,
+    double period,  ///< seconds
+    void* contextPtr ///< unused
+)
+//--------------------------------------------------------------------------------------------------
+{
+    if (period <= 0)
+    {
+        LE_ERROR("Heartbeat of %lf seconds is out of range.", period);
+    }
+    else
+    {
+        Settings.heartbeat = (uint32_t)(period * 1000);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Set the number of samples per batch push.  0 turns batching off, after pushing the samples
+ * already collected.
+ */
+//--------------------------------------------------------------------------------------------------
+
+static void SetBatchSize
+(
+    double timestamp,
+    double size,    ///< samples
+    void* contextPtr ///< unused
+)
+//--------------------------------------------------------------------------------------------------
+{
+    if ((size < 0) || (size > UTIL_MAX_BATCH_SAMPLES))
+    {
+        LE_ERROR("Batch size of %lf samples is out of range (0 to %d).",
+                 size,
+                 UTIL_MAX_BATCH_SAMPLES);
+    }
+    else
+    {
+        Settings.batchSize = (uint32_t)size;
+
+        // Push the samples already collected if there are now enough of them, or batching was
+        // turned off.
+        if (Batch.count >= Settings.batchSize)
+        {
+            core_FlushBatch();
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Set the longest time a sample is held in a batch before the batch is pushed.
+ */
+//--------------------------------------------------------------------------------------------------
+
+static void SetBatchMaxAge
+(
+    double timestamp,
+    double maxAge,  ///< seconds
+    void* contextPtr ///< unused
+)
+//--------------------------------------------------------------------------------------------------
+{
+    if (maxAge <= 0)
+    {
+        LE_ERROR("Batch maximum age of %lf seconds is out of range.", maxAge);
+    }
+    else
+    {
+        Settings.batchMaxAge = (uint32_t)(maxAge * 1000);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * @return true if the charging status means that the battery is charging.
+ */
+//--------------------------------------------------------------------------------------------------
+static bool IsCharging
+(
+    ma_battery_ChargingStatus_t chargingStatus
+)
+{
+    // Note: The battery monitors show FULL only when on external power.
+    return ((chargingStatus == MA_BATTERY_CHARGING) || (chargingStatus == MA_BATTERY_FULL));
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Decide whether values differ enough from the last ones pushed to the value resource to be
+ * pushed.  If so, they are remembered as the last pushed values.
+ *
+ * @return true if the values should be pushed.
+ */
+//--------------------------------------------------------------------------------------------------
+static bool IsPushDue
+(
+    const core_Values_t *valuesPtr
+)
+{
+    bool isCharging = IsCharging(valuesPtr->chargingStatus);
+
+    if (   LastPush.isValid
+        && (valuesPtr->health == LastPush.health)
+        && (isCharging == LastPush.isCharging)
+        && !util_IsOutsideDeadband(valuesPtr->percent,
+                                   LastPush.percentage,
+                                   Settings.percentDeadband)
+        && !util_IsOutsideDeadband(valuesPtr->voltage, LastPush.voltage, Settings.voltageDeadband)
+        && !util_IsOutsideDeadband(valuesPtr->current, LastPush.current, Settings.currentDeadband)
+        && !util_IsOutsideDeadband(valuesPtr->temp, LastPush.temperature, Settings.tempDeadband)
+        && (util_MsSince(LastPush.time) < Settings.heartbeat)  )
+    {
+        return false;
+    }
+
+    LastPush.isValid = true;
+    LastPush.time = util_GetRelativeTime();
+    LastPush.health = valuesPtr->health;
+    LastPush.isCharging = isCharging;
+    LastPush.percentage = valuesPtr->percent;
+    LastPush.voltage = valuesPtr->voltage;
+    LastPush.current = valuesPtr->current;
+    LastPush.temperature = valuesPtr->temp;
+
+    return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Push the fields that have changed to their own resources in the Data Hub.
+ */
+//--------------------------------------------------------------------------------------------------
+static void PushFields
+(
+    const core_Values_t *valuesPtr
+)
+{
+    bool isCharging = IsCharging(valuesPtr->chargingStatus);
+    bool isFirst = !LastFieldPush.isValid;
+    LastFieldPush.isValid = true;
+
+    if (isFirst || (valuesPtr->health != LastFieldPush.health))
+    {
+        LastFieldPush.health = valuesPtr->health;
+        dhubIO_PushString(RES_PATH_HEALTH, DHUBIO_NOW, core_GetHealthStr(valuesPtr->health));
+    }
+    if (isFirst || (isCharging != LastFieldPush.isCharging))
+    {
+        LastFieldPush.isCharging = isCharging;
+        dhubIO_PushBoolean(RES_PATH_CHARGING, DHUBIO_NOW, isCharging);
+    }
+    if (   isFirst
+        || util_IsOutsideDeadband(valuesPtr->percent,
+                                  LastFieldPush.percentage,
+                                  Settings.percentDeadband))
+    {
+        LastFieldPush.percentage = valuesPtr->percent;
+        dhubIO_PushNumeric(RES_PATH_PERCENT, DHUBIO_NOW, valuesPtr->percent);
+    }
+    if (isFirst || (valuesPtr->charge != LastFieldPush.charge))
+    {
+        LastFieldPush.charge = valuesPtr->charge;
+        dhubIO_PushNumeric(RES_PATH_CHARGE, DHUBIO_NOW, valuesPtr->charge);
+    }
+    if (   isFirst
+        || util_IsOutsideDeadband(valuesPtr->current,
+                                  LastFieldPush.current,
+                                  Settings.currentDeadband))
+    {
+        LastFieldPush.current = valuesPtr->current;
+        dhubIO_PushNumeric(RES_PATH_CURRENT, DHUBIO_NOW, valuesPtr->current);
+    }
+    if (   isFirst
+        || util_IsOutsideDeadband(valuesPtr->voltage,
+                                  LastFieldPush.voltage,
+                                  Settings.voltageDeadband))
+    {
+        LastFieldPush.voltage = valuesPtr->voltage;
+        dhubIO_PushNumeric(RES_PATH_VOLTAGE, DHUBIO_NOW, valuesPtr->voltage);
+    }
+    if (   isFirst
+        || util_IsOutsideDeadband(valuesPtr->temp,
+                                  LastFieldPush.temperature,
+                                  Settings.tempDeadband))
+    {
+        LastFieldPush.temperature = valuesPtr->temp;
+        dhubIO_PushNumeric(RES_PATH_TEMP, DHUBIO_NOW, valuesPtr->temp);
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Push the values of a sample taken for a push: the fields that have changed to their own
+ * resources, and all of them to the value resource unless nothing has changed by more than its
+ * deadband since the last push and the push heartbeat hasn't expired.
+ */
+//--------------------------------------------------------------------------------------------------
+void core_PushValues
+(
+    const core_Values_t *valuesPtr
+)
+{
+    PushFields(valuesPtr);
+
+    if (!IsPushDue(valuesPtr))
+    {
+        return;
+    }
+
+    // Generate a JSON value.
+    char value[JSON_VALUE_BUFFER_SIZE];
+    size_t len;
+    util_JsonWriter_t writer;
+    util_JsonBegin(&writer, value, sizeof(value));
+    util_JsonAddString(&writer, "health", core_GetHealthStr(valuesPtr->health));
+    util_JsonAddInt(&writer, "percent", valuesPtr->percent);
+    util_JsonAddInt(&writer, "mAh", valuesPtr->charge);
+    util_JsonAddBool(&writer, "charging", IsCharging(valuesPtr->chargingStatus));
+    util_JsonAddDecimal(&writer, "mA", valuesPtr->current, 3);
+    util_JsonAddDecimal(&writer, "V", valuesPtr->voltage, 2);
+    util_JsonAddDecimal(&writer, "degC", valuesPtr->temp, 2);
+    uint32_t seconds;
+    if (core_GetTimeToEmpty(valuesPtr, &seconds) == LE_OK)
+    {
+        util_JsonAddInt(&writer, "timeToEmpty", seconds);
+    }
+    if (core_GetTimeToFull(valuesPtr, &seconds) == LE_OK)
+    {
+        util_JsonAddInt(&writer, "timeToFull", seconds);
+    }
+    uint8_t stateOfHealth;
+    uint16_t fullCapacity;
+    if (core_GetSohPercent(&stateOfHealth, &fullCapacity) == LE_OK)
+    {
+        util_JsonAddInt(&writer, "soh", stateOfHealth);
+    }
+    uint32_t cycles;
+    if (core_GetCycleCount(&cycles) == LE_OK)
+    {
+        util_JsonAddInt(&writer, "cycles", cycles);
+    }
+    if ((util_JsonEnd(&writer, &len) != LE_OK) || (len > DHUBIO_MAX_STRING_VALUE_LEN))
+    {
+        LE_ERROR("JSON value too big for Data Hub (%zu characters).", len);
+    }
+    else
+    {
+        LE_DEBUG("'%s'", value);
+        dhubIO_PushJson(RES_PATH_VALUE, DHUBIO_NOW, value);
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Push the samples collected in the batch to the Data Hub in one value, and empty the batch.
+ */
+//--------------------------------------------------------------------------------------------------
+void core_FlushBatch
+(
+    void
+)
+{
+    static char value[UTIL_BATCH_JSON_BUFFER_SIZE];
+
+    if (Batch.count == 0)
+    {
+        return;
+    }
+
+    size_t len;
+    if (   (util_RenderBatch(&Batch, value, sizeof(value), &len) != LE_OK)
+        || (len > DHUBIO_MAX_STRING_VALUE_LEN)  )
+    {
+        LE_ERROR("Batch too big for Data Hub (%zu characters).", len);
+    }
+    else
+    {
+        dhubIO_PushJson(RES_PATH_BATCH, DHUBIO_NOW, value);
+    }
+
+    util_ClearBatch(&Batch);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Add the values of a sample to the batch if batching is on, and push the batch once it is full
+ * or its oldest sample has waited long enough.
+ */
+//--------------------------------------------------------------------------------------------------
+void core_AddToBatch
+(
+    const core_Values_t *valuesPtr
+)
+{
+    if (Settings.batchSize == 0)
+    {
+        return;
+    }
+
+    size_t count = util_AddBatchSample(&Batch,
+                                       valuesPtr->percent,
+                                       valuesPtr->charge,
+                                       valuesPtr->current,
+                                       valuesPtr->voltage,
+                                       valuesPtr->temp);
+
+    if ((count >= Settings.batchSize) || (util_GetBatchAge(&Batch) >= Settings.batchMaxAge))
+    {
+        core_FlushBatch();
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Create the resources of the pushes and of their settings.  Called once the backend is selected.
+ */
+//--------------------------------------------------------------------------------------------------
+void core_InitPush
+(
+    void
+)
+{
+    // Change-suppression deadbands for pushes of the sensor data.
+    static const struct
+    {
+        const char *path;
+        const char *units;
+        double *deadbandPtr;
+    }
+    deadbands[] =
+    {
+        { RES_PATH_PERCENT_DEADBAND, "%",    &Settings.percentDeadband },
+        { RES_PATH_VOLTAGE_DEADBAND, "V",    &Settings.voltageDeadband },
+        { RES_PATH_TEMP_DEADBAND,    "degC", &Settings.tempDeadband },
+        { RES_PATH_CURRENT_DEADBAND, "mA",   &Settings.currentDeadband },
+    };
+    for (int i = 0; i < NUM_ARRAY_MEMBERS(deadbands); i++)
+    {
+        LE_ASSERT(LE_OK == dhubIO_CreateOutput(deadbands[i].path,
+                                               DHUBIO_DATA_TYPE_NUMERIC,
+                                               deadbands[i].units));
+        dhubIO_AddNumericPushHandler(deadbands[i].path, SetDeadband, deadbands[i].deadbandPtr);
+        dhubIO_SetNumericDefault(deadbands[i].path, *deadbands[i].deadbandPtr);
+        dhubIO_MarkOptional(deadbands[i].path);
+    }
+
+    LE_ASSERT(LE_OK == dhubIO_CreateOutput(RES_PATH_HEARTBEAT, DHUBIO_DATA_TYPE_NUMERIC, "s"));
+    dhubIO_AddNumericPushHandler(RES_PATH_HEARTBEAT, SetHeartbeat, NULL);
+    dhubIO_SetNumericDefault(RES_PATH_HEARTBEAT, ((double)DEFAULT_PUSH_HEARTBEAT_MS) / 1000);
+    dhubIO_MarkOptional(RES_PATH_HEARTBEAT);
+
+    LE_ASSERT(LE_OK == dhubIO_CreateOutput(RES_PATH_BATCH_SIZE, DHUBIO_DATA_TYPE_NUMERIC, ""));
+    dhubIO_AddNumericPushHandler(RES_PATH_BATCH_SIZE, SetBatchSize, NULL);
+    dhubIO_SetNumericDefault(RES_PATH_BATCH_SIZE, 0);
+    dhubIO_MarkOptional(RES_PATH_BATCH_SIZE);
+
+    LE_ASSERT(LE_OK == dhubIO_CreateOutput(RES_PATH_BATCH_MAX_AGE, DHUBIO_DATA_TYPE_NUMERIC, "s"));
+    dhubIO_AddNumericPushHandler(RES_PATH_BATCH_MAX_AGE, SetBatchMaxAge, NULL);
+    dhubIO_SetNumericDefault(RES_PATH_BATCH_MAX_AGE, ((double)DEFAULT_BATCH_MAX_AGE_MS) / 1000);
+    dhubIO_MarkOptional(RES_PATH_BATCH_MAX_AGE);
+
+    // Sensor data flowing into the Data Hub as a JSON structure.
+    LE_ASSERT(LE_OK == dhubIO_CreateInput(RES_PATH_VALUE, DHUBIO_DATA_TYPE_JSON, ""));
+    dhubIO_SetJsonExample(RES_PATH_VALUE, JSON_EXAMPLE);
+
+    // The same values, one resource per field.
+    static const struct
+    {
+        const char *path;
+        dhubIO_DataType_t type;
+        const char *units;
+    }
+    fields[] =
+    {
+        { RES_PATH_PERCENT,  DHUBIO_DATA_TYPE_NUMERIC, "%" },
+        { RES_PATH_CHARGE,   DHUBIO_DATA_TYPE_NUMERIC, "mAh" },
+        { RES_PATH_CURRENT,  DHUBIO_DATA_TYPE_NUMERIC, "mA" },
+        { RES_PATH_VOLTAGE,  DHUBIO_DATA_TYPE_NUMERIC, "V" },
+        { RES_PATH_TEMP,     DHUBIO_DATA_TYPE_NUMERIC, "degC" },
+        { RES_PATH_CHARGING, DHUBIO_DATA_TYPE_BOOLEAN, "" },
+        { RES_PATH_HEALTH,   DHUBIO_DATA_TYPE_STRING,  "" },
+    };
+    for (int i = 0; i < NUM_ARRAY_MEMBERS(fields); i++)
+    {
+        LE_ASSERT(LE_OK == dhubIO_CreateInput(fields[i].path, fields[i].type, fields[i].units));
+    }
+
+    // Batches of samples, pushed as a single value each.
+    LE_ASSERT(LE_OK == dhubIO_CreateInput(RES_PATH_BATCH, DHUBIO_DATA_TYPE_JSON, ""));
+    dhubIO_SetJsonExample(RES_PATH_BATCH, BATCH_JSON_EXAMPLE);
+    util_ClearBatch(&Batch);
+}
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the settings of the pushes to the Data Hub.
+ *
+ * @return Pointer to the settings, which stay valid and are updated in place when a config
+ *         resource is set.
+ */
+//--------------------------------------------------------------------------------------------------
+const core_PushSettings_t *core_GetPushSettings
+(
+    void
+)
+{
+    return &Settings;
+}
@@ -0,0 +1,37 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file push.h
+ *
+ * Pushes of the battery values to the Data Hub, and their settings.  Only used inside batteryCore.
+ *
+ * The settings are served as Data Hub config resources of the Battery Service app, the same for
+ * every backend.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#ifndef PUSH_H
+#define PUSH_H
+
+#include "legato.h"
+#include "batteryCore.h"
+
+/// Settings of the pushes to the Data Hub.
+typedef struct
+{
+    double percentDeadband;     ///< Change in % that forces a push.
+    double voltageDeadband;     ///< Change in V that forces a push.
+    double tempDeadband;        ///< Change in degrees C that forces a push.
+    double currentDeadband;     ///< Change in mA that forces a push.
+    uint32_t heartbeat;         ///< Longest time between pushes (ms).
+    uint32_t batchSize;         ///< Samples per batch push (0 = no batches).
+    uint32_t batchMaxAge;       ///< Longest time a sample waits in a batch (ms).
+}
+core_PushSettings_t;
+
+void core_InitPush(void);
+const core_PushSettings_t *core_GetPushSettings(void);
+void core_PushValues(const core_Values_t *valuesPtr);
+void core_AddToBatch(const core_Values_t *valuesPtr);
+void core_FlushBatch(void);
+
+#endif // PUSH_H
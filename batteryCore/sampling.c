@@ -0,0 +1,522 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file sampling.c
+ *
+ * Sampling of the backend's battery (see sampling.h).
+ *
+ * The sampler thread calls the backend's readSample() function, reads the other power supplies in
+ * the same sweep, and publishes the sample under a sequence lock, so the main thread can copy the
+ * latest one without waiting for the driver files to be read.  A sample taken to push or report is
+ * then processed in the main thread, in this order:
+ *
+ *  -# the backend's processSample() updates the backend's state;
+ *  -# the backend's getValues() maps the sample to the battery values;
+ *  -# the current is added to the run time prediction;
+ *  -# the values are reported to the API clients (see core_Report());
+ *  -# the values are added to the history and the batch (see push.h);
+ *  -# if the sample was taken for a push, the values are pushed to the Data Hub;
+ *  -# the state of health counters are saved if they are due (see persist.h).
+ *
+ * When the process is stopped, the state not saved yet is written to the Config Tree and the
+ * batch is pushed.
+ *
+ * <hr>
+ *
+ * Copyright (C) Sierra Wireless Inc.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#include "legato.h"
+#include "interfaces.h"
+#include "batteryCore.h"
+#include "batteryUtils.h"
+#include "runTime.h"
+#include "seqLock.h"
+#include "sampler.h"
+#include "sampling.h"
+#include "supplies.h"
+#include "push.h"
+#include "persist.h"
+
+/// Maximum age of a sample that an API getter will use without requesting a new sample.
+#define SAMPLE_MAX_AGE_MS 1000
+
+/// Sample request flag of the samples taken only to refresh the published sample.
+#define SAMPLE_FOR_REFRESH 0x4
+
+/// Time constant of the average current used to predict the time to empty or full.
+#define RUN_TIME_CONSTANT_MS 300000
+
+/// Shortest time between saves of the state of health counters to the Config Tree.
+#define SOH_SAVE_INTERVAL_MS 3600000
+
+/// A sample of the backend's hardware, as published by the sampler thread.
+typedef struct
+{
+    uint32_t count;                 ///< Number of samples taken before this one.
+    uint32_t reasons;               ///< Sample request flags it was taken for (0 for a refresh).
+    le_clk_Time_t time;             ///< When the sample was taken (monotonic clock).
+    uint64_t captureTime;           ///< When the sample was taken (ms since the Epoch).
+    union
+    {
+        uint8_t bytes[CORE_MAX_SAMPLE_SIZE];
+        double alignDouble;
+        uint64_t alignInt;
+        void *alignPtr;
+    }
+    data;                           ///< The backend's sample.
+}
+Sample_t;
+
+/// The backend, or NULL until core_InitSampling() is called.
+static const core_Backend_t *BackendPtr = NULL;
+
+/// Number of bytes of Sample_t used with the backend's sample size.
+static size_t SampleSize;
+
+/// The most recent sample, published by the sampler thread.  Only access it through SampleLock.
+static Sample_t PublishedSample;
+static util_SeqLock_t SampleLock = UTIL_SEQ_LOCK_INIT;
+
+/// Number of samples taken so far.  Only used by the thread that takes the samples.
+static uint32_t SampleCount = 0;
+
+/// Copy of the published sample, made by the main thread for the API getters.
+static Sample_t LastSample;
+
+/// The count of the last sample processed, valid if IsAnyProcessed.
+static uint32_t ProcessedCount;
+static bool IsAnyProcessed = false;
+
+/// The sampler thread, which reads and writes the driver files.
+static util_SamplerRef_t Sampler = NULL;
+
+/// The main thread, which serves the API and processes the samples.
+static le_thread_Ref_t MainThread;
+
+/// Average of the battery current, for predicting the time to empty or full.
+static util_RunTime_t RunTime;
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Take a new sample, and publish it.  Runs in the sampler thread (or in core_StartSampling(),
+ * before the sampler thread is started).
+ */
+//--------------------------------------------------------------------------------------------------
+static void TakeSample
+(
+    uint32_t reasons    ///< Sample request flags.
+)
+{
+    Sample_t sample;
+
+    BackendPtr->readSample(sample.data.bytes);
+
+    // Time-stamp the sample when the reads are done, so that the interval between two samples
+    // doesn't depend on how long the reads took.
+    sample.time = util_GetRelativeTime();
+    sample.captureTime = util_GetEpochMs();
+    sample.count = SampleCount++;
+    sample.reasons = reasons;
+
+    util_SeqLockWrite(&SampleLock, &PublishedSample, &sample, SampleSize);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Copy the latest published sample.
+ */
+//--------------------------------------------------------------------------------------------------
+static void ReadPublishedSample
+(
+    Sample_t *samplePtr
+)
+{
+    util_SeqLockRead(&SampleLock, samplePtr, &PublishedSample, SampleSize);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * If the charge level is not known, because the battery is disconnected or its health can't be
+ * read, then the charge levels are meaningless and are zeroed.
+ */
+//--------------------------------------------------------------------------------------------------
+static void DropUnknownCharge
+(
+    core_Values_t *valuesPtr
+)
+{
+    if (   (valuesPtr->health == MA_BATTERY_DISCONNECTED)
+        || (valuesPtr->health == MA_BATTERY_HEALTH_ERROR)
+        || (valuesPtr->health == MA_BATTERY_HEALTH_UNKNOWN)  )
+    {
+        valuesPtr->validFields &= ~(MA_BATTERY_FIELD_CHARGE | MA_BATTERY_FIELD_PERCENT);
+    }
+    if (!(valuesPtr->validFields & MA_BATTERY_FIELD_CHARGE))
+    {
+        valuesPtr->charge = 0;
+    }
+    if (!(valuesPtr->validFields & MA_BATTERY_FIELD_PERCENT))
+    {
+        valuesPtr->percent = 0;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Called in the main thread when the sampler thread has published a new sample.
+ */
+//--------------------------------------------------------------------------------------------------
+static void SampleReady
+(
+    void *param1Ptr,    ///< Reasons the sample was taken (sample request flags).
+    void *param2Ptr     ///< unused
+)
+{
+    uint32_t reasons = (uint32_t)(uintptr_t)param1Ptr;
+
+    Sample_t sample;
+    ReadPublishedSample(&sample);
+
+    // Another sample may have been published since this one was queued.  The latest one serves
+    // the requests of both, and is only processed once.
+    if (IsAnyProcessed && (sample.count == ProcessedCount))
+    {
+        return;
+    }
+    reasons = (reasons | sample.reasons) & (CORE_SAMPLE_FOR_PUSH | CORE_SAMPLE_FOR_REPORT);
+
+    // A sample taken only to refresh the API values isn't added to the history, the batch or the
+    // estimators.  Those are fed at the pace set by the backend's requests.
+    if (reasons == 0)
+    {
+        return;
+    }
+    ProcessedCount = sample.count;
+    IsAnyProcessed = true;
+
+    if (   (BackendPtr->processSample != NULL)
+        && !BackendPtr->processSample(sample.data.bytes, sample.time, reasons)  )
+    {
+        return;
+    }
+
+    core_Values_t values;
+    BackendPtr->getValues(sample.data.bytes, &values);
+
+    if (values.validFields & MA_BATTERY_FIELD_CURRENT)
+    {
+        util_AddRunTimeSample(&RunTime, values.current);
+    }
+    else
+    {
+        util_ResetRunTime(&RunTime);
+    }
+
+    core_Report(values.health,
+                values.chargingStatus,
+                (values.validFields & MA_BATTERY_FIELD_PERCENT) ? values.percent : -1);
+
+    DropUnknownCharge(&values);
+
+    core_AddHistorySample(sample.captureTime,
+                          values.health,
+                          values.chargingStatus,
+                          values.percent,
+                          values.charge,
+                          values.current,
+                          values.voltage,
+                          values.temp);
+    core_AddToBatch(&values);
+
+    if (reasons & CORE_SAMPLE_FOR_PUSH)
+    {
+        core_PushValues(&values);
+    }
+
+    core_SaveStateOfHealth(SOH_SAVE_INTERVAL_MS);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Take a sample in the sampler thread, and pass it on to the main thread.  The other power
+ * supplies are read in the same sweep.
+ */
+//--------------------------------------------------------------------------------------------------
+static void Sample
+(
+    uint32_t reasons,   ///< Sample request flags.
+    void *contextPtr    ///< unused
+)
+{
+    TakeSample(reasons);
+    core_SampleSupplies();
+
+    if (reasons & (CORE_SAMPLE_FOR_PUSH | CORE_SAMPLE_FOR_REPORT))
+    {
+        le_event_QueueFunctionToThread(MainThread, SampleReady, (void *)(uintptr_t)reasons, NULL);
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Read the hardware again.  Runs in the sampler thread, called by util_CallInSampler() for an API
+ * caller that can't use the latest sample.  The other power supplies are read in the same sweep,
+ * as for any other sample.
+ */
+//--------------------------------------------------------------------------------------------------
+static void ReadSampleNow
+(
+    void *param1Ptr,    ///< unused
+    void *param2Ptr     ///< unused
+)
+{
+    TakeSample(0);
+    core_SampleSupplies();
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Write any state not saved yet to the Config Tree and the Data Hub and exit, when the process is
+ * being stopped.
+ */
+//--------------------------------------------------------------------------------------------------
+static void SigTermHandler
+(
+    int sigNum
+)
+{
+    core_FlushPercentage();
+    core_SaveStateOfHealth(0);
+    core_FlushBatch();
+
+    exit(EXIT_SUCCESS);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Read the hardware again, and wait until the new sample is published.
+ */
+//--------------------------------------------------------------------------------------------------
+void core_Refresh
+(
+    void
+)
+{
+    if (Sampler != NULL)
+    {
+        util_CallInSampler(Sampler, ReadSampleNow, NULL, NULL);
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the values of the latest sample, without waiting for the hardware to be read.  If the sample
+ * is older than SAMPLE_MAX_AGE_MS, a new sample is requested for subsequent calls.
+ */
+//--------------------------------------------------------------------------------------------------
+void core_GetLatestValues
+(
+    core_Values_t *valuesPtr    ///< [out]
+)
+{
+    ReadPublishedSample(&LastSample);
+
+    if ((Sampler != NULL) && (util_MsSince(LastSample.time) > SAMPLE_MAX_AGE_MS))
+    {
+        util_RequestSample(Sampler, SAMPLE_FOR_REFRESH);
+    }
+
+    BackendPtr->getValues(LastSample.data.bytes, valuesPtr);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the values for ma_battery_GetSnapshot(), mapped from the latest sample, after reading the
+ * hardware again if that sample is older than maxAge.  Every value, and the time stamp, come from
+ * that one sample, so the values are consistent even if the sampler publishes another meanwhile.
+ */
+//--------------------------------------------------------------------------------------------------
+void core_GetSnapshotValues
+(
+    uint32_t maxAge,            ///< Maximum age of the values (ms).
+    uint64_t *timestampPtr,     ///< [out] When the values were read (ms since the Epoch).
+    core_Values_t *valuesPtr    ///< [out]
+)
+{
+    ReadPublishedSample(&LastSample);
+    if (util_MsSince(LastSample.time) > maxAge)
+    {
+        core_Refresh();
+        ReadPublishedSample(&LastSample);
+    }
+
+    BackendPtr->getValues(LastSample.data.bytes, valuesPtr);
+    *timestampPtr = LastSample.captureTime;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Predict the time until the battery is empty, at the average current of the processed samples.
+ *
+ * @return
+ *      - LE_OK
+ *      - LE_NOT_FOUND if the charge or current is unknown, or the battery is not discharging.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t core_GetTimeToEmpty
+(
+    const core_Values_t *valuesPtr,
+    uint32_t *secondsPtr        ///< [out]
+)
+{
+    if (   !(valuesPtr->validFields & MA_BATTERY_FIELD_CHARGE)
+        || !(valuesPtr->validFields & MA_BATTERY_FIELD_CURRENT)  )
+    {
+        return LE_NOT_FOUND;
+    }
+
+    return util_GetTimeToEmpty(&RunTime, valuesPtr->charge, secondsPtr);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Predict the time until the battery is full, at the average current of the processed samples.
+ *
+ * @return
+ *      - LE_OK
+ *      - LE_NOT_FOUND if the charge, full charge or current is unknown, or the battery is not
+ *        charging.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t core_GetTimeToFull
+(
+    const core_Values_t *valuesPtr,
+    uint32_t *secondsPtr        ///< [out]
+)
+{
+    if (   !(valuesPtr->validFields & MA_BATTERY_FIELD_CHARGE)
+        || !(valuesPtr->validFields & MA_BATTERY_FIELD_CURRENT)
+        || (valuesPtr->fullCharge == 0)  )
+    {
+        return LE_NOT_FOUND;
+    }
+
+    return util_GetTimeToFull(&RunTime,
+                              valuesPtr->charge,
+                              valuesPtr->fullCharge,
+                              secondsPtr);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Request a sample of the battery.  The sample is taken by the sampler thread and then processed
+ * in the main thread.  Requests made while one is pending are served by the same sample.
+ */
+//--------------------------------------------------------------------------------------------------
+void core_RequestSample
+(
+    uint32_t reasons    ///< CORE_SAMPLE_FOR_PUSH and/or CORE_SAMPLE_FOR_REPORT.
+)
+{
+    LE_ASSERT(Sampler != NULL);
+
+    util_RequestSample(Sampler, reasons);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get a copy of the latest sample, e.g., for the backend to take its baselines at start-up.
+ *
+ * @return When the sample was taken (monotonic clock).
+ */
+//--------------------------------------------------------------------------------------------------
+le_clk_Time_t core_GetLatestSample
+(
+    void *samplePtr     ///< [out] Buffer of the backend's sample size.
+)
+{
+    ReadPublishedSample(&LastSample);
+    memcpy(samplePtr, LastSample.data.bytes, BackendPtr->sampleSize);
+
+    return LastSample.time;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Queue a function to the sampler thread, behind any sample it is taking, e.g., for the backend
+ * to write to its hardware.
+ */
+//--------------------------------------------------------------------------------------------------
+void core_QueueToSampler
+(
+    le_event_DeferredFunc_t func,
+    void *param1Ptr,
+    void *param2Ptr
+)
+{
+    LE_ASSERT(Sampler != NULL);
+
+    util_QueueToSampler(Sampler, func, param1Ptr, param2Ptr);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Start sampling the battery.  Called by the backend, in the main thread, once it can read its
+ * hardware.  The first sample is taken right away, so the API never sees an empty one, and from
+ * then on the hardware is only accessed by the sampler thread.
+ */
+//--------------------------------------------------------------------------------------------------
+void core_StartSampling
+(
+    void
+)
+{
+    LE_ASSERT(BackendPtr != NULL);
+    LE_ASSERT(Sampler == NULL);
+
+    // Save the state held in RAM when the process is stopped.  SIGTERM must be blocked before the
+    // sampler thread is created, so that the thread inherits the mask and the signal can only be
+    // received by the handler in the main thread.
+    le_sig_Block(SIGTERM);
+    le_sig_SetEventHandler(SIGTERM, SigTermHandler);
+
+    TakeSample(0);
+    MainThread = le_thread_GetCurrent();
+    Sampler = util_CreateSampler("BatterySampler", Sample, NULL);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Set up the sampling of the backend's battery.  Called once the backend is selected.
+ */
+//--------------------------------------------------------------------------------------------------
+void core_InitSampling
+(
+    const core_Backend_t *backendPtr
+)
+{
+    LE_ASSERT(backendPtr->sampleSize <= CORE_MAX_SAMPLE_SIZE);
+
+    BackendPtr = backendPtr;
+    SampleSize = offsetof(Sample_t, data) + backendPtr->sampleSize;
+
+    util_InitRunTime(&RunTime, RUN_TIME_CONSTANT_MS);
+}
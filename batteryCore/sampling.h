@@ -0,0 +1,37 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file sampling.h
+ *
+ * Sampling of the backend's battery.  Only used inside batteryCore.
+ *
+ * The sampler thread reads the backend's hardware, and the other power supplies in the same
+ * sweep, and publishes the sample.  The samples taken to report or push are then processed in the
+ * main thread: the backend updates its state from them, and their values are reported to API
+ * clients, added to the history and the run time prediction, and pushed to the Data Hub.  The API
+ * getters map the latest published sample.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include "batteryCore.h"
+
+void core_InitSampling(const core_Backend_t *backendPtr);
+void core_GetLatestValues(core_Values_t *valuesPtr);
+void core_GetSnapshotValues(uint32_t maxAge, uint64_t *timestampPtr, core_Values_t *valuesPtr);
+void core_Refresh(void);
+le_result_t core_GetTimeToEmpty(const core_Values_t *valuesPtr, uint32_t *secondsPtr);
+le_result_t core_GetTimeToFull(const core_Values_t *valuesPtr, uint32_t *secondsPtr);
+
+// Implemented in batteryCore.c.
+void core_Report(ma_battery_HealthStatus_t health, ma_battery_ChargingStatus_t chargingStatus,
+                 int percentage);
+void core_AddHistorySample(uint64_t timestamp, ma_battery_HealthStatus_t health,
+                           ma_battery_ChargingStatus_t chargingStatus, unsigned int percentage,
+                           unsigned int charge, double current, double voltage,
+                           double temperature);
+
+#endif // SAMPLING_H
@@ -0,0 +1,414 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file supplies.c
+ *
+ * Power supplies that the Battery Service reports on besides the battery of the backend.
+ *
+ * Each supply only gets handles for the attributes its driver provides.  A sweep reads every
+ * supply in the sampler thread (see sampling.c) and publishes all of the values at once through a
+ * sequence lock.  The main thread then compares them with the values it last reported, and
+ * reports the supplies whose status changed.
+ *
+ * <hr>
+ *
+ * Copyright (C) Sierra Wireless Inc.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#include "legato.h"
+#include "interfaces.h"
+#include "supplies.h"
+#include "batteryCore.h"
+#include "seqLock.h"
+#include <sys/stat.h>
+
+/// Attributes of a power supply.  Not every driver provides all of them.
+typedef enum
+{
+    ATTR_ONLINE,        ///< "online" (1 if the supply is connected)
+    ATTR_PRESENT,       ///< "present" (1 if the battery is inserted)
+    ATTR_STATUS,        ///< "status" string
+    ATTR_HEALTH,        ///< "health" string
+    ATTR_VOLTAGE,       ///< "voltage_now" in uV
+    ATTR_CURRENT,       ///< "current_now" in uA
+    ATTR_TEMP,          ///< "temp" in tenths of degrees C
+    ATTR_CAPACITY,      ///< "capacity" in %
+    ATTR_CHARGE_NOW,    ///< "charge_now" in uAh
+    ATTR_CHARGE_FULL,   ///< "charge_full" in uAh
+    NUM_ATTRS
+}
+Attr_t;
+
+/// Names of the attribute files, by Attr_t.
+static const char *const AttrNames[NUM_ATTRS] =
+{
+    [ATTR_ONLINE]       = "online",
+    [ATTR_PRESENT]      = "present",
+    [ATTR_STATUS]       = "status",
+    [ATTR_HEALTH]       = "health",
+    [ATTR_VOLTAGE]      = "voltage_now",
+    [ATTR_CURRENT]      = "current_now",
+    [ATTR_TEMP]         = "temp",
+    [ATTR_CAPACITY]     = "capacity",
+    [ATTR_CHARGE_NOW]   = "charge_now",
+    [ATTR_CHARGE_FULL]  = "charge_full",
+};
+
+/// A power supply.
+typedef struct
+{
+    util_PowerSupplyInfo_t info;
+    util_FileRef_t files[NUM_ATTRS];    ///< By Attr_t.  NULL if the driver has no such attribute.
+}
+Supply_t;
+
+/// The supplies, in name order.  Only changed by core_InitSupplies().
+static Supply_t Supplies[CORE_MAX_SUPPLIES];
+static size_t NumSupplies = 0;
+
+/// Latest values of each supply, written by the sampler thread under SampleLock.
+static core_SupplySample_t PublishedSamples[CORE_MAX_SUPPLIES];
+static util_SeqLock_t SampleLock = UTIL_SEQ_LOCK_INIT;
+
+/// Values of each supply last passed to ChangeFunc.  Only used in the main thread.
+static core_SupplySample_t ReportedSamples[CORE_MAX_SUPPLIES];
+
+static core_SupplyChangeFunc_t ChangeFunc;
+static core_SupplyLevelFunc_t LevelFunc;
+static le_thread_Ref_t MainThread;
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Open a handle for an attribute of a power supply.
+ *
+ * @return The handle, or NULL if the supply doesn't have the attribute.
+ */
+//--------------------------------------------------------------------------------------------------
+static util_FileRef_t OpenAttr
+(
+    const char *supplyName,
+    const char *attrName
+)
+{
+    char relativePath[PATH_MAX];
+    int pathLen = snprintf(relativePath, sizeof(relativePath), "class/power_supply/%s/%s",
+                           supplyName, attrName);
+    LE_ASSERT(pathLen < sizeof(relativePath));
+
+    char path[PATH_MAX];
+    pathLen = snprintf(path, sizeof(path), "%s/%s", util_GetSysfsRoot(), relativePath);
+
+    struct stat st;
+    if ((pathLen >= sizeof(path)) || (stat(path, &st) != 0))
+    {
+        return NULL;
+    }
+
+    return util_OpenSysfsFile(relativePath, O_RDONLY);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Read an integer attribute of a power supply.
+ *
+ * @return
+ *      - LE_OK on success.
+ *      - LE_NOT_FOUND if the supply doesn't have the attribute.
+ *      - LE_IO_ERROR if the read failed.
+ */
+//--------------------------------------------------------------------------------------------------
+static le_result_t ReadIntAttr
+(
+    const Supply_t *supplyPtr,
+    Attr_t attr,
+    int *valuePtr
+)
+{
+    if (supplyPtr->files[attr] == NULL)
+    {
+        return LE_NOT_FOUND;
+    }
+
+    return util_ReadIntFromHandle(supplyPtr->files[attr], valuePtr);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Read all of the attributes of a power supply.  Runs in the sampler thread.
+ */
+//--------------------------------------------------------------------------------------------------
+static void ReadSupply
+(
+    const Supply_t *supplyPtr,
+    core_SupplySample_t *samplePtr  ///< [OUT]
+)
+{
+    memset(samplePtr, 0, sizeof(*samplePtr));
+    samplePtr->timestamp = util_GetEpochMs();
+    samplePtr->chargingStatus = MA_BATTERY_CHARGING_UNKNOWN;
+    samplePtr->health = MA_BATTERY_HEALTH_UNKNOWN;
+
+    int value;
+
+    if (ReadIntAttr(supplyPtr, ATTR_ONLINE, &value) == LE_OK)
+    {
+        samplePtr->isOnline = (value != 0);
+    }
+    else if (ReadIntAttr(supplyPtr, ATTR_PRESENT, &value) == LE_OK)
+    {
+        samplePtr->isOnline = (value != 0);
+    }
+    else
+    {
+        samplePtr->isOnline = (   (supplyPtr->files[ATTR_ONLINE] == NULL)
+                               && (supplyPtr->files[ATTR_PRESENT] == NULL)  );
+    }
+
+    util_PowerSupplyStatus_t status;
+    if (   (supplyPtr->files[ATTR_STATUS] != NULL)
+        && (util_ReadPowerSupplyStatus(supplyPtr->files[ATTR_STATUS], &status) == LE_OK)  )
+    {
+        samplePtr->chargingStatus = core_GetChargingStatusCode(status);
+        samplePtr->validFields |= MA_BATTERY_FIELD_CHARGING_STATUS;
+    }
+
+    util_PowerSupplyHealth_t health;
+    if (   (supplyPtr->files[ATTR_HEALTH] != NULL)
+        && (util_ReadPowerSupplyHealth(supplyPtr->files[ATTR_HEALTH], &health) == LE_OK)  )
+    {
+        samplePtr->health = core_GetHealthStatusCode(health);
+        samplePtr->validFields |= MA_BATTERY_FIELD_HEALTH;
+    }
+
+    if (ReadIntAttr(supplyPtr, ATTR_VOLTAGE, &value) == LE_OK)
+    {
+        samplePtr->voltage = value / 1000000.0;
+        samplePtr->validFields |= MA_BATTERY_FIELD_VOLTAGE;
+    }
+
+    if (ReadIntAttr(supplyPtr, ATTR_CURRENT, &value) == LE_OK)
+    {
+        samplePtr->current = value / 1000.0;
+        samplePtr->validFields |= MA_BATTERY_FIELD_CURRENT;
+    }
+
+    if (ReadIntAttr(supplyPtr, ATTR_TEMP, &value) == LE_OK)
+    {
+        samplePtr->temp = value / 10.0;
+        samplePtr->validFields |= MA_BATTERY_FIELD_TEMP;
+    }
+
+    if ((ReadIntAttr(supplyPtr, ATTR_CHARGE_FULL, &value) == LE_OK) && (value > 0))
+    {
+        samplePtr->fullCharge = (uint16_t)(value / 1000);
+    }
+
+    if ((ReadIntAttr(supplyPtr, ATTR_CHARGE_NOW, &value) == LE_OK) && (value >= 0))
+    {
+        samplePtr->charge = (uint16_t)(value / 1000);
+        samplePtr->validFields |= MA_BATTERY_FIELD_CHARGE;
+    }
+
+    if (ReadIntAttr(supplyPtr, ATTR_CAPACITY, &value) == LE_OK)
+    {
+        samplePtr->percent = (uint16_t)((value < 0) ? 0 : value);
+        samplePtr->validFields |= MA_BATTERY_FIELD_PERCENT;
+    }
+    else if ((samplePtr->validFields & MA_BATTERY_FIELD_CHARGE) && (samplePtr->fullCharge > 0))
+    {
+        samplePtr->percent = core_ComputePercentage(samplePtr->charge, samplePtr->fullCharge);
+        samplePtr->validFields |= MA_BATTERY_FIELD_PERCENT;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Report the supplies whose status changed in the last sweep, and the levels of the supplies.
+ * Runs in the main thread.
+ */
+//--------------------------------------------------------------------------------------------------
+static void SweepDone
+(
+    void *param1Ptr,    ///< unused
+    void *param2Ptr     ///< unused
+)
+{
+    core_SupplySample_t samples[CORE_MAX_SUPPLIES];
+    util_SeqLockRead(&SampleLock, samples, PublishedSamples, sizeof(samples));
+
+    for (size_t i = 0; i < NumSupplies; i++)
+    {
+        core_SupplySample_t *reportedPtr = &ReportedSamples[i];
+
+        if (   (samples[i].isOnline != reportedPtr->isOnline)
+            || (samples[i].chargingStatus != reportedPtr->chargingStatus)
+            || (samples[i].health != reportedPtr->health)  )
+        {
+            *reportedPtr = samples[i];
+            ChangeFunc(i, &samples[i]);
+        }
+
+        if (samples[i].isOnline && (samples[i].validFields & MA_BATTERY_FIELD_PERCENT))
+        {
+            LevelFunc(i, (samples[i].percent > 100) ? 100 : (uint8_t)samples[i].percent);
+        }
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Read all of the power supplies in one sweep.  Called in the sampler thread each time it samples
+ * the backend's battery.
+ */
+//--------------------------------------------------------------------------------------------------
+void core_SampleSupplies
+(
+    void
+)
+{
+    if (NumSupplies == 0)
+    {
+        return;
+    }
+
+    core_SupplySample_t samples[CORE_MAX_SUPPLIES];
+    for (size_t i = 0; i < NumSupplies; i++)
+    {
+        ReadSupply(&Supplies[i], &samples[i]);
+    }
+
+    util_SeqLockWrite(&SampleLock, PublishedSamples, samples, sizeof(samples));
+
+    le_event_QueueFunctionToThread(MainThread, SweepDone, NULL, NULL);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Find the power supplies and open their attributes.  Must be called in the main thread, before
+ * the backend starts sampling.
+ */
+//--------------------------------------------------------------------------------------------------
+void core_InitSupplies
+(
+    const char *const *excludeNames,    ///< Supplies handled by the backend, terminated by NULL.
+    core_SupplyChangeFunc_t changeFunc, ///< Called when the status of a supply changes.
+    core_SupplyLevelFunc_t levelFunc    ///< Called with the level of each supply after a sweep.
+)
+{
+    MainThread = le_thread_GetCurrent();
+    ChangeFunc = changeFunc;
+    LevelFunc = levelFunc;
+
+    util_PowerSupplyInfo_t found[CORE_MAX_SUPPLIES];
+    size_t numFound = util_ListPowerSupplies(found, NUM_ARRAY_MEMBERS(found));
+
+    for (size_t i = 0; i < numFound; i++)
+    {
+        bool isExcluded = false;
+        for (const char *const *namePtr = excludeNames; *namePtr != NULL; namePtr++)
+        {
+            isExcluded = isExcluded || (strcmp(*namePtr, found[i].name) == 0);
+        }
+        if (isExcluded)
+        {
+            continue;
+        }
+
+        Supply_t *supplyPtr = &Supplies[NumSupplies];
+        supplyPtr->info = found[i];
+        for (int attr = 0; attr < NUM_ATTRS; attr++)
+        {
+            supplyPtr->files[attr] = OpenAttr(found[i].name, AttrNames[attr]);
+        }
+
+        ReportedSamples[NumSupplies].chargingStatus = MA_BATTERY_CHARGING_UNKNOWN;
+        ReportedSamples[NumSupplies].health = MA_BATTERY_HEALTH_UNKNOWN;
+        NumSupplies++;
+
+        LE_INFO("Also reporting on power supply '%s'.", found[i].name);
+    }
+
+    // Have values to return before the first sweep.
+    for (size_t i = 0; i < NumSupplies; i++)
+    {
+        ReadSupply(&Supplies[i], &PublishedSamples[i]);
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the number of power supplies found by core_InitSupplies().
+ *
+ * @return The number of supplies.
+ */
+//--------------------------------------------------------------------------------------------------
+size_t core_GetNumSupplies
+(
+    void
+)
+{
+    return NumSupplies;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the name of a power supply.
+ *
+ * @return Name of the supply's directory in /sys/class/power_supply.
+ */
+//--------------------------------------------------------------------------------------------------
+const char *core_GetSupplyName
+(
+    size_t index    ///< Less than core_GetNumSupplies().
+)
+{
+    LE_ASSERT(index < NumSupplies);
+
+    return Supplies[index].info.name;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the type of a power supply.
+ *
+ * @return The type.
+ */
+//--------------------------------------------------------------------------------------------------
+util_PowerSupplyType_t core_GetSupplyType
+(
+    size_t index    ///< Less than core_GetNumSupplies().
+)
+{
+    LE_ASSERT(index < NumSupplies);
+
+    return Supplies[index].info.type;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the values read from a power supply in the latest sweep.
+ */
+//--------------------------------------------------------------------------------------------------
+void core_GetSupplySample
+(
+    size_t index,                       ///< Less than core_GetNumSupplies().
+    core_SupplySample_t *samplePtr      ///< [OUT]
+)
+{
+    LE_ASSERT(index < NumSupplies);
+
+    util_SeqLockRead(&SampleLock,
+                     samplePtr,
+                     &PublishedSamples[index],
+                     sizeof(*samplePtr));
+}
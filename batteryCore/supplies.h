@@ -0,0 +1,55 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file supplies.h
+ *
+ * Power supplies that the Battery Service reports on besides the battery of the backend: a backup
+ * cell, an external USB-PD supply, the mains adapter, etc.  Only used inside batteryCore.
+ *
+ * The supplies are found by listing /sys/class/power_supply when the backend is selected, and
+ * read through their standard power_supply attributes.  They are all read in one sweep, which the
+ * sampler thread makes each time it samples the backend's battery (see sampling.h).
+ */
+//--------------------------------------------------------------------------------------------------
+
+#ifndef SUPPLIES_H
+#define SUPPLIES_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include "powerSupply.h"
+
+/// Largest number of power supplies tracked besides the backend's battery.
+#define CORE_MAX_SUPPLIES 8
+
+/// Values read from a power supply in one sweep.
+typedef struct
+{
+    uint64_t timestamp;         ///< When the values were read (ms since the Epoch).
+    ma_battery_SnapshotField_t validFields; ///< Which of the following values are valid.
+    bool isOnline;              ///< "online" (or "present" for a battery), true if neither exists.
+    ma_battery_ChargingStatus_t chargingStatus;
+    ma_battery_HealthStatus_t health;
+    double voltage;             ///< V
+    double current;             ///< mA
+    double temp;                ///< degrees C
+    uint16_t percent;
+    uint16_t charge;            ///< mAh
+    uint16_t fullCharge;        ///< mAh when full, or 0 if unknown.
+}
+core_SupplySample_t;
+
+/// Called in the main thread when the online, charging or health status of a supply changes.
+typedef void (*core_SupplyChangeFunc_t)(size_t index, const core_SupplySample_t *samplePtr);
+
+/// Called in the main thread after each sweep, for each online supply that reports its level.
+typedef void (*core_SupplyLevelFunc_t)(size_t index, uint8_t percentage);
+
+void core_InitSupplies(const char *const *excludeNames, core_SupplyChangeFunc_t changeFunc,
+                       core_SupplyLevelFunc_t levelFunc);
+size_t core_GetNumSupplies(void);
+const char *core_GetSupplyName(size_t index);
+util_PowerSupplyType_t core_GetSupplyType(size_t index);
+void core_GetSupplySample(size_t index, core_SupplySample_t *samplePtr);
+void core_SampleSupplies(void);
+
+#endif // SUPPLIES_H
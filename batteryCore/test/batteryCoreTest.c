@@ -0,0 +1,920 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file batteryCoreTest.c
+ *
+ * Unit tests of batteryCore, built on the host against the Legato shim (see CMakeLists.txt at the
+ * top of the tree).  The battery hardware is the fake backend in fakeBackend.c, which the core
+ * samples in its own sampler thread, and the other power supplies are stood in for by a temporary
+ * sysfs directory, which BATTERY_SYSFS_ROOT points at.
+ *
+ * The test calls the ma_battery API functions directly, so it also stands in for the messaging
+ * layer: it chooses the client session that each call is made from, and closes sessions.
+ *
+ * Exits with status 0 if all the tests pass.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#include "legato.h"
+#include "interfaces.h"
+#include "admin_interface.h"
+#include "batteryCore.h"
+#include "sampling.h"
+#include "push.h"
+#include "batch.h"
+#include "hostTest.h"
+#include "fakeBackend.h"
+
+/// Stand-ins for the ma_battery service and two client sessions.
+static int Service;
+static int SessionA;
+static int SessionB;
+#define SERVICE_REF ((le_msg_ServiceRef_t)&Service)
+#define SESSION_A ((le_msg_SessionRef_t)&SessionA)
+#define SESSION_B ((le_msg_SessionRef_t)&SessionB)
+
+/// Session that the API calls are made from.
+static le_msg_SessionRef_t CurrentSession = SESSION_A;
+
+/// Handler that the core added for the closing of client sessions.
+static le_msg_SessionEventHandler_t SessionClosedHandler = NULL;
+static void *SessionClosedContext = NULL;
+
+/// Notifications received by the handlers below.
+static struct
+{
+    int numHealth;
+    ma_battery_HealthStatus_t health;
+    int numChargingStatus;
+    ma_battery_ChargingStatus_t chargingStatus;
+    int numLevel;
+    uint8_t percentage;
+    uint8_t percentageTrigger;
+    bool isHighLevel;
+    int numSupply;
+    bool isSupplyOnline[4];     ///< By supply index.
+    int numSupplyLevel;
+    uint32_t supplyLevelIndex;
+    uint8_t supplyPercentage;
+    uint8_t supplyPercentageTrigger;
+    bool isSupplyHighLevel;
+}
+Notified;
+
+/// batteryCore's initialization function (see CMakeLists.txt).
+void _batteryCore_COMPONENT_INIT(void);
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the ma_battery service.
+ *
+ * @return The stand-in service.
+ */
+//--------------------------------------------------------------------------------------------------
+le_msg_ServiceRef_t ma_battery_GetServiceRef
+(
+    void
+)
+{
+    return SERVICE_REF;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the client session of the API call being made.
+ *
+ * @return The session chosen by the test.
+ */
+//--------------------------------------------------------------------------------------------------
+le_msg_SessionRef_t ma_battery_GetClientSessionRef
+(
+    void
+)
+{
+    return CurrentSession;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Record the core's handler for the closing of client sessions.
+ *
+ * @return A reference to the handler.
+ */
+//--------------------------------------------------------------------------------------------------
+le_msg_SessionEventHandlerRef_t le_msg_AddServiceCloseHandler
+(
+    le_msg_ServiceRef_t serviceRef,
+    le_msg_SessionEventHandler_t handlerFunc,
+    void *contextPtr
+)
+{
+    LE_ASSERT(serviceRef == SERVICE_REF);
+    LE_ASSERT(SessionClosedHandler == NULL);
+
+    SessionClosedHandler = handlerFunc;
+    SessionClosedContext = contextPtr;
+
+    return (le_msg_SessionEventHandlerRef_t)&SessionClosedHandler;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Notification handlers of the clients.  They record what they were called with in Notified.
+//--------------------------------------------------------------------------------------------------
+
+static void HealthHandler
+(
+    ma_battery_HealthStatus_t health,
+    void *contextPtr
+)
+{
+    Notified.numHealth++;
+    Notified.health = health;
+}
+
+
+static void ChargingStatusHandler
+(
+    ma_battery_ChargingStatus_t condition,
+    void *contextPtr
+)
+{
+    Notified.numChargingStatus++;
+    Notified.chargingStatus = condition;
+}
+
+
+static void LevelHandler
+(
+    uint8_t percentage,
+    uint8_t percentageTrigger,
+    bool isHighLevel,
+    void *contextPtr
+)
+{
+    Notified.numLevel++;
+    Notified.percentage = percentage;
+    Notified.percentageTrigger = percentageTrigger;
+    Notified.isHighLevel = isHighLevel;
+}
+
+
+static void SupplyStatusHandler
+(
+    uint32_t index,
+    bool isOnline,
+    ma_battery_ChargingStatus_t chargingStatus,
+    ma_battery_HealthStatus_t health,
+    void *contextPtr
+)
+{
+    LE_ASSERT(index < NUM_ARRAY_MEMBERS(Notified.isSupplyOnline));
+
+    Notified.numSupply++;
+    Notified.isSupplyOnline[index] = isOnline;
+}
+
+
+static void SupplyLevelHandler
+(
+    uint32_t index,
+    uint8_t percentage,
+    uint8_t percentageTrigger,
+    bool isHighLevel,
+    void *contextPtr
+)
+{
+    Notified.numSupplyLevel++;
+    Notified.supplyLevelIndex = index;
+    Notified.supplyPercentage = percentage;
+    Notified.supplyPercentageTrigger = percentageTrigger;
+    Notified.isSupplyHighLevel = isHighLevel;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Until a backend has found its hardware, the API reports that there is no battery.
+ */
+//--------------------------------------------------------------------------------------------------
+static void TestNoHardware
+(
+    void
+)
+{
+    CHECK_RESULT(fake_Select(), LE_NOT_FOUND);
+
+    double voltage;
+    uint16_t percent;
+    CHECK_RESULT(ma_battery_GetVoltage(&voltage), LE_NOT_FOUND);
+    CHECK_RESULT(ma_battery_GetPercentRemaining(&percent), LE_NOT_FOUND);
+    CHECK(ma_battery_GetHealthStatus() == MA_BATTERY_HEALTH_UNKNOWN);
+    CHECK(ma_battery_GetChargingStatus() == MA_BATTERY_CHARGING_UNKNOWN);
+    CHECK(ma_battery_GetSupplyCount() == 0);
+
+    char name[MA_BATTERY_MAX_SUPPLY_NAME_LEN + 1];
+    ma_battery_SupplyType_t type;
+    bool isOnline;
+    CHECK_RESULT(ma_battery_GetSupplyInfo(0, name, sizeof(name), &type, &isOnline),
+                 LE_OUT_OF_RANGE);
+
+    uint32_t numBatteries, charge, fullCharge;
+    bool isExternalPower;
+    CHECK_RESULT(ma_battery_GetAggregate(&numBatteries, &percent, &charge, &fullCharge,
+                                         &isExternalPower),
+                 LE_NOT_FOUND);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * The backend is selected once its hardware is present, and only one backend can be selected.
+ * The other power supplies are listed after the backend's battery, in name order.
+ */
+//--------------------------------------------------------------------------------------------------
+static void TestSelection
+(
+    void
+)
+{
+    test_WriteSysfsFile("class/power_supply/" FAKE_SUPPLY_NAME "/type", "Battery\n");
+
+    test_WriteSysfsFile("class/power_supply/usb/type", "USB\n");
+    test_WriteSysfsFile("class/power_supply/usb/online", "0\n");
+
+    test_WriteSysfsFile("class/power_supply/backup/type", "Battery\n");
+    test_WriteSysfsFile("class/power_supply/backup/present", "1\n");
+    test_WriteSysfsFile("class/power_supply/backup/status", "Discharging\n");
+    test_WriteSysfsFile("class/power_supply/backup/health", "Good\n");
+    test_WriteSysfsFile("class/power_supply/backup/voltage_now", "3000000\n");
+    test_WriteSysfsFile("class/power_supply/backup/charge_now", "50000\n");
+    test_WriteSysfsFile("class/power_supply/backup/charge_full", "100000\n");
+
+    // The state of health saved before a restart is loaded.
+    le_cfg_QuickSetInt("batteryInfo/soh/cycles", 12);
+
+    CHECK_RESULT(fake_Select(), LE_OK);
+    CHECK_RESULT(fake_Select(), LE_DUPLICATE);
+
+    CHECK(ma_battery_GetSupplyCount() == 3);
+
+    static const struct
+    {
+        const char *name;
+        ma_battery_SupplyType_t type;
+        bool isOnline;
+    }
+    expected[] =
+    {
+        { FAKE_BACKEND_NAME, MA_BATTERY_SUPPLY_BATTERY, true },
+        { "backup",          MA_BATTERY_SUPPLY_BATTERY, true },
+        { "usb",             MA_BATTERY_SUPPLY_USB,     false },
+    };
+    for (uint32_t i = 0; i < NUM_ARRAY_MEMBERS(expected); i++)
+    {
+        char name[MA_BATTERY_MAX_SUPPLY_NAME_LEN + 1] = "";
+        ma_battery_SupplyType_t type = MA_BATTERY_SUPPLY_OTHER;
+        bool isOnline = !expected[i].isOnline;
+        CHECK_RESULT(ma_battery_GetSupplyInfo(i, name, sizeof(name), &type, &isOnline), LE_OK);
+        CHECK(strcmp(name, expected[i].name) == 0);
+        CHECK(type == expected[i].type);
+        CHECK(isOnline == expected[i].isOnline);
+    }
+
+    char name[MA_BATTERY_MAX_SUPPLY_NAME_LEN + 1];
+    ma_battery_SupplyType_t type;
+    bool isOnline;
+    CHECK_RESULT(ma_battery_GetSupplyInfo(3, name, sizeof(name), &type, &isOnline),
+                 LE_OUT_OF_RANGE);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * The API functions return the values of the backend's latest sample for the battery, and the
+ * values read from sysfs for the other supplies.  The time to empty or full is predicted from the
+ * current of the processed samples.
+ */
+//--------------------------------------------------------------------------------------------------
+static void TestValues
+(
+    void
+)
+{
+    fake_Values_t values =
+    {
+        .health = MA_BATTERY_GOOD,
+        .chargingStatus = MA_BATTERY_DISCHARGING,
+        .voltage = 3.8,
+        .current = -250.0,
+        .temp = 24.5,
+        .percent = 50,
+        .confidence = 90,
+        .charge = 500,
+        .capacity = 1000,
+        .fullCapacity = 0,
+    };
+    fake_SetValues(&values);
+
+    double voltage, current, temp;
+    uint16_t percent, charge, fullCapacity;
+    uint8_t confidence, health;
+    uint32_t seconds, cycles;
+
+    CHECK(ma_battery_GetHealthStatus() == MA_BATTERY_GOOD);
+    CHECK(ma_battery_GetChargingStatus() == MA_BATTERY_DISCHARGING);
+    CHECK_RESULT(ma_battery_GetVoltage(&voltage), LE_OK);
+    CHECK(voltage == 3.8);
+    CHECK_RESULT(ma_battery_GetCurrent(&current), LE_OK);
+    CHECK(current == -250.0);
+    CHECK_RESULT(ma_battery_GetTemp(&temp), LE_OK);
+    CHECK(temp == 24.5);
+    CHECK_RESULT(ma_battery_GetPercentRemaining(&percent), LE_OK);
+    CHECK(percent == 50);
+    CHECK_RESULT(ma_battery_GetPercentConfidence(&confidence), LE_OK);
+    CHECK(confidence == 90);
+    CHECK_RESULT(ma_battery_GetChargeRemaining(&charge), LE_OK);
+    CHECK(charge == 500);
+    CHECK_RESULT(ma_battery_GetTimeToEmpty(&seconds), LE_OK);
+    CHECK(seconds == 7200);
+    CHECK_RESULT(ma_battery_GetTimeToFull(&seconds), LE_NOT_FOUND);
+    CHECK_RESULT(ma_battery_GetStateOfHealth(&health, &fullCapacity), LE_NOT_FOUND);
+    CHECK_RESULT(ma_battery_GetCycleCount(&cycles), LE_OK);
+    CHECK(cycles == 12);
+
+    // Supply 0 is the backend's battery.
+    uint64_t timestamp;
+    ma_battery_SnapshotField_t validFields;
+    ma_battery_ChargingStatus_t chargingStatus;
+    ma_battery_HealthStatus_t healthStatus;
+    CHECK_RESULT(ma_battery_GetSupplySnapshot(0, 1000, &timestamp, &validFields, &chargingStatus,
+                                              &healthStatus, &voltage, &current, &temp, &percent,
+                                              &charge),
+                 LE_OK);
+    CHECK(validFields & MA_BATTERY_FIELD_CHARGE);
+    CHECK(chargingStatus == MA_BATTERY_DISCHARGING);
+    CHECK(voltage == 3.8);
+    CHECK(charge == 500);
+
+    // The backup cell's percentage is computed from its charge.
+    CHECK_RESULT(ma_battery_GetSupplySnapshot(1, 1000, &timestamp, &validFields, &chargingStatus,
+                                              &healthStatus, &voltage, &current, &temp, &percent,
+                                              &charge),
+                 LE_OK);
+    CHECK(validFields == (MA_BATTERY_FIELD_CHARGING_STATUS | MA_BATTERY_FIELD_HEALTH |
+                          MA_BATTERY_FIELD_VOLTAGE | MA_BATTERY_FIELD_CHARGE |
+                          MA_BATTERY_FIELD_PERCENT));
+    CHECK(chargingStatus == MA_BATTERY_DISCHARGING);
+    CHECK(healthStatus == MA_BATTERY_GOOD);
+    CHECK(voltage == 3.0);
+    CHECK(charge == 50);
+    CHECK(percent == 50);
+
+    CHECK_RESULT(ma_battery_GetSupplySnapshot(3, 1000, &timestamp, &validFields, &chargingStatus,
+                                              &healthStatus, &voltage, &current, &temp, &percent,
+                                              &charge),
+                 LE_OUT_OF_RANGE);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * The aggregate combines the batteries whose full charge is known, using the capacity learned by
+ * the backend's state of health once it has one.
+ */
+//--------------------------------------------------------------------------------------------------
+static void TestAggregate
+(
+    void
+)
+{
+    fake_Values_t values =
+    {
+        .health = MA_BATTERY_GOOD,
+        .chargingStatus = MA_BATTERY_DISCHARGING,
+        .percent = 50,
+        .charge = 500,
+        .capacity = 1000,
+    };
+    fake_SetValues(&values);
+
+    uint32_t numBatteries = 0, charge = 0, fullCharge = 0;
+    uint16_t percent = 0;
+    bool isExternalPower = true;
+    CHECK_RESULT(ma_battery_GetAggregate(&numBatteries, &percent, &charge, &fullCharge,
+                                         &isExternalPower),
+                 LE_OK);
+    CHECK(numBatteries == 2);
+    CHECK(charge == 550);
+    CHECK(fullCharge == 1100);
+    CHECK(percent == 50);
+    CHECK(!isExternalPower);
+
+    values.fullCapacity = 800;
+    fake_SetValues(&values);
+    CHECK_RESULT(ma_battery_GetAggregate(&numBatteries, &percent, &charge, &fullCharge,
+                                         &isExternalPower),
+                 LE_OK);
+    CHECK(numBatteries == 2);
+    CHECK(fullCharge == 900);
+    CHECK(percent == 61);
+
+    uint8_t health;
+    uint16_t fullCapacity;
+    CHECK_RESULT(ma_battery_GetStateOfHealth(&health, &fullCapacity), LE_OK);
+    CHECK((health == 80) && (fullCapacity == 800));
+
+    // A charging battery means that there is external power.
+    values.chargingStatus = MA_BATTERY_CHARGING;
+    fake_SetValues(&values);
+    CHECK_RESULT(ma_battery_GetAggregate(&numBatteries, &percent, &charge, &fullCharge,
+                                         &isExternalPower),
+                 LE_OK);
+    CHECK(isExternalPower);
+
+    // A disconnected battery is left out.
+    values.health = MA_BATTERY_DISCONNECTED;
+    values.chargingStatus = MA_BATTERY_NOT_CHARGING;
+    fake_SetValues(&values);
+    CHECK_RESULT(ma_battery_GetAggregate(&numBatteries, &percent, &charge, &fullCharge,
+                                         &isExternalPower),
+                 LE_OK);
+    CHECK(numBatteries == 1);
+    CHECK(charge == 50);
+    CHECK(fullCharge == 100);
+    CHECK(!isExternalPower);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * A supply snapshot older than the maximum age makes the sampler thread read the hardware again,
+ * and the supplies whose status changed are reported to the supply status handlers.
+ */
+//--------------------------------------------------------------------------------------------------
+static void TestSupplyChanges
+(
+    void
+)
+{
+    memset(&Notified, 0, sizeof(Notified));
+    CHECK(!fake_AreNotificationsWanted());
+
+    CurrentSession = SESSION_A;
+    ma_battery_SupplyStatusChangeHandlerRef_t ref =
+        ma_battery_AddSupplyStatusChangeHandler(SupplyStatusHandler, NULL);
+    CHECK(ref != NULL);
+    CHECK(fake_AreNotificationsWanted());
+
+    test_WriteSysfsFile("class/power_supply/usb/online", "1\n");
+
+    // A recent enough snapshot is returned as it is.
+    unsigned int readCount = fake_GetReadCount();
+    uint64_t timestamp;
+    ma_battery_SnapshotField_t validFields;
+    ma_battery_ChargingStatus_t chargingStatus;
+    ma_battery_HealthStatus_t health;
+    double voltage, current, temp;
+    uint16_t percent, charge;
+    CHECK_RESULT(ma_battery_GetSupplySnapshot(2, 60000, &timestamp, &validFields,
+                                              &chargingStatus, &health, &voltage, &current,
+                                              &temp, &percent, &charge),
+                 LE_OK);
+    CHECK(fake_GetReadCount() == readCount);
+
+    usleep(2000);
+    CHECK_RESULT(ma_battery_GetSupplySnapshot(2, 0, &timestamp, &validFields, &chargingStatus,
+                                              &health, &voltage, &current, &temp, &percent,
+                                              &charge),
+                 LE_OK);
+    CHECK(fake_GetReadCount() == readCount + 1);
+
+    // The changes are reported from the main thread's event loop.  The backup cell was reported
+    // online when the samples of the earlier tests were taken, so only the USB supply is.
+    CHECK(Notified.numSupply == 0);
+    test_ServiceEvents();
+    CHECK(Notified.numSupply == 1);
+    CHECK(Notified.isSupplyOnline[2]);
+
+    uint32_t numBatteries, totalCharge, fullCharge;
+    bool isExternalPower = false;
+    CHECK_RESULT(ma_battery_GetAggregate(&numBatteries, &percent, &totalCharge, &fullCharge,
+                                         &isExternalPower),
+                 LE_OK);
+    CHECK(isExternalPower);
+
+    // Another sweep without changes reports nothing.
+    usleep(2000);
+    CHECK_RESULT(ma_battery_GetSupplySnapshot(2, 0, &timestamp, &validFields, &chargingStatus,
+                                              &health, &voltage, &current, &temp, &percent,
+                                              &charge),
+                 LE_OK);
+    test_ServiceEvents();
+    CHECK(Notified.numSupply == 1);
+
+    ma_battery_RemoveSupplyStatusChangeHandler(ref);
+    CHECK(!fake_AreNotificationsWanted());
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * The percent and charge of each supply can be read by index, and the level alarms of a supply
+ * fire when a sweep finds its level past their thresholds.
+ */
+//--------------------------------------------------------------------------------------------------
+static void TestSupplyLevels
+(
+    void
+)
+{
+    memset(&Notified, 0, sizeof(Notified));
+
+    uint16_t percent, charge;
+    CHECK_RESULT(ma_battery_GetSupplyPercentRemaining(1, &percent), LE_OK);
+    CHECK(percent == 50);
+    CHECK_RESULT(ma_battery_GetSupplyChargeRemaining(1, &charge), LE_OK);
+    CHECK(charge == 50);
+    CHECK_RESULT(ma_battery_GetSupplyPercentRemaining(2, &percent), LE_NOT_FOUND);
+    CHECK_RESULT(ma_battery_GetSupplyChargeRemaining(2, &charge), LE_NOT_FOUND);
+    CHECK_RESULT(ma_battery_GetSupplyPercentRemaining(3, &percent), LE_OUT_OF_RANGE);
+    CHECK_RESULT(ma_battery_GetSupplyChargeRemaining(3, &charge), LE_OUT_OF_RANGE);
+
+    CurrentSession = SESSION_A;
+    CHECK(ma_battery_AddSupplyLevelPercentageHandler(3, 20, 80, SupplyLevelHandler, NULL) == NULL);
+    CHECK(ma_battery_AddSupplyLevelPercentageHandler(1, 80, 20, SupplyLevelHandler, NULL) == NULL);
+    CHECK(!fake_AreNotificationsWanted());
+
+    ma_battery_SupplyLevelPercentageHandlerRef_t ref =
+        ma_battery_AddSupplyLevelPercentageHandler(1, 20, 80, SupplyLevelHandler, NULL);
+    CHECK(ref != NULL);
+    CHECK(fake_AreNotificationsWanted());
+
+    // The backup cell drops to 10%, which the next sweep finds.
+    test_WriteSysfsFile("class/power_supply/backup/charge_now", "10000\n");
+    usleep(2000);
+    uint64_t timestamp;
+    ma_battery_SnapshotField_t validFields;
+    ma_battery_ChargingStatus_t chargingStatus;
+    ma_battery_HealthStatus_t health;
+    double voltage, current, temp;
+    CHECK_RESULT(ma_battery_GetSupplySnapshot(1, 0, &timestamp, &validFields, &chargingStatus,
+                                              &health, &voltage, &current, &temp, &percent,
+                                              &charge),
+                 LE_OK);
+    CHECK(percent == 10);
+    test_ServiceEvents();
+    CHECK(Notified.numSupplyLevel == 1);
+    CHECK(Notified.supplyLevelIndex == 1);
+    CHECK(Notified.supplyPercentage == 10);
+    CHECK(Notified.supplyPercentageTrigger == 20);
+    CHECK(!Notified.isSupplyHighLevel);
+    CHECK_RESULT(ma_battery_GetSupplyPercentRemaining(1, &percent), LE_OK);
+    CHECK(percent == 10);
+
+    // The level staying low reports nothing more.
+    usleep(2000);
+    CHECK_RESULT(ma_battery_GetSupplySnapshot(1, 0, &timestamp, &validFields, &chargingStatus,
+                                              &health, &voltage, &current, &temp, &percent,
+                                              &charge),
+                 LE_OK);
+    test_ServiceEvents();
+    CHECK(Notified.numSupplyLevel == 1);
+
+    // Another client can't remove the handler.
+    CurrentSession = SESSION_B;
+    ma_battery_RemoveSupplyLevelPercentageHandler(ref);
+    CHECK(fake_AreNotificationsWanted());
+
+    CurrentSession = SESSION_A;
+    ma_battery_RemoveSupplyLevelPercentageHandler(ref);
+    CHECK(!fake_AreNotificationsWanted());
+
+    test_WriteSysfsFile("class/power_supply/backup/charge_now", "50000\n");
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Changes reported by the backend reach the handlers of each client session.  A client can only
+ * remove its own handlers, and a session's handlers are all removed when it closes.
+ */
+//--------------------------------------------------------------------------------------------------
+static void TestNotifications
+(
+    void
+)
+{
+    memset(&Notified, 0, sizeof(Notified));
+
+    CurrentSession = SESSION_A;
+    CHECK(ma_battery_AddLevelPercentageHandler(80, 20, LevelHandler, NULL) == NULL);
+    CHECK(ma_battery_AddLevelPercentageHandler(10, 101, LevelHandler, NULL) == NULL);
+    CHECK(!fake_AreNotificationsWanted());
+
+    ma_battery_HealthChangeHandlerRef_t healthRef =
+        ma_battery_AddHealthChangeHandler(HealthHandler, NULL);
+    ma_battery_ChargingStatusChangeHandlerRef_t chargingRef =
+        ma_battery_AddChargingStatusChangeHandler(ChargingStatusHandler, NULL);
+    ma_battery_LevelPercentageHandlerRef_t levelRef =
+        ma_battery_AddLevelPercentageHandler(20, 80, LevelHandler, NULL);
+    ma_battery_SupplyLevelPercentageHandlerRef_t supplyLevelRef =
+        ma_battery_AddSupplyLevelPercentageHandler(0, 10, 80, SupplyLevelHandler, NULL);
+    CHECK(   (healthRef != NULL) && (chargingRef != NULL) && (levelRef != NULL)
+          && (supplyLevelRef != NULL));
+    CHECK(fake_AreNotificationsWanted());
+
+    core_Report(MA_BATTERY_GOOD, MA_BATTERY_DISCHARGING, 50);
+    CHECK(Notified.numHealth == 1);
+    CHECK(Notified.health == MA_BATTERY_GOOD);
+    CHECK(Notified.numChargingStatus == 1);
+    CHECK(Notified.chargingStatus == MA_BATTERY_DISCHARGING);
+    CHECK(Notified.numLevel == 0);
+
+    // Only changes are reported.
+    core_Report(MA_BATTERY_GOOD, MA_BATTERY_DISCHARGING, 15);
+    CHECK(Notified.numHealth == 1);
+    CHECK(Notified.numChargingStatus == 1);
+    CHECK(Notified.numLevel == 1);
+    CHECK(Notified.percentage == 15);
+    CHECK(Notified.percentageTrigger == 20);
+    CHECK(!Notified.isHighLevel);
+
+    // Supply 0 is the backend's battery, so its level alarms fire on the same reports.
+    CHECK(Notified.numSupplyLevel == 0);
+    core_Report(MA_BATTERY_GOOD, MA_BATTERY_DISCHARGING, 5);
+    CHECK(Notified.numLevel == 1);
+    CHECK(Notified.numSupplyLevel == 1);
+    CHECK(Notified.supplyLevelIndex == 0);
+    CHECK(Notified.supplyPercentage == 5);
+    CHECK(Notified.supplyPercentageTrigger == 10);
+    core_Report(MA_BATTERY_GOOD, MA_BATTERY_DISCHARGING, 15);
+
+    CHECK(core_IsNearLevelAlarm(22, 2));
+    CHECK(core_IsNearLevelAlarm(12, 2));
+    CHECK(!core_IsNearLevelAlarm(30, 2));
+
+    // Another client can't remove the handlers.
+    CurrentSession = SESSION_B;
+    ma_battery_RemoveHealthChangeHandler(healthRef);
+    core_Report(MA_BATTERY_HOT, MA_BATTERY_DISCHARGING, 15);
+    CHECK(Notified.numHealth == 2);
+    CHECK(Notified.health == MA_BATTERY_HOT);
+
+    CurrentSession = SESSION_A;
+    ma_battery_RemoveChargingStatusChangeHandler(chargingRef);
+    core_Report(MA_BATTERY_HOT, MA_BATTERY_CHARGING, 15);
+    CHECK(Notified.numChargingStatus == 1);
+    CHECK(fake_AreNotificationsWanted());
+
+    // Closing the session removes the rest.  Closing one without registrations does nothing.
+    SessionClosedHandler(SESSION_B, SessionClosedContext);
+    CHECK(fake_AreNotificationsWanted());
+    SessionClosedHandler(SESSION_A, SessionClosedContext);
+    CHECK(!fake_AreNotificationsWanted());
+
+    core_Report(MA_BATTERY_GOOD, MA_BATTERY_DISCHARGING, 90);
+    CHECK(Notified.numHealth == 2);
+    CHECK(Notified.numLevel == 1);
+    CHECK(Notified.numSupplyLevel == 1);
+    CHECK(!core_IsNearLevelAlarm(20, 0));
+    CHECK(!core_IsNearLevelAlarm(10, 0));
+
+    // The references are no longer valid.
+    ma_battery_RemoveHealthChangeHandler(healthRef);
+    ma_battery_RemoveLevelPercentageHandler(levelRef);
+    ma_battery_RemoveSupplyLevelPercentageHandler(supplyLevelRef);
+    CHECK(!fake_AreNotificationsWanted());
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the percentages of the samples in the history.
+ *
+ * @return The result of ma_battery_GetHistory(), or of ma_battery_GetRecentHistory() if isRange
+ *         is false.
+ */
+//--------------------------------------------------------------------------------------------------
+static le_result_t GetHistoryPercents
+(
+    bool isRange,
+    uint64_t startTime,
+    uint64_t endTime,
+    uint8_t *percentPtr,
+    size_t *countPtr            ///< [IN/OUT] Size of the array, then the number of samples.
+)
+{
+    uint64_t timestamp[MA_BATTERY_MAX_HISTORY_SAMPLES];
+    uint16_t charge[MA_BATTERY_MAX_HISTORY_SAMPLES];
+    double current[MA_BATTERY_MAX_HISTORY_SAMPLES];
+    double voltage[MA_BATTERY_MAX_HISTORY_SAMPLES];
+    double temp[MA_BATTERY_MAX_HISTORY_SAMPLES];
+    uint8_t chargingStatus[MA_BATTERY_MAX_HISTORY_SAMPLES];
+    uint8_t health[MA_BATTERY_MAX_HISTORY_SAMPLES];
+    size_t sizes[8];
+
+    LE_ASSERT(*countPtr <= MA_BATTERY_MAX_HISTORY_SAMPLES);
+    for (int i = 0; i < NUM_ARRAY_MEMBERS(sizes); i++)
+    {
+        sizes[i] = *countPtr;
+    }
+
+    le_result_t result;
+    if (isRange)
+    {
+        result = ma_battery_GetHistory(startTime, endTime,
+                                       timestamp, &sizes[0], percentPtr, &sizes[1],
+                                       charge, &sizes[2], current, &sizes[3],
+                                       voltage, &sizes[4], temp, &sizes[5],
+                                       chargingStatus, &sizes[6], health, &sizes[7]);
+    }
+    else
+    {
+        result = ma_battery_GetRecentHistory(timestamp, &sizes[0], percentPtr, &sizes[1],
+                                             charge, &sizes[2], current, &sizes[3],
+                                             voltage, &sizes[4], temp, &sizes[5],
+                                             chargingStatus, &sizes[6], health, &sizes[7]);
+    }
+
+    for (int i = 1; i < NUM_ARRAY_MEMBERS(sizes); i++)
+    {
+        CHECK(sizes[i] == sizes[0]);
+    }
+    *countPtr = sizes[0];
+
+    return result;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * The samples added by the backend are returned oldest first, limited to the size of the arrays.
+ */
+//--------------------------------------------------------------------------------------------------
+static void TestHistory
+(
+    void
+)
+{
+    uint8_t percent[MA_BATTERY_MAX_HISTORY_SAMPLES];
+    size_t count = NUM_ARRAY_MEMBERS(percent);
+    CHECK_RESULT(GetHistoryPercents(false, 0, 0, percent, &count), LE_NOT_FOUND);
+    CHECK(count == 0);
+
+    // The samples are time-stamped with when they were read, not when they were added.
+    uint64_t startTime = util_GetEpochMs() - 10000;
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        core_AddHistorySample(startTime + 1000 * i, MA_BATTERY_GOOD, MA_BATTERY_DISCHARGING,
+                              60 - i, 600 - 10 * i, -100.0, 3.9, 25.0);
+    }
+
+    count = NUM_ARRAY_MEMBERS(percent);
+    CHECK_RESULT(GetHistoryPercents(false, 0, 0, percent, &count), LE_OK);
+    CHECK(count == 3);
+    CHECK((percent[0] == 60) && (percent[1] == 59) && (percent[2] == 58));
+
+    count = 2;
+    CHECK_RESULT(GetHistoryPercents(false, 0, 0, percent, &count), LE_OK);
+    CHECK(count == 2);
+    CHECK((percent[0] == 59) && (percent[1] == 58));
+
+    count = 2;
+    CHECK_RESULT(GetHistoryPercents(true, startTime, UINT64_MAX, percent, &count), LE_OVERFLOW);
+    CHECK(count == 2);
+    CHECK((percent[0] == 60) && (percent[1] == 59));
+
+    count = NUM_ARRAY_MEMBERS(percent);
+    CHECK_RESULT(GetHistoryPercents(true, 0, startTime - 1, percent, &count), LE_NOT_FOUND);
+    CHECK(count == 0);
+
+    count = NUM_ARRAY_MEMBERS(percent);
+    CHECK_RESULT(GetHistoryPercents(true, startTime + 1000, startTime + 1000, percent, &count),
+                 LE_OK);
+    CHECK((count == 1) && (percent[0] == 59));
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * A sample taken for a report is reported to the clients and added to the history, and one taken
+ * for a push is also pushed to the Data Hub.  A battery that isn't configured has no percentage,
+ * so it doesn't trigger level alarms.
+ */
+//--------------------------------------------------------------------------------------------------
+static void TestSampling
+(
+    void
+)
+{
+    memset(&Notified, 0, sizeof(Notified));
+
+    CurrentSession = SESSION_A;
+    ma_battery_LevelPercentageHandlerRef_t levelRef =
+        ma_battery_AddLevelPercentageHandler(20, 80, LevelHandler, NULL);
+    CHECK(levelRef != NULL);
+
+    fake_Values_t values =
+    {
+        .health = MA_BATTERY_GOOD,
+        .chargingStatus = MA_BATTERY_DISCHARGING,
+        .voltage = 3.6,
+        .current = -100.0,
+        .temp = 20.0,
+        .percent = 10,
+        .charge = 100,
+        .capacity = 0,
+    };
+    fake_SetValues(&values);
+    CHECK(Notified.numLevel == 0);
+
+    values.capacity = 1000;
+    fake_SetValues(&values);
+    CHECK(Notified.numLevel == 1);
+    CHECK(Notified.percentage == 10);
+
+    uint8_t percent[MA_BATTERY_MAX_HISTORY_SAMPLES];
+    size_t count = 1;
+    CHECK_RESULT(GetHistoryPercents(false, 0, 0, percent, &count), LE_OK);
+    CHECK((count == 1) && (percent[0] == 10));
+
+    double timestamp, value = 0;
+    values.percent = 9;
+    fake_SetValues(&values);
+    CHECK((dhubIO_GetNumericValue("percent", &timestamp, &value) != LE_OK) || (value != 9));
+
+    fake_Sample(CORE_SAMPLE_FOR_PUSH);
+    CHECK_RESULT(dhubIO_GetNumericValue("percent", &timestamp, &value), LE_OK);
+    CHECK(value == 9);
+
+    ma_battery_RemoveLevelPercentageHandler(levelRef);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * The push settings are set through their Data Hub config resources, and values out of range are
+ * ignored.
+ */
+//--------------------------------------------------------------------------------------------------
+static void TestPushSettings
+(
+    void
+)
+{
+    const core_PushSettings_t *settingsPtr = core_GetPushSettings();
+    CHECK(settingsPtr->batchSize == 0);
+    CHECK(settingsPtr->heartbeat > 0);
+
+    admin_PushNumeric("/app/battery/deadband/percent", 0, 2.5);
+    admin_PushNumeric("/app/battery/deadband/V", 0, 0.05);
+    admin_PushNumeric("/app/battery/deadband/degC", 0, 1);
+    admin_PushNumeric("/app/battery/deadband/mA", 0, 20);
+    admin_PushNumeric("/app/battery/heartbeat", 0, 60);
+    admin_PushNumeric("/app/battery/batch/size", 0, 10);
+    admin_PushNumeric("/app/battery/batch/maxAge", 0, 30);
+    CHECK(settingsPtr->percentDeadband == 2.5);
+    CHECK(settingsPtr->voltageDeadband == 0.05);
+    CHECK(settingsPtr->tempDeadband == 1);
+    CHECK(settingsPtr->currentDeadband == 20);
+    CHECK(settingsPtr->heartbeat == 60000);
+    CHECK(settingsPtr->batchSize == 10);
+    CHECK(settingsPtr->batchMaxAge == 30000);
+
+    admin_PushNumeric("/app/battery/deadband/percent", 0, -1);
+    admin_PushNumeric("/app/battery/heartbeat", 0, 0);
+    admin_PushNumeric("/app/battery/batch/size", 0, UTIL_MAX_BATCH_SAMPLES + 1);
+    admin_PushNumeric("/app/battery/batch/maxAge", 0, 0);
+    CHECK(settingsPtr->percentDeadband == 2.5);
+    CHECK(settingsPtr->heartbeat == 60000);
+    CHECK(settingsPtr->batchSize == 10);
+    CHECK(settingsPtr->batchMaxAge == 30000);
+}
+
+
+int main
+(
+    void
+)
+{
+    test_CreateSysfsRoot("batteryCoreTest");
+
+    _batteryCore_COMPONENT_INIT();
+    CHECK(SessionClosedHandler != NULL);
+
+    TestNoHardware();
+    TestHistory();
+    TestSelection();
+    TestValues();
+    TestAggregate();
+    TestSupplyChanges();
+    TestSupplyLevels();
+    TestNotifications();
+    TestSampling();
+    TestPushSettings();
+
+    return test_Finish();
+}
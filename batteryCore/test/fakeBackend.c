@@ -0,0 +1,254 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file fakeBackend.c
+ *
+ * Battery backend for the host tests of batteryCore (see fakeBackend.h).
+ *
+ * The core's sampler thread reads the values set by the test, so they are guarded by a mutex.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#include "legato.h"
+#include "interfaces.h"
+#include "batteryCore.h"
+#include "batteryUtils.h"
+#include "stateOfHealth.h"
+#include "fakeBackend.h"
+#include <pthread.h>
+
+/// Values set by the test.  Only access them through ValuesMutex.
+static fake_Values_t Values =
+{
+    .health = MA_BATTERY_HEALTH_UNKNOWN,
+    .chargingStatus = MA_BATTERY_CHARGING_UNKNOWN,
+};
+static pthread_mutex_t ValuesMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/// Number of calls to ReadSample().  Only used in the sampler thread, or while it is idle.
+static volatile unsigned int ReadCount = 0;
+
+/// Number of calls to ProcessSample().
+static unsigned int ProcessCount = 0;
+
+/// Last value passed to NotificationsChanged().
+static bool AreNotificationsWanted = false;
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Read the values set by the test into a sample.
+ */
+//--------------------------------------------------------------------------------------------------
+static void ReadSample
+(
+    void *samplePtr     ///< [out] fake_Values_t
+)
+{
+    pthread_mutex_lock(&ValuesMutex);
+    *(fake_Values_t *)samplePtr = Values;
+    pthread_mutex_unlock(&ValuesMutex);
+
+    ReadCount++;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Give the state of health the capacity learned, like a fuel gauge that reports its own.
+ *
+ * @return true, as every sample can be reported.
+ */
+//--------------------------------------------------------------------------------------------------
+static bool ProcessSample
+(
+    const void *samplePtr,
+    le_clk_Time_t time,
+    uint32_t reasons
+)
+{
+    const fake_Values_t *valuesPtr = samplePtr;
+
+    if (valuesPtr->fullCapacity > 0)
+    {
+        util_SetSohFullCapacity(core_GetStateOfHealth(), valuesPtr->fullCapacity);
+    }
+
+    ProcessCount++;
+
+    return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Map a sample to the battery values.  They are always valid, except the percentage, which needs
+ * the capacity to be configured.
+ */
+//--------------------------------------------------------------------------------------------------
+static void GetValues
+(
+    const void *samplePtr,
+    core_Values_t *valuesPtr
+)
+{
+    const fake_Values_t *fakePtr = samplePtr;
+
+    valuesPtr->validFields = MA_BATTERY_FIELD_CHARGING_STATUS | MA_BATTERY_FIELD_HEALTH |
+                             MA_BATTERY_FIELD_VOLTAGE | MA_BATTERY_FIELD_CURRENT |
+                             MA_BATTERY_FIELD_TEMP | MA_BATTERY_FIELD_CHARGE;
+    if (fakePtr->capacity > 0)
+    {
+        valuesPtr->validFields |= MA_BATTERY_FIELD_PERCENT;
+    }
+    valuesPtr->chargingStatus = fakePtr->chargingStatus;
+    valuesPtr->health = fakePtr->health;
+    valuesPtr->voltage = fakePtr->voltage;
+    valuesPtr->current = fakePtr->current;
+    valuesPtr->temp = fakePtr->temp;
+    valuesPtr->percent = fakePtr->percent;
+    valuesPtr->charge = fakePtr->charge;
+    valuesPtr->fullCharge = fakePtr->capacity;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the confidence set by the test.
+ */
+//--------------------------------------------------------------------------------------------------
+static le_result_t GetPercentConfidence
+(
+    uint8_t *confidencePtr
+)
+{
+    pthread_mutex_lock(&ValuesMutex);
+    *confidencePtr = Values.confidence;
+    pthread_mutex_unlock(&ValuesMutex);
+
+    return LE_OK;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Record whether any client has a notification handler.
+ */
+//--------------------------------------------------------------------------------------------------
+static void NotificationsChanged
+(
+    bool isAnyRegistered
+)
+{
+    AreNotificationsWanted = isAnyRegistered;
+}
+
+
+static const char *const SupplyNames[] = { FAKE_SUPPLY_NAME, NULL };
+
+/// The functions that read and interpret the fake hardware.
+static const core_Backend_t Backend =
+{
+    .name = FAKE_BACKEND_NAME,
+    .supplyNames = SupplyNames,
+    .sampleSize = sizeof(fake_Values_t),
+    .readSample = ReadSample,
+    .processSample = ProcessSample,
+    .getValues = GetValues,
+    .getPercentConfidence = GetPercentConfidence,
+    .notificationsChanged = NotificationsChanged,
+};
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Ask the core to use the fake backend, and start sampling it, as a real backend does in its
+ * COMPONENT_INIT.
+ *
+ * @return The result of core_SetBackend().
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t fake_Select
+(
+    void
+)
+{
+    le_result_t result = core_SetBackend(&Backend);
+
+    if (result == LE_OK)
+    {
+        core_LoadStateOfHealth(FAKE_DESIGN_CAPACITY);
+        core_StartSampling();
+    }
+
+    return result;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Set the values read by the fake backend, and wait until a sample of them has been processed.
+ */
+//--------------------------------------------------------------------------------------------------
+void fake_SetValues
+(
+    const fake_Values_t *valuesPtr
+)
+{
+    pthread_mutex_lock(&ValuesMutex);
+    Values = *valuesPtr;
+    pthread_mutex_unlock(&ValuesMutex);
+
+    fake_Sample(CORE_SAMPLE_FOR_REPORT);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Request a sample, and run the main thread's event loop until it has been processed.
+ */
+//--------------------------------------------------------------------------------------------------
+void fake_Sample
+(
+    uint32_t reasons    ///< Sample request flags.
+)
+{
+    unsigned int processCount = ProcessCount;
+
+    core_RequestSample(reasons);
+
+    while (ProcessCount == processCount)
+    {
+        if (le_event_ServiceLoop() != LE_OK)
+        {
+            usleep(1000);
+        }
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * @return The number of times the hardware has been read.
+ */
+//--------------------------------------------------------------------------------------------------
+unsigned int fake_GetReadCount
+(
+    void
+)
+{
+    return ReadCount;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * @return true if the core last told the backend that a client has a notification handler.
+ */
+//--------------------------------------------------------------------------------------------------
+bool fake_AreNotificationsWanted
+(
+    void
+)
+{
+    return AreNotificationsWanted;
+}
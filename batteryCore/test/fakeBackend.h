@@ -0,0 +1,48 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file fakeBackend.h
+ *
+ * Battery backend for the host tests of batteryCore.  Its samples hold whatever values the test
+ * sets, and it stands for the power_supply class device FAKE_SUPPLY_NAME, which the test creates
+ * under the sysfs root to make the backend's hardware present.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#ifndef FAKE_BACKEND_H
+#define FAKE_BACKEND_H
+
+#include "legato.h"
+#include "interfaces.h"
+
+/// Name of the fake backend, as reported for supply 0.
+#define FAKE_BACKEND_NAME "Fake"
+
+/// power_supply class device that must be present for the fake backend to be selected.
+#define FAKE_SUPPLY_NAME "fake-battery"
+
+/// Capacity of the fake battery when new (mAh).
+#define FAKE_DESIGN_CAPACITY 1000
+
+/// Values read by the fake backend.
+typedef struct
+{
+    ma_battery_HealthStatus_t health;
+    ma_battery_ChargingStatus_t chargingStatus;
+    double voltage;             ///< V
+    double current;             ///< mA
+    double temp;                ///< degrees C
+    uint16_t percent;
+    uint8_t confidence;
+    uint16_t charge;            ///< mAh
+    uint16_t capacity;          ///< Configured capacity (mAh), or 0 if not configured.
+    uint16_t fullCapacity;      ///< Capacity learned by the state of health (mAh), or 0.
+}
+fake_Values_t;
+
+le_result_t fake_Select(void);
+void fake_SetValues(const fake_Values_t *valuesPtr);
+void fake_Sample(uint32_t reasons);
+unsigned int fake_GetReadCount(void);
+bool fake_AreNotificationsWanted(void);
+
+#endif // FAKE_BACKEND_H
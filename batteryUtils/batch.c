@@ -0,0 +1,145 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file batch.c
+ *
+ * Batches of battery samples, used by the Battery Service to push many samples to the Data Hub
+ * in a single value.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#include "legato.h"
+#include "batch.h"
+#include "batteryUtils.h"
+#include <math.h>
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Round a value to the nearest integer, clamped to the range of an int32_t.
+ */
+//--------------------------------------------------------------------------------------------------
+static int32_t Clamp
+(
+    double value
+)
+{
+    if (isnan(value))
+    {
+        return 0;
+    }
+    if (value <= INT32_MIN)
+    {
+        return INT32_MIN;
+    }
+    if (value >= INT32_MAX)
+    {
+        return INT32_MAX;
+    }
+    return (int32_t)lround(value);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Empty a batch.
+ */
+//--------------------------------------------------------------------------------------------------
+void util_ClearBatch
+(
+    util_Batch_t *batchPtr
+)
+{
+    batchPtr->count = 0;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Add a sample to a batch, time-stamped now.
+ *
+ * @warning The batch must not be full.
+ *
+ * @return The number of samples in the batch.
+ */
+//--------------------------------------------------------------------------------------------------
+size_t util_AddBatchSample
+(
+    util_Batch_t *batchPtr,
+    unsigned int percentage,
+    unsigned int charge,    ///< mAh
+    double current,         ///< mA
+    double voltage,         ///< V
+    double temperature      ///< degrees C
+)
+{
+    LE_ASSERT(batchPtr->count < UTIL_MAX_BATCH_SAMPLES);
+
+    uint64_t now = util_GetEpochMs();
+    if (batchPtr->count == 0)
+    {
+        batchPtr->startTime = now;
+        batchPtr->startClock = util_GetRelativeTime();
+    }
+
+    size_t i = batchPtr->count;
+    batchPtr->offset[i] = (now > batchPtr->startTime) ? Clamp(now - batchPtr->startTime) : 0;
+    batchPtr->percentage[i] = (percentage > INT32_MAX) ? INT32_MAX : percentage;
+    batchPtr->charge[i] = (charge > INT32_MAX) ? INT32_MAX : charge;
+    batchPtr->current[i] = Clamp(current * 1000.0);
+    batchPtr->voltage[i] = Clamp(voltage * 1000.0);
+    batchPtr->temperature[i] = Clamp(temperature * 100.0);
+
+    return ++batchPtr->count;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the time since the first sample of a batch was added.
+ *
+ * @return The age in ms, or 0 if the batch is empty.
+ */
+//--------------------------------------------------------------------------------------------------
+uint64_t util_GetBatchAge
+(
+    const util_Batch_t *batchPtr
+)
+{
+    if (batchPtr->count == 0)
+    {
+        return 0;
+    }
+
+    return util_MsSince(batchPtr->startClock);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Render a batch as a JSON object with one array per field (see batch.h).
+ *
+ * @return
+ *  - LE_OK if the document fit in the buffer.
+ *  - LE_OVERFLOW if it didn't.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t util_RenderBatch
+(
+    const util_Batch_t *batchPtr,
+    char *bufferPtr,
+    size_t size,            ///< Size of the buffer (bytes).
+    size_t *lenPtr          ///< [OUT] Exact length of the document.  May be NULL.
+)
+{
+    util_JsonWriter_t writer;
+    util_JsonBegin(&writer, bufferPtr, size);
+    util_JsonAddInt(&writer, "t0", (int64_t)batchPtr->startTime);
+    util_JsonAddFixedArray(&writer, "dt", batchPtr->offset, batchPtr->count, 0);
+    util_JsonAddFixedArray(&writer, "percent", batchPtr->percentage, batchPtr->count, 0);
+    util_JsonAddFixedArray(&writer, "mAh", batchPtr->charge, batchPtr->count, 0);
+    util_JsonAddFixedArray(&writer, "mA", batchPtr->current, batchPtr->count, 3);
+    util_JsonAddFixedArray(&writer, "V", batchPtr->voltage, batchPtr->count, 3);
+    util_JsonAddFixedArray(&writer, "degC", batchPtr->temperature, batchPtr->count, 2);
+
+    return util_JsonEnd(&writer, lenPtr);
+}
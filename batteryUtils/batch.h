@@ -0,0 +1,53 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file batch.h
+ *
+ * Batches of battery samples, used by the Battery Service to push many samples to the Data Hub
+ * in a single value.
+ *
+ * Samples are stored column by column and rendered as one JSON object holding an array per
+ * field, with the time of each sample as an offset from the first one:
+ *
+ * @code
+ * {"t0":1700000000000,"dt":[0,1000,2000],"percent":[80,80,79],"mAh":[1760,1759,1758],
+ *  "mA":[-120.512,-121.003,-119.870],"V":[3.912,3.911,3.911],"degC":[31.20,31.25,31.25]}
+ * @endcode
+ */
+//--------------------------------------------------------------------------------------------------
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "legato.h"
+#include "jsonWriter.h"
+
+/// Largest number of samples in a batch.
+#define UTIL_MAX_BATCH_SAMPLES 100
+
+/// Size of a buffer that can hold any rendered batch.
+#define UTIL_BATCH_JSON_BUFFER_SIZE (128 + (UTIL_MAX_BATCH_SAMPLES * 64))
+
+/// A batch of samples.
+typedef struct
+{
+    size_t count;               ///< Number of samples in the batch.
+    uint64_t startTime;         ///< When the first sample was added (ms since the Epoch).
+    le_clk_Time_t startClock;   ///< When the first sample was added (monotonic clock).
+    int32_t offset[UTIL_MAX_BATCH_SAMPLES];     ///< ms since startTime.
+    int32_t percentage[UTIL_MAX_BATCH_SAMPLES];
+    int32_t charge[UTIL_MAX_BATCH_SAMPLES];     ///< mAh.
+    int32_t current[UTIL_MAX_BATCH_SAMPLES];    ///< uA.
+    int32_t voltage[UTIL_MAX_BATCH_SAMPLES];    ///< mV.
+    int32_t temperature[UTIL_MAX_BATCH_SAMPLES];///< Hundredths of a degree C.
+}
+util_Batch_t;
+
+LE_SHARED void util_ClearBatch(util_Batch_t *batchPtr);
+LE_SHARED size_t util_AddBatchSample(util_Batch_t *batchPtr, unsigned int percentage,
+                                     unsigned int charge, double current, double voltage,
+                                     double temperature);
+LE_SHARED uint64_t util_GetBatchAge(const util_Batch_t *batchPtr);
+LE_SHARED le_result_t util_RenderBatch(const util_Batch_t *batchPtr, char *bufferPtr, size_t size,
+                                       size_t *lenPtr);
+
+#endif // BATCH_H
@@ -3,140 +3,485 @@
  * @file batteryUtils.c
  *
  * File access utilities used by the Battery Service.
+ *
+ * Besides the one-shot path-based readers, a handle-based API is provided for files that are
+ * sampled repeatedly (e.g., sysfs attributes).  A handle keeps its file descriptor open between
+ * reads and uses pread() at offset 0, which makes the kernel regenerate the attribute value
+ * without a path lookup or any stdio buffering.  If a read fails, the file is re-opened and the
+ * read is retried once.
  */
 //--------------------------------------------------------------------------------------------------
 
 #include "legato.h"
 #include "batteryUtils.h"
+#include "trace.h"
+#include <math.h>
 
-le_result_t util_ReadStringFromFile
+/// Holds the state of a file opened with util_OpenFile().
+typedef struct util_File
+{
+    int fd;                 ///< File descriptor, or -1 if not currently open.
+    int flags;              ///< Flags to pass to open() (O_RDONLY, O_WRONLY or O_RDWR).
+    char path[PATH_MAX];    ///< Path of the file.
+    util_TraceFile_t trace; ///< Trace recording/replay state.
+}
+util_File_t;
+
+/// Pool from which util_File_t objects are allocated.
+static le_mem_PoolRef_t FilePool = NULL;
+
+/// I/O statistics for all file handles.
+static util_IoStats_t IoStats;
+
+/// The I/O statistics are logged (at debug level) every time this many more reads have been done.
+#define IO_STATS_LOG_INTERVAL 1000
+
+/// Environment variable that can be set to run against a copy of sysfs mounted somewhere else.
+#define SYSFS_ROOT_ENV_VAR "BATTERY_SYSFS_ROOT"
+
+/// Where sysfs is mounted, if SYSFS_ROOT_ENV_VAR is not set.
+#define DEFAULT_SYSFS_ROOT "/sys"
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Check for a whitespace character, as isspace() does in the "C" locale.
+ */
+//--------------------------------------------------------------------------------------------------
+static inline bool IsSpace
 (
-    const char *filePath,
-    char *value,
-    size_t valueSize
+    char c
 )
 {
-    le_result_t r = LE_OK;
-    FILE *f       = fopen(filePath, "r");
+    return (c == ' ') || ((c >= '\t') && (c <= '\r'));
+}
 
-    if (f == NULL)
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Parse a decimal integer from a buffer (not necessarily null-terminated), requiring the whole
+ * buffer to be consumed.  Like sscanf("%d"), leading whitespace and a sign are accepted.  One
+ * trailing newline is also accepted, as the kernel terminates sysfs values with one.
+ *
+ * @return
+ *  - LE_OK on success.
+ *  - LE_FORMAT_ERROR if the buffer does not hold a decimal integer.
+ *  - LE_OVERFLOW if the integer doesn't fit in an int64_t.
+ */
+//--------------------------------------------------------------------------------------------------
+static le_result_t ParseInt64
+(
+    const char *buffer,
+    size_t len,
+    int64_t *valuePtr
+)
+{
+    const char *charPtr = buffer;
+    const char *endPtr = buffer + len;
+
+    if ((endPtr > charPtr) && (endPtr[-1] == '\n'))
     {
-        LE_WARN("Couldn't open '%s' - %m", filePath);
-        r = LE_IO_ERROR;
-        goto done;
+        endPtr--;
     }
 
-    bool eofReached = false;
-    size_t numRead  = 0;
-    while (numRead < valueSize - 1)
+    while ((charPtr < endPtr) && IsSpace(*charPtr))
     {
-        size_t freadRes = fread(&value[numRead], 1, valueSize - 1 - numRead, f);
-        numRead += freadRes;
-        if (feof(f))
+        charPtr++;
+    }
+
+    bool isNegative = false;
+    if ((charPtr < endPtr) && ((*charPtr == '-') || (*charPtr == '+')))
+    {
+        isNegative = (*charPtr == '-');
+        charPtr++;
+    }
+
+    if (charPtr == endPtr)
+    {
+        return LE_FORMAT_ERROR;
+    }
+
+    // Accumulate the magnitude unsigned, so that INT64_MIN can be represented.
+    const uint64_t limit = isNegative ? ((uint64_t)INT64_MAX + 1) : (uint64_t)INT64_MAX;
+    uint64_t magnitude = 0;
+    for (; charPtr < endPtr; charPtr++)
+    {
+        unsigned int digit = (unsigned char)*charPtr - (unsigned char)'0';
+        if (digit > 9)
         {
-            if (numRead > 0 && value[numRead - 1] == '\n')
-            {
-                value[numRead - 1] = '\0';
-            }
-            else
-            {
-                value[numRead] = '\0';
-            }
-            eofReached = true;
-            break;
+            return LE_FORMAT_ERROR;
         }
-        if (ferror(f))
+        if (magnitude > (limit - digit) / 10)
         {
-            r = LE_IO_ERROR;
-            goto cleanup;
+            return LE_OVERFLOW;
         }
+        magnitude = (magnitude * 10) + digit;
     }
 
-    if (!eofReached)
+    *valuePtr = isNegative ? (int64_t)(0 - magnitude) : (int64_t)magnitude;
+
+    return LE_OK;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Narrow a parsed integer to an int.
+ *
+ * @return
+ *  - LE_OK on success.
+ *  - LE_OVERFLOW if the integer doesn't fit in an int.
+ */
+//--------------------------------------------------------------------------------------------------
+static le_result_t NarrowToInt
+(
+    int64_t value64,
+    int *valuePtr
+)
+{
+    if ((value64 < INT_MIN) || (value64 > INT_MAX))
     {
-        r = LE_OVERFLOW;
-        goto cleanup;
+        return LE_OVERFLOW;
     }
 
-cleanup:
-    fclose(f);
-done:
-    return r;
+    *valuePtr = (int)value64;
+
+    return LE_OK;
 }
 
-le_result_t util_ReadIntFromFile
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Parse a floating point number from a buffer of len bytes, with room for a terminator after them,
+ * requiring the whole buffer to be consumed.  One trailing newline is accepted.
+ *
+ * Sysfs values are plain fixed-point decimals, so those are parsed directly: while the digits fit
+ * in a double's 53-bit mantissa and there are at most 22 decimal places, one division by an exact
+ * power of ten gives the same correctly rounded result as sscanf("%lf").  Anything else (an
+ * exponent, "inf", hexadecimal, too many digits) is left to sscanf().
+ *
+ * @return
+ *  - LE_OK on success.
+ *  - LE_FORMAT_ERROR if the buffer does not hold a number.
+ */
+//--------------------------------------------------------------------------------------------------
+static le_result_t ParseDouble
 (
-    const char *filePath,
-    int *value
+    char *buffer,
+    size_t len,
+    double *value
 )
 {
-    char buffer[16];
-    le_result_t r = util_ReadStringFromFile(filePath, buffer, sizeof(buffer));
-    if (r == LE_OK)
+    static const double powersOf10[] =
+    {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    if ((len > 0) && (buffer[len - 1] == '\n'))
+    {
+        len--;
+    }
+    buffer[len] = '\0';
+
+    const char *charPtr = buffer;
+    const char *endPtr = buffer + len;
+
+    while ((charPtr < endPtr) && IsSpace(*charPtr))
     {
-        int charsScanned = 0;
-        int sscanfRes    = sscanf(buffer, "%d%n", value, &charsScanned);
-        if (sscanfRes == 1)
+        charPtr++;
+    }
+
+    bool isNegative = false;
+    if ((charPtr < endPtr) && ((*charPtr == '-') || (*charPtr == '+')))
+    {
+        isNegative = (*charPtr == '-');
+        charPtr++;
+    }
+
+    uint64_t mantissa = 0;
+    size_t numDigits = 0;
+    size_t numDecimals = 0;
+    bool isFraction = false;
+    for (; charPtr < endPtr; charPtr++)
+    {
+        unsigned int digit = (unsigned char)*charPtr - (unsigned char)'0';
+        if (digit <= 9)
         {
-            if (charsScanned == strlen(buffer))
-            {
-                r = LE_OK;
-            }
-            else
+            // Stop accumulating before the mantissa can pass 2^53; sscanf() handles the rest.
+            if (mantissa > ((UINT64_C(1) << 53) - digit) / 10)
             {
-                r = LE_FORMAT_ERROR;
+                break;
             }
+            mantissa = (mantissa * 10) + digit;
+            numDigits++;
+            numDecimals += isFraction;
+        }
+        else if ((*charPtr == '.') && !isFraction)
+        {
+            isFraction = true;
         }
         else
         {
-            r = LE_FORMAT_ERROR;
+            break;
         }
     }
-    return r;
+
+    if ((charPtr == endPtr) && (numDigits > 0) && (numDecimals < NUM_ARRAY_MEMBERS(powersOf10)))
+    {
+        double magnitude = (double)mantissa / powersOf10[numDecimals];
+        *value = isNegative ? -magnitude : magnitude;
+        return LE_OK;
+    }
+
+    int charsScanned = 0;
+    int sscanfRes    = sscanf(buffer, "%lf%n", value, &charsScanned);
+    if ((sscanfRes == 1) && (charsScanned == strlen(buffer)))
+    {
+        return LE_OK;
+    }
+
+    return LE_FORMAT_ERROR;
 }
 
 
-le_result_t util_ReadDoubleFromFile
+//--------------------------------------------------------------------------------------------------
+/**
+ * Make sure a file handle has an open file descriptor.
+ *
+ * @return
+ *  - LE_OK if the file is open.
+ *  - LE_IO_ERROR if it couldn't be opened.
+ */
+//--------------------------------------------------------------------------------------------------
+static le_result_t EnsureOpen
 (
-    const char *filePath,
-    double *value
+    util_File_t *filePtr
 )
 {
-    char buffer[32];
-    le_result_t r = util_ReadStringFromFile(filePath, buffer, sizeof(buffer));
-    if (r == LE_OK)
+    if (filePtr->fd < 0)
     {
-        int charsScanned = 0;
-        int sscanfRes    = sscanf(buffer, "%lf%n", value, &charsScanned);
-        if (sscanfRes == 1)
+        filePtr->fd = open(filePtr->path, filePtr->flags | O_CLOEXEC);
+        IoStats.numSyscalls++;
+        if (filePtr->fd < 0)
         {
-            if (charsScanned == strlen(buffer))
-            {
-                r = LE_OK;
-            }
-            else
-            {
-                r = LE_FORMAT_ERROR;
-            }
+            LE_WARN("Couldn't open '%s' - %m", filePtr->path);
+            return LE_IO_ERROR;
         }
-        else
+    }
+
+    return LE_OK;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Close a file handle's file descriptor, if it is open.
+ */
+//--------------------------------------------------------------------------------------------------
+static void CloseFd
+(
+    util_File_t *filePtr
+)
+{
+    if (filePtr->fd >= 0)
+    {
+        close(filePtr->fd);
+        IoStats.numSyscalls++;
+        filePtr->fd = -1;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Read from offset 0 of a file handle, re-opening the file and retrying once if the read fails.
+ *
+ * @return Number of bytes read, or -1 on error.
+ */
+//--------------------------------------------------------------------------------------------------
+static ssize_t ReadFromStart
+(
+    util_File_t *filePtr,
+    char *buffer,
+    size_t bufferSize
+)
+{
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        if (EnsureOpen(filePtr) != LE_OK)
+        {
+            return -1;
+        }
+
+        ssize_t numRead;
+        do
+        {
+            numRead = pread(filePtr->fd, buffer, bufferSize, 0);
+            IoStats.numSyscalls++;
+        }
+        while ((numRead < 0) && (errno == EINTR));
+
+        if (numRead >= 0)
         {
-            r = LE_FORMAT_ERROR;
+            return numRead;
         }
+
+        LE_WARN("Failed to read '%s' - %m", filePtr->path);
+        CloseFd(filePtr);
     }
-    return r;
+
+    return -1;
 }
 
 
-le_result_t util_WriteIntToFile
+//--------------------------------------------------------------------------------------------------
+/**
+ * Write to offset 0 of a file handle, re-opening the file and retrying once if the write fails.
+ *
+ * @return Number of bytes written, or -1 on error.
+ */
+//--------------------------------------------------------------------------------------------------
+static ssize_t WriteFromStart
+(
+    util_File_t *filePtr,
+    const char *buffer,
+    size_t bufferSize
+)
+{
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        if (EnsureOpen(filePtr) != LE_OK)
+        {
+            return -1;
+        }
+
+        ssize_t numWritten;
+        do
+        {
+            numWritten = pwrite(filePtr->fd, buffer, bufferSize, 0);
+            IoStats.numSyscalls++;
+        }
+        while ((numWritten < 0) && (errno == EINTR));
+
+        if (numWritten >= 0)
+        {
+            return numWritten;
+        }
+
+        LE_WARN("Failed to write '%s' - %m", filePtr->path);
+        CloseFd(filePtr);
+    }
+
+    return -1;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Read the monotonic clock.
+ *
+ * @return Time in ns.
+ */
+//--------------------------------------------------------------------------------------------------
+static uint64_t GetNs
+(
+    void
+)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ((uint64_t)now.tv_sec * 1000000000) + now.tv_nsec;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Account for a read in the I/O statistics, logging them every IO_STATS_LOG_INTERVAL reads.
+ */
+//--------------------------------------------------------------------------------------------------
+static void CountRead
+(
+    uint64_t startNs,
+    bool isOk
+)
+{
+    IoStats.numReads++;
+    IoStats.readNs += GetNs() - startNs;
+    if (!isOk)
+    {
+        IoStats.numFailures++;
+    }
+
+    if ((IoStats.numReads % IO_STATS_LOG_INTERVAL) == 0)
+    {
+        LE_DEBUG("File I/O: %" PRIu64 " reads, %" PRIu64 " ns/read, %" PRIu64 ".%02" PRIu64
+                 " syscalls/read, %" PRIu64 " writes, %" PRIu64 " failures.",
+                 IoStats.numReads,
+                 IoStats.readNs / IoStats.numReads,
+                 IoStats.numSyscalls / IoStats.numReads,
+                 ((IoStats.numSyscalls % IoStats.numReads) * 100) / IoStats.numReads,
+                 IoStats.numWrites,
+                 IoStats.numFailures);
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Terminate the contents of a buffer filled by a read, stripping one trailing newline.
+ *
+ * @return
+ *  - LE_OK on success.
+ *  - LE_OVERFLOW if the file contents didn't fit in the buffer.
+ */
+//--------------------------------------------------------------------------------------------------
+static le_result_t TerminateString
+(
+    char *value,
+    size_t valueSize,
+    size_t numRead
+)
+{
+    if (numRead >= valueSize)
+    {
+        value[valueSize - 1] = '\0';
+        return LE_OVERFLOW;
+    }
+
+    if ((numRead > 0) && (value[numRead - 1] == '\n'))
+    {
+        numRead--;
+    }
+    value[numRead] = '\0';
+
+    return LE_OK;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Read the whole of a file into a buffer, without terminating it.  At most bufferSize - 1 bytes
+ * are read, leaving room for a terminator.
+ *
+ * @return
+ *  - LE_OK on success.
+ *  - LE_IO_ERROR if the file couldn't be opened or read.
+ *  - LE_OVERFLOW if the file contents didn't fit in the buffer.
+ */
+//--------------------------------------------------------------------------------------------------
+static le_result_t ReadFile
 (
     const char *filePath,
-    int value
+    char *buffer,
+    size_t bufferSize,
+    size_t *numReadPtr
 )
 {
-    char intStr[12];
     le_result_t r = LE_OK;
-    FILE *f       = fopen(filePath, "w");
+    FILE *f       = fopen(filePath, "r");
+
     if (f == NULL)
     {
         LE_WARN("Couldn't open '%s' - %m", filePath);
@@ -144,21 +489,513 @@ le_result_t util_WriteIntToFile
         goto done;
     }
 
-    int bytesRequired = snprintf(intStr, sizeof(intStr), "%d", value);
-    LE_ASSERT(bytesRequired < sizeof(intStr));
-
-    const size_t numWritten = fwrite(intStr, 1, bytesRequired, f);
-    if (numWritten != bytesRequired)
+    bool eofReached = false;
+    size_t numRead  = 0;
+    while (numRead < bufferSize - 1)
     {
-        r = LE_IO_ERROR;
-    }
-
-    fclose(f);
-done:
+        size_t freadRes = fread(&buffer[numRead], 1, bufferSize - 1 - numRead, f);
+        numRead += freadRes;
+        if (feof(f))
+        {
+            eofReached = true;
+            break;
+        }
+        if (ferror(f))
+        {
+            r = LE_IO_ERROR;
+            goto cleanup;
+        }
+    }
+
+    if (!eofReached)
+    {
+        r = LE_OVERFLOW;
+        goto cleanup;
+    }
+
+    *numReadPtr = numRead;
+
+cleanup:
+    fclose(f);
+done:
+    return r;
+}
+
+
+le_result_t util_ReadStringFromFile
+(
+    const char *filePath,
+    char *value,
+    size_t valueSize
+)
+{
+    size_t numRead;
+    le_result_t r = ReadFile(filePath, value, valueSize, &numRead);
+    if (r == LE_OK)
+    {
+        r = TerminateString(value, valueSize, numRead);
+    }
+    return r;
+}
+
+le_result_t util_ReadIntFromFile
+(
+    const char *filePath,
+    int *value
+)
+{
+    char buffer[16];
+    size_t numRead;
+    int64_t value64;
+    le_result_t r = ReadFile(filePath, buffer, sizeof(buffer), &numRead);
+    if (r == LE_OK)
+    {
+        r = ParseInt64(buffer, numRead, &value64);
+    }
+    if (r == LE_OK)
+    {
+        r = NarrowToInt(value64, value);
+    }
+    return r;
+}
+
+
+le_result_t util_ReadDoubleFromFile
+(
+    const char *filePath,
+    double *value
+)
+{
+    char buffer[32];
+    size_t numRead;
+    le_result_t r = ReadFile(filePath, buffer, sizeof(buffer), &numRead);
+    if (r == LE_OK)
+    {
+        r = ParseDouble(buffer, numRead, value);
+    }
+    return r;
+}
+
+
+le_result_t util_WriteIntToFile
+(
+    const char *filePath,
+    int value
+)
+{
+    char intStr[12];
+    le_result_t r = LE_OK;
+    FILE *f       = fopen(filePath, "w");
+    if (f == NULL)
+    {
+        LE_WARN("Couldn't open '%s' - %m", filePath);
+        r = LE_IO_ERROR;
+        goto done;
+    }
+
+    int bytesRequired = snprintf(intStr, sizeof(intStr), "%d", value);
+    LE_ASSERT(bytesRequired < sizeof(intStr));
+
+    const size_t numWritten = fwrite(intStr, 1, bytesRequired, f);
+    if (numWritten != bytesRequired)
+    {
+        r = LE_IO_ERROR;
+    }
+
+    fclose(f);
+done:
     return r;
 }
 
 
+//--------------------------------------------------------------------------------------------------
+/**
+ * Create a handle for a file that will be read (or written) repeatedly.
+ *
+ * The file is opened immediately if possible.  If it can't be opened yet (e.g., the driver isn't
+ * loaded), opening is retried on every access.
+ *
+ * @return The file handle (never NULL).
+ */
+//--------------------------------------------------------------------------------------------------
+util_FileRef_t util_OpenFile
+(
+    const char *filePath,
+    int flags           ///< O_RDONLY, O_WRONLY or O_RDWR.
+)
+{
+    if (FilePool == NULL)
+    {
+        FilePool = le_mem_CreatePool("utilFiles", sizeof(util_File_t));
+    }
+
+    util_File_t *filePtr = le_mem_ForceAlloc(FilePool);
+    filePtr->fd = -1;
+    filePtr->flags = flags;
+    LE_ASSERT(le_utf8_Copy(filePtr->path, filePath, sizeof(filePtr->path), NULL) == LE_OK);
+
+    util_TraceOpen(&filePtr->trace, filePtr->path);
+
+    // When replaying a trace, the driver files are never accessed.
+    if (!util_IsReplaying())
+    {
+        (void)EnsureOpen(filePtr);
+    }
+
+    return filePtr;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the directory that sysfs paths are relative to.  This is "/sys" unless the
+ * BATTERY_SYSFS_ROOT environment variable is set (e.g., to a tmpfs tree for testing).
+ *
+ * @return The sysfs root directory path.
+ */
+//--------------------------------------------------------------------------------------------------
+const char *util_GetSysfsRoot
+(
+    void
+)
+{
+    const char *rootPtr = getenv(SYSFS_ROOT_ENV_VAR);
+
+    if ((rootPtr == NULL) || (rootPtr[0] == '\0'))
+    {
+        return DEFAULT_SYSFS_ROOT;
+    }
+
+    return rootPtr;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Create a handle for a sysfs file that will be read (or written) repeatedly.  Same as
+ * util_OpenFile(), except that the path is relative to the sysfs root (see util_GetSysfsRoot()).
+ *
+ * @return The file handle (never NULL).
+ */
+//--------------------------------------------------------------------------------------------------
+util_FileRef_t util_OpenSysfsFile
+(
+    const char *relativePath,   ///< Path relative to the sysfs root (e.g., "class/power_supply").
+    int flags                   ///< O_RDONLY, O_WRONLY or O_RDWR.
+)
+{
+    char path[PATH_MAX];
+
+    int pathLen = snprintf(path, sizeof(path), "%s/%s", util_GetSysfsRoot(), relativePath);
+    LE_FATAL_IF(pathLen >= sizeof(path), "Path too long: '%s/%s'.",
+                util_GetSysfsRoot(), relativePath);
+
+    return util_OpenFile(path, flags);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Close a file handle created using util_OpenFile().
+ */
+//--------------------------------------------------------------------------------------------------
+void util_CloseFile
+(
+    util_FileRef_t fileRef
+)
+{
+    CloseFd(fileRef);
+    le_mem_Release(fileRef);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the path of the file behind a file handle.
+ *
+ * @return Ptr to the null-terminated path.
+ */
+//--------------------------------------------------------------------------------------------------
+const char *util_GetFilePath
+(
+    util_FileRef_t fileRef
+)
+{
+    return fileRef->path;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Read the raw contents of a file handle (or the recorded contents, if replaying a trace).
+ *
+ * @return Number of bytes read, or -1 on error.
+ */
+//--------------------------------------------------------------------------------------------------
+static ssize_t ReadRaw
+(
+    util_File_t *fileRef,
+    char *value,
+    size_t valueSize
+)
+{
+    uint64_t startNs = GetNs();
+
+    ssize_t numRead;
+    if (util_IsReplaying())
+    {
+        numRead = util_TraceReplay(&fileRef->trace, value, valueSize);
+    }
+    else
+    {
+        numRead = ReadFromStart(fileRef, value, valueSize);
+    }
+
+    util_TraceRecord(&fileRef->trace, value, numRead);
+
+    CountRead(startNs, (numRead >= 0));
+
+    return numRead;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Read an integer from a file handle, parsing it straight out of the read buffer.
+ *
+ * @return
+ *  - LE_OK on success.
+ *  - LE_IO_ERROR if the read failed.
+ *  - LE_OVERFLOW if the file contents are too long, or the integer doesn't fit in an int64_t.
+ *  - LE_FORMAT_ERROR if the file doesn't contain a decimal integer.
+ */
+//--------------------------------------------------------------------------------------------------
+static le_result_t ReadInt64
+(
+    util_File_t *fileRef,
+    char *buffer,
+    size_t bufferSize,
+    int64_t *valuePtr
+)
+{
+    ssize_t numRead = ReadRaw(fileRef, buffer, bufferSize);
+    if (numRead < 0)
+    {
+        return LE_IO_ERROR;
+    }
+
+    // Same as util_ReadStringFromHandle(), a full buffer means the contents may be truncated.
+    if (numRead >= bufferSize)
+    {
+        return LE_OVERFLOW;
+    }
+
+    return ParseInt64(buffer, numRead, valuePtr);
+}
+
+
+le_result_t util_ReadStringFromHandle
+(
+    util_FileRef_t fileRef,
+    char *value,
+    size_t valueSize
+)
+{
+    ssize_t numRead = ReadRaw(fileRef, value, valueSize);
+    if (numRead < 0)
+    {
+        return LE_IO_ERROR;
+    }
+
+    return TerminateString(value, valueSize, numRead);
+}
+
+
+le_result_t util_ReadInt64FromHandle
+(
+    util_FileRef_t fileRef,
+    int64_t *value
+)
+{
+    char buffer[24];
+
+    return ReadInt64(fileRef, buffer, sizeof(buffer), value);
+}
+
+
+le_result_t util_ReadIntFromHandle
+(
+    util_FileRef_t fileRef,
+    int *value
+)
+{
+    char buffer[16];
+    int64_t value64;
+    le_result_t r = ReadInt64(fileRef, buffer, sizeof(buffer), &value64);
+    if (r == LE_OK)
+    {
+        r = NarrowToInt(value64, value);
+    }
+    return r;
+}
+
+
+le_result_t util_ReadDoubleFromHandle
+(
+    util_FileRef_t fileRef,
+    double *value
+)
+{
+    char buffer[32];
+    ssize_t numRead = ReadRaw(fileRef, buffer, sizeof(buffer));
+    if (numRead < 0)
+    {
+        return LE_IO_ERROR;
+    }
+
+    // Same as util_ReadStringFromHandle(), a full buffer means the contents may be truncated.
+    if (numRead >= sizeof(buffer))
+    {
+        return LE_OVERFLOW;
+    }
+
+    return ParseDouble(buffer, numRead, value);
+}
+
+
+le_result_t util_WriteIntToHandle
+(
+    util_FileRef_t fileRef,
+    int value
+)
+{
+    char intStr[12];
+
+    int bytesRequired = snprintf(intStr, sizeof(intStr), "%d", value);
+    LE_ASSERT(bytesRequired < sizeof(intStr));
+
+    // When replaying a trace, the driver files must not be modified.
+    if (util_IsReplaying())
+    {
+        return LE_OK;
+    }
+
+    IoStats.numWrites++;
+
+    if (WriteFromStart(fileRef, intStr, bytesRequired) != bytesRequired)
+    {
+        IoStats.numFailures++;
+        return LE_IO_ERROR;
+    }
+
+    return LE_OK;
+}
+
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the I/O statistics accumulated by all file handles since the process started.
+ */
+//--------------------------------------------------------------------------------------------------
+void util_GetIoStats
+(
+    util_IoStats_t *statsPtr    ///< [OUT]
+)
+{
+    *statsPtr = IoStats;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Read the monotonic clock of the Battery Service.  This is le_clk_GetRelativeTime(), except when
+ * replaying a trace, when the clock follows the recorded time of the values replayed.
+ *
+ * @return The time.
+ */
+//--------------------------------------------------------------------------------------------------
+le_clk_Time_t util_GetRelativeTime
+(
+    void
+)
+{
+    if (util_IsReplaying())
+    {
+        return util_TraceGetTime();
+    }
+
+    return le_clk_GetRelativeTime();
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the time elapsed since a time on the monotonic clock (util_GetRelativeTime()).
+ *
+ * @return Elapsed time in ms.
+ */
+//--------------------------------------------------------------------------------------------------
+uint64_t util_MsSince
+(
+    le_clk_Time_t since
+)
+{
+    le_clk_Time_t elapsed = le_clk_Sub(util_GetRelativeTime(), since);
+
+    if (elapsed.sec < 0)
+    {
+        return 0;
+    }
+
+    return ((uint64_t)elapsed.sec * 1000) + (elapsed.usec / 1000);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the wall-clock time.  When replaying a trace, this follows the recorded time of the values
+ * replayed, like util_GetRelativeTime().
+ *
+ * @return ms since the Epoch.
+ */
+//--------------------------------------------------------------------------------------------------
+uint64_t util_GetEpochMs
+(
+    void
+)
+{
+    if (util_IsReplaying())
+    {
+        return util_TraceGetEpochMs();
+    }
+
+    le_clk_Time_t now = le_clk_GetAbsoluteTime();
+
+    return ((uint64_t)now.sec * 1000) + (now.usec / 1000);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Check whether a value has moved far enough from a reference value to leave a deadband.
+ *
+ * @return true if the value differs from the reference by at least the deadband, or if the
+ *         deadband is zero and the value differs at all.
+ */
+//--------------------------------------------------------------------------------------------------
+bool util_IsOutsideDeadband
+(
+    double value,
+    double reference,
+    double deadband
+)
+{
+    double delta = fabs(value - reference);
+
+    return (delta > 0) && (delta >= deadband);
+}
+
 COMPONENT_INIT
 {
 }
@@ -11,9 +11,47 @@
 
 #include "legato.h"
 
+/// Reference to a file that is kept open for repeated access.
+typedef struct util_File *util_FileRef_t;
+
+/// I/O statistics for the file handles, to put numbers on the cost of sampling the drivers.
+typedef struct
+{
+    uint64_t numReads;      ///< Reads through file handles.
+    uint64_t numWrites;     ///< Writes through file handles.
+    uint64_t numSyscalls;   ///< open(), close(), pread() and pwrite() calls made by them.
+    uint64_t numFailures;   ///< Reads and writes that failed.
+    uint64_t readNs;        ///< Total time spent in reads (ns).
+}
+util_IoStats_t;
+
+/// Handler for power_supply uevents.  supplyName is the name of the supply that sent the event.
+typedef void (*util_PowerSupplyEventHandlerFunc_t)(const char *supplyName, void *contextPtr);
+
 LE_SHARED le_result_t util_ReadIntFromFile(const char *filePath, int *value);
 LE_SHARED le_result_t util_ReadDoubleFromFile(const char *filePath, double *value);
 LE_SHARED le_result_t util_ReadStringFromFile(const char *filePath, char *value, size_t valueSize);
 LE_SHARED le_result_t util_WriteIntToFile(const char *filepath, int value);
 
+LE_SHARED const char *util_GetSysfsRoot(void);
+LE_SHARED util_FileRef_t util_OpenFile(const char *filePath, int flags);
+LE_SHARED util_FileRef_t util_OpenSysfsFile(const char *relativePath, int flags);
+LE_SHARED void util_CloseFile(util_FileRef_t fileRef);
+LE_SHARED const char *util_GetFilePath(util_FileRef_t fileRef);
+LE_SHARED le_result_t util_ReadIntFromHandle(util_FileRef_t fileRef, int *value);
+LE_SHARED le_result_t util_ReadInt64FromHandle(util_FileRef_t fileRef, int64_t *value);
+LE_SHARED le_result_t util_ReadDoubleFromHandle(util_FileRef_t fileRef, double *value);
+LE_SHARED le_result_t util_ReadStringFromHandle(util_FileRef_t fileRef, char *value,
+                                                size_t valueSize);
+LE_SHARED le_result_t util_WriteIntToHandle(util_FileRef_t fileRef, int value);
+LE_SHARED void util_GetIoStats(util_IoStats_t *statsPtr);
+
+LE_SHARED le_clk_Time_t util_GetRelativeTime(void);
+LE_SHARED uint64_t util_MsSince(le_clk_Time_t since);
+LE_SHARED uint64_t util_GetEpochMs(void);
+LE_SHARED bool util_IsOutsideDeadband(double value, double reference, double deadband);
+
+LE_SHARED le_result_t util_AddPowerSupplyEventHandler(util_PowerSupplyEventHandlerFunc_t handler,
+                                                      void *contextPtr);
+
 #endif // BATTERY_UTILS_H
@@ -0,0 +1,201 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file history.c
+ *
+ * Fixed-size, preallocated history of battery samples, used by the Battery Service.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#include "legato.h"
+#include "history.h"
+#include "batteryUtils.h"
+#include <math.h>
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Round a value to the nearest integer, clamped to a range.
+ */
+//--------------------------------------------------------------------------------------------------
+static long Clamp
+(
+    double value,
+    long min,
+    long max
+)
+{
+    if (isnan(value))
+    {
+        return 0;
+    }
+    if (value <= min)
+    {
+        return min;
+    }
+    if (value >= max)
+    {
+        return max;
+    }
+    return lround(value);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the i-th oldest sample in the history.
+ */
+//--------------------------------------------------------------------------------------------------
+static const util_HistorySample_t *GetSample
+(
+    const util_History_t *historyPtr,
+    size_t i    ///< 0 = oldest, count - 1 = newest.
+)
+{
+    return &historyPtr->samples[   (historyPtr->next + UTIL_HISTORY_SIZE - historyPtr->count + i)
+                                % UTIL_HISTORY_SIZE];
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Copy a sample into element i of each of the output arrays.
+ */
+//--------------------------------------------------------------------------------------------------
+static void CopySample
+(
+    const util_HistorySample_t *samplePtr,
+    const util_HistoryColumns_t *columnsPtr,
+    size_t i
+)
+{
+    columnsPtr->timestampPtr[i] = samplePtr->timestamp;
+    columnsPtr->percentPtr[i] = samplePtr->percentage;
+    columnsPtr->chargePtr[i] = samplePtr->charge;
+    columnsPtr->currentPtr[i] = ((double)samplePtr->current) / 1000.0;
+    columnsPtr->voltagePtr[i] = ((double)samplePtr->voltage) / 1000.0;
+    columnsPtr->tempPtr[i] = ((double)samplePtr->temperature) / 100.0;
+    columnsPtr->chargingStatusPtr[i] = samplePtr->chargingStatus;
+    columnsPtr->healthPtr[i] = samplePtr->health;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Initialize an empty history.
+ */
+//--------------------------------------------------------------------------------------------------
+void util_InitHistory
+(
+    util_History_t *historyPtr
+)
+{
+    historyPtr->next = 0;
+    historyPtr->count = 0;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Add a sample to the history, time-stamped with when its values were read.  If the history is full, the oldest sample is
+ * discarded.
+ */
+//--------------------------------------------------------------------------------------------------
+void util_AddHistorySample
+(
+    util_History_t *historyPtr,
+    uint64_t timestamp,         ///< When the values were read (ms since the Epoch).
+    uint8_t health,             ///< ma_battery_HealthStatus_t
+    uint8_t chargingStatus,     ///< ma_battery_ChargingStatus_t
+    unsigned int percentage,
+    unsigned int charge,        ///< mAh
+    double current,             ///< mA
+    double voltage,             ///< V
+    double temperature          ///< degrees C
+)
+{
+    util_HistorySample_t *samplePtr = &historyPtr->samples[historyPtr->next];
+    samplePtr->timestamp = timestamp;
+    samplePtr->current = Clamp(current * 1000.0, INT32_MIN, INT32_MAX);
+    samplePtr->voltage = Clamp(voltage * 1000.0, 0, UINT16_MAX);
+    samplePtr->temperature = Clamp(temperature * 100.0, INT16_MIN, INT16_MAX);
+    samplePtr->charge = (charge > UINT16_MAX) ? UINT16_MAX : charge;
+    samplePtr->percentage = (percentage > UINT8_MAX) ? UINT8_MAX : percentage;
+    samplePtr->chargingStatus = chargingStatus;
+    samplePtr->health = health;
+
+    historyPtr->next = (historyPtr->next + 1) % UTIL_HISTORY_SIZE;
+    if (historyPtr->count < UTIL_HISTORY_SIZE)
+    {
+        historyPtr->count++;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Copy the samples time-stamped in a range out of the history, oldest first.
+ *
+ * @return The number of samples copied.
+ */
+//--------------------------------------------------------------------------------------------------
+size_t util_GetHistoryRange
+(
+    const util_History_t *historyPtr,
+    uint64_t startTime,             ///< ms since the Epoch (inclusive).
+    uint64_t endTime,               ///< ms since the Epoch (inclusive).
+    const util_HistoryColumns_t *columnsPtr,
+    size_t maxCount,                ///< Number of elements in each of the output arrays.
+    bool *isMorePtr                 ///< [OUT] true if there were more samples in the range than
+                                    ///<       could be copied.
+)
+{
+    size_t numCopied = 0;
+
+    *isMorePtr = false;
+
+    // The wall clock can be set backwards, so the timestamps aren't necessarily in order.
+    for (size_t i = 0; i < historyPtr->count; i++)
+    {
+        const util_HistorySample_t *samplePtr = GetSample(historyPtr, i);
+
+        if ((samplePtr->timestamp >= startTime) && (samplePtr->timestamp <= endTime))
+        {
+            if (numCopied >= maxCount)
+            {
+                *isMorePtr = true;
+                break;
+            }
+
+            CopySample(samplePtr, columnsPtr, numCopied);
+            numCopied++;
+        }
+    }
+
+    return numCopied;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Copy the most recent samples out of the history, oldest first.
+ *
+ * @return The number of samples copied.
+ */
+//--------------------------------------------------------------------------------------------------
+size_t util_GetRecentHistory
+(
+    const util_History_t *historyPtr,
+    const util_HistoryColumns_t *columnsPtr,
+    size_t maxCount                 ///< Number of elements in each of the output arrays.
+)
+{
+    size_t count = (historyPtr->count < maxCount) ? historyPtr->count : maxCount;
+    size_t first = historyPtr->count - count;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        CopySample(GetSample(historyPtr, first + i), columnsPtr, i);
+    }
+
+    return count;
+}
@@ -0,0 +1,69 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file history.h
+ *
+ * Fixed-size, preallocated history of battery samples, used by the Battery Service.
+ *
+ * Samples are stored in a compact form in a ring buffer, so the oldest sample is overwritten once
+ * the buffer is full.  Queries copy samples out, oldest first, into separate arrays (one per
+ * field), matching the layout of the history functions in the ma_battery API.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "legato.h"
+
+/// Number of samples kept in the history.
+#define UTIL_HISTORY_SIZE 1024
+
+/// A battery sample, as stored in the history.
+typedef struct
+{
+    uint64_t timestamp;         ///< ms since the Epoch.
+    int32_t current;            ///< uA.
+    uint16_t voltage;           ///< mV.
+    int16_t temperature;        ///< Hundredths of a degree C.
+    uint16_t charge;            ///< mAh.
+    uint8_t percentage;
+    uint8_t chargingStatus;     ///< ma_battery_ChargingStatus_t
+    uint8_t health;             ///< ma_battery_HealthStatus_t
+}
+util_HistorySample_t;
+
+/// The history.
+typedef struct
+{
+    util_HistorySample_t samples[UTIL_HISTORY_SIZE];
+    size_t next;                ///< Index of the slot the next sample will be stored in.
+    size_t count;               ///< Number of samples stored.
+}
+util_History_t;
+
+/// Arrays to copy samples into.  Element i of each array holds a field of the i-th sample.
+typedef struct
+{
+    uint64_t *timestampPtr;     ///< ms since the Epoch.
+    uint8_t *percentPtr;
+    uint16_t *chargePtr;        ///< mAh.
+    double *currentPtr;         ///< mA.
+    double *voltagePtr;         ///< V.
+    double *tempPtr;            ///< degrees C.
+    uint8_t *chargingStatusPtr;
+    uint8_t *healthPtr;
+}
+util_HistoryColumns_t;
+
+LE_SHARED void util_InitHistory(util_History_t *historyPtr);
+LE_SHARED void util_AddHistorySample(util_History_t *historyPtr, uint64_t timestamp,
+                                     uint8_t health, uint8_t chargingStatus, unsigned int percentage,
+                                     unsigned int charge, double current, double voltage,
+                                     double temperature);
+LE_SHARED size_t util_GetHistoryRange(const util_History_t *historyPtr, uint64_t startTime,
+                                      uint64_t endTime, const util_HistoryColumns_t *columnsPtr,
+                                      size_t maxCount, bool *isMorePtr);
+LE_SHARED size_t util_GetRecentHistory(const util_History_t *historyPtr,
+                                       const util_HistoryColumns_t *columnsPtr, size_t maxCount);
+
+#endif // HISTORY_H
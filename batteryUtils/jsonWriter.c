@@ -0,0 +1,428 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file jsonWriter.c
+ *
+ * Minimal JSON object writer used by the Battery Service to build Data Hub values.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#include "legato.h"
+#include "jsonWriter.h"
+#include <math.h>
+
+/// Largest number of decimal places supported by util_JsonAddFixed().
+#define MAX_DECIMALS 9
+
+/// Powers of ten up to 10^MAX_DECIMALS.
+static const int64_t PowersOfTen[MAX_DECIMALS + 1] =
+{
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Append characters to the document.  Whatever doesn't fit in the buffer is only counted.
+ */
+//--------------------------------------------------------------------------------------------------
+static void Append
+(
+    util_JsonWriter_t *writerPtr,
+    const char *charsPtr,
+    size_t numChars
+)
+{
+    // One byte of the buffer is always reserved for the null terminator.
+    if (writerPtr->len + 1 < writerPtr->size)
+    {
+        size_t room = writerPtr->size - 1 - writerPtr->len;
+        memcpy(writerPtr->bufferPtr + writerPtr->len, charsPtr, (numChars < room) ? numChars : room);
+    }
+
+    writerPtr->len += numChars;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Append a single character to the document.
+ */
+//--------------------------------------------------------------------------------------------------
+static void AppendChar
+(
+    util_JsonWriter_t *writerPtr,
+    char c
+)
+{
+    Append(writerPtr, &c, 1);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Append a quoted, escaped JSON string to the document.
+ */
+//--------------------------------------------------------------------------------------------------
+static void AppendString
+(
+    util_JsonWriter_t *writerPtr,
+    const char *str
+)
+{
+    static const char hexDigits[] = "0123456789abcdef";
+
+    AppendChar(writerPtr, '"');
+
+    const char *runPtr = str;
+    for (const char *charPtr = str; *charPtr != '\0'; charPtr++)
+    {
+        unsigned char c = *charPtr;
+
+        if ((c == '"') || (c == '\\') || (c < 0x20))
+        {
+            Append(writerPtr, runPtr, charPtr - runPtr);
+            runPtr = charPtr + 1;
+
+            if (c < 0x20)
+            {
+                char escape[6] = { '\\', 'u', '0', '0', hexDigits[c >> 4], hexDigits[c & 0xF] };
+                Append(writerPtr, escape, sizeof(escape));
+            }
+            else
+            {
+                char escape[2] = { '\\', c };
+                Append(writerPtr, escape, sizeof(escape));
+            }
+        }
+    }
+    Append(writerPtr, runPtr, strlen(runPtr));
+
+    AppendChar(writerPtr, '"');
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Append the separator (if needed) and the key of an object member.
+ */
+//--------------------------------------------------------------------------------------------------
+static void AppendKey
+(
+    util_JsonWriter_t *writerPtr,
+    const char *key
+)
+{
+    if (!writerPtr->isFirstMember)
+    {
+        AppendChar(writerPtr, ',');
+    }
+    writerPtr->isFirstMember = false;
+
+    AppendString(writerPtr, key);
+    AppendChar(writerPtr, ':');
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Append a fixed-point number, +/- magnitude / 10^decimals, to the document.
+ */
+//--------------------------------------------------------------------------------------------------
+static void AppendFixedMagnitude
+(
+    util_JsonWriter_t *writerPtr,
+    bool isNegative,
+    uint64_t magnitude,
+    unsigned int decimals
+)
+{
+    // Enough for a sign, 20 digits and a decimal point.
+    char digits[24];
+    char *endPtr = digits + sizeof(digits);
+    char *startPtr = endPtr;
+
+    unsigned int numDigits = 0;
+    do
+    {
+        if ((numDigits == decimals) && (decimals > 0))
+        {
+            *(--startPtr) = '.';
+        }
+        *(--startPtr) = '0' + (magnitude % 10);
+        magnitude /= 10;
+        numDigits++;
+    }
+    while ((magnitude != 0) || (numDigits <= decimals));
+
+    if (isNegative)
+    {
+        *(--startPtr) = '-';
+    }
+
+    Append(writerPtr, startPtr, endPtr - startPtr);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Append a fixed-point number, value / 10^decimals, to the document.
+ */
+//--------------------------------------------------------------------------------------------------
+static void AppendFixed
+(
+    util_JsonWriter_t *writerPtr,
+    int64_t value,
+    unsigned int decimals
+)
+{
+    // Work with the magnitude as unsigned to handle INT64_MIN.
+    AppendFixedMagnitude(writerPtr,
+                         (value < 0),
+                         (value < 0) ? (0 - (uint64_t)value) : (uint64_t)value,
+                         decimals);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Round magnitude * 10^decimals to an integer the way printf() does: to the nearest, with exact
+ * ties to even, according to the exact binary value of magnitude.  Rounding the product instead
+ * would get e.g. 0.2845 (really 0.28449999999999997513...) wrong to 3 places.
+ *
+ * @return The rounded value.
+ */
+//--------------------------------------------------------------------------------------------------
+static uint64_t RoundScaled
+(
+    double magnitude,           ///< Finite, >= 0, and with magnitude * 10^decimals < 9.0e18.
+    unsigned int decimals
+)
+{
+    double scale = (double)PowersOfTen[decimals];
+    double scaled = magnitude * scale;
+
+    // From 2^52 up, the product is an integer.
+    if (scaled >= 4503599627370496.0)
+    {
+        return (uint64_t)scaled;
+    }
+
+    // fma() gives the sign of the exact difference between the product and a nearby value.
+    double lower = floor(scaled);
+    if (fma(magnitude, scale, -lower) < 0.0)
+    {
+        lower -= 1.0;
+    }
+    double excess = fma(magnitude, scale, -(lower + 0.5));
+
+    uint64_t result = (uint64_t)lower;
+    if ((excess > 0.0) || ((excess == 0.0) && ((result & 1) != 0)))
+    {
+        result++;
+    }
+
+    return result;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Start writing a JSON object into a buffer.
+ */
+//--------------------------------------------------------------------------------------------------
+void util_JsonBegin
+(
+    util_JsonWriter_t *writerPtr,
+    char *bufferPtr,    ///< Output buffer, or NULL to only compute the length.
+    size_t size         ///< Size of the output buffer (bytes), or 0.
+)
+{
+    writerPtr->bufferPtr = bufferPtr;
+    writerPtr->size = (bufferPtr == NULL) ? 0 : size;
+    writerPtr->len = 0;
+    writerPtr->isFirstMember = true;
+
+    AppendChar(writerPtr, '{');
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Add a string member to the object.
+ */
+//--------------------------------------------------------------------------------------------------
+void util_JsonAddString
+(
+    util_JsonWriter_t *writerPtr,
+    const char *key,
+    const char *value
+)
+{
+    AppendKey(writerPtr, key);
+    AppendString(writerPtr, value);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Add a boolean member to the object.
+ */
+//--------------------------------------------------------------------------------------------------
+void util_JsonAddBool
+(
+    util_JsonWriter_t *writerPtr,
+    const char *key,
+    bool value
+)
+{
+    AppendKey(writerPtr, key);
+    if (value)
+    {
+        Append(writerPtr, "true", 4);
+    }
+    else
+    {
+        Append(writerPtr, "false", 5);
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Add an integer member to the object.
+ */
+//--------------------------------------------------------------------------------------------------
+void util_JsonAddInt
+(
+    util_JsonWriter_t *writerPtr,
+    const char *key,
+    int64_t value
+)
+{
+    AppendKey(writerPtr, key);
+    AppendFixed(writerPtr, value, 0);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Add a fixed-point number member to the object.  The number written is value / 10^decimals,
+ * with exactly "decimals" digits after the decimal point.  E.g., (3712, 3) is written as 3.712.
+ */
+//--------------------------------------------------------------------------------------------------
+void util_JsonAddFixed
+(
+    util_JsonWriter_t *writerPtr,
+    const char *key,
+    int64_t value,
+    unsigned int decimals   ///< Number of decimal places (at most 9).
+)
+{
+    LE_ASSERT(decimals <= MAX_DECIMALS);
+
+    AppendKey(writerPtr, key);
+    AppendFixed(writerPtr, value, decimals);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Add a floating point number member to the object, rounded to a number of decimal places.
+ * This is equivalent to "%.<decimals>lf" in the "C" locale, but without using stdio.  Values that
+ * can't be represented in JSON (NaN or infinity) or that are too large are written as null.
+ */
+//--------------------------------------------------------------------------------------------------
+void util_JsonAddDecimal
+(
+    util_JsonWriter_t *writerPtr,
+    const char *key,
+    double value,
+    unsigned int decimals   ///< Number of decimal places (at most 9).
+)
+{
+    LE_ASSERT(decimals <= MAX_DECIMALS);
+
+    AppendKey(writerPtr, key);
+
+    double scaled = value * (double)PowersOfTen[decimals];
+    if (isfinite(scaled) && (fabs(scaled) < 9.0e18))
+    {
+        // Like printf(), a negative value that rounds to 0 keeps its sign (e.g., -0.00).
+        AppendFixedMagnitude(writerPtr, signbit(value), RoundScaled(fabs(value), decimals),
+                             decimals);
+    }
+    else
+    {
+        Append(writerPtr, "null", 4);
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Add an array of fixed-point numbers member to the object.  Each element is written as by
+ * util_JsonAddFixed().
+ */
+//--------------------------------------------------------------------------------------------------
+void util_JsonAddFixedArray
+(
+    util_JsonWriter_t *writerPtr,
+    const char *key,
+    const int32_t *valuesPtr,
+    size_t count,
+    unsigned int decimals   ///< Number of decimal places (at most 9).
+)
+{
+    LE_ASSERT(decimals <= MAX_DECIMALS);
+
+    AppendKey(writerPtr, key);
+    AppendChar(writerPtr, '[');
+    for (size_t i = 0; i < count; i++)
+    {
+        if (i > 0)
+        {
+            AppendChar(writerPtr, ',');
+        }
+        AppendFixed(writerPtr, valuesPtr[i], decimals);
+    }
+    AppendChar(writerPtr, ']');
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Finish writing the JSON object and null-terminate the buffer.
+ *
+ * @return
+ *  - LE_OK if the document fit in the buffer.
+ *  - LE_OVERFLOW if it didn't (the buffer then holds a truncated, null-terminated document).
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t util_JsonEnd
+(
+    util_JsonWriter_t *writerPtr,
+    size_t *lenPtr      ///< [OUT] Exact length of the document, excluding the terminator.  May be
+                        ///<       NULL.
+)
+{
+    AppendChar(writerPtr, '}');
+
+    if (lenPtr != NULL)
+    {
+        *lenPtr = writerPtr->len;
+    }
+
+    if (writerPtr->size == 0)
+    {
+        return LE_OVERFLOW;
+    }
+
+    if (writerPtr->len < writerPtr->size)
+    {
+        writerPtr->bufferPtr[writerPtr->len] = '\0';
+        return LE_OK;
+    }
+
+    writerPtr->bufferPtr[writerPtr->size - 1] = '\0';
+    return LE_OVERFLOW;
+}
@@ -0,0 +1,43 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file jsonWriter.h
+ *
+ * Minimal JSON object writer used by the Battery Service to build Data Hub values.
+ *
+ * Numbers are formatted from integers (fixed-point for fractional values), so no heap
+ * allocation, stdio or locale-dependent float formatting is involved.  The writer always counts
+ * the full length of the document, even if it doesn't fit in the buffer, so a pass with a zero
+ * size buffer computes the exact size required.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include "legato.h"
+
+/// State of a JSON object being written.  Treat as opaque.
+typedef struct
+{
+    char *bufferPtr;    ///< Output buffer (may be NULL if size is 0).
+    size_t size;        ///< Size of the output buffer (bytes).
+    size_t len;         ///< Length of the document so far, including anything that didn't fit.
+    bool isFirstMember; ///< true until the first member has been written.
+}
+util_JsonWriter_t;
+
+LE_SHARED void util_JsonBegin(util_JsonWriter_t *writerPtr, char *bufferPtr, size_t size);
+LE_SHARED void util_JsonAddString(util_JsonWriter_t *writerPtr, const char *key,
+                                  const char *value);
+LE_SHARED void util_JsonAddBool(util_JsonWriter_t *writerPtr, const char *key, bool value);
+LE_SHARED void util_JsonAddInt(util_JsonWriter_t *writerPtr, const char *key, int64_t value);
+LE_SHARED void util_JsonAddFixed(util_JsonWriter_t *writerPtr, const char *key, int64_t value,
+                                 unsigned int decimals);
+LE_SHARED void util_JsonAddDecimal(util_JsonWriter_t *writerPtr, const char *key, double value,
+                                   unsigned int decimals);
+LE_SHARED void util_JsonAddFixedArray(util_JsonWriter_t *writerPtr, const char *key,
+                                      const int32_t *valuesPtr, size_t count,
+                                      unsigned int decimals);
+LE_SHARED le_result_t util_JsonEnd(util_JsonWriter_t *writerPtr, size_t *lenPtr);
+
+#endif // JSON_WRITER_H
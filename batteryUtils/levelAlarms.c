@@ -0,0 +1,220 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file levelAlarms.c
+ *
+ * Index of battery level percentage alarm registrations, used by the Battery Service.
+ *
+ * An alarm fires when the level is above its high threshold (or below its low threshold) and the
+ * last alarm it reported was not already of that type.  Since lastAlarmType only changes when an
+ * alarm fires, once a registration has been evaluated it can only fire again after the level
+ * crosses one of its thresholds.  So a check from percentage "old" to "new" only needs to visit:
+ *
+ *  - the high buckets in [old, new) when the level rises,
+ *  - the low buckets in (new, old] when the level falls,
+ *  - the registrations that have never been evaluated.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#include "legato.h"
+#include "levelAlarms.h"
+
+static const le_dls_List_t EmptyList = LE_DLS_LIST_INIT;
+static const le_dls_Link_t UnlinkedLink = LE_DLS_LINK_INIT;
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Evaluate one alarm registration against a percentage and call the alarm function if it fires.
+ */
+//--------------------------------------------------------------------------------------------------
+static void EvaluateAlarm
+(
+    util_LevelAlarm_t *alarmPtr,
+    uint8_t percentage,
+    util_LevelAlarmFunc_t func
+)
+{
+    if ((percentage > alarmPtr->percentageHigh) && (alarmPtr->lastAlarmType != UTIL_LEVEL_HIGH))
+    {
+        alarmPtr->lastAlarmType = UTIL_LEVEL_HIGH;
+        func(alarmPtr, percentage, true);
+    }
+    else if ((percentage < alarmPtr->percentageLow) && (alarmPtr->lastAlarmType != UTIL_LEVEL_LOW))
+    {
+        alarmPtr->lastAlarmType = UTIL_LEVEL_LOW;
+        func(alarmPtr, percentage, false);
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Initialize an empty level alarm index.
+ */
+//--------------------------------------------------------------------------------------------------
+void util_InitLevelAlarmIndex
+(
+    util_LevelAlarmIndex_t *indexPtr
+)
+{
+    for (int i = 0; i < UTIL_NUM_PERCENT_LEVELS; i++)
+    {
+        indexPtr->lowBuckets[i] = EmptyList;
+        indexPtr->highBuckets[i] = EmptyList;
+    }
+    indexPtr->pendingList = EmptyList;
+    indexPtr->lastPercentage = -1;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Add an alarm registration to the index.  It is evaluated at the next util_CheckLevelAlarms().
+ *
+ * @warning percentageLow <= percentageHigh <= 100 must be checked by the caller.
+ */
+//--------------------------------------------------------------------------------------------------
+void util_AddLevelAlarm
+(
+    util_LevelAlarmIndex_t *indexPtr,
+    util_LevelAlarm_t *alarmPtr,
+    uint8_t percentageLow,
+    uint8_t percentageHigh
+)
+{
+    LE_ASSERT((percentageLow <= percentageHigh) && (percentageHigh < UTIL_NUM_PERCENT_LEVELS));
+
+    alarmPtr->percentageLow = percentageLow;
+    alarmPtr->percentageHigh = percentageHigh;
+    alarmPtr->lastAlarmType = UTIL_LEVEL_NONE;
+    alarmPtr->lowLink = UnlinkedLink;
+    alarmPtr->highLink = UnlinkedLink;
+    alarmPtr->pendingLink = UnlinkedLink;
+
+    le_dls_Queue(&indexPtr->lowBuckets[percentageLow], &alarmPtr->lowLink);
+    le_dls_Queue(&indexPtr->highBuckets[percentageHigh], &alarmPtr->highLink);
+    le_dls_Queue(&indexPtr->pendingList, &alarmPtr->pendingLink);
+    alarmPtr->isPending = true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Remove an alarm registration from the index.
+ */
+//--------------------------------------------------------------------------------------------------
+void util_RemoveLevelAlarm
+(
+    util_LevelAlarmIndex_t *indexPtr,
+    util_LevelAlarm_t *alarmPtr
+)
+{
+    le_dls_Remove(&indexPtr->lowBuckets[alarmPtr->percentageLow], &alarmPtr->lowLink);
+    le_dls_Remove(&indexPtr->highBuckets[alarmPtr->percentageHigh], &alarmPtr->highLink);
+    if (alarmPtr->isPending)
+    {
+        le_dls_Remove(&indexPtr->pendingList, &alarmPtr->pendingLink);
+        alarmPtr->isPending = false;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Check the alarm registrations against a new percentage, calling func for each one that fires.
+ */
+//--------------------------------------------------------------------------------------------------
+void util_CheckLevelAlarms
+(
+    util_LevelAlarmIndex_t *indexPtr,
+    uint8_t percentage,
+    util_LevelAlarmFunc_t func
+)
+{
+    if (percentage >= UTIL_NUM_PERCENT_LEVELS)
+    {
+        percentage = UTIL_NUM_PERCENT_LEVELS - 1;
+    }
+
+    int oldPercentage = indexPtr->lastPercentage;
+    indexPtr->lastPercentage = percentage;
+
+    if ((oldPercentage >= 0) && (percentage > oldPercentage))
+    {
+        // Level rose above the high thresholds in [oldPercentage, percentage).
+        for (int level = oldPercentage; level < percentage; level++)
+        {
+            le_dls_Link_t *linkPtr = le_dls_Peek(&indexPtr->highBuckets[level]);
+            while (linkPtr != NULL)
+            {
+                util_LevelAlarm_t *alarmPtr = CONTAINER_OF(linkPtr, util_LevelAlarm_t, highLink);
+                linkPtr = le_dls_PeekNext(&indexPtr->highBuckets[level], linkPtr);
+
+                EvaluateAlarm(alarmPtr, percentage, func);
+            }
+        }
+    }
+    else if ((oldPercentage >= 0) && (percentage < oldPercentage))
+    {
+        // Level fell below the low thresholds in (percentage, oldPercentage].
+        for (int level = oldPercentage; level > percentage; level--)
+        {
+            le_dls_Link_t *linkPtr = le_dls_Peek(&indexPtr->lowBuckets[level]);
+            while (linkPtr != NULL)
+            {
+                util_LevelAlarm_t *alarmPtr = CONTAINER_OF(linkPtr, util_LevelAlarm_t, lowLink);
+                linkPtr = le_dls_PeekNext(&indexPtr->lowBuckets[level], linkPtr);
+
+                EvaluateAlarm(alarmPtr, percentage, func);
+            }
+        }
+    }
+
+    // Evaluate the registrations added since the last check.
+    le_dls_Link_t *linkPtr;
+    while ((linkPtr = le_dls_Pop(&indexPtr->pendingList)) != NULL)
+    {
+        util_LevelAlarm_t *alarmPtr = CONTAINER_OF(linkPtr, util_LevelAlarm_t, pendingLink);
+        alarmPtr->isPending = false;
+
+        EvaluateAlarm(alarmPtr, percentage, func);
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Check whether any alarm registration has a threshold within a given distance of a percentage.
+ *
+ * A low threshold of 0% or a high threshold of 100% can never be crossed, and is what a client
+ * registers when it only wants the other alarm, so those are ignored.
+ *
+ * @return true if a low or high threshold lies in [percentage - distance, percentage + distance].
+ */
+//--------------------------------------------------------------------------------------------------
+bool util_IsNearLevelAlarm
+(
+    const util_LevelAlarmIndex_t *indexPtr,
+    int percentage,
+    int distance
+)
+{
+    int first = (percentage - distance < 0) ? 0 : percentage - distance;
+    int last = (percentage + distance >= UTIL_NUM_PERCENT_LEVELS) ?
+                   UTIL_NUM_PERCENT_LEVELS - 1 : percentage + distance;
+
+    for (int level = first; level <= last; level++)
+    {
+        if ((level > 0) && !le_dls_IsEmpty(&indexPtr->lowBuckets[level]))
+        {
+            return true;
+        }
+
+        if ((level < UTIL_NUM_PERCENT_LEVELS - 1) && !le_dls_IsEmpty(&indexPtr->highBuckets[level]))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,66 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file levelAlarms.h
+ *
+ * Index of battery level percentage alarm registrations, used by the Battery Service.
+ *
+ * Registrations are kept in buckets indexed by their low and high thresholds, and the last
+ * evaluated percentage is cached.  A check then only visits the registrations whose thresholds
+ * were crossed since the previous check, plus any registrations added since then.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#ifndef LEVEL_ALARMS_H
+#define LEVEL_ALARMS_H
+
+#include "legato.h"
+
+/// Number of distinct percentage thresholds (0 to 100 inclusive).
+#define UTIL_NUM_PERCENT_LEVELS 101
+
+/// Enumeration of possible types of alarm.
+typedef enum
+{
+    UTIL_LEVEL_HIGH, ///< Level was higher than high alarm threshold.
+    UTIL_LEVEL_LOW,  ///< Level was lower that low alarm threshold.
+    UTIL_LEVEL_NONE, ///< No alarm.
+}
+util_LevelAlarmType_t;
+
+/// A level alarm registration.  Embed this in the registration record.
+typedef struct
+{
+    uint8_t percentageHigh;
+    uint8_t percentageLow;
+    util_LevelAlarmType_t lastAlarmType;
+    bool isPending;             ///< true if not evaluated since being added.
+    le_dls_Link_t lowLink;      ///< Link in the low threshold bucket.
+    le_dls_Link_t highLink;     ///< Link in the high threshold bucket.
+    le_dls_Link_t pendingLink;  ///< Link in the pending list, if isPending.
+}
+util_LevelAlarm_t;
+
+/// The index of level alarm registrations.
+typedef struct
+{
+    le_dls_List_t lowBuckets[UTIL_NUM_PERCENT_LEVELS];
+    le_dls_List_t highBuckets[UTIL_NUM_PERCENT_LEVELS];
+    le_dls_List_t pendingList;
+    int lastPercentage;         ///< Percentage of the last check, or -1 if never checked.
+}
+util_LevelAlarmIndex_t;
+
+/// Called for each alarm that fires.  isHigh is true if the level went above percentageHigh.
+typedef void (*util_LevelAlarmFunc_t)(util_LevelAlarm_t *alarmPtr, uint8_t percentage, bool isHigh);
+
+LE_SHARED void util_InitLevelAlarmIndex(util_LevelAlarmIndex_t *indexPtr);
+LE_SHARED void util_AddLevelAlarm(util_LevelAlarmIndex_t *indexPtr, util_LevelAlarm_t *alarmPtr,
+                                  uint8_t percentageLow, uint8_t percentageHigh);
+LE_SHARED void util_RemoveLevelAlarm(util_LevelAlarmIndex_t *indexPtr,
+                                     util_LevelAlarm_t *alarmPtr);
+LE_SHARED void util_CheckLevelAlarms(util_LevelAlarmIndex_t *indexPtr, uint8_t percentage,
+                                     util_LevelAlarmFunc_t func);
+LE_SHARED bool util_IsNearLevelAlarm(const util_LevelAlarmIndex_t *indexPtr, int percentage,
+                                     int distance);
+
+#endif // LEVEL_ALARMS_H
@@ -0,0 +1,111 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file ocvTable.c
+ *
+ * Open-circuit voltage to state-of-charge tables, used by the Battery Service.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#include "legato.h"
+#include "ocvTable.h"
+
+/// Uncertainty of a rest voltage measurement, including incomplete relaxation (V).
+#define REST_VOLTAGE_UNCERTAINTY 0.01
+
+/// Smallest uncertainty of a charge level derived from the rest voltage, as a fraction of capacity.
+#define MIN_REST_UNCERTAINTY 0.02
+
+/// Lithium polymer (LiCoO2) cell at 0%, 5%, ... 100% charge.
+static const double LiPoVoltages[] =
+{
+    3.27, 3.61, 3.69, 3.71, 3.73, 3.75, 3.77, 3.79, 3.80, 3.82, 3.84,
+    3.85, 3.87, 3.91, 3.95, 3.98, 4.02, 4.08, 4.11, 4.15, 4.20
+};
+
+/// Lithium ion (NMC) cell at 0%, 5%, ... 100% charge.
+static const double LiIonVoltages[] =
+{
+    3.00, 3.30, 3.45, 3.53, 3.58, 3.62, 3.65, 3.68, 3.70, 3.72, 3.75,
+    3.78, 3.81, 3.84, 3.88, 3.92, 3.96, 4.00, 4.05, 4.11, 4.18
+};
+
+/// The tables, by battery technology name (as set in the "tech" Data Hub resource).
+static const util_OcvTable_t Tables[] =
+{
+    { "LiPo",  LiPoVoltages,  NUM_ARRAY_MEMBERS(LiPoVoltages) },
+    { "LiIon", LiIonVoltages, NUM_ARRAY_MEMBERS(LiIonVoltages) },
+};
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the open-circuit voltage table for a battery technology.
+ *
+ * @return The table, or NULL if there is none for the technology.
+ */
+//--------------------------------------------------------------------------------------------------
+const util_OcvTable_t *util_GetOcvTable
+(
+    const char *tech    ///< Battery technology name (e.g., "LiPo").
+)
+{
+    for (size_t i = 0; i < NUM_ARRAY_MEMBERS(Tables); i++)
+    {
+        if (strcmp(tech, Tables[i].tech) == 0)
+        {
+            return &Tables[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the charge level implied by an open-circuit voltage.  The uncertainty is larger where the
+ * voltage curve is flat, since a small voltage error then covers a large range of charge.
+ */
+//--------------------------------------------------------------------------------------------------
+void util_GetOcvCharge
+(
+    const util_OcvTable_t *tablePtr,
+    double capacity,            ///< mAh
+    double voltage,             ///< V
+    double *chargePtr,          ///< [OUT] mAh, within [0, capacity].
+    double *uncertaintyPtr      ///< [OUT] mAh
+)
+{
+    const double *voltagesPtr = tablePtr->voltagesPtr;
+    size_t numSteps = tablePtr->numPoints - 1;
+
+    // Find the segment of the curve containing the voltage.
+    size_t i = 0;
+    while ((i < numSteps - 1) && (voltage > voltagesPtr[i + 1]))
+    {
+        i++;
+    }
+
+    double segmentCharge = capacity / numSteps;
+    double segmentVoltage = voltagesPtr[i + 1] - voltagesPtr[i];
+    double fraction = (voltage - voltagesPtr[i]) / segmentVoltage;
+    double charge = (i + fraction) * segmentCharge;
+
+    if (charge < 0)
+    {
+        charge = 0;
+    }
+    else if (charge > capacity)
+    {
+        charge = capacity;
+    }
+
+    double uncertainty = REST_VOLTAGE_UNCERTAINTY * segmentCharge / segmentVoltage;
+    if (uncertainty < (capacity * MIN_REST_UNCERTAINTY))
+    {
+        uncertainty = capacity * MIN_REST_UNCERTAINTY;
+    }
+
+    *chargePtr = charge;
+    *uncertaintyPtr = uncertainty;
+}
@@ -0,0 +1,32 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file ocvTable.h
+ *
+ * Open-circuit voltage to state-of-charge tables, used by the Battery Service.
+ *
+ * The voltage of a battery that has been at rest long enough for it to relax (its open-circuit
+ * voltage) depends on its charge level, with a curve that depends on the battery chemistry.
+ * Each table holds the open-circuit voltage of a single cell at evenly spaced charge levels,
+ * from empty to full.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#ifndef OCV_TABLE_H
+#define OCV_TABLE_H
+
+#include "legato.h"
+
+/// An open-circuit voltage table.  Treat as opaque.
+typedef struct
+{
+    const char *tech;           ///< Battery technology name (e.g., "LiPo").
+    const double *voltagesPtr;  ///< Voltage (V) at each charge level, in increasing order.
+    size_t numPoints;           ///< Number of voltages (at least 2).
+}
+util_OcvTable_t;
+
+LE_SHARED const util_OcvTable_t *util_GetOcvTable(const char *tech);
+LE_SHARED void util_GetOcvCharge(const util_OcvTable_t *tablePtr, double capacity, double voltage,
+                                 double *chargePtr, double *uncertaintyPtr);
+
+#endif // OCV_TABLE_H
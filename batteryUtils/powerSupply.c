@@ -0,0 +1,414 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file powerSupply.c
+ *
+ * Decoding of the strings in the Linux power_supply class "status" and "health" attributes,
+ * and probing and listing of power_supply class devices, used by the Battery Service.
+ *
+ * The strings are looked up in tables indexed by string length, and only the entries of the
+ * right length whose first character matches are compared in full.  Few strings in either
+ * vocabulary share both their length and their first character, so a lookup rarely compares
+ * more than one string.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#include "legato.h"
+#include "powerSupply.h"
+#include "trace.h"
+#include <sys/stat.h>
+#include <dirent.h>
+
+/// Longest string in either vocabulary ("Watchdog timer expire").
+#define MAX_STRING_LEN 21
+
+/// Size of the buffer the attributes are read into: the longest string, a newline and a null.
+#define READ_BUFFER_SIZE (MAX_STRING_LEN + 2)
+
+/// An entry of a lookup table.
+typedef struct
+{
+    const char *str;
+    int value;
+}
+Entry_t;
+
+/// "status" strings, by length.  Each list is terminated by an entry with a NULL string.
+static const Entry_t StatusLen4[] = { { "Full", UTIL_STATUS_FULL }, { NULL } };
+static const Entry_t StatusLen7[] = { { "Unknown", UTIL_STATUS_UNKNOWN }, { NULL } };
+static const Entry_t StatusLen8[] = { { "Charging", UTIL_STATUS_CHARGING }, { NULL } };
+static const Entry_t StatusLen11[] = { { "Discharging", UTIL_STATUS_DISCHARGING }, { NULL } };
+static const Entry_t StatusLen12[] = { { "Not charging", UTIL_STATUS_NOT_CHARGING }, { NULL } };
+
+static const Entry_t *const StatusTable[MAX_STRING_LEN + 1] =
+{
+    [4] = StatusLen4,
+    [7] = StatusLen7,
+    [8] = StatusLen8,
+    [11] = StatusLen11,
+    [12] = StatusLen12,
+};
+
+/// "health" strings, by length.  Each list is terminated by an entry with a NULL string.
+static const Entry_t HealthLen3[] = { { "Hot", UTIL_HEALTH_HOT }, { NULL } };
+static const Entry_t HealthLen4[] =
+{
+    { "Good", UTIL_HEALTH_GOOD },
+    { "Dead", UTIL_HEALTH_DEAD },
+    { "Cold", UTIL_HEALTH_COLD },
+    { "Warm", UTIL_HEALTH_WARM },
+    { "Cool", UTIL_HEALTH_COOL },
+    { NULL }
+};
+static const Entry_t HealthLen7[] = { { "Unknown", UTIL_HEALTH_UNKNOWN }, { NULL } };
+static const Entry_t HealthLen8[] = { { "Overheat", UTIL_HEALTH_OVERHEAT }, { NULL } };
+static const Entry_t HealthLen10[] = { { "No battery", UTIL_HEALTH_NO_BATTERY }, { NULL } };
+static const Entry_t HealthLen11[] = { { "Overvoltage", UTIL_HEALTH_OVERVOLTAGE }, { NULL } };
+static const Entry_t HealthLen12[] =
+{
+    { "Over voltage", UTIL_HEALTH_OVERVOLTAGE },
+    { "Over current", UTIL_HEALTH_OVERCURRENT },
+    { NULL }
+};
+static const Entry_t HealthLen19[] =
+{
+    { "Unspecified failure", UTIL_HEALTH_UNSPEC_FAILURE },
+    { "Safety timer expire", UTIL_HEALTH_SAFETY_TIMER_EXPIRE },
+    { NULL }
+};
+static const Entry_t HealthLen20[] =
+{
+    { "Calibration required", UTIL_HEALTH_CALIBRATION_REQUIRED },
+    { NULL }
+};
+static const Entry_t HealthLen21[] =
+{
+    { "Watchdog timer expire", UTIL_HEALTH_WATCHDOG_TIMER_EXPIRE },
+    { NULL }
+};
+
+static const Entry_t *const HealthTable[MAX_STRING_LEN + 1] =
+{
+    [3] = HealthLen3,
+    [4] = HealthLen4,
+    [7] = HealthLen7,
+    [8] = HealthLen8,
+    [10] = HealthLen10,
+    [11] = HealthLen11,
+    [12] = HealthLen12,
+    [19] = HealthLen19,
+    [20] = HealthLen20,
+    [21] = HealthLen21,
+};
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Look a string up in a table.
+ *
+ * @return The value of the matching entry, or notFoundValue.
+ */
+//--------------------------------------------------------------------------------------------------
+static int Lookup
+(
+    const Entry_t *const table[],
+    const char *str,
+    size_t len,
+    int notFoundValue
+)
+{
+    if ((len == 0) || (len > MAX_STRING_LEN) || (table[len] == NULL))
+    {
+        return notFoundValue;
+    }
+
+    for (const Entry_t *entryPtr = table[len]; entryPtr->str != NULL; entryPtr++)
+    {
+        if ((entryPtr->str[0] == str[0]) && (memcmp(entryPtr->str, str, len) == 0))
+        {
+            return entryPtr->value;
+        }
+    }
+
+    return notFoundValue;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Read an attribute into a buffer, stripping the trailing newline.
+ *
+ * @return
+ *  - LE_OK on success.
+ *  - LE_IO_ERROR if the read failed.
+ *  - LE_OVERFLOW if the value is longer than any string in the vocabularies.
+ */
+//--------------------------------------------------------------------------------------------------
+static le_result_t ReadAttribute
+(
+    util_FileRef_t fileRef,
+    char *buffer,       ///< READ_BUFFER_SIZE bytes.
+    size_t *lenPtr      ///< [OUT] Length of the value read.
+)
+{
+    le_result_t r = util_ReadStringFromHandle(fileRef, buffer, READ_BUFFER_SIZE);
+    if (r == LE_OK)
+    {
+        *lenPtr = strlen(buffer);
+    }
+    else if (r == LE_OVERFLOW)
+    {
+        LE_ERROR("Unrecognized value '%s...' in '%s'.", buffer, util_GetFilePath(fileRef));
+    }
+
+    return r;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Decode a power_supply "status" string.
+ *
+ * @return The status, or UTIL_STATUS_UNRECOGNIZED.
+ */
+//--------------------------------------------------------------------------------------------------
+util_PowerSupplyStatus_t util_ParsePowerSupplyStatus
+(
+    const char *str,
+    size_t len          ///< Length of the string (it need not be null-terminated).
+)
+{
+    return Lookup(StatusTable, str, len, UTIL_STATUS_UNRECOGNIZED);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Decode a power_supply "health" string.
+ *
+ * @return The health, or UTIL_HEALTH_UNRECOGNIZED.
+ */
+//--------------------------------------------------------------------------------------------------
+util_PowerSupplyHealth_t util_ParsePowerSupplyHealth
+(
+    const char *str,
+    size_t len          ///< Length of the string (it need not be null-terminated).
+)
+{
+    return Lookup(HealthTable, str, len, UTIL_HEALTH_UNRECOGNIZED);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Read and decode a power_supply "status" attribute.
+ *
+ * @return
+ *  - LE_OK on success.
+ *  - LE_IO_ERROR if the read failed.
+ *  - LE_NOT_FOUND if the value is not recognized (it is logged).
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t util_ReadPowerSupplyStatus
+(
+    util_FileRef_t fileRef,
+    util_PowerSupplyStatus_t *statusPtr     ///< [OUT]
+)
+{
+    char buffer[READ_BUFFER_SIZE];
+    size_t len;
+    le_result_t r = ReadAttribute(fileRef, buffer, &len);
+    if (r == LE_OK)
+    {
+        *statusPtr = util_ParsePowerSupplyStatus(buffer, len);
+        if (*statusPtr == UTIL_STATUS_UNRECOGNIZED)
+        {
+            LE_ERROR("Unrecognized charging status '%s'.", buffer);
+            r = LE_NOT_FOUND;
+        }
+    }
+    else if (r == LE_OVERFLOW)
+    {
+        *statusPtr = UTIL_STATUS_UNRECOGNIZED;
+        r = LE_NOT_FOUND;
+    }
+
+    return r;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Read and decode a power_supply "health" attribute.
+ *
+ * @return
+ *  - LE_OK on success.
+ *  - LE_IO_ERROR if the read failed.
+ *  - LE_NOT_FOUND if the value is not recognized (it is logged).
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t util_ReadPowerSupplyHealth
+(
+    util_FileRef_t fileRef,
+    util_PowerSupplyHealth_t *healthPtr     ///< [OUT]
+)
+{
+    char buffer[READ_BUFFER_SIZE];
+    size_t len;
+    le_result_t r = ReadAttribute(fileRef, buffer, &len);
+    if (r == LE_OK)
+    {
+        *healthPtr = util_ParsePowerSupplyHealth(buffer, len);
+        if (*healthPtr == UTIL_HEALTH_UNRECOGNIZED)
+        {
+            LE_ERROR("Unrecognized health string from driver: '%s'.", buffer);
+            r = LE_NOT_FOUND;
+        }
+    }
+    else if (r == LE_OVERFLOW)
+    {
+        *healthPtr = UTIL_HEALTH_UNRECOGNIZED;
+        r = LE_NOT_FOUND;
+    }
+
+    return r;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Check whether a power_supply class device exists (e.g., "bq24190-battery").  When replaying a
+ * trace, the driver files aren't accessed, so a device exists if the trace has values of any of
+ * its files.  That way, a trace recorded on one board selects that board's backend.
+ *
+ * @return true if the device exists.
+ */
+//--------------------------------------------------------------------------------------------------
+bool util_IsPowerSupplyPresent
+(
+    const char *name    ///< Name of the device's directory in /sys/class/power_supply.
+)
+{
+    char path[PATH_MAX];
+    int pathLen = snprintf(path, sizeof(path), "%s/class/power_supply/%s",
+                           util_GetSysfsRoot(), name);
+    if (pathLen >= sizeof(path))
+    {
+        return false;
+    }
+
+    if (util_IsReplaying())
+    {
+        return util_TraceHasDir(path);
+    }
+
+    struct stat st;
+    return ((stat(path, &st) == 0) && S_ISDIR(st.st_mode));
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Decode a power_supply "type" string.
+ *
+ * @return The type of device.
+ */
+//--------------------------------------------------------------------------------------------------
+static util_PowerSupplyType_t ParseType
+(
+    const char *str
+)
+{
+    if (strcmp(str, "Battery") == 0)
+    {
+        return UTIL_SUPPLY_BATTERY;
+    }
+    if (strcmp(str, "Mains") == 0)
+    {
+        return UTIL_SUPPLY_MAINS;
+    }
+    if (strncmp(str, "USB", 3) == 0)
+    {
+        return UTIL_SUPPLY_USB;
+    }
+
+    return UTIL_SUPPLY_OTHER;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * List the power_supply class devices, sorted by name so that their order doesn't depend on the
+ * order in which the drivers were probed.  Nothing is listed when replaying a trace, since only
+ * the files that were recorded can be read.
+ *
+ * @return The number of devices stored in the array.
+ */
+//--------------------------------------------------------------------------------------------------
+size_t util_ListPowerSupplies
+(
+    util_PowerSupplyInfo_t *infoPtr,    ///< [OUT] Array that receives the devices.
+    size_t maxCount                     ///< Number of elements in the array.
+)
+{
+    if (util_IsReplaying())
+    {
+        return 0;
+    }
+
+    char path[PATH_MAX];
+    int pathLen = snprintf(path, sizeof(path), "%s/class/power_supply", util_GetSysfsRoot());
+    if (pathLen >= sizeof(path))
+    {
+        return 0;
+    }
+
+    DIR *dirPtr = opendir(path);
+    if (dirPtr == NULL)
+    {
+        LE_WARN("Couldn't open '%s' - %m", path);
+        return 0;
+    }
+
+    size_t count = 0;
+    struct dirent *entryPtr;
+    while ((entryPtr = readdir(dirPtr)) != NULL)
+    {
+        const char *name = entryPtr->d_name;
+        if (name[0] == '.')
+        {
+            continue;
+        }
+        if (strlen(name) > UTIL_MAX_SUPPLY_NAME_LEN)
+        {
+            LE_WARN("Power supply name '%s' is too long. Ignored.", name);
+            continue;
+        }
+        if (count == maxCount)
+        {
+            LE_WARN("More than %zu power supplies. '%s' ignored.", maxCount, name);
+            continue;
+        }
+
+        char type[16] = "";
+        char typePath[PATH_MAX];
+        if (snprintf(typePath, sizeof(typePath), "%s/%s/type", path, name) < sizeof(typePath))
+        {
+            (void)util_ReadStringFromFile(typePath, type, sizeof(type));
+        }
+
+        // Insert in name order.
+        size_t i = count;
+        while ((i > 0) && (strcmp(infoPtr[i - 1].name, name) > 0))
+        {
+            infoPtr[i] = infoPtr[i - 1];
+            i--;
+        }
+        LE_ASSERT(le_utf8_Copy(infoPtr[i].name, name, sizeof(infoPtr[i].name), NULL) == LE_OK);
+        infoPtr[i].type = ParseType(type);
+        count++;
+    }
+
+    closedir(dirPtr);
+
+    return count;
+}
@@ -0,0 +1,80 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file powerSupply.h
+ *
+ * Decoding of the strings in the Linux power_supply class "status" and "health" attributes,
+ * and probing and listing of power_supply class devices, used by the Battery Service.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#ifndef POWER_SUPPLY_H
+#define POWER_SUPPLY_H
+
+#include "legato.h"
+#include "batteryUtils.h"
+
+/// Values of the power_supply "status" attribute.
+typedef enum
+{
+    UTIL_STATUS_UNKNOWN,        ///< "Unknown"
+    UTIL_STATUS_CHARGING,       ///< "Charging"
+    UTIL_STATUS_DISCHARGING,    ///< "Discharging"
+    UTIL_STATUS_NOT_CHARGING,   ///< "Not charging"
+    UTIL_STATUS_FULL,           ///< "Full"
+    UTIL_STATUS_UNRECOGNIZED,   ///< Anything else.
+}
+util_PowerSupplyStatus_t;
+
+/// Values of the power_supply "health" attribute.
+typedef enum
+{
+    UTIL_HEALTH_UNKNOWN,                ///< "Unknown"
+    UTIL_HEALTH_GOOD,                   ///< "Good"
+    UTIL_HEALTH_OVERHEAT,               ///< "Overheat"
+    UTIL_HEALTH_DEAD,                   ///< "Dead"
+    UTIL_HEALTH_OVERVOLTAGE,            ///< "Over voltage" (or "Overvoltage")
+    UTIL_HEALTH_UNSPEC_FAILURE,         ///< "Unspecified failure"
+    UTIL_HEALTH_COLD,                   ///< "Cold"
+    UTIL_HEALTH_WATCHDOG_TIMER_EXPIRE,  ///< "Watchdog timer expire"
+    UTIL_HEALTH_SAFETY_TIMER_EXPIRE,    ///< "Safety timer expire"
+    UTIL_HEALTH_OVERCURRENT,            ///< "Over current"
+    UTIL_HEALTH_CALIBRATION_REQUIRED,   ///< "Calibration required"
+    UTIL_HEALTH_WARM,                   ///< "Warm"
+    UTIL_HEALTH_COOL,                   ///< "Cool"
+    UTIL_HEALTH_HOT,                    ///< "Hot"
+    UTIL_HEALTH_NO_BATTERY,             ///< "No battery"
+    UTIL_HEALTH_UNRECOGNIZED,           ///< Anything else.
+}
+util_PowerSupplyHealth_t;
+
+/// Kinds of power_supply class device, from the "type" attribute.
+typedef enum
+{
+    UTIL_SUPPLY_BATTERY,    ///< "Battery"
+    UTIL_SUPPLY_MAINS,      ///< "Mains"
+    UTIL_SUPPLY_USB,        ///< "USB", or any of its variants ("USB_PD", "USB_C", ...).
+    UTIL_SUPPLY_OTHER,      ///< Anything else, or no "type" attribute.
+}
+util_PowerSupplyType_t;
+
+/// Longest power_supply class device name supported (excluding the null terminator).
+#define UTIL_MAX_SUPPLY_NAME_LEN 31
+
+/// A power_supply class device found by util_ListPowerSupplies().
+typedef struct
+{
+    char name[UTIL_MAX_SUPPLY_NAME_LEN + 1];    ///< Name of the device's directory.
+    util_PowerSupplyType_t type;
+}
+util_PowerSupplyInfo_t;
+
+LE_SHARED util_PowerSupplyStatus_t util_ParsePowerSupplyStatus(const char *str, size_t len);
+LE_SHARED util_PowerSupplyHealth_t util_ParsePowerSupplyHealth(const char *str, size_t len);
+LE_SHARED le_result_t util_ReadPowerSupplyStatus(util_FileRef_t fileRef,
+                                                 util_PowerSupplyStatus_t *statusPtr);
+LE_SHARED le_result_t util_ReadPowerSupplyHealth(util_FileRef_t fileRef,
+                                                 util_PowerSupplyHealth_t *healthPtr);
+LE_SHARED bool util_IsPowerSupplyPresent(const char *name);
+LE_SHARED size_t util_ListPowerSupplies(util_PowerSupplyInfo_t *infoPtr, size_t maxCount);
+
+#endif // POWER_SUPPLY_H
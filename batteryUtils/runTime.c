@@ -0,0 +1,158 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file runTime.c
+ *
+ * Time-to-empty and time-to-full prediction, used by the Battery Service.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#include "legato.h"
+#include "runTime.h"
+#include "batteryUtils.h"
+#include <math.h>
+
+/// Smallest average current (mA) for the battery to be considered charging or discharging.
+#define MIN_CURRENT_MA 1.0
+
+#define SECONDS_PER_HOUR 3600.0
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Compute the time for a charge to flow at a current.
+ *
+ * @return Seconds, saturating at UINT32_MAX.
+ */
+//--------------------------------------------------------------------------------------------------
+static uint32_t ComputeSeconds
+(
+    double charge,      ///< mAh
+    double current      ///< mA (positive)
+)
+{
+    double seconds = charge * SECONDS_PER_HOUR / current;
+
+    if (seconds <= 0)
+    {
+        return 0;
+    }
+    if (seconds >= (double)UINT32_MAX)
+    {
+        return UINT32_MAX;
+    }
+    return (uint32_t)lround(seconds);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Initialize a run time predictor.
+ */
+//--------------------------------------------------------------------------------------------------
+void util_InitRunTime
+(
+    util_RunTime_t *rtPtr,
+    uint32_t timeConstantMs     ///< Time constant of the current average.
+)
+{
+    rtPtr->timeConstantMs = timeConstantMs;
+
+    util_ResetRunTime(rtPtr);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Forget the current average, e.g., when the battery is disconnected.
+ */
+//--------------------------------------------------------------------------------------------------
+void util_ResetRunTime
+(
+    util_RunTime_t *rtPtr
+)
+{
+    rtPtr->averageCurrent = 0;
+    rtPtr->hasSamples = false;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Add a current sample to the average.
+ */
+//--------------------------------------------------------------------------------------------------
+void util_AddRunTimeSample
+(
+    util_RunTime_t *rtPtr,
+    double current              ///< mA.  Positive when charging, negative when discharging.
+)
+{
+    if (!rtPtr->hasSamples)
+    {
+        rtPtr->averageCurrent = current;
+        rtPtr->hasSamples = true;
+    }
+    else
+    {
+        double weight = 1.0 - exp(-(double)util_MsSince(rtPtr->lastTime) / rtPtr->timeConstantMs);
+
+        rtPtr->averageCurrent += weight * (current - rtPtr->averageCurrent);
+    }
+
+    rtPtr->lastTime = util_GetRelativeTime();
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Predict the time until the battery is empty, at the average current.
+ *
+ * @return
+ *      - LE_OK
+ *      - LE_NOT_FOUND if the battery is not discharging.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t util_GetTimeToEmpty
+(
+    const util_RunTime_t *rtPtr,
+    double charge,              ///< Charge remaining (mAh).
+    uint32_t *secondsPtr        ///< [OUT]
+)
+{
+    if ((!rtPtr->hasSamples) || (rtPtr->averageCurrent > -MIN_CURRENT_MA))
+    {
+        return LE_NOT_FOUND;
+    }
+
+    *secondsPtr = ComputeSeconds(charge, -rtPtr->averageCurrent);
+
+    return LE_OK;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Predict the time until the battery is full, at the average current.
+ *
+ * @return
+ *      - LE_OK
+ *      - LE_NOT_FOUND if the battery is not charging.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t util_GetTimeToFull
+(
+    const util_RunTime_t *rtPtr,
+    double charge,              ///< Charge remaining (mAh).
+    double capacity,            ///< Full charge (mAh).
+    uint32_t *secondsPtr        ///< [OUT]
+)
+{
+    if ((!rtPtr->hasSamples) || (rtPtr->averageCurrent < MIN_CURRENT_MA))
+    {
+        return LE_NOT_FOUND;
+    }
+
+    *secondsPtr = ComputeSeconds(capacity - charge, rtPtr->averageCurrent);
+
+    return LE_OK;
+}
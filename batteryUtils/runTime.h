@@ -0,0 +1,36 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file runTime.h
+ *
+ * Time-to-empty and time-to-full prediction, used by the Battery Service.
+ *
+ * The current is smoothed with an exponentially weighted moving average that is updated at each
+ * sample.  The weight of a sample depends on the time since the previous one, so the average has
+ * the same time constant whatever the sampling interval.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#ifndef RUN_TIME_H
+#define RUN_TIME_H
+
+#include "legato.h"
+
+/// State of a run time predictor.
+typedef struct
+{
+    double averageCurrent;      ///< mA.  Positive when charging, negative when discharging.
+    double timeConstantMs;      ///< Time constant of the average (ms).
+    le_clk_Time_t lastTime;     ///< When the last sample was added (monotonic clock).
+    bool hasSamples;            ///< false if no sample has been added since the last reset.
+}
+util_RunTime_t;
+
+LE_SHARED void util_InitRunTime(util_RunTime_t *rtPtr, uint32_t timeConstantMs);
+LE_SHARED void util_ResetRunTime(util_RunTime_t *rtPtr);
+LE_SHARED void util_AddRunTimeSample(util_RunTime_t *rtPtr, double current);
+LE_SHARED le_result_t util_GetTimeToEmpty(const util_RunTime_t *rtPtr, double charge,
+                                          uint32_t *secondsPtr);
+LE_SHARED le_result_t util_GetTimeToFull(const util_RunTime_t *rtPtr, double charge,
+                                         double capacity, uint32_t *secondsPtr);
+
+#endif // RUN_TIME_H
@@ -0,0 +1,202 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file sampler.c
+ *
+ * Sampler thread, used by the Battery Service to read the driver files off the main thread.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#include "legato.h"
+#include "sampler.h"
+#include <pthread.h>
+#include <signal.h>
+
+/// A sampler thread.
+typedef struct util_Sampler
+{
+    le_thread_Ref_t thread;     ///< The sampler thread.
+    util_SampleFunc_t func;     ///< Takes a sample.
+    void *contextPtr;           ///< Passed to func.
+    uint32_t pendingReasons;    ///< Reasons of the requests not served yet (0 if none).
+    le_sem_Ref_t callDoneSem;   ///< Posted when a function run by util_CallInSampler() is done.
+}
+Sampler_t;
+
+static le_mem_PoolRef_t SamplerPool = NULL;
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Main function of a sampler thread.
+ */
+//--------------------------------------------------------------------------------------------------
+static void *SamplerMain
+(
+    void *contextPtr    ///< The sampler.
+)
+{
+    // Signals such as SIGTERM are handled by the main thread.  The mask is normally inherited from
+    // the creating thread, but make sure the kernel never picks this one to deliver them to.
+    sigset_t sigSet;
+    sigemptyset(&sigSet);
+    sigaddset(&sigSet, SIGTERM);
+    sigaddset(&sigSet, SIGINT);
+    sigaddset(&sigSet, SIGHUP);
+    LE_ASSERT(pthread_sigmask(SIG_BLOCK, &sigSet, NULL) == 0);
+
+    le_event_RunLoop();
+
+    return NULL;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Take a sample for all of the requests made since the last one.  Runs in the sampler thread.
+ */
+//--------------------------------------------------------------------------------------------------
+static void TakeSample
+(
+    void *param1Ptr,    ///< The sampler.
+    void *param2Ptr     ///< unused
+)
+{
+    Sampler_t *samplerPtr = param1Ptr;
+
+    uint32_t reasons = __atomic_exchange_n(&samplerPtr->pendingReasons, 0, __ATOMIC_ACQ_REL);
+
+    samplerPtr->func(reasons, samplerPtr->contextPtr);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * A function called by util_CallInSampler(), with its parameters.
+ */
+//--------------------------------------------------------------------------------------------------
+typedef struct
+{
+    Sampler_t *samplerPtr;
+    le_event_DeferredFunc_t func;
+    void *param1Ptr;
+    void *param2Ptr;
+}
+Call_t;
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Run a function for util_CallInSampler(), and wake up the caller.  Runs in the sampler thread.
+ */
+//--------------------------------------------------------------------------------------------------
+static void RunCall
+(
+    void *param1Ptr,    ///< The call.
+    void *param2Ptr     ///< unused
+)
+{
+    Call_t *callPtr = param1Ptr;
+
+    callPtr->func(callPtr->param1Ptr, callPtr->param2Ptr);
+
+    le_sem_Post(callPtr->samplerPtr->callDoneSem);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Create and start a sampler thread.
+ *
+ * @return Reference to the sampler.
+ */
+//--------------------------------------------------------------------------------------------------
+util_SamplerRef_t util_CreateSampler
+(
+    const char *name,           ///< Name of the thread.
+    util_SampleFunc_t func,     ///< Called in the sampler thread to take a sample.
+    void *contextPtr            ///< Passed to func.
+)
+{
+    if (SamplerPool == NULL)
+    {
+        SamplerPool = le_mem_CreatePool("utilSamplers", sizeof(Sampler_t));
+    }
+
+    Sampler_t *samplerPtr = le_mem_ForceAlloc(SamplerPool);
+    samplerPtr->func = func;
+    samplerPtr->contextPtr = contextPtr;
+    samplerPtr->pendingReasons = 0;
+    samplerPtr->callDoneSem = le_sem_Create(name, 0);
+
+    samplerPtr->thread = le_thread_Create(name, SamplerMain, samplerPtr);
+    le_thread_Start(samplerPtr->thread);
+
+    return samplerPtr;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Request a sample.  Can be called from any thread.  Returns immediately; the sample is taken in
+ * the sampler thread.
+ */
+//--------------------------------------------------------------------------------------------------
+void util_RequestSample
+(
+    util_SamplerRef_t samplerRef,
+    uint32_t reasons            ///< Reason flags (at least one) passed to the sample function.
+)
+{
+    LE_ASSERT(reasons != 0);
+
+    uint32_t oldReasons = __atomic_fetch_or(&samplerRef->pendingReasons, reasons, __ATOMIC_ACQ_REL);
+
+    // Only the first request since the last sample needs to wake the thread.
+    if (oldReasons == 0)
+    {
+        le_event_QueueFunctionToThread(samplerRef->thread, TakeSample, samplerRef, NULL);
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Queue a function to be run in the sampler thread, e.g., to write to a driver file.  Functions
+ * run in the order they are queued, between samples.  Note that a sample requested while another
+ * request is pending is taken at the place of the pending one, which may be before the function.
+ */
+//--------------------------------------------------------------------------------------------------
+void util_QueueToSampler
+(
+    util_SamplerRef_t samplerRef,
+    le_event_DeferredFunc_t func,
+    void *param1Ptr,
+    void *param2Ptr
+)
+{
+    le_event_QueueFunctionToThread(samplerRef->thread, func, param1Ptr, param2Ptr);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Run a function in the sampler thread, and wait until it has returned, e.g., to read the driver
+ * files again when the latest sample is too old for an API caller.  Functions queued before it
+ * run first.  Must only be called from one thread, other than the sampler thread itself.
+ */
+//--------------------------------------------------------------------------------------------------
+void util_CallInSampler
+(
+    util_SamplerRef_t samplerRef,
+    le_event_DeferredFunc_t func,
+    void *param1Ptr,
+    void *param2Ptr
+)
+{
+    LE_ASSERT(le_thread_GetCurrent() != samplerRef->thread);
+
+    Call_t call = { samplerRef, func, param1Ptr, param2Ptr };
+
+    le_event_QueueFunctionToThread(samplerRef->thread, RunCall, &call, NULL);
+    le_sem_Wait(samplerRef->callDoneSem);
+}
@@ -0,0 +1,33 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file sampler.h
+ *
+ * Sampler thread, used by the Battery Service to read the driver files off the main thread.
+ *
+ * Reading a driver file can take tens of milliseconds when the driver talks to the battery monitor
+ * over I2C.  The sampler thread does these reads, so the main thread (which serves the ma_battery
+ * API) never waits for them.  Sample requests carry a set of reason flags; requests made while
+ * one is already pending are merged into it, and the sample function gets all of their reasons.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "legato.h"
+
+/// Reference to a sampler thread.
+typedef struct util_Sampler *util_SamplerRef_t;
+
+/// Called in the sampler thread to take a sample, with the reasons of the requests it serves.
+typedef void (*util_SampleFunc_t)(uint32_t reasons, void *contextPtr);
+
+LE_SHARED util_SamplerRef_t util_CreateSampler(const char *name, util_SampleFunc_t func,
+                                               void *contextPtr);
+LE_SHARED void util_RequestSample(util_SamplerRef_t samplerRef, uint32_t reasons);
+LE_SHARED void util_QueueToSampler(util_SamplerRef_t samplerRef, le_event_DeferredFunc_t func,
+                                   void *param1Ptr, void *param2Ptr);
+LE_SHARED void util_CallInSampler(util_SamplerRef_t samplerRef, le_event_DeferredFunc_t func,
+                                  void *param1Ptr, void *param2Ptr);
+
+#endif // SAMPLER_H
@@ -0,0 +1,63 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file seqLock.c
+ *
+ * Sequence lock, used by the Battery Service to publish samples from the sampler thread.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#include "legato.h"
+#include "seqLock.h"
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Update the protected data.  Must only be called by the one writer thread.
+ */
+//--------------------------------------------------------------------------------------------------
+void util_SeqLockWrite
+(
+    util_SeqLock_t *lockPtr,
+    void *dataPtr,          ///< The protected data.
+    const void *srcPtr,     ///< New value of the data.
+    size_t size
+)
+{
+    uint32_t sequence = __atomic_load_n(&lockPtr->sequence, __ATOMIC_RELAXED);
+
+    __atomic_store_n(&lockPtr->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    memcpy(dataPtr, srcPtr, size);
+
+    __atomic_store_n(&lockPtr->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Copy the protected data, retrying until a copy is made without a write in progress.
+ */
+//--------------------------------------------------------------------------------------------------
+void util_SeqLockRead
+(
+    const util_SeqLock_t *lockPtr,
+    void *dstPtr,           ///< [OUT] Copy of the data.
+    const void *dataPtr,    ///< The protected data.
+    size_t size
+)
+{
+    uint32_t before;
+    uint32_t after;
+
+    do
+    {
+        before = __atomic_load_n(&lockPtr->sequence, __ATOMIC_ACQUIRE);
+
+        memcpy(dstPtr, dataPtr, size);
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(&lockPtr->sequence, __ATOMIC_RELAXED);
+    }
+    while ((before != after) || ((before & 1) != 0));
+}
@@ -0,0 +1,34 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file seqLock.h
+ *
+ * Sequence lock, used by the Battery Service to publish samples from the sampler thread.
+ *
+ * A single writer thread updates the protected data while any number of threads read it.
+ * Readers never block the writer and never take a lock: they copy the data and retry if the
+ * writer changed it while it was being copied.  The writer only holds the data for the time it
+ * takes to copy it in, so retries are rare and short.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#ifndef SEQ_LOCK_H
+#define SEQ_LOCK_H
+
+#include "legato.h"
+
+/// A sequence lock.  The sequence number is odd while a write is in progress.
+typedef struct
+{
+    uint32_t sequence;
+}
+util_SeqLock_t;
+
+/// Static initializer for a sequence lock.
+#define UTIL_SEQ_LOCK_INIT { 0 }
+
+LE_SHARED void util_SeqLockWrite(util_SeqLock_t *lockPtr, void *dataPtr, const void *srcPtr,
+                                 size_t size);
+LE_SHARED void util_SeqLockRead(const util_SeqLock_t *lockPtr, void *dstPtr, const void *dataPtr,
+                                size_t size);
+
+#endif // SEQ_LOCK_H
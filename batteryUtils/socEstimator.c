@@ -0,0 +1,239 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file socEstimator.c
+ *
+ * Coulomb-counting state-of-charge estimator, used by the Battery Service.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#include "legato.h"
+#include "socEstimator.h"
+#include <math.h>
+
+/// Default fraction of the charge flowing into a Li-ion battery that is stored.
+#define DEFAULT_CHARGE_EFFICIENCY 0.99
+
+/// Default self-discharge of a Li-ion battery (about 3% of capacity per month).
+#define DEFAULT_SELF_DISCHARGE_PER_DAY 0.001
+
+/// Default uncertainty added per mAh counted (gain and offset error of the counter).
+#define DEFAULT_COUNTER_ERROR_RATE 0.01
+
+#define MS_PER_DAY (24.0 * 60 * 60 * 1000)
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Keep the estimate within [0, capacity] and the uncertainty within [0, capacity / 2].
+ */
+//--------------------------------------------------------------------------------------------------
+static void Clamp
+(
+    util_SocEstimator_t *estPtr
+)
+{
+    if (estPtr->charge < 0)
+    {
+        estPtr->charge = 0;
+    }
+    else if (estPtr->charge > estPtr->capacity)
+    {
+        estPtr->charge = estPtr->capacity;
+    }
+
+    if (estPtr->uncertainty < 0)
+    {
+        estPtr->uncertainty = 0;
+    }
+    else if (estPtr->uncertainty > (estPtr->capacity / 2))
+    {
+        estPtr->uncertainty = estPtr->capacity / 2;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Initialize an estimator for a battery of a given capacity.  The charge starts out completely
+ * unknown (half the capacity, with an uncertainty of half the capacity).
+ */
+//--------------------------------------------------------------------------------------------------
+void util_InitSocEstimator
+(
+    util_SocEstimator_t *estPtr,
+    double capacity             ///< mAh
+)
+{
+    estPtr->capacity = capacity;
+    estPtr->chargeEfficiency = DEFAULT_CHARGE_EFFICIENCY;
+    estPtr->selfDischargeRate = DEFAULT_SELF_DISCHARGE_PER_DAY;
+    estPtr->counterErrorRate = DEFAULT_COUNTER_ERROR_RATE;
+
+    util_SetSocEstimate(estPtr, capacity / 2, capacity / 2);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Replace the estimate, e.g., after the charge counter has been re-seeded.  The charge counter
+ * baseline is reset, so the next util_CountSocCharge() only records the counter value.
+ */
+//--------------------------------------------------------------------------------------------------
+void util_SetSocEstimate
+(
+    util_SocEstimator_t *estPtr,
+    double charge,              ///< mAh
+    double uncertainty          ///< mAh
+)
+{
+    estPtr->charge = charge;
+    estPtr->uncertainty = uncertainty;
+    estPtr->hasLastCounter = false;
+
+    Clamp(estPtr);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Correct the estimate with an independent measurement of the charge, weighting the estimate and
+ * the measurement by their uncertainties.
+ */
+//--------------------------------------------------------------------------------------------------
+void util_CorrectSocEstimate
+(
+    util_SocEstimator_t *estPtr,
+    double measuredCharge,          ///< mAh
+    double measurementUncertainty   ///< mAh
+)
+{
+    double estimateVariance = estPtr->uncertainty * estPtr->uncertainty;
+    double measurementVariance = measurementUncertainty * measurementUncertainty;
+    double totalVariance = estimateVariance + measurementVariance;
+
+    if (totalVariance <= 0)
+    {
+        estPtr->charge = measuredCharge;
+    }
+    else
+    {
+        double gain = estimateVariance / totalVariance;
+
+        estPtr->charge += gain * (measuredCharge - estPtr->charge);
+        estPtr->uncertainty = sqrt(estimateVariance * measurementVariance / totalVariance);
+    }
+
+    Clamp(estPtr);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Correct the estimate with the charge level implied by the voltage of a battery that has been at
+ * rest long enough for its voltage to relax to the open-circuit voltage.
+ *
+ * @return The charge level implied by the voltage (mAh).
+ */
+//--------------------------------------------------------------------------------------------------
+double util_CorrectSocFromRestVoltage
+(
+    util_SocEstimator_t *estPtr,
+    const util_OcvTable_t *tablePtr,    ///< Table for the battery technology.
+    double voltage                      ///< V
+)
+{
+    double measuredCharge;
+    double uncertainty;
+    util_GetOcvCharge(tablePtr, estPtr->capacity, voltage, &measuredCharge, &uncertainty);
+
+    LE_DEBUG("Rest voltage %.3lf V -> %.0lf mAh (+/- %.0lf mAh), estimate %.0lf mAh (+/- %.0lf mAh).",
+             voltage,
+             measuredCharge,
+             uncertainty,
+             estPtr->charge,
+             estPtr->uncertainty);
+
+    util_CorrectSocEstimate(estPtr, measuredCharge, uncertainty);
+
+    return measuredCharge;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Update the estimate with a new charge counter reading.
+ */
+//--------------------------------------------------------------------------------------------------
+void util_CountSocCharge
+(
+    util_SocEstimator_t *estPtr,
+    int32_t counter,            ///< Charge counter (uAh).  Counts up when charging.
+    uint64_t elapsedMs          ///< Time since the previous update.
+)
+{
+    if (estPtr->hasLastCounter)
+    {
+        double delta = ((double)counter - (double)estPtr->lastCounter) / 1000.0;  // mAh
+
+        if (delta > 0)
+        {
+            estPtr->charge += delta * estPtr->chargeEfficiency;
+        }
+        else
+        {
+            estPtr->charge += delta;
+        }
+        estPtr->uncertainty += fabs(delta) * estPtr->counterErrorRate;
+
+        // Self-discharge doesn't flow through the counter.  The rate is only a typical value, so
+        // half of the amount is added to the uncertainty.
+        double selfDischarge = estPtr->capacity * estPtr->selfDischargeRate
+                             * ((double)elapsedMs / MS_PER_DAY);
+        estPtr->charge -= selfDischarge;
+        estPtr->uncertainty += selfDischarge / 2;
+
+        Clamp(estPtr);
+    }
+
+    estPtr->lastCounter = counter;
+    estPtr->hasLastCounter = true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the estimated charge remaining.
+ *
+ * @return mAh.
+ */
+//--------------------------------------------------------------------------------------------------
+double util_GetSocCharge
+(
+    const util_SocEstimator_t *estPtr
+)
+{
+    return estPtr->charge;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the confidence in the estimate.
+ *
+ * @return 0 (charge completely unknown) to 100 (no uncertainty), in percent.
+ */
+//--------------------------------------------------------------------------------------------------
+uint8_t util_GetSocConfidence
+(
+    const util_SocEstimator_t *estPtr
+)
+{
+    if (estPtr->capacity <= 0)
+    {
+        return 0;
+    }
+
+    double confidence = 100.0 * (1.0 - (estPtr->uncertainty / (estPtr->capacity / 2)));
+
+    return (uint8_t)lround((confidence < 0) ? 0 : confidence);
+}
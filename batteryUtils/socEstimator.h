@@ -0,0 +1,46 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file socEstimator.h
+ *
+ * Coulomb-counting state-of-charge estimator, used by the Battery Service.
+ *
+ * The estimator integrates the deltas of a charge counter (in uAh) between samples, applying a
+ * charge efficiency to charge flowing in and a self-discharge rate over time.  Alongside the
+ * charge estimate it tracks an uncertainty (in mAh), which grows with the charge counted and the
+ * time elapsed, and shrinks when the estimate is corrected at an anchor point (e.g., when the
+ * charger reports "Full", or from the open-circuit voltage of a rested battery).
+ */
+//--------------------------------------------------------------------------------------------------
+
+#ifndef SOC_ESTIMATOR_H
+#define SOC_ESTIMATOR_H
+
+#include "legato.h"
+#include "ocvTable.h"
+
+/// State of a state-of-charge estimator.
+typedef struct
+{
+    double capacity;            ///< Full charge capacity (mAh).
+    double charge;              ///< Estimated charge remaining (mAh).
+    double uncertainty;         ///< Uncertainty of the estimate (mAh).
+    double chargeEfficiency;    ///< Fraction of the charge flowing in that is stored.
+    double selfDischargeRate;   ///< Fraction of the capacity lost per day to self-discharge.
+    double counterErrorRate;    ///< Uncertainty added per mAh counted, as a fraction.
+    int32_t lastCounter;        ///< Charge counter value at the last update (uAh).
+    bool hasLastCounter;        ///< false if lastCounter has not been read since the last reset.
+}
+util_SocEstimator_t;
+
+LE_SHARED void util_InitSocEstimator(util_SocEstimator_t *estPtr, double capacity);
+LE_SHARED void util_SetSocEstimate(util_SocEstimator_t *estPtr, double charge, double uncertainty);
+LE_SHARED void util_CorrectSocEstimate(util_SocEstimator_t *estPtr, double measuredCharge,
+                                       double measurementUncertainty);
+LE_SHARED double util_CorrectSocFromRestVoltage(util_SocEstimator_t *estPtr,
+                                                const util_OcvTable_t *tablePtr, double voltage);
+LE_SHARED void util_CountSocCharge(util_SocEstimator_t *estPtr, int32_t counter,
+                                   uint64_t elapsedMs);
+LE_SHARED double util_GetSocCharge(const util_SocEstimator_t *estPtr);
+LE_SHARED uint8_t util_GetSocConfidence(const util_SocEstimator_t *estPtr);
+
+#endif // SOC_ESTIMATOR_H
@@ -0,0 +1,227 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file stateOfHealth.c
+ *
+ * Battery state-of-health and cycle count tracking, used by the Battery Service.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#include "legato.h"
+#include "stateOfHealth.h"
+#include "batteryUtils.h"
+#include <math.h>
+
+/// Smallest difference in state of charge between two anchor points to estimate the capacity from.
+#define MIN_ANCHOR_SPAN 0.5
+
+/// Range of capacity estimates accepted, as fractions of the design capacity.
+#define MIN_CAPACITY_ESTIMATE 0.5
+#define MAX_CAPACITY_ESTIMATE 1.2
+
+/// Weight of a new capacity estimate in the running estimate.
+#define CAPACITY_ESTIMATE_WEIGHT 0.25
+
+/// Smallest change in the full charge capacity worth saving (mAh).
+#define MIN_CAPACITY_CHANGE 1.0
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Initialize state of health tracking from the counters last saved (or zeroes for a new battery).
+ */
+//--------------------------------------------------------------------------------------------------
+void util_InitStateOfHealth
+(
+    util_StateOfHealth_t *sohPtr,
+    double designCapacity,      ///< mAh, or 0 if unknown.
+    double fullCapacity,        ///< mAh, or 0 if not estimated yet.
+    uint32_t cycleCount,
+    double cycleCharge          ///< mAh
+)
+{
+    memset(sohPtr, 0, sizeof(*sohPtr));
+
+    sohPtr->designCapacity = designCapacity;
+    sohPtr->fullCapacity = fullCapacity;
+    sohPtr->cycleCount = cycleCount;
+    sohPtr->cycleCharge = cycleCharge;
+    sohPtr->lastSaveTime = util_GetRelativeTime();
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Count charge flowing into or out of the battery.
+ */
+//--------------------------------------------------------------------------------------------------
+void util_CountSohCharge
+(
+    util_StateOfHealth_t *sohPtr,
+    double charge               ///< mAh.  Positive when charging, negative when discharging.
+)
+{
+    if (charge == 0)
+    {
+        return;
+    }
+
+    sohPtr->anchorCharge += charge;
+
+    if ((charge < 0) && (sohPtr->designCapacity > 0))
+    {
+        sohPtr->cycleCharge -= charge;
+        while (sohPtr->cycleCharge >= sohPtr->designCapacity)
+        {
+            sohPtr->cycleCharge -= sohPtr->designCapacity;
+            sohPtr->cycleCount++;
+            sohPtr->isSaveForced = true;
+
+            LE_INFO("Battery cycle count = %" PRIu32 ".", sohPtr->cycleCount);
+        }
+        sohPtr->isDirty = true;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Record an anchor point, where the state of charge is known.  If the previous anchor point is far
+ * enough away, the full charge capacity is estimated from the charge counted in between.
+ */
+//--------------------------------------------------------------------------------------------------
+void util_SetSohAnchor
+(
+    util_StateOfHealth_t *sohPtr,
+    double fraction             ///< State of charge (0 to 1).
+)
+{
+    double span = fraction - sohPtr->anchorFraction;
+
+    if (sohPtr->hasAnchor && (fabs(span) >= MIN_ANCHOR_SPAN) && (sohPtr->designCapacity > 0))
+    {
+        double estimate = sohPtr->anchorCharge / span;
+
+        if (   (estimate < sohPtr->designCapacity * MIN_CAPACITY_ESTIMATE)
+            || (estimate > sohPtr->designCapacity * MAX_CAPACITY_ESTIMATE)  )
+        {
+            LE_WARN("Ignoring capacity estimate of %.0lf mAh.", estimate);
+        }
+        else
+        {
+            LE_INFO("Capacity estimate = %.0lf mAh.", estimate);
+
+            if (sohPtr->fullCapacity <= 0)
+            {
+                util_SetSohFullCapacity(sohPtr, estimate);
+            }
+            else
+            {
+                util_SetSohFullCapacity(sohPtr,
+                                        sohPtr->fullCapacity
+                                        + CAPACITY_ESTIMATE_WEIGHT
+                                          * (estimate - sohPtr->fullCapacity));
+            }
+        }
+    }
+
+    sohPtr->anchorCharge = 0;
+    sohPtr->anchorFraction = fraction;
+    sohPtr->hasAnchor = true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Forget the last anchor point, e.g., when the battery is disconnected.
+ */
+//--------------------------------------------------------------------------------------------------
+void util_ClearSohAnchor
+(
+    util_StateOfHealth_t *sohPtr
+)
+{
+    sohPtr->anchorCharge = 0;
+    sohPtr->hasAnchor = false;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Set the full charge capacity, e.g., as learned by a fuel gauge.
+ */
+//--------------------------------------------------------------------------------------------------
+void util_SetSohFullCapacity
+(
+    util_StateOfHealth_t *sohPtr,
+    double fullCapacity         ///< mAh
+)
+{
+    if (fabs(fullCapacity - sohPtr->fullCapacity) >= MIN_CAPACITY_CHANGE)
+    {
+        sohPtr->fullCapacity = fullCapacity;
+        sohPtr->isDirty = true;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the state of health, as the full charge capacity in percent of the design capacity.
+ *
+ * @return
+ *      - LE_OK
+ *      - LE_NOT_FOUND if the design capacity or the full charge capacity is unknown.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t util_GetSohPercent
+(
+    const util_StateOfHealth_t *sohPtr,
+    uint8_t *percentPtr         ///< [OUT] 0 to 100.
+)
+{
+    if ((sohPtr->designCapacity <= 0) || (sohPtr->fullCapacity <= 0))
+    {
+        return LE_NOT_FOUND;
+    }
+
+    long percent = lround(100.0 * sohPtr->fullCapacity / sohPtr->designCapacity);
+
+    *percentPtr = (percent > 100) ? 100 : (uint8_t)percent;
+
+    return LE_OK;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Check whether the counters should be saved.  Changes are saved at most once per interval,
+ * except that a new cycle is saved right away.
+ *
+ * @return true if the counters should be saved now.
+ */
+//--------------------------------------------------------------------------------------------------
+bool util_IsSohSaveDue
+(
+    const util_StateOfHealth_t *sohPtr,
+    uint32_t intervalMs         ///< Shortest time between saves.
+)
+{
+    return (   sohPtr->isDirty
+            && (sohPtr->isSaveForced || (util_MsSince(sohPtr->lastSaveTime) >= intervalMs))  );
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Record that the counters have been saved.
+ */
+//--------------------------------------------------------------------------------------------------
+void util_MarkSohSaved
+(
+    util_StateOfHealth_t *sohPtr
+)
+{
+    sohPtr->isDirty = false;
+    sohPtr->isSaveForced = false;
+    sohPtr->lastSaveTime = util_GetRelativeTime();
+}
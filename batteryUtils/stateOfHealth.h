@@ -0,0 +1,49 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file stateOfHealth.h
+ *
+ * Battery state-of-health and cycle count tracking, used by the Battery Service.
+ *
+ * The charge drawn from the battery is accumulated into equivalent full cycles (one cycle per
+ * design capacity discharged).  The full charge capacity is either set directly (e.g., from a fuel
+ * gauge that learns it) or estimated from the charge counted between two anchor points whose
+ * state of charge is known (e.g., "Full" and a rest voltage) and that are far enough apart.
+ *
+ * The module doesn't store anything itself.  The caller loads the counters at initialization and
+ * saves them when util_IsSohSaveDue() says so, which bounds how often they are written.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#ifndef STATE_OF_HEALTH_H
+#define STATE_OF_HEALTH_H
+
+#include "legato.h"
+
+/// State of health tracking state.
+typedef struct
+{
+    double designCapacity;      ///< Capacity of a new battery (mAh), or 0 if unknown.
+    double fullCapacity;        ///< Estimated full charge capacity (mAh), or 0 if not estimated.
+    uint32_t cycleCount;        ///< Number of equivalent full cycles.
+    double cycleCharge;         ///< Charge discharged since the last whole cycle (mAh).
+    double anchorCharge;        ///< Net charge counted since the last anchor point (mAh).
+    double anchorFraction;      ///< State of charge at the last anchor point (0 to 1).
+    bool hasAnchor;             ///< false if there is no anchor point to count from.
+    bool isDirty;               ///< true if the counters changed since they were last saved.
+    bool isSaveForced;          ///< true if the counters must be saved regardless of the interval.
+    le_clk_Time_t lastSaveTime; ///< When the counters were last saved (monotonic clock).
+}
+util_StateOfHealth_t;
+
+LE_SHARED void util_InitStateOfHealth(util_StateOfHealth_t *sohPtr, double designCapacity,
+                                      double fullCapacity, uint32_t cycleCount,
+                                      double cycleCharge);
+LE_SHARED void util_CountSohCharge(util_StateOfHealth_t *sohPtr, double charge);
+LE_SHARED void util_SetSohAnchor(util_StateOfHealth_t *sohPtr, double fraction);
+LE_SHARED void util_ClearSohAnchor(util_StateOfHealth_t *sohPtr);
+LE_SHARED void util_SetSohFullCapacity(util_StateOfHealth_t *sohPtr, double fullCapacity);
+LE_SHARED le_result_t util_GetSohPercent(const util_StateOfHealth_t *sohPtr, uint8_t *percentPtr);
+LE_SHARED bool util_IsSohSaveDue(const util_StateOfHealth_t *sohPtr, uint32_t intervalMs);
+LE_SHARED void util_MarkSohSaved(util_StateOfHealth_t *sohPtr);
+
+#endif // STATE_OF_HEALTH_H
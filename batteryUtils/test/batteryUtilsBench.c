@@ -0,0 +1,596 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file batteryUtilsBench.c
+ *
+ * Microbenchmarks of batteryUtils, built on the host against the Legato shim (see CMakeLists.txt
+ * at the top of the tree).
+ *
+ * The file benchmarks compare the path-based (stdio) readers and writer with the file handles,
+ * on a fake sysfs tree in tmpfs (BATTERY_SYSFS_ROOT).  A handle is "warm" when it is kept open
+ * between operations, as the service does, and "cold" when it is opened and closed around each
+ * one.  Each benchmark reports, per operation:
+ *
+ *  - ns: the average time;
+ *  - r/w: read and write system calls, as counted by the kernel (syscr and syscw in
+ *    /proc/self/io); open(), close() and fstat() are not included;
+ *  - sys: all the system calls made by the handles (util_GetIoStats()), for the handle
+ *    benchmarks only;
+ *  - alloc: heap allocations (malloc(), calloc() and realloc() are counted by this program).
+ *    The shim's memory pools allocate from the heap, so a cold handle counts one allocation that
+ *    Legato's pre-allocated pools would not make.
+ *
+ * Usage: batteryUtilsBench [iterations]
+ */
+//--------------------------------------------------------------------------------------------------
+
+#include "legato.h"
+#include "batteryUtils.h"
+#include "jsonWriter.h"
+
+/// Default number of iterations of each benchmark.
+#define DEFAULT_ITERATIONS 200000
+
+/// Number of iterations of each benchmark.
+static unsigned long Iterations = DEFAULT_ITERATIONS;
+
+/// Sum of the results of the benchmarked operations, so that they can't be optimized away.
+static volatile size_t Sink;
+
+/// Number of heap allocations made by the process.
+static uint64_t NumAllocs = 0;
+
+/// The fake sysfs tree.
+static char SysfsRoot[64];
+
+/// Paths of the files in the fake sysfs tree.
+static char VoltagePath[PATH_MAX];
+static char TempPath[PATH_MAX];
+static char StatusPath[PATH_MAX];
+static char LimitPath[PATH_MAX];
+
+/// Handles of the files, kept open for the warm benchmarks.
+static util_FileRef_t VoltageRef;
+static util_FileRef_t TempRef;
+static util_FileRef_t StatusRef;
+static util_FileRef_t LimitRef;
+
+/// Counters sampled before and after a benchmark.
+typedef struct
+{
+    uint64_t ns;
+    uint64_t numReadWrites;     ///< Read and write system calls, from /proc/self/io.
+    uint64_t numSyscalls;       ///< System calls made by the file handles.
+    uint64_t numAllocs;
+}
+Counters_t;
+
+/// Inputs of the Data Hub value, varied each iteration like successive battery samples.
+typedef struct
+{
+    unsigned int percent;
+    unsigned int mAh;
+    bool isCharging;
+    double current;
+    double voltage;
+    double temp;
+    unsigned int timeToEmpty;
+}
+Sample_t;
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Read the monotonic clock.
+ *
+ * @return Time in ns.
+ */
+//--------------------------------------------------------------------------------------------------
+static uint64_t GetNs
+(
+    void
+)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ((uint64_t)now.tv_sec * 1000000000) + now.tv_nsec;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Make up the sample of an iteration.
+ */
+//--------------------------------------------------------------------------------------------------
+static void MakeSample
+(
+    unsigned long i,
+    Sample_t *samplePtr
+)
+{
+    samplePtr->percent = i % 101;
+    samplePtr->mAh = 2000 - (i % 2000);
+    samplePtr->isCharging = ((i & 1) != 0);
+    samplePtr->current = -412.0625 + (double)(i % 1000) * 0.37;
+    samplePtr->voltage = 3.4 + (double)(i % 800) * 0.001;
+    samplePtr->temp = 21.5 + (double)(i % 300) * 0.05;
+    samplePtr->timeToEmpty = 3600 + (i % 10000);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Build the Data Hub value of a battery with the JSON writer.
+ *
+ * @return Length of the document.
+ */
+//--------------------------------------------------------------------------------------------------
+static size_t WriteJson
+(
+    const Sample_t *samplePtr,
+    char *buffer,
+    size_t size
+)
+{
+    size_t len;
+    util_JsonWriter_t writer;
+    util_JsonBegin(&writer, buffer, size);
+    util_JsonAddString(&writer, "health", "good");
+    util_JsonAddInt(&writer, "%EL", samplePtr->percent);
+    util_JsonAddInt(&writer, "mAh", samplePtr->mAh);
+    util_JsonAddBool(&writer, "charging", samplePtr->isCharging);
+    util_JsonAddDecimal(&writer, "mA", samplePtr->current, 3);
+    util_JsonAddDecimal(&writer, "V", samplePtr->voltage, 2);
+    util_JsonAddDecimal(&writer, "degC", samplePtr->temp, 2);
+    util_JsonAddInt(&writer, "timeToEmpty", samplePtr->timeToEmpty);
+    LE_ASSERT(util_JsonEnd(&writer, &len) == LE_OK);
+
+    return len;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Build the same Data Hub value with snprintf(), as the service did before the JSON writer.
+ *
+ * @return Length of the document.
+ */
+//--------------------------------------------------------------------------------------------------
+static size_t PrintJson
+(
+    const Sample_t *samplePtr,
+    char *buffer,
+    size_t size
+)
+{
+    int len = snprintf(buffer,
+                       size,
+                       "{\"health\":\"%s\","
+                       "\"%%EL\":%u,"
+                       "\"mAh\":%u,"
+                       "\"charging\":%s,"
+                       "\"mA\":%.3lf,"
+                       "\"V\":%.2lf,"
+                       "\"degC\":%.2lf,"
+                       "\"timeToEmpty\":%u}",
+                       "good",
+                       samplePtr->percent,
+                       samplePtr->mAh,
+                       samplePtr->isCharging ? "true" : "false",
+                       samplePtr->current,
+                       samplePtr->voltage,
+                       samplePtr->temp,
+                       samplePtr->timeToEmpty);
+    LE_ASSERT((len > 0) && (len < size));
+
+    return len;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Time a way of building the Data Hub value.
+ */
+//--------------------------------------------------------------------------------------------------
+static void BenchJson
+(
+    const char *name,
+    size_t (*buildFunc)(const Sample_t *samplePtr, char *buffer, size_t size)
+)
+{
+    char buffer[256];
+    Sample_t sample;
+    size_t sum = 0;
+
+    uint64_t startNs = GetNs();
+    for (unsigned long i = 0; i < Iterations; i++)
+    {
+        MakeSample(i, &sample);
+        sum += buildFunc(&sample, buffer, sizeof(buffer));
+    }
+    uint64_t elapsedNs = GetNs() - startNs;
+
+    Sink += sum;
+    printf("%-32s %8.1f ns/op\n", name, (double)elapsedNs / Iterations);
+}
+
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void __libc_free(void *ptr);
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Replacements of the heap allocation functions, which count the allocations.
+ */
+//--------------------------------------------------------------------------------------------------
+void *malloc
+(
+    size_t size
+)
+{
+    __atomic_add_fetch(&NumAllocs, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+void *calloc
+(
+    size_t count,
+    size_t size
+)
+{
+    __atomic_add_fetch(&NumAllocs, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(count, size);
+}
+
+void *realloc
+(
+    void *ptr,
+    size_t size
+)
+{
+    __atomic_add_fetch(&NumAllocs, 1, __ATOMIC_RELAXED);
+    return __libc_realloc(ptr, size);
+}
+
+void free
+(
+    void *ptr
+)
+{
+    __libc_free(ptr);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the number of read and write system calls made by the process, from /proc/self/io.
+ *
+ * @return The number of calls.
+ */
+//--------------------------------------------------------------------------------------------------
+static uint64_t GetNumReadWrites
+(
+    void
+)
+{
+    char buffer[512];
+    int fd = open("/proc/self/io", O_RDONLY | O_CLOEXEC);
+    LE_FATAL_IF(fd < 0, "Can't open /proc/self/io - %m");
+    ssize_t len = read(fd, buffer, sizeof(buffer) - 1);
+    close(fd);
+    LE_ASSERT(len > 0);
+    buffer[len] = '\0';
+
+    const char *syscrPtr = strstr(buffer, "syscr: ");
+    const char *syscwPtr = strstr(buffer, "syscw: ");
+    LE_ASSERT((syscrPtr != NULL) && (syscwPtr != NULL));
+
+    return strtoull(syscrPtr + 7, NULL, 10) + strtoull(syscwPtr + 7, NULL, 10);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Sample the counters.
+ */
+//--------------------------------------------------------------------------------------------------
+static void GetCounters
+(
+    Counters_t *countersPtr
+)
+{
+    util_IoStats_t ioStats;
+    util_GetIoStats(&ioStats);
+
+    countersPtr->numReadWrites = GetNumReadWrites();
+    countersPtr->numSyscalls = ioStats.numSyscalls;
+    countersPtr->numAllocs = NumAllocs;
+    countersPtr->ns = GetNs();
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Run a file benchmark and print its costs per operation.
+ */
+//--------------------------------------------------------------------------------------------------
+static void BenchFile
+(
+    const char *name,
+    void (*opFunc)(unsigned long i),
+    bool isHandle           ///< true if the operation uses a file handle.
+)
+{
+    Counters_t start;
+    Counters_t end;
+
+    GetCounters(&start);
+    for (unsigned long i = 0; i < Iterations; i++)
+    {
+        opFunc(i);
+    }
+    end.ns = GetNs();
+    end.numAllocs = NumAllocs;
+    util_IoStats_t ioStats;
+    util_GetIoStats(&ioStats);
+    end.numSyscalls = ioStats.numSyscalls;
+    end.numReadWrites = GetNumReadWrites();
+
+    // The reading of /proc/self/io itself is one read.
+    double numReadWrites = (double)(end.numReadWrites - start.numReadWrites - 1) / Iterations;
+
+    printf("%-32s %8.1f %6.2f ", name, (double)(end.ns - start.ns) / Iterations, numReadWrites);
+    if (isHandle)
+    {
+        printf("%6.2f ", (double)(end.numSyscalls - start.numSyscalls) / Iterations);
+    }
+    else
+    {
+        printf("%6s ", "-");
+    }
+    printf("%6.2f\n", (double)(end.numAllocs - start.numAllocs) / Iterations);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * The file operations benchmarked.
+ */
+//--------------------------------------------------------------------------------------------------
+static void ReadIntFromFile
+(
+    unsigned long i
+)
+{
+    int value;
+    LE_ASSERT(util_ReadIntFromFile(VoltagePath, &value) == LE_OK);
+    Sink += value;
+}
+
+static void ReadIntFromHandle
+(
+    unsigned long i
+)
+{
+    int value;
+    LE_ASSERT(util_ReadIntFromHandle(VoltageRef, &value) == LE_OK);
+    Sink += value;
+}
+
+static void ReadIntFromColdHandle
+(
+    unsigned long i
+)
+{
+    int value;
+    util_FileRef_t fileRef = util_OpenFile(VoltagePath, O_RDONLY);
+    LE_ASSERT(util_ReadIntFromHandle(fileRef, &value) == LE_OK);
+    util_CloseFile(fileRef);
+    Sink += value;
+}
+
+static void ReadDoubleFromFile
+(
+    unsigned long i
+)
+{
+    double value;
+    LE_ASSERT(util_ReadDoubleFromFile(TempPath, &value) == LE_OK);
+    Sink += (size_t)value;
+}
+
+static void ReadDoubleFromHandle
+(
+    unsigned long i
+)
+{
+    double value;
+    LE_ASSERT(util_ReadDoubleFromHandle(TempRef, &value) == LE_OK);
+    Sink += (size_t)value;
+}
+
+static void ReadDoubleFromColdHandle
+(
+    unsigned long i
+)
+{
+    double value;
+    util_FileRef_t fileRef = util_OpenFile(TempPath, O_RDONLY);
+    LE_ASSERT(util_ReadDoubleFromHandle(fileRef, &value) == LE_OK);
+    util_CloseFile(fileRef);
+    Sink += (size_t)value;
+}
+
+static void ReadStringFromFile
+(
+    unsigned long i
+)
+{
+    char value[32];
+    LE_ASSERT(util_ReadStringFromFile(StatusPath, value, sizeof(value)) == LE_OK);
+    Sink += value[0];
+}
+
+static void ReadStringFromHandle
+(
+    unsigned long i
+)
+{
+    char value[32];
+    LE_ASSERT(util_ReadStringFromHandle(StatusRef, value, sizeof(value)) == LE_OK);
+    Sink += value[0];
+}
+
+static void ReadStringFromColdHandle
+(
+    unsigned long i
+)
+{
+    char value[32];
+    util_FileRef_t fileRef = util_OpenFile(StatusPath, O_RDONLY);
+    LE_ASSERT(util_ReadStringFromHandle(fileRef, value, sizeof(value)) == LE_OK);
+    util_CloseFile(fileRef);
+    Sink += value[0];
+}
+
+static void WriteIntToFile
+(
+    unsigned long i
+)
+{
+    LE_ASSERT(util_WriteIntToFile(LimitPath, 50 + (i % 50)) == LE_OK);
+}
+
+static void WriteIntToHandle
+(
+    unsigned long i
+)
+{
+    LE_ASSERT(util_WriteIntToHandle(LimitRef, 50 + (i % 50)) == LE_OK);
+}
+
+static void WriteIntToColdHandle
+(
+    unsigned long i
+)
+{
+    util_FileRef_t fileRef = util_OpenFile(LimitPath, O_WRONLY);
+    LE_ASSERT(util_WriteIntToHandle(fileRef, 50 + (i % 50)) == LE_OK);
+    util_CloseFile(fileRef);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Create a file in the fake sysfs tree, and get its path.
+ */
+//--------------------------------------------------------------------------------------------------
+static void CreateSysfsFile
+(
+    const char *name,
+    const char *contents,
+    char *path              ///< [OUT] PATH_MAX bytes.
+)
+{
+    snprintf(path, PATH_MAX, "%s/class/power_supply/bench/%s", SysfsRoot, name);
+
+    FILE *filePtr = fopen(path, "w");
+    LE_FATAL_IF(filePtr == NULL, "Can't create '%s' - %m", path);
+    LE_ASSERT(fputs(contents, filePtr) >= 0);
+    LE_ASSERT(fclose(filePtr) == 0);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Run the file benchmarks on a fake sysfs tree in tmpfs.
+ */
+//--------------------------------------------------------------------------------------------------
+static void BenchFiles
+(
+    void
+)
+{
+    snprintf(SysfsRoot, sizeof(SysfsRoot), "%s/batteryUtilsBench.XXXXXX",
+             (access("/dev/shm", W_OK) == 0) ? "/dev/shm" : "/tmp");
+    LE_FATAL_IF(mkdtemp(SysfsRoot) == NULL, "Can't create '%s' - %m", SysfsRoot);
+    LE_ASSERT(setenv("BATTERY_SYSFS_ROOT", SysfsRoot, 1) == 0);
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/class", SysfsRoot);
+    LE_ASSERT(mkdir(path, 0755) == 0);
+    snprintf(path, sizeof(path), "%s/class/power_supply", SysfsRoot);
+    LE_ASSERT(mkdir(path, 0755) == 0);
+    snprintf(path, sizeof(path), "%s/class/power_supply/bench", SysfsRoot);
+    LE_ASSERT(mkdir(path, 0755) == 0);
+
+    CreateSysfsFile("voltage_now", "3912000\n", VoltagePath);
+    CreateSysfsFile("temp", "24.75\n", TempPath);
+    CreateSysfsFile("status", "Discharging\n", StatusPath);
+    CreateSysfsFile("charge_control_limit", "80\n", LimitPath);
+
+    VoltageRef = util_OpenSysfsFile("class/power_supply/bench/voltage_now", O_RDONLY);
+    TempRef = util_OpenSysfsFile("class/power_supply/bench/temp", O_RDONLY);
+    StatusRef = util_OpenSysfsFile("class/power_supply/bench/status", O_RDONLY);
+    LimitRef = util_OpenSysfsFile("class/power_supply/bench/charge_control_limit", O_WRONLY);
+
+    printf("%-32s %8s %6s %6s %6s\n", "per op", "ns", "r/w", "sys", "alloc");
+
+    BenchFile("ReadIntFromFile", ReadIntFromFile, false);
+    BenchFile("ReadIntFromHandle, cold", ReadIntFromColdHandle, true);
+    BenchFile("ReadIntFromHandle, warm", ReadIntFromHandle, true);
+    BenchFile("ReadDoubleFromFile", ReadDoubleFromFile, false);
+    BenchFile("ReadDoubleFromHandle, cold", ReadDoubleFromColdHandle, true);
+    BenchFile("ReadDoubleFromHandle, warm", ReadDoubleFromHandle, true);
+    BenchFile("ReadStringFromFile", ReadStringFromFile, false);
+    BenchFile("ReadStringFromHandle, cold", ReadStringFromColdHandle, true);
+    BenchFile("ReadStringFromHandle, warm", ReadStringFromHandle, true);
+    BenchFile("WriteIntToFile", WriteIntToFile, false);
+    BenchFile("WriteIntToHandle, cold", WriteIntToColdHandle, true);
+    BenchFile("WriteIntToHandle, warm", WriteIntToHandle, true);
+
+    util_CloseFile(VoltageRef);
+    util_CloseFile(TempRef);
+    util_CloseFile(StatusRef);
+    util_CloseFile(LimitRef);
+
+    char command[PATH_MAX + 16];
+    snprintf(command, sizeof(command), "rm -rf '%s'", SysfsRoot);
+    LE_ASSERT(system(command) == 0);
+}
+
+
+int main
+(
+    int argc,
+    char *argv[]
+)
+{
+    if (argc > 1)
+    {
+        Iterations = strtoul(argv[1], NULL, 10);
+        LE_FATAL_IF(Iterations == 0, "Usage: %s [iterations]", argv[0]);
+    }
+
+    // The two must produce the same document for the comparison to be fair.
+    char jsonBuffer[256];
+    char printBuffer[256];
+    Sample_t sample;
+    for (unsigned long i = 0; i < 10000; i++)
+    {
+        MakeSample(i, &sample);
+        WriteJson(&sample, jsonBuffer, sizeof(jsonBuffer));
+        PrintJson(&sample, printBuffer, sizeof(printBuffer));
+        LE_FATAL_IF(strcmp(jsonBuffer, printBuffer) != 0, "'%s' != '%s'", jsonBuffer, printBuffer);
+    }
+
+    BenchFiles();
+    printf("\n");
+    BenchJson("JSON value, util_Json*()", WriteJson);
+    BenchJson("JSON value, snprintf()", PrintJson);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,1089 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file batteryUtilsTest.c
+ *
+ * Unit tests of batteryUtils, built on the host against the Legato shim (see CMakeLists.txt at the
+ * top of the tree).  The sysfs files are stood in for by a temporary directory, which
+ * BATTERY_SYSFS_ROOT points at.
+ *
+ * The uevent socket is faked: the test is linked with socket(), bind() and recvfrom() wrapped, so
+ * that a netlink socket is a local datagram socket whose messages the test sends itself, with
+ * any sender pid.
+ *
+ * Exits with status 0 if all the tests pass.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#include "legato.h"
+#include "batteryUtils.h"
+#include "powerSupply.h"
+#include "trace.h"
+#include "jsonWriter.h"
+#include <math.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <sys/wait.h>
+
+/// Number of checks that failed.
+static int NumFailures = 0;
+
+/// Temporary directory used as the sysfs root.
+static char SysfsRoot[] = "/tmp/batteryUtilsTest.XXXXXX";
+
+/// The fake netlink socket handed to the code under test, and the test's end of it.
+static int FakeNetlinkFd = -1;
+static int FakeSenderFd = -1;
+
+/// Check a condition, reporting it if it is false.
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            NumFailures++; \
+        } \
+    } \
+    while (0)
+
+/// Check that two results are equal, reporting both if not.
+#define CHECK_RESULT(actual, expected) \
+    do \
+    { \
+        le_result_t actualResult = (actual); \
+        if (actualResult != (expected)) \
+        { \
+            fprintf(stderr, "%s:%d: %s is %s, expected %s\n", __FILE__, __LINE__, #actual, \
+                    LE_RESULT_TXT(actualResult), LE_RESULT_TXT(expected)); \
+            NumFailures++; \
+        } \
+    } \
+    while (0)
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Write a file under the sysfs root, creating its directory if needed.
+ */
+//--------------------------------------------------------------------------------------------------
+static void WriteSysfsFile
+(
+    const char *relativePath,
+    const char *contents
+)
+{
+    char path[PATH_MAX];
+
+    snprintf(path, sizeof(path), "%s/%s", SysfsRoot, relativePath);
+    for (char *slashPtr = strchr(path + strlen(SysfsRoot) + 1, '/');
+         slashPtr != NULL;
+         slashPtr = strchr(slashPtr + 1, '/'))
+    {
+        *slashPtr = '\0';
+        LE_ASSERT((mkdir(path, 0755) == 0) || (errno == EEXIST));
+        *slashPtr = '/';
+    }
+
+    FILE *filePtr = fopen(path, "w");
+    LE_ASSERT(filePtr != NULL);
+    LE_ASSERT(fputs(contents, filePtr) >= 0);
+    LE_ASSERT(fclose(filePtr) == 0);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Sysfs paths are relative to BATTERY_SYSFS_ROOT, and handles read the current file contents.
+ */
+//--------------------------------------------------------------------------------------------------
+static void TestHandleReads
+(
+    void
+)
+{
+    CHECK(strcmp(util_GetSysfsRoot(), SysfsRoot) == 0);
+
+    WriteSysfsFile("class/power_supply/battery/voltage_now", "3900000\n");
+    WriteSysfsFile("class/power_supply/battery/status", "Charging\n");
+    WriteSysfsFile("class/power_supply/battery/temp", "25.5\n");
+    WriteSysfsFile("class/power_supply/battery/charge_limit", "80\n");
+
+    util_FileRef_t voltageRef = util_OpenSysfsFile("class/power_supply/battery/voltage_now",
+                                                   O_RDONLY);
+    util_FileRef_t statusRef = util_OpenSysfsFile("class/power_supply/battery/status", O_RDONLY);
+    util_FileRef_t tempRef = util_OpenSysfsFile("class/power_supply/battery/temp", O_RDONLY);
+    util_FileRef_t limitRef = util_OpenSysfsFile("class/power_supply/battery/charge_limit",
+                                                 O_WRONLY);
+    util_FileRef_t missingRef = util_OpenSysfsFile("class/power_supply/battery/missing",
+                                                   O_RDONLY);
+
+    int voltage = 0;
+    CHECK_RESULT(util_ReadIntFromHandle(voltageRef, &voltage), LE_OK);
+    CHECK(voltage == 3900000);
+
+    char status[16];
+    CHECK_RESULT(util_ReadStringFromHandle(statusRef, status, sizeof(status)), LE_OK);
+    CHECK(strcmp(status, "Charging") == 0);
+    CHECK_RESULT(util_ReadStringFromHandle(statusRef, status, 4), LE_OVERFLOW);
+
+    double temp = 0.0;
+    CHECK_RESULT(util_ReadDoubleFromHandle(tempRef, &temp), LE_OK);
+    CHECK(temp == 25.5);
+
+    // The handle re-reads the file from the start each time.
+    WriteSysfsFile("class/power_supply/battery/voltage_now", "3750000\n");
+    CHECK_RESULT(util_ReadIntFromHandle(voltageRef, &voltage), LE_OK);
+    CHECK(voltage == 3750000);
+
+    // Like sysfs attributes, the file is overwritten from the start without being truncated.
+    CHECK_RESULT(util_WriteIntToHandle(limitRef, 90), LE_OK);
+    int limit = 0;
+    CHECK_RESULT(util_ReadIntFromFile(util_GetFilePath(limitRef), &limit), LE_OK);
+    CHECK(limit == 90);
+
+    CHECK_RESULT(util_ReadIntFromHandle(missingRef, &voltage), LE_IO_ERROR);
+
+    // Opening is retried when the file appears.
+    WriteSysfsFile("class/power_supply/battery/missing", "-12\n");
+    CHECK_RESULT(util_ReadIntFromHandle(missingRef, &voltage), LE_OK);
+    CHECK(voltage == -12);
+
+    util_CloseFile(voltageRef);
+    util_CloseFile(statusRef);
+    util_CloseFile(tempRef);
+    util_CloseFile(limitRef);
+    util_CloseFile(missingRef);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Check that a vocabulary string, and near misses of it, are decoded correctly.
+ */
+//--------------------------------------------------------------------------------------------------
+static void CheckLookup
+(
+    int (*parseFunc)(const char *str, size_t len),
+    const char *str,
+    int expected,
+    int unrecognized
+)
+{
+    size_t len = strlen(str);
+    char buffer[64];
+
+    // The string needn't be null-terminated.
+    snprintf(buffer, sizeof(buffer), "%sX", str);
+    CHECK(parseFunc(buffer, len) == expected);
+
+    // Too long or too short.
+    CHECK(parseFunc(buffer, len + 1) == unrecognized);
+    CHECK(parseFunc(buffer, len - 1) == unrecognized);
+
+    // Wrong first or last character.
+    snprintf(buffer, sizeof(buffer), "%s", str);
+    buffer[0] ^= 0x20;
+    CHECK(parseFunc(buffer, len) == unrecognized);
+    buffer[0] ^= 0x20;
+    buffer[len - 1]++;
+    CHECK(parseFunc(buffer, len) == unrecognized);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Adapters of the parsers to CheckLookup().
+ */
+//--------------------------------------------------------------------------------------------------
+static int ParseStatus
+(
+    const char *str,
+    size_t len
+)
+{
+    return util_ParsePowerSupplyStatus(str, len);
+}
+
+static int ParseHealth
+(
+    const char *str,
+    size_t len
+)
+{
+    return util_ParsePowerSupplyHealth(str, len);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Every string of the power_supply "status" and "health" vocabularies is decoded, and nothing
+ * else is.
+ */
+//--------------------------------------------------------------------------------------------------
+static void TestPowerSupplyLookup
+(
+    void
+)
+{
+    static const struct
+    {
+        const char *str;
+        util_PowerSupplyStatus_t status;
+    }
+    statuses[] =
+    {
+        { "Unknown", UTIL_STATUS_UNKNOWN },
+        { "Charging", UTIL_STATUS_CHARGING },
+        { "Discharging", UTIL_STATUS_DISCHARGING },
+        { "Not charging", UTIL_STATUS_NOT_CHARGING },
+        { "Full", UTIL_STATUS_FULL },
+    };
+
+    static const struct
+    {
+        const char *str;
+        util_PowerSupplyHealth_t health;
+    }
+    healths[] =
+    {
+        { "Unknown", UTIL_HEALTH_UNKNOWN },
+        { "Good", UTIL_HEALTH_GOOD },
+        { "Overheat", UTIL_HEALTH_OVERHEAT },
+        { "Dead", UTIL_HEALTH_DEAD },
+        { "Over voltage", UTIL_HEALTH_OVERVOLTAGE },
+        { "Overvoltage", UTIL_HEALTH_OVERVOLTAGE },
+        { "Unspecified failure", UTIL_HEALTH_UNSPEC_FAILURE },
+        { "Cold", UTIL_HEALTH_COLD },
+        { "Watchdog timer expire", UTIL_HEALTH_WATCHDOG_TIMER_EXPIRE },
+        { "Safety timer expire", UTIL_HEALTH_SAFETY_TIMER_EXPIRE },
+        { "Over current", UTIL_HEALTH_OVERCURRENT },
+        { "Calibration required", UTIL_HEALTH_CALIBRATION_REQUIRED },
+        { "Warm", UTIL_HEALTH_WARM },
+        { "Cool", UTIL_HEALTH_COOL },
+        { "Hot", UTIL_HEALTH_HOT },
+        { "No battery", UTIL_HEALTH_NO_BATTERY },
+    };
+
+    for (size_t i = 0; i < NUM_ARRAY_MEMBERS(statuses); i++)
+    {
+        CheckLookup(ParseStatus, statuses[i].str, statuses[i].status, UTIL_STATUS_UNRECOGNIZED);
+        CHECK(util_ParsePowerSupplyHealth(statuses[i].str, strlen(statuses[i].str)) ==
+              ((strcmp(statuses[i].str, "Unknown") == 0) ?
+                   UTIL_HEALTH_UNKNOWN : UTIL_HEALTH_UNRECOGNIZED));
+    }
+
+    for (size_t i = 0; i < NUM_ARRAY_MEMBERS(healths); i++)
+    {
+        CheckLookup(ParseHealth, healths[i].str, healths[i].health, UTIL_HEALTH_UNRECOGNIZED);
+    }
+
+    CHECK(util_ParsePowerSupplyStatus("", 0) == UTIL_STATUS_UNRECOGNIZED);
+    CHECK(util_ParsePowerSupplyHealth("", 0) == UTIL_HEALTH_UNRECOGNIZED);
+    CHECK(util_ParsePowerSupplyStatus("charging", 8) == UTIL_STATUS_UNRECOGNIZED);
+    CHECK(util_ParsePowerSupplyHealth("Watchdog timer expired", 22) == UTIL_HEALTH_UNRECOGNIZED);
+
+    // Through a file: the newline is stripped, and an overlong value is not recognized.
+    WriteSysfsFile("class/power_supply/battery/status", "Not charging\n");
+    WriteSysfsFile("class/power_supply/battery/health", "Watchdog timer expire and more\n");
+    util_FileRef_t statusRef = util_OpenSysfsFile("class/power_supply/battery/status", O_RDONLY);
+    util_FileRef_t healthRef = util_OpenSysfsFile("class/power_supply/battery/health", O_RDONLY);
+
+    util_PowerSupplyStatus_t status;
+    CHECK_RESULT(util_ReadPowerSupplyStatus(statusRef, &status), LE_OK);
+    CHECK(status == UTIL_STATUS_NOT_CHARGING);
+
+    util_PowerSupplyHealth_t health;
+    CHECK_RESULT(util_ReadPowerSupplyHealth(healthRef, &health), LE_NOT_FOUND);
+    CHECK(health == UTIL_HEALTH_UNRECOGNIZED);
+
+    WriteSysfsFile("class/power_supply/battery/health", "Good\n");
+    CHECK_RESULT(util_ReadPowerSupplyHealth(healthRef, &health), LE_OK);
+    CHECK(health == UTIL_HEALTH_GOOD);
+
+    util_CloseFile(statusRef);
+    util_CloseFile(healthRef);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Replace the contents of a file.
+ */
+//--------------------------------------------------------------------------------------------------
+static void SetFileContents
+(
+    int fd,
+    const char *contents,
+    size_t len
+)
+{
+    LE_ASSERT(ftruncate(fd, 0) == 0);
+    LE_ASSERT(pwrite(fd, contents, len, 0) == (ssize_t)len);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Reference integer parser, built on strtoll(), for the contents of a file read into a buffer of
+ * bufferSize bytes: one trailing newline, leading whitespace and a sign are accepted.
+ *
+ * @return The result util_ReadInt64FromHandle() (or util_ReadIntFromHandle()) must give.
+ */
+//--------------------------------------------------------------------------------------------------
+static le_result_t ReferenceParse
+(
+    const char *contents,
+    size_t len,
+    size_t bufferSize,
+    int64_t min,
+    int64_t max,
+    int64_t *valuePtr
+)
+{
+    if (len >= bufferSize)
+    {
+        return LE_OVERFLOW;
+    }
+
+    char str[64];
+    memcpy(str, contents, len);
+    if ((len > 0) && (str[len - 1] == '\n'))
+    {
+        len--;
+    }
+    str[len] = '\0';
+
+    // strtoll() also skips leading whitespace, but must not see the sign of an empty number.
+    const char *startPtr = str;
+    while ((*startPtr == ' ') || ((*startPtr >= '\t') && (*startPtr <= '\r')))
+    {
+        startPtr++;
+    }
+    if (((startPtr[0] == '-') || (startPtr[0] == '+')) &&
+        ((startPtr[1] < '0') || (startPtr[1] > '9')))
+    {
+        return LE_FORMAT_ERROR;
+    }
+
+    char *endPtr;
+    errno = 0;
+    long long value = strtoll(startPtr, &endPtr, 10);
+    if (errno == ERANGE)
+    {
+        return LE_OVERFLOW;
+    }
+    if ((endPtr == startPtr) || (endPtr != str + len))
+    {
+        return LE_FORMAT_ERROR;
+    }
+    if ((value < min) || (value > max))
+    {
+        return LE_OVERFLOW;
+    }
+
+    *valuePtr = value;
+    return LE_OK;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Read an integer through both handle readers, and compare them with the reference parser.
+ */
+//--------------------------------------------------------------------------------------------------
+static void CheckIntParse
+(
+    int fd,
+    util_FileRef_t fileRef,
+    const char *contents,
+    size_t len
+)
+{
+    SetFileContents(fd, contents, len);
+
+    int64_t expected64 = 0;
+    le_result_t expectedResult = ReferenceParse(contents, len, 24, INT64_MIN, INT64_MAX,
+                                                &expected64);
+    int64_t value64 = 0;
+    le_result_t result = util_ReadInt64FromHandle(fileRef, &value64);
+    if ((result != expectedResult) || ((result == LE_OK) && (value64 != expected64)))
+    {
+        fprintf(stderr, "int64 '%.*s': %s %" PRId64 ", expected %s %" PRId64 "\n", (int)len,
+                contents, LE_RESULT_TXT(result), value64, LE_RESULT_TXT(expectedResult),
+                expected64);
+        NumFailures++;
+    }
+
+    expectedResult = ReferenceParse(contents, len, 16, INT_MIN, INT_MAX, &expected64);
+    int value = 0;
+    result = util_ReadIntFromHandle(fileRef, &value);
+    if ((result != expectedResult) || ((result == LE_OK) && (value != expected64)))
+    {
+        fprintf(stderr, "int '%.*s': %s %d, expected %s %" PRId64 "\n", (int)len, contents,
+                LE_RESULT_TXT(result), value, LE_RESULT_TXT(expectedResult), expected64);
+        NumFailures++;
+    }
+
+    // The path-based reader leaves room for a terminator in its 16 byte buffer.
+    expectedResult = ReferenceParse(contents, len, 15, INT_MIN, INT_MAX, &expected64);
+    value = 0;
+    result = util_ReadIntFromFile(util_GetFilePath(fileRef), &value);
+    if ((result != expectedResult) || ((result == LE_OK) && (value != expected64)))
+    {
+        fprintf(stderr, "file int '%.*s': %s %d, expected %s %" PRId64 "\n", (int)len, contents,
+                LE_RESULT_TXT(result), value, LE_RESULT_TXT(expectedResult), expected64);
+        NumFailures++;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Reference floating point parser, the sscanf() code that the double readers used to have, for
+ * the contents of a file read into a buffer of bufferSize bytes.
+ *
+ * @return The result util_ReadDoubleFromHandle() must give.
+ */
+//--------------------------------------------------------------------------------------------------
+static le_result_t ReferenceParseDouble
+(
+    const char *contents,
+    size_t len,
+    size_t bufferSize,
+    double *valuePtr
+)
+{
+    if (len >= bufferSize)
+    {
+        return LE_OVERFLOW;
+    }
+
+    char str[64];
+    memcpy(str, contents, len);
+    if ((len > 0) && (str[len - 1] == '\n'))
+    {
+        len--;
+    }
+    str[len] = '\0';
+
+    int charsScanned = 0;
+    if ((sscanf(str, "%lf%n", valuePtr, &charsScanned) == 1) && (charsScanned == strlen(str)))
+    {
+        return LE_OK;
+    }
+
+    return LE_FORMAT_ERROR;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Read a floating point number through both double readers, and compare them with the reference
+ * parser.  The values must be identical, not just close.
+ */
+//--------------------------------------------------------------------------------------------------
+static void CheckDoubleParse
+(
+    int fd,
+    util_FileRef_t fileRef,
+    const char *contents,
+    size_t len
+)
+{
+    SetFileContents(fd, contents, len);
+
+    for (int isFile = 0; isFile < 2; isFile++)
+    {
+        double expected = 0;
+        le_result_t expectedResult = ReferenceParseDouble(contents, len, isFile ? 31 : 32,
+                                                          &expected);
+        double value = 0;
+        le_result_t result = isFile ?
+                             util_ReadDoubleFromFile(util_GetFilePath(fileRef), &value) :
+                             util_ReadDoubleFromHandle(fileRef, &value);
+        if (   (result != expectedResult)
+            || (   (result == LE_OK)
+                && (memcmp(&value, &expected, sizeof(value)) != 0)
+                && !(isnan(value) && isnan(expected))  )  )
+        {
+            fprintf(stderr, "%s double '%.*s': %s %.17g, expected %s %.17g\n",
+                    isFile ? "file" : "handle", (int)len, contents, LE_RESULT_TXT(result), value,
+                    LE_RESULT_TXT(expectedResult), expected);
+            NumFailures++;
+        }
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Fuzz the integer parser of the handle readers against strtoll(), with edge cases and random
+ * strings of digits, signs, whitespace and other characters.
+ */
+//--------------------------------------------------------------------------------------------------
+static void TestIntParseFuzz
+(
+    void
+)
+{
+    static const char *const edgeCases[] =
+    {
+        "", "\n", "\n\n", " ", "-", "+", "-\n", "0", "-0", "+0", "7\n", " \t\n7\n", "7 ", "7\n\n",
+        "- 7", "+-7", "0x10", "1e3", "12a", "a12",
+        "2147483647", "2147483648", "-2147483648", "-2147483649",
+        "9223372036854775807", "9223372036854775808\n",
+        "-9223372036854775808", "-9223372036854775809",
+        "99999999999999999999", "99999999999999999999x", "000000000000000000001\n",
+        "00000000000000000000001",
+    };
+
+    WriteSysfsFile("class/power_supply/battery/fuzz", "");
+    util_FileRef_t fileRef = util_OpenSysfsFile("class/power_supply/battery/fuzz", O_RDONLY);
+    int fd = open(util_GetFilePath(fileRef), O_WRONLY);
+    LE_ASSERT(fd >= 0);
+
+    for (size_t i = 0; i < NUM_ARRAY_MEMBERS(edgeCases); i++)
+    {
+        CheckIntParse(fd, fileRef, edgeCases[i], strlen(edgeCases[i]));
+    }
+
+    // Mostly digits, so that many strings are valid numbers of every length.
+    static const char alphabet[] = "0123456789012345678901234567890123456789 \t\n-+x.\0";
+    uint32_t seed = 12345;
+
+    for (int i = 0; i < 20000; i++)
+    {
+        char contents[32];
+
+        seed = (seed * 1103515245) + 12345;
+        size_t len = (seed >> 16) % sizeof(contents);
+        for (size_t j = 0; j < len; j++)
+        {
+            seed = (seed * 1103515245) + 12345;
+            contents[j] = alphabet[(seed >> 16) % (sizeof(alphabet) - 1)];
+        }
+
+        CheckIntParse(fd, fileRef, contents, len);
+    }
+
+    close(fd);
+    util_CloseFile(fileRef);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Fuzz the floating point parser of the double readers against the sscanf() code it replaced,
+ * with edge cases and random strings of digits, decimal points, signs, whitespace and exponents.
+ */
+//--------------------------------------------------------------------------------------------------
+static void TestDoubleParseFuzz
+(
+    void
+)
+{
+    static const char *const edgeCases[] =
+    {
+        "", "\n", ".", "-.", "+.\n", "0", "-0", "-0.0\n", "1.", ".5", "1.5\n", "1.5\n\n", " 1.5",
+        "1.5 ", "1..5", "1.5.", "31.2\n", "-120.512", "3.912", "1e3", "1E-3\n", "0x1p3", "inf",
+        "-nan", "9007199254740992", "9007199254740993", "9007199254740993.5",
+        "0.1", "0.3", "2.2250738585072014", "0.0000000000000000000001",
+        "0.00000000000000000000001", "123456789012345678901234567890",
+        "12345678901234567890123456789012", "1.5\0" "2",
+    };
+
+    WriteSysfsFile("class/power_supply/battery/fuzz", "");
+    util_FileRef_t fileRef = util_OpenSysfsFile("class/power_supply/battery/fuzz", O_RDONLY);
+    int fd = open(util_GetFilePath(fileRef), O_WRONLY);
+    LE_ASSERT(fd >= 0);
+
+    for (size_t i = 0; i < NUM_ARRAY_MEMBERS(edgeCases) - 1; i++)
+    {
+        CheckDoubleParse(fd, fileRef, edgeCases[i], strlen(edgeCases[i]));
+    }
+    // The last one has a null character in it.
+    CheckDoubleParse(fd, fileRef, edgeCases[NUM_ARRAY_MEMBERS(edgeCases) - 1], 5);
+
+    static const char alphabet[] = "0123456789012345678901234567890123456789.... \n-+e\0";
+    uint32_t seed = 54321;
+
+    for (int i = 0; i < 20000; i++)
+    {
+        char contents[36];
+
+        seed = (seed * 1103515245) + 12345;
+        size_t len = (seed >> 16) % sizeof(contents);
+        for (size_t j = 0; j < len; j++)
+        {
+            seed = (seed * 1103515245) + 12345;
+            contents[j] = alphabet[(seed >> 16) % (sizeof(alphabet) - 1)];
+        }
+
+        CheckDoubleParse(fd, fileRef, contents, len);
+    }
+
+    close(fd);
+    util_CloseFile(fileRef);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Check that a document written with the JSON writer is the same as one printed by snprintf().
+ */
+//--------------------------------------------------------------------------------------------------
+static void CheckJson
+(
+    util_JsonWriter_t *writerPtr,
+    const char *expected
+)
+{
+    size_t len;
+    CHECK_RESULT(util_JsonEnd(writerPtr, &len), LE_OK);
+    if ((strcmp(writerPtr->bufferPtr, expected) != 0) || (len != strlen(expected)))
+    {
+        fprintf(stderr, "JSON '%s', expected '%s'\n", writerPtr->bufferPtr, expected);
+        NumFailures++;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * The JSON writer gives the same output as the snprintf() formats it replaced, including the
+ * rounding of "%.<decimals>f", and computes the exact length of documents that don't fit.
+ */
+//--------------------------------------------------------------------------------------------------
+static void TestJsonWriter
+(
+    void
+)
+{
+    char buffer[256];
+    char expected[256];
+    util_JsonWriter_t writer;
+
+    // The Data Hub value of a battery.
+    util_JsonBegin(&writer, buffer, sizeof(buffer));
+    util_JsonAddString(&writer, "health", "good");
+    util_JsonAddInt(&writer, "%EL", 87);
+    util_JsonAddInt(&writer, "mAh", 1843);
+    util_JsonAddBool(&writer, "charging", false);
+    util_JsonAddDecimal(&writer, "mA", -412.0625, 3);
+    util_JsonAddDecimal(&writer, "V", 3.875, 2);
+    util_JsonAddDecimal(&writer, "degC", 24.994999, 2);
+    util_JsonAddInt(&writer, "timeToEmpty", 16117);
+    snprintf(expected, sizeof(expected),
+             "{\"health\":\"%s\",\"%%EL\":%u,\"mAh\":%u,\"charging\":%s,\"mA\":%.3lf,"
+             "\"V\":%.2lf,\"degC\":%.2lf,\"timeToEmpty\":%u}",
+             "good", 87, 1843, "false", -412.0625, 3.875, 24.994999, 16117);
+    CheckJson(&writer, expected);
+
+    // Integers, fixed-point numbers and escaped strings.
+    util_JsonBegin(&writer, buffer, sizeof(buffer));
+    util_JsonAddInt(&writer, "min", INT64_MIN);
+    util_JsonAddInt(&writer, "max", INT64_MAX);
+    util_JsonAddFixed(&writer, "fixed", -5, 3);
+    util_JsonAddFixedArray(&writer, "array", (const int32_t[]){ 3712, -1, 0 }, 3, 3);
+    util_JsonAddString(&writer, "a\"b", "c\\d\n\x01");
+    util_JsonAddDecimal(&writer, "nan", NAN, 2);
+    util_JsonAddBool(&writer, "true", true);
+    snprintf(expected, sizeof(expected),
+             "{\"min\":%" PRId64 ",\"max\":%" PRId64 ",\"fixed\":-0.005,"
+             "\"array\":[3.712,-0.001,0.000],\"a\\\"b\":\"c\\\\d\\u000a\\u0001\","
+             "\"nan\":null,\"true\":true}",
+             INT64_MIN, INT64_MAX);
+    CheckJson(&writer, expected);
+
+    // Random numbers of every magnitude, and decimal fractions near rounding ties.
+    uint32_t seed = 54321;
+    for (int i = 0; i < 100000; i++)
+    {
+        seed = (seed * 1103515245) + 12345;
+        unsigned int decimals = (seed >> 16) % 10;
+        seed = (seed * 1103515245) + 12345;
+        double value;
+        if ((i % 2) == 0)
+        {
+            value = (int32_t)seed / pow(2.0, (seed >> 8) % 40);
+        }
+        else
+        {
+            value = ((int32_t)seed % 1000000) / pow(10.0, (decimals + 1) % 7);
+        }
+
+        util_JsonBegin(&writer, buffer, sizeof(buffer));
+        util_JsonAddDecimal(&writer, "v", value, decimals);
+        snprintf(expected, sizeof(expected), "{\"v\":%.*f}", (int)decimals, value);
+        CheckJson(&writer, expected);
+    }
+
+    // A document that doesn't fit is truncated, and its exact length is reported.
+    util_JsonBegin(&writer, buffer, 8);
+    util_JsonAddString(&writer, "health", "overheat");
+    size_t len;
+    CHECK_RESULT(util_JsonEnd(&writer, &len), LE_OVERFLOW);
+    CHECK(len == strlen("{\"health\":\"overheat\"}"));
+    CHECK(strcmp(buffer, "{\"healt") == 0);
+
+    util_JsonBegin(&writer, NULL, 0);
+    util_JsonAddInt(&writer, "mAh", 1843);
+    CHECK_RESULT(util_JsonEnd(&writer, &len), LE_OVERFLOW);
+    CHECK(len == strlen("{\"mAh\":1843}"));
+}
+
+
+int __real_socket(int domain, int type, int protocol);
+int __real_bind(int fd, const struct sockaddr *addrPtr, socklen_t addrLen);
+ssize_t __real_recvfrom(int fd, void *buffer, size_t size, int flags, struct sockaddr *addrPtr,
+                        socklen_t *addrLenPtr);
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Wrapper of socket().  A uevent netlink socket is replaced by a local datagram socket.
+ */
+//--------------------------------------------------------------------------------------------------
+int __wrap_socket
+(
+    int domain,
+    int type,
+    int protocol
+)
+{
+    if ((domain != AF_NETLINK) || (protocol != NETLINK_KOBJECT_UEVENT))
+    {
+        return __real_socket(domain, type, protocol);
+    }
+
+    int fds[2];
+    if (socketpair(AF_UNIX, type, 0, fds) != 0)
+    {
+        return -1;
+    }
+
+    FakeNetlinkFd = fds[0];
+    FakeSenderFd = fds[1];
+
+    return FakeNetlinkFd;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Wrapper of bind().  The fake netlink socket must be bound to the kernel uevent group.
+ */
+//--------------------------------------------------------------------------------------------------
+int __wrap_bind
+(
+    int fd,
+    const struct sockaddr *addrPtr,
+    socklen_t addrLen
+)
+{
+    if (fd != FakeNetlinkFd)
+    {
+        return __real_bind(fd, addrPtr, addrLen);
+    }
+
+    const struct sockaddr_nl *nlAddrPtr = (const struct sockaddr_nl *)addrPtr;
+    CHECK(addrLen == sizeof(struct sockaddr_nl));
+    CHECK(nlAddrPtr->nl_family == AF_NETLINK);
+    CHECK(nlAddrPtr->nl_groups == 1);
+
+    return 0;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Wrapper of recvfrom().  A message on the fake netlink socket starts with the sender's pid,
+ * which is returned in the sender's address.
+ */
+//--------------------------------------------------------------------------------------------------
+ssize_t __wrap_recvfrom
+(
+    int fd,
+    void *buffer,
+    size_t size,
+    int flags,
+    struct sockaddr *addrPtr,
+    socklen_t *addrLenPtr
+)
+{
+    if (fd != FakeNetlinkFd)
+    {
+        return __real_recvfrom(fd, buffer, size, flags, addrPtr, addrLenPtr);
+    }
+
+    uint8_t message[sizeof(uint32_t) + 4096];
+    ssize_t len = recv(fd, message, sizeof(message), flags);
+    if (len < 0)
+    {
+        return -1;
+    }
+    LE_ASSERT(len >= (ssize_t)sizeof(uint32_t));
+
+    struct sockaddr_nl sender;
+    memset(&sender, 0, sizeof(sender));
+    sender.nl_family = AF_NETLINK;
+    memcpy(&sender.nl_pid, message, sizeof(uint32_t));
+    LE_ASSERT(*addrLenPtr >= sizeof(sender));
+    memcpy(addrPtr, &sender, sizeof(sender));
+    *addrLenPtr = sizeof(sender);
+
+    len -= sizeof(uint32_t);
+    if ((size_t)len > size)
+    {
+        len = size;
+    }
+    memcpy(buffer, message + sizeof(uint32_t), len);
+
+    return len;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Send a uevent on the fake netlink socket.  The message is given as a string of lines separated
+ * by '|', which are sent null-terminated.
+ */
+//--------------------------------------------------------------------------------------------------
+static void SendUevent
+(
+    uint32_t senderPid,     ///< 0 for the kernel.
+    const char *lines
+)
+{
+    uint8_t message[sizeof(uint32_t) + 512];
+    size_t len = strlen(lines) + 1;
+    LE_ASSERT(len <= sizeof(message) - sizeof(uint32_t));
+
+    memcpy(message, &senderPid, sizeof(uint32_t));
+    memcpy(message + sizeof(uint32_t), lines, len);
+    for (size_t i = sizeof(uint32_t); i < sizeof(uint32_t) + len; i++)
+    {
+        if (message[i] == '|')
+        {
+            message[i] = '\0';
+        }
+    }
+
+    LE_ASSERT(send(FakeSenderFd, message, sizeof(uint32_t) + len, 0) ==
+              (ssize_t)(sizeof(uint32_t) + len));
+}
+
+
+/// Power supply events received by TestPowerSupplyEvents().
+static int NumSupplyEvents = 0;
+static char LastSupplyName[32];
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Power supply event handler of TestPowerSupplyEvents().
+ */
+//--------------------------------------------------------------------------------------------------
+static void SupplyEventHandler
+(
+    const char *supplyName,
+    void *contextPtr
+)
+{
+    CHECK(contextPtr == &NumSupplyEvents);
+
+    NumSupplyEvents++;
+    snprintf(LastSupplyName, sizeof(LastSupplyName), "%s", supplyName);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Run the main thread's event loop until nothing is pending.
+ */
+//--------------------------------------------------------------------------------------------------
+static void ServiceEvents
+(
+    void
+)
+{
+    while (le_event_ServiceLoop() == LE_OK)
+    {
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Power supply uevents from the kernel call the handler with the supply's name; other uevents,
+ * and uevents sent by processes, are ignored.
+ */
+//--------------------------------------------------------------------------------------------------
+static void TestPowerSupplyEvents
+(
+    void
+)
+{
+    CHECK_RESULT(util_AddPowerSupplyEventHandler(SupplyEventHandler, &NumSupplyEvents), LE_OK);
+    CHECK(FakeNetlinkFd >= 0);
+    CHECK_RESULT(util_AddPowerSupplyEventHandler(SupplyEventHandler, &NumSupplyEvents),
+                 LE_DUPLICATE);
+
+    SendUevent(0, "change@/devices/platform/bq24190|ACTION=change|SUBSYSTEM=power_supply|"
+                  "POWER_SUPPLY_NAME=bq24190-charger|POWER_SUPPLY_STATUS=Charging");
+    ServiceEvents();
+    CHECK(NumSupplyEvents == 1);
+    CHECK(strcmp(LastSupplyName, "bq24190-charger") == 0);
+
+    // Another subsystem, and a power_supply uevent forged by a process.
+    SendUevent(0, "add@/devices/virtual/net/tun0|ACTION=add|SUBSYSTEM=net|INTERFACE=tun0");
+    SendUevent(1234, "change@/devices/platform/bq27426|ACTION=change|SUBSYSTEM=power_supply|"
+                     "POWER_SUPPLY_NAME=bq27426-0");
+    ServiceEvents();
+    CHECK(NumSupplyEvents == 1);
+
+    // Several pending uevents are all handled, including one without a supply name.
+    SendUevent(0, "change@/devices/platform/bq27426|SUBSYSTEM=power_supply|"
+                  "POWER_SUPPLY_NAME=bq27426-0");
+    SendUevent(0, "change@/devices/platform/ac|SUBSYSTEM=power_supply");
+    ServiceEvents();
+    CHECK(NumSupplyEvents == 3);
+    CHECK(strcmp(LastSupplyName, "") == 0);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * While replaying a trace, values come from the trace, and the clock follows their recorded
+ * times.  Runs in a child process, as the replay must start before any file is opened.
+ */
+//--------------------------------------------------------------------------------------------------
+static void TestReplayClock
+(
+    void
+)
+{
+    // Values of "voltage_now" recorded at 0 s, 10 s and 70.5 s, with a failed read at 80 s, and
+    // the path of a file of the power supply "M" under the sysfs root "s".
+    static const uint8_t trace[] =
+    {
+        'B', 'T', 'R', 'C', 1,
+        0xFF, 0, 11, 'v', 'o', 'l', 't', 'a', 'g', 'e', '_', 'n', 'o', 'w',
+        0xFF, 1, 24, 's', '/', 'c', 'l', 'a', 's', 's', '/', 'p', 'o', 'w', 'e', 'r', '_',
+                     's', 'u', 'p', 'p', 'l', 'y', '/', 'M', '/', 't',
+        0, 0x00, 0x00, 0x00, 0x00, 8, '3', '9', '0', '0', '0', '0', '0', '\n',
+        0, 0x10, 0x27, 0x00, 0x00, 8, '3', '8', '9', '0', '0', '0', '0', '\n',
+        0, 0x64, 0x13, 0x01, 0x00, 8, '3', '8', '8', '0', '0', '0', '0', '\n',
+        0, 0x80, 0x38, 0x01, 0x00, 0xFF,
+    };
+
+    char tracePath[PATH_MAX];
+    snprintf(tracePath, sizeof(tracePath), "%s/trace", SysfsRoot);
+    FILE *filePtr = fopen(tracePath, "w");
+    LE_ASSERT(filePtr != NULL);
+    LE_ASSERT(fwrite(trace, 1, sizeof(trace), filePtr) == sizeof(trace));
+    LE_ASSERT(fclose(filePtr) == 0);
+    LE_ASSERT(setenv("BATTERY_REPLAY_FILE", tracePath, 1) == 0);
+
+    CHECK(util_IsReplaying());
+
+    // Only the power supplies that the trace has files of are present.
+    LE_ASSERT(setenv("BATTERY_SYSFS_ROOT", "s", 1) == 0);
+    CHECK(util_IsPowerSupplyPresent("M"));
+    CHECK(!util_IsPowerSupplyPresent("N"));
+    CHECK(!util_IsPowerSupplyPresent("t"));
+    LE_ASSERT(setenv("BATTERY_SYSFS_ROOT", SysfsRoot, 1) == 0);
+
+    // The file doesn't exist; its values come from the trace.
+    util_FileRef_t fileRef = util_OpenFile("voltage_now", O_RDONLY);
+    le_clk_Time_t startTime = util_GetRelativeTime();
+    uint64_t startEpochMs = util_GetEpochMs();
+
+    int voltage;
+    CHECK_RESULT(util_ReadIntFromHandle(fileRef, &voltage), LE_OK);
+    CHECK(voltage == 3900000);
+    CHECK(util_MsSince(startTime) == 0);
+
+    CHECK_RESULT(util_ReadIntFromHandle(fileRef, &voltage), LE_OK);
+    CHECK(voltage == 3890000);
+    CHECK(util_MsSince(startTime) == 10000);
+
+    // The clock doesn't move between reads, however long they take.
+    le_clk_Time_t sampleTime = util_GetRelativeTime();
+    usleep(20000);
+    CHECK(util_MsSince(sampleTime) == 0);
+
+    CHECK_RESULT(util_ReadIntFromHandle(fileRef, &voltage), LE_OK);
+    CHECK(voltage == 3880000);
+    CHECK(util_MsSince(startTime) == 70500);
+    CHECK(util_MsSince(sampleTime) == 60500);
+    CHECK(util_GetEpochMs() - startEpochMs == 70500);
+
+    CHECK_RESULT(util_ReadIntFromHandle(fileRef, &voltage), LE_IO_ERROR);
+    CHECK(util_MsSince(startTime) == 80000);
+
+    // Writes are discarded, and the host's uevents are not listened to.
+    CHECK_RESULT(util_WriteIntToHandle(fileRef, 1), LE_OK);
+    CHECK_RESULT(util_AddPowerSupplyEventHandler(SupplyEventHandler, NULL), LE_OK);
+    CHECK(FakeNetlinkFd < 0);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Run a test in a child process.
+ */
+//--------------------------------------------------------------------------------------------------
+static void RunInChild
+(
+    void (*testFunc)(void)
+)
+{
+    pid_t pid = fork();
+    LE_ASSERT(pid >= 0);
+
+    if (pid == 0)
+    {
+        testFunc();
+        _exit((NumFailures == 0) ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    int status;
+    LE_ASSERT(waitpid(pid, &status, 0) == pid);
+    if (!WIFEXITED(status) || (WEXITSTATUS(status) != EXIT_SUCCESS))
+    {
+        fprintf(stderr, "Child test failed (status 0x%x).\n", status);
+        NumFailures++;
+    }
+}
+
+
+int main
+(
+    void
+)
+{
+    LE_ASSERT(mkdtemp(SysfsRoot) != NULL);
+    LE_ASSERT(setenv("BATTERY_SYSFS_ROOT", SysfsRoot, 1) == 0);
+
+    RunInChild(TestReplayClock);
+    TestHandleReads();
+    TestPowerSupplyLookup();
+    TestIntParseFuzz();
+    TestDoubleParseFuzz();
+    TestJsonWriter();
+    TestPowerSupplyEvents();
+
+    char command[PATH_MAX + 16];
+    snprintf(command, sizeof(command), "rm -rf '%s'", SysfsRoot);
+    LE_ASSERT(system(command) == 0);
+
+    if (NumFailures > 0)
+    {
+        fprintf(stderr, "%d checks failed.\n", NumFailures);
+        return EXIT_FAILURE;
+    }
+
+    printf("All tests passed.\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,493 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file trace.c
+ *
+ * Recording and replay of the raw values read from the battery driver files.  See trace.h for
+ * the trace file format.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#include "legato.h"
+#include "trace.h"
+#include "batteryUtils.h"
+#include <sys/mman.h>
+
+/// Environment variable naming the file to record a trace into.
+#define TRACE_FILE_ENV_VAR "BATTERY_TRACE_FILE"
+
+/// Environment variable naming the trace file to replay.
+#define REPLAY_FILE_ENV_VAR "BATTERY_REPLAY_FILE"
+
+/// Header at the start of a trace file.
+static const uint8_t Header[] = { 'B', 'T', 'R', 'C', 1 };
+
+/// First byte of a path record.
+#define PATH_RECORD_TAG 0xFF
+
+/// Length of a value record whose read failed.
+#define FAILED_READ_LEN 0xFF
+
+/// Largest id that can be given to a path (ids must not collide with PATH_RECORD_TAG).
+#define MAX_PATH_ID 0xFE
+
+/// Size of a value record, excluding the value.
+#define VALUE_RECORD_OVERHEAD 6
+
+/// true once the environment variables have been checked.
+static bool IsInitialized = false;
+
+/// File descriptor of the trace being recorded, or -1 if not recording.
+static int RecordFd = -1;
+
+/// When recording started (monotonic clock).
+static le_clk_Time_t RecordStart;
+
+/// Id to give to the next path added to the trace being recorded.
+static int NextRecordId = 0;
+
+/// The trace being replayed (mapped into memory), or NULL if not replaying.
+static const uint8_t *ReplayPtr = NULL;
+
+/// Size of the trace being replayed (bytes).
+static size_t ReplaySize = 0;
+
+/// When replay started, on the monotonic clock and as ms since the Epoch.
+static le_clk_Time_t ReplayStartTime;
+static uint64_t ReplayStartEpochMs;
+
+/// Recorded time of the latest value replayed (ms since recording started).  Written by the
+/// thread that reads the files, read by any thread.
+static uint32_t ReplayMs = 0;
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Append bytes to the trace being recorded.  Recording stops if the write fails.
+ */
+//--------------------------------------------------------------------------------------------------
+static void Write
+(
+    const uint8_t *bytes,
+    size_t numBytes
+)
+{
+    while (numBytes > 0)
+    {
+        ssize_t numWritten = write(RecordFd, bytes, numBytes);
+        if (numWritten < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            LE_ERROR("Failed to write trace file. Recording stopped - %m");
+            close(RecordFd);
+            RecordFd = -1;
+            return;
+        }
+
+        bytes += numWritten;
+        numBytes -= numWritten;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Start recording a trace into a file, replacing anything already in it.
+ */
+//--------------------------------------------------------------------------------------------------
+static void StartRecording
+(
+    const char *path
+)
+{
+    RecordFd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (RecordFd < 0)
+    {
+        LE_ERROR("Couldn't create trace file '%s' - %m", path);
+        return;
+    }
+
+    RecordStart = le_clk_GetRelativeTime();
+    Write(Header, sizeof(Header));
+
+    LE_INFO("Recording trace to '%s'.", path);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Map a trace file into memory for replay.
+ */
+//--------------------------------------------------------------------------------------------------
+static void StartReplay
+(
+    const char *path
+)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    LE_FATAL_IF(fd < 0, "Couldn't open replay file '%s' - %m", path);
+
+    struct stat fileStat;
+    LE_FATAL_IF(fstat(fd, &fileStat) != 0, "Couldn't stat replay file '%s' - %m", path);
+    LE_FATAL_IF(fileStat.st_size < sizeof(Header), "Replay file '%s' is too short.", path);
+
+    void *mapPtr = mmap(NULL, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    LE_FATAL_IF(mapPtr == MAP_FAILED, "Couldn't map replay file '%s' - %m", path);
+    close(fd);
+
+    LE_FATAL_IF(memcmp(mapPtr, Header, sizeof(Header)) != 0,
+                "'%s' is not a battery trace file.", path);
+
+    ReplayPtr = mapPtr;
+    ReplaySize = fileStat.st_size;
+    ReplayStartTime = le_clk_GetRelativeTime();
+    le_clk_Time_t now = le_clk_GetAbsoluteTime();
+    ReplayStartEpochMs = ((uint64_t)now.sec * 1000) + (now.usec / 1000);
+
+    LE_INFO("Replaying trace from '%s'.", path);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Start recording and/or replaying, if requested through the environment.  Only done once.
+ */
+//--------------------------------------------------------------------------------------------------
+static void Init
+(
+    void
+)
+{
+    if (IsInitialized)
+    {
+        return;
+    }
+    IsInitialized = true;
+
+    const char *pathPtr = getenv(TRACE_FILE_ENV_VAR);
+    if ((pathPtr != NULL) && (pathPtr[0] != '\0'))
+    {
+        StartRecording(pathPtr);
+    }
+
+    pathPtr = getenv(REPLAY_FILE_ENV_VAR);
+    if ((pathPtr != NULL) && (pathPtr[0] != '\0'))
+    {
+        StartReplay(pathPtr);
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Parse the record at an offset in the trace being replayed.
+ *
+ * @return
+ *  - LE_OK on success.
+ *  - LE_OUT_OF_RANGE if there are no more (complete) records.
+ */
+//--------------------------------------------------------------------------------------------------
+static le_result_t ParseRecord
+(
+    size_t offset,
+    bool *isPathPtr,            ///< [OUT] true = path record, false = value record.
+    int *idPtr,                 ///< [OUT] Path id.
+    int *lenPtr,                ///< [OUT] Length field of the record.
+    size_t *dataOffsetPtr,      ///< [OUT] Offset of the path or value.
+    size_t *nextOffsetPtr       ///< [OUT] Offset of the next record.
+)
+{
+    const uint8_t *recordPtr = ReplayPtr + offset;
+    size_t remaining = ReplaySize - offset;
+
+    if ((remaining >= 3) && (recordPtr[0] == PATH_RECORD_TAG))
+    {
+        *isPathPtr = true;
+        *idPtr = recordPtr[1];
+        *lenPtr = recordPtr[2];
+        *dataOffsetPtr = offset + 3;
+        *nextOffsetPtr = *dataOffsetPtr + *lenPtr;
+    }
+    else if (remaining >= VALUE_RECORD_OVERHEAD)
+    {
+        *isPathPtr = false;
+        *idPtr = recordPtr[0];
+        *lenPtr = recordPtr[5];
+        *dataOffsetPtr = offset + VALUE_RECORD_OVERHEAD;
+        *nextOffsetPtr = *dataOffsetPtr + ((*lenPtr == FAILED_READ_LEN) ? 0 : *lenPtr);
+    }
+    else
+    {
+        return LE_OUT_OF_RANGE;
+    }
+
+    if (*nextOffsetPtr > ReplaySize)
+    {
+        return LE_OUT_OF_RANGE;
+    }
+
+    return LE_OK;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Set up the trace state of a newly created file handle.
+ */
+//--------------------------------------------------------------------------------------------------
+void util_TraceOpen
+(
+    util_TraceFile_t *tracePtr,
+    const char *path
+)
+{
+    Init();
+
+    tracePtr->recordId = -1;
+    tracePtr->replayId = -1;
+    tracePtr->replayOffset = sizeof(Header);
+
+    size_t pathLen = strlen(path);
+
+    if (RecordFd >= 0)
+    {
+        if ((NextRecordId > MAX_PATH_ID) || (pathLen > UINT8_MAX))
+        {
+            LE_WARN("Can't add '%s' to the trace. Its values won't be recorded.", path);
+        }
+        else
+        {
+            tracePtr->recordId = NextRecordId++;
+
+            uint8_t recordHeader[3] = { PATH_RECORD_TAG, tracePtr->recordId, pathLen };
+            Write(recordHeader, sizeof(recordHeader));
+            Write((const uint8_t *)path, pathLen);
+        }
+    }
+
+    if (ReplayPtr != NULL)
+    {
+        size_t offset = sizeof(Header);
+        bool isPath;
+        int id;
+        int len;
+        size_t dataOffset;
+
+        while (ParseRecord(offset, &isPath, &id, &len, &dataOffset, &offset) == LE_OK)
+        {
+            if (   isPath
+                && (len == pathLen)
+                && (memcmp(ReplayPtr + dataOffset, path, pathLen) == 0)  )
+            {
+                tracePtr->replayId = id;
+                break;
+            }
+        }
+
+        if (tracePtr->replayId < 0)
+        {
+            LE_WARN("'%s' is not in the replayed trace. Reading it will fail.", path);
+        }
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Check whether the trace being replayed has values of any file in a directory (or below it), as
+ * a stand-in for the directory existing.
+ *
+ * @return true if a path in the trace starts with the directory path and a '/'.
+ */
+//--------------------------------------------------------------------------------------------------
+bool util_TraceHasDir
+(
+    const char *dirPath
+)
+{
+    if (!util_IsReplaying())
+    {
+        return false;
+    }
+
+    size_t dirLen = strlen(dirPath);
+    size_t offset = sizeof(Header);
+    bool isPath;
+    int id;
+    int len;
+    size_t dataOffset;
+
+    while (ParseRecord(offset, &isPath, &id, &len, &dataOffset, &offset) == LE_OK)
+    {
+        if (   isPath
+            && (len > dirLen)
+            && (memcmp(ReplayPtr + dataOffset, dirPath, dirLen) == 0)
+            && (ReplayPtr[dataOffset + dirLen] == '/')  )
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Check whether values are being replayed from a trace instead of read from the driver files.
+ *
+ * @return true if replaying.
+ */
+//--------------------------------------------------------------------------------------------------
+bool util_IsReplaying
+(
+    void
+)
+{
+    Init();
+
+    return (ReplayPtr != NULL);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Record a value read from a file handle, if recording.
+ */
+//--------------------------------------------------------------------------------------------------
+void util_TraceRecord
+(
+    const util_TraceFile_t *tracePtr,
+    const char *value,
+    ssize_t numRead     ///< Number of bytes read into value, or -1 if the read failed.
+)
+{
+    if ((RecordFd < 0) || (tracePtr->recordId < 0))
+    {
+        return;
+    }
+
+    // Recorded against the real clock, even when the values come from a replayed trace.
+    le_clk_Time_t elapsed = le_clk_Sub(le_clk_GetRelativeTime(), RecordStart);
+    uint64_t ms = ((uint64_t)elapsed.sec * 1000) + (elapsed.usec / 1000);
+    if (ms > UINT32_MAX)
+    {
+        ms = UINT32_MAX;
+    }
+
+    // Values longer than a length byte can describe are truncated.
+    size_t len = (numRead < 0) ? 0 : numRead;
+    if (len >= FAILED_READ_LEN)
+    {
+        len = FAILED_READ_LEN - 1;
+    }
+
+    uint8_t record[VALUE_RECORD_OVERHEAD + FAILED_READ_LEN];
+    record[0] = tracePtr->recordId;
+    record[1] = ms & 0xFF;
+    record[2] = (ms >> 8) & 0xFF;
+    record[3] = (ms >> 16) & 0xFF;
+    record[4] = (ms >> 24) & 0xFF;
+    record[5] = (numRead < 0) ? FAILED_READ_LEN : len;
+    memcpy(record + VALUE_RECORD_OVERHEAD, value, len);
+
+    Write(record, VALUE_RECORD_OVERHEAD + len);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the next value recorded for a file handle from the trace being replayed.  If there are no
+ * more values recorded for the file, the replay is over and the process exits.
+ *
+ * @return Number of bytes copied into the buffer, or -1 if the recorded read failed.
+ */
+//--------------------------------------------------------------------------------------------------
+ssize_t util_TraceReplay
+(
+    util_TraceFile_t *tracePtr,
+    char *buffer,
+    size_t bufferSize
+)
+{
+    if (tracePtr->replayId < 0)
+    {
+        return -1;
+    }
+
+    bool isPath;
+    int id;
+    int len;
+    size_t dataOffset;
+    size_t offset = tracePtr->replayOffset;
+
+    while (ParseRecord(offset, &isPath, &id, &len, &dataOffset, &offset) == LE_OK)
+    {
+        if ((!isPath) && (id == tracePtr->replayId))
+        {
+            tracePtr->replayOffset = offset;
+
+            // The clock moves on to the time the value was read.  Values of different files
+            // were recorded by one thread, in time order.
+            const uint8_t *timePtr = ReplayPtr + dataOffset - VALUE_RECORD_OVERHEAD + 1;
+            uint32_t ms = timePtr[0] | (timePtr[1] << 8) | (timePtr[2] << 16) |
+                          ((uint32_t)timePtr[3] << 24);
+            if (ms > __atomic_load_n(&ReplayMs, __ATOMIC_RELAXED))
+            {
+                __atomic_store_n(&ReplayMs, ms, __ATOMIC_RELAXED);
+            }
+
+            if (len == FAILED_READ_LEN)
+            {
+                return -1;
+            }
+
+            size_t numCopied = (len < bufferSize) ? len : bufferSize;
+            memcpy(buffer, ReplayPtr + dataOffset, numCopied);
+
+            return numCopied;
+        }
+    }
+
+    LE_INFO("End of replayed trace reached.");
+    exit(EXIT_SUCCESS);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the time on the replay clock, which stands in for the monotonic clock while replaying: it
+ * starts when replay starts, and moves on to the recorded time of each value as it is replayed.
+ *
+ * @return The time.
+ */
+//--------------------------------------------------------------------------------------------------
+le_clk_Time_t util_TraceGetTime
+(
+    void
+)
+{
+    uint32_t ms = __atomic_load_n(&ReplayMs, __ATOMIC_RELAXED);
+    le_clk_Time_t offset = { ms / 1000, (ms % 1000) * 1000 };
+
+    return le_clk_Add(ReplayStartTime, offset);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the wall-clock time that goes with the replay clock (see util_TraceGetTime()).
+ *
+ * @return ms since the Epoch.
+ */
+//--------------------------------------------------------------------------------------------------
+uint64_t util_TraceGetEpochMs
+(
+    void
+)
+{
+    return ReplayStartEpochMs + __atomic_load_n(&ReplayMs, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,48 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file trace.h
+ *
+ * Recording and replay of the raw values read from the battery driver files.
+ *
+ * If the BATTERY_TRACE_FILE environment variable is set, every value read through a file handle
+ * is appended to that file.  If BATTERY_REPLAY_FILE is set, values are served from that file
+ * instead of the driver files, in the order they were recorded (per file), and writes to the
+ * driver files are discarded.  The process exits when a file handle runs out of recorded values.
+ *
+ * While replaying, the Battery Service's clock (util_GetRelativeTime() and util_GetEpochMs()) is
+ * driven by the trace: it moves on to the recorded time of each value as the value is replayed,
+ * so that the replay can run faster than the recording without changing the outcome.
+ *
+ * The trace file starts with the 4 characters "BTRC" and a version byte (1), followed by records:
+ *
+ *  - Path:  0xFF, id (1 byte), length (1 byte), path (length bytes, not null-terminated).
+ *  - Value: id (1 byte, < 0xFF), time (4 bytes, little-endian, ms since recording started),
+ *           length (1 byte, 0xFF if the read failed), value (length bytes, as read).
+ *
+ * A path record always precedes the first value record with its id.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "legato.h"
+
+/// Trace state of a file handle.
+typedef struct
+{
+    int recordId;           ///< Id of the file's path in the trace being recorded, or -1.
+    int replayId;           ///< Id of the file's path in the trace being replayed, or -1.
+    size_t replayOffset;    ///< Where to look for the file's next value in the replayed trace.
+}
+util_TraceFile_t;
+
+void util_TraceOpen(util_TraceFile_t *tracePtr, const char *path);
+LE_SHARED bool util_IsReplaying(void);
+bool util_TraceHasDir(const char *dirPath);
+void util_TraceRecord(const util_TraceFile_t *tracePtr, const char *value, ssize_t numRead);
+ssize_t util_TraceReplay(util_TraceFile_t *tracePtr, char *buffer, size_t bufferSize);
+le_clk_Time_t util_TraceGetTime(void);
+uint64_t util_TraceGetEpochMs(void);
+
+#endif // TRACE_H
@@ -0,0 +1,186 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file uevent.c
+ *
+ * Listener for power_supply class uevents sent by the kernel over a NETLINK_KOBJECT_UEVENT
+ * socket.  The power supply drivers send a "change" uevent whenever the charger status or health
+ * changes, which lets the Battery Service re-sample immediately instead of waiting for its next
+ * polling timer expiry.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#include "legato.h"
+#include "batteryUtils.h"
+#include "trace.h"
+#include <poll.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+
+/// Kernel uevent multicast group.
+#define UEVENT_KERNEL_GROUP 1
+
+/// Size of the uevent receive buffer.  The kernel limits a uevent to 2 KB.
+#define UEVENT_BUFFER_SIZE 2048
+
+static const char SubsystemKey[] = "SUBSYSTEM=";
+static const char PowerSupplySubsystem[] = "power_supply";
+static const char SupplyNameKey[] = "POWER_SUPPLY_NAME=";
+
+/// Handler registered using util_AddPowerSupplyEventHandler().
+static util_PowerSupplyEventHandlerFunc_t EventHandler = NULL;
+static void *EventHandlerContextPtr = NULL;
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Process one uevent message and call the registered handler if it is for a power supply.
+ */
+//--------------------------------------------------------------------------------------------------
+static void ProcessUevent
+(
+    const char *msgPtr,
+    size_t msgLen
+)
+{
+    const char *supplyName = "";
+    bool isPowerSupply = false;
+
+    // The message is the "action@devpath" header followed by null-terminated KEY=VALUE pairs.
+    const char *endPtr = msgPtr + msgLen;
+    const char *linePtr = msgPtr;
+    while (linePtr < endPtr)
+    {
+        size_t lineLen = strnlen(linePtr, endPtr - linePtr);
+
+        if (strncmp(linePtr, SubsystemKey, sizeof(SubsystemKey) - 1) == 0)
+        {
+            isPowerSupply = (strcmp(linePtr + sizeof(SubsystemKey) - 1, PowerSupplySubsystem) == 0);
+        }
+        else if (strncmp(linePtr, SupplyNameKey, sizeof(SupplyNameKey) - 1) == 0)
+        {
+            supplyName = linePtr + sizeof(SupplyNameKey) - 1;
+        }
+
+        linePtr += lineLen + 1;
+    }
+
+    if (isPowerSupply)
+    {
+        LE_DEBUG("Power supply uevent '%s' from '%s'.", msgPtr, supplyName);
+        EventHandler(supplyName, EventHandlerContextPtr);
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * File descriptor monitor handler for the uevent socket.  Drains all pending messages.
+ */
+//--------------------------------------------------------------------------------------------------
+static void UeventSocketHandler
+(
+    int fd,
+    short events
+)
+{
+    if (events & (POLLERR | POLLHUP))
+    {
+        LE_ERROR("Error on uevent socket (events = 0x%x).", events);
+    }
+
+    for (;;)
+    {
+        char buffer[UEVENT_BUFFER_SIZE + 1];
+        struct sockaddr_nl sender;
+        socklen_t senderLen = sizeof(sender);
+
+        ssize_t msgLen = recvfrom(fd,
+                                  buffer,
+                                  sizeof(buffer) - 1,
+                                  0,
+                                  (struct sockaddr *)&sender,
+                                  &senderLen);
+        if (msgLen < 0)
+        {
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+            {
+                // ENOBUFS means messages were dropped; the next sample will catch up.
+                LE_WARN("Failed to receive uevent - %m");
+            }
+            if (errno != EINTR)
+            {
+                break;
+            }
+            continue;
+        }
+
+        // Only trust messages sent by the kernel.
+        if ((senderLen != sizeof(sender)) || (sender.nl_pid != 0))
+        {
+            LE_DEBUG("Ignoring uevent from pid %u.", (unsigned int)sender.nl_pid);
+            continue;
+        }
+
+        buffer[msgLen] = '\0';
+        ProcessUevent(buffer, msgLen);
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Start listening for power_supply uevents from the kernel.  The handler is called from the
+ * calling thread's event loop with the name of the power supply that changed.
+ *
+ * Only one handler can be registered per process.  When replaying a trace, the uevents of the
+ * host's power supplies are unrelated to the replayed values, so they are not listened to.
+ *
+ * @return
+ *  - LE_OK on success.
+ *  - LE_DUPLICATE if a handler is already registered.
+ *  - LE_FAULT if the uevent socket could not be set up.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t util_AddPowerSupplyEventHandler
+(
+    util_PowerSupplyEventHandlerFunc_t handler,
+    void *contextPtr
+)
+{
+    if (EventHandler != NULL)
+    {
+        return LE_DUPLICATE;
+    }
+
+    if (util_IsReplaying())
+    {
+        EventHandler = handler;
+        return LE_OK;
+    }
+
+    int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+    if (fd < 0)
+    {
+        LE_ERROR("Failed to create uevent socket - %m");
+        return LE_FAULT;
+    }
+
+    struct sockaddr_nl addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = UEVENT_KERNEL_GROUP;
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        LE_ERROR("Failed to bind uevent socket - %m");
+        close(fd);
+        return LE_FAULT;
+    }
+
+    EventHandler = handler;
+    EventHandlerContextPtr = contextPtr;
+
+    le_fdMonitor_Create("uevent", fd, UeventSocketHandler, POLLIN);
+
+    return LE_OK;
+}
@@ -0,0 +1,32 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file admin_interface.h
+ *
+ * Host stand-in for the client interface of the Data Hub's admin.api, for tests to play the part
+ * of the Data Hub's administrator: setting an app's outputs, and watching what it pushes to its
+ * inputs.  See host/dataHub.c.
+ *
+ * Paths are absolute, e.g. "/app/battery/value" for the Battery Service's "value" resource.  The
+ * push handler types are dhubIO's.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#ifndef ADMIN_INTERFACE_H_INCLUDE_GUARD
+#define ADMIN_INTERFACE_H_INCLUDE_GUARD
+
+#include "dhubIO_interface.h"
+
+void admin_PushBoolean(const char *path, double timestamp, bool value);
+void admin_PushNumeric(const char *path, double timestamp, double value);
+void admin_PushString(const char *path, double timestamp, const char *value);
+
+dhubIO_BooleanPushHandlerRef_t admin_AddBooleanPushHandler(
+    const char *path, dhubIO_BooleanPushHandlerFunc_t callbackPtr, void *contextPtr);
+dhubIO_NumericPushHandlerRef_t admin_AddNumericPushHandler(
+    const char *path, dhubIO_NumericPushHandlerFunc_t callbackPtr, void *contextPtr);
+dhubIO_StringPushHandlerRef_t admin_AddStringPushHandler(
+    const char *path, dhubIO_StringPushHandlerFunc_t callbackPtr, void *contextPtr);
+dhubIO_JsonPushHandlerRef_t admin_AddJsonPushHandler(
+    const char *path, dhubIO_JsonPushHandlerFunc_t callbackPtr, void *contextPtr);
+
+#endif // ADMIN_INTERFACE_H_INCLUDE_GUARD
@@ -0,0 +1,675 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file configTree.c
+ *
+ * Host implementation of the Config Tree client interface declared in host/le_cfg_interface.h.
+ *
+ * The tree is a flat list of leaf nodes, each named by its full path.  Deleting a node deletes
+ * every node whose path starts with the node's path, which is all that the branches of a real
+ * tree are needed for here.  A write transaction queues its changes, and commits them in order.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#include "legato.h"
+#include "le_cfg_interface.h"
+#include <math.h>
+
+/// Longest node path, including the terminator.
+#define MAX_PATH_BYTES 128
+
+/// Longest string value, including the terminator.
+#define MAX_STRING_BYTES 128
+
+/// Largest number of nodes in the tree.
+#define MAX_NODES 64
+
+/// Largest number of changes in a write transaction.
+#define MAX_CHANGES 16
+
+/// Type of a node's value.
+typedef enum
+{
+    NODE_INT,
+    NODE_FLOAT,
+    NODE_STRING,
+    NODE_DELETED,       ///< Only in a write transaction's changes: delete the node and its children.
+}
+NodeType_t;
+
+/// A leaf node, or a change to one.
+typedef struct
+{
+    char path[MAX_PATH_BYTES];
+    NodeType_t type;
+    int32_t intValue;
+    double floatValue;
+    char stringValue[MAX_STRING_BYTES];
+}
+Node_t;
+
+/// A transaction, and the iterator it is read and written through.
+typedef struct le_cfg_Iterator
+{
+    char basePath[MAX_PATH_BYTES];
+    bool isWrite;
+    Node_t changes[MAX_CHANGES];
+    size_t numChanges;
+}
+Iterator_t;
+
+/// The tree.
+static Node_t Nodes[MAX_NODES];
+static size_t NumNodes = 0;
+static pthread_mutex_t Mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Build the full path of a node from a base path and a path relative to it.  Leading slashes are
+ * dropped, so that absolute and relative paths name the same nodes.
+ */
+//--------------------------------------------------------------------------------------------------
+static void JoinPath
+(
+    char *fullPath,         ///< [OUT] MAX_PATH_BYTES long.
+    const char *basePath,
+    const char *path
+)
+{
+    while (*basePath == '/')
+    {
+        basePath++;
+    }
+    while (*path == '/')
+    {
+        path++;
+    }
+
+    int len;
+    if (*basePath == '\0')
+    {
+        len = snprintf(fullPath, MAX_PATH_BYTES, "%s", path);
+    }
+    else if (*path == '\0')
+    {
+        len = snprintf(fullPath, MAX_PATH_BYTES, "%s", basePath);
+    }
+    else
+    {
+        len = snprintf(fullPath, MAX_PATH_BYTES, "%s/%s", basePath, path);
+    }
+    LE_FATAL_IF(len >= MAX_PATH_BYTES, "Config Tree path too long: '%s/%s'.", basePath, path);
+
+    // A trailing slash names the same node.
+    while ((len > 0) && (fullPath[len - 1] == '/'))
+    {
+        fullPath[--len] = '\0';
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Check whether a node is a path or one of its children.
+ *
+ * @return true if it is.
+ */
+//--------------------------------------------------------------------------------------------------
+static bool IsUnder
+(
+    const char *nodePath,
+    const char *path        ///< "" for the root.
+)
+{
+    size_t len = strlen(path);
+
+    if (len == 0)
+    {
+        return true;
+    }
+
+    return (strncmp(nodePath, path, len) == 0)
+        && ((nodePath[len] == '\0') || (nodePath[len] == '/'));
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Find a leaf node.  Called with the mutex locked.
+ *
+ * @return Ptr to the node, or NULL if there is none with that path.
+ */
+//--------------------------------------------------------------------------------------------------
+static Node_t *FindNode
+(
+    const char *fullPath
+)
+{
+    for (size_t i = 0; i < NumNodes; i++)
+    {
+        if (strcmp(Nodes[i].path, fullPath) == 0)
+        {
+            return &Nodes[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Apply a change to the tree: set a leaf node, or delete a node and its children.
+ */
+//--------------------------------------------------------------------------------------------------
+static void ApplyChange
+(
+    const Node_t *changePtr
+)
+{
+    pthread_mutex_lock(&Mutex);
+
+    if (changePtr->type == NODE_DELETED)
+    {
+        size_t numKept = 0;
+        for (size_t i = 0; i < NumNodes; i++)
+        {
+            if (!IsUnder(Nodes[i].path, changePtr->path))
+            {
+                Nodes[numKept++] = Nodes[i];
+            }
+        }
+        NumNodes = numKept;
+    }
+    else
+    {
+        Node_t *nodePtr = FindNode(changePtr->path);
+        if (nodePtr == NULL)
+        {
+            LE_FATAL_IF(NumNodes >= MAX_NODES, "Config Tree full.");
+            nodePtr = &Nodes[NumNodes++];
+        }
+        *nodePtr = *changePtr;
+    }
+
+    pthread_mutex_unlock(&Mutex);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Read a leaf node.
+ *
+ * @return true if the node exists, in which case it is copied.
+ */
+//--------------------------------------------------------------------------------------------------
+static bool ReadNode
+(
+    const char *basePath,
+    const char *path,
+    Node_t *nodePtr         ///< [OUT]
+)
+{
+    char fullPath[MAX_PATH_BYTES];
+    JoinPath(fullPath, basePath, path);
+
+    pthread_mutex_lock(&Mutex);
+    const Node_t *foundPtr = FindNode(fullPath);
+    if (foundPtr != NULL)
+    {
+        *nodePtr = *foundPtr;
+    }
+    pthread_mutex_unlock(&Mutex);
+
+    return (foundPtr != NULL);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Make a change through an iterator: queue it in a write transaction, or else apply it now (for
+ * the Quick functions, which pass NULL).
+ */
+//--------------------------------------------------------------------------------------------------
+static void Change
+(
+    le_cfg_IteratorRef_t iteratorRef,   ///< NULL for the Quick functions.
+    const char *path,
+    const Node_t *valuePtr              ///< Type and value of the change.  Its path is ignored.
+)
+{
+    Node_t change = *valuePtr;
+
+    if (iteratorRef == NULL)
+    {
+        JoinPath(change.path, "", path);
+        ApplyChange(&change);
+        return;
+    }
+
+    LE_FATAL_IF(!iteratorRef->isWrite, "Write to a read transaction ('%s').", path);
+    LE_FATAL_IF(iteratorRef->numChanges >= MAX_CHANGES, "Too many changes in a transaction.");
+
+    JoinPath(change.path, iteratorRef->basePath, path);
+    iteratorRef->changes[iteratorRef->numChanges++] = change;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get an integer node.  A floating point value is rounded.
+ *
+ * @return The value, or the default if the node doesn't exist or isn't a number.
+ */
+//--------------------------------------------------------------------------------------------------
+static int32_t GetInt
+(
+    const char *basePath,
+    const char *path,
+    int32_t defaultValue
+)
+{
+    Node_t node;
+
+    if (!ReadNode(basePath, path, &node))
+    {
+        return defaultValue;
+    }
+
+    switch (node.type)
+    {
+        case NODE_INT:
+            return node.intValue;
+        case NODE_FLOAT:
+            return (int32_t)lround(node.floatValue);
+        default:
+            return defaultValue;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get a floating point node.  An integer value is converted.
+ *
+ * @return The value, or the default if the node doesn't exist or isn't a number.
+ */
+//--------------------------------------------------------------------------------------------------
+static double GetFloat
+(
+    const char *basePath,
+    const char *path,
+    double defaultValue
+)
+{
+    Node_t node;
+
+    if (!ReadNode(basePath, path, &node))
+    {
+        return defaultValue;
+    }
+
+    switch (node.type)
+    {
+        case NODE_INT:
+            return node.intValue;
+        case NODE_FLOAT:
+            return node.floatValue;
+        default:
+            return defaultValue;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get a string node.
+ *
+ * @return
+ *  - LE_OK on success (including when the default is returned).
+ *  - LE_OVERFLOW if the value was truncated.
+ */
+//--------------------------------------------------------------------------------------------------
+static le_result_t GetString
+(
+    const char *basePath,
+    const char *path,
+    char *value,
+    size_t valueSize,
+    const char *defaultValue
+)
+{
+    Node_t node;
+
+    if (ReadNode(basePath, path, &node) && (node.type == NODE_STRING))
+    {
+        return le_utf8_Copy(value, node.stringValue, valueSize, NULL);
+    }
+
+    return le_utf8_Copy(value, defaultValue, valueSize, NULL);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Start a transaction.
+ *
+ * @return The transaction's iterator.
+ */
+//--------------------------------------------------------------------------------------------------
+static le_cfg_IteratorRef_t CreateTxn
+(
+    const char *basePath,
+    bool isWrite
+)
+{
+    Iterator_t *iteratorPtr = calloc(1, sizeof(Iterator_t));
+    LE_ASSERT(iteratorPtr != NULL);
+
+    JoinPath(iteratorPtr->basePath, "", basePath);
+    iteratorPtr->isWrite = isWrite;
+
+    return iteratorPtr;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Start a read transaction.
+ *
+ * @return The transaction's iterator.
+ */
+//--------------------------------------------------------------------------------------------------
+le_cfg_IteratorRef_t le_cfg_CreateReadTxn
+(
+    const char *basePath
+)
+{
+    return CreateTxn(basePath, false);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Start a write transaction.
+ *
+ * @return The transaction's iterator.
+ */
+//--------------------------------------------------------------------------------------------------
+le_cfg_IteratorRef_t le_cfg_CreateWriteTxn
+(
+    const char *basePath
+)
+{
+    return CreateTxn(basePath, true);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Commit a write transaction's changes to the tree, and end the transaction.
+ */
+//--------------------------------------------------------------------------------------------------
+void le_cfg_CommitTxn
+(
+    le_cfg_IteratorRef_t iteratorRef
+)
+{
+    for (size_t i = 0; i < iteratorRef->numChanges; i++)
+    {
+        ApplyChange(&iteratorRef->changes[i]);
+    }
+
+    free(iteratorRef);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * End a transaction, discarding its changes.
+ */
+//--------------------------------------------------------------------------------------------------
+void le_cfg_CancelTxn
+(
+    le_cfg_IteratorRef_t iteratorRef
+)
+{
+    free(iteratorRef);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * @return An integer node, or the default.
+ */
+//--------------------------------------------------------------------------------------------------
+int32_t le_cfg_GetInt
+(
+    le_cfg_IteratorRef_t iteratorRef,
+    const char *path,
+    int32_t defaultValue
+)
+{
+    return GetInt(iteratorRef->basePath, path, defaultValue);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Set an integer node.
+ */
+//--------------------------------------------------------------------------------------------------
+void le_cfg_SetInt
+(
+    le_cfg_IteratorRef_t iteratorRef,
+    const char *path,
+    int32_t value
+)
+{
+    Node_t node = { .type = NODE_INT, .intValue = value };
+
+    Change(iteratorRef, path, &node);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * @return A floating point node, or the default.
+ */
+//--------------------------------------------------------------------------------------------------
+double le_cfg_GetFloat
+(
+    le_cfg_IteratorRef_t iteratorRef,
+    const char *path,
+    double defaultValue
+)
+{
+    return GetFloat(iteratorRef->basePath, path, defaultValue);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Set a floating point node.
+ */
+//--------------------------------------------------------------------------------------------------
+void le_cfg_SetFloat
+(
+    le_cfg_IteratorRef_t iteratorRef,
+    const char *path,
+    double value
+)
+{
+    Node_t node = { .type = NODE_FLOAT, .floatValue = value };
+
+    Change(iteratorRef, path, &node);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get a string node, or the default.
+ *
+ * @return
+ *  - LE_OK on success.
+ *  - LE_OVERFLOW if the value was truncated.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t le_cfg_GetString
+(
+    le_cfg_IteratorRef_t iteratorRef,
+    const char *path,
+    char *value,
+    size_t valueSize,
+    const char *defaultValue
+)
+{
+    return GetString(iteratorRef->basePath, path, value, valueSize, defaultValue);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Set a string node.
+ */
+//--------------------------------------------------------------------------------------------------
+void le_cfg_SetString
+(
+    le_cfg_IteratorRef_t iteratorRef,
+    const char *path,
+    const char *value
+)
+{
+    Node_t node = { .type = NODE_STRING };
+    LE_FATAL_IF(le_utf8_Copy(node.stringValue, value, sizeof(node.stringValue), NULL) != LE_OK,
+                "Config Tree string too long: '%s'.", value);
+
+    Change(iteratorRef, path, &node);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Delete a node and its children.
+ */
+//--------------------------------------------------------------------------------------------------
+void le_cfg_DeleteNode
+(
+    le_cfg_IteratorRef_t iteratorRef,
+    const char *path
+)
+{
+    Node_t node = { .type = NODE_DELETED };
+
+    Change(iteratorRef, path, &node);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * @return An integer node, or the default.
+ */
+//--------------------------------------------------------------------------------------------------
+int32_t le_cfg_QuickGetInt
+(
+    const char *path,
+    int32_t defaultValue
+)
+{
+    return GetInt("", path, defaultValue);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Set an integer node.
+ */
+//--------------------------------------------------------------------------------------------------
+void le_cfg_QuickSetInt
+(
+    const char *path,
+    int32_t value
+)
+{
+    le_cfg_SetInt(NULL, path, value);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * @return A floating point node, or the default.
+ */
+//--------------------------------------------------------------------------------------------------
+double le_cfg_QuickGetFloat
+(
+    const char *path,
+    double defaultValue
+)
+{
+    return GetFloat("", path, defaultValue);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Set a floating point node.
+ */
+//--------------------------------------------------------------------------------------------------
+void le_cfg_QuickSetFloat
+(
+    const char *path,
+    double value
+)
+{
+    le_cfg_SetFloat(NULL, path, value);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get a string node, or the default.
+ *
+ * @return
+ *  - LE_OK on success.
+ *  - LE_OVERFLOW if the value was truncated.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t le_cfg_QuickGetString
+(
+    const char *path,
+    char *value,
+    size_t valueSize,
+    const char *defaultValue
+)
+{
+    return GetString("", path, value, valueSize, defaultValue);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Set a string node.
+ */
+//--------------------------------------------------------------------------------------------------
+void le_cfg_QuickSetString
+(
+    const char *path,
+    const char *value
+)
+{
+    le_cfg_SetString(NULL, path, value);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Delete a node and its children.
+ */
+//--------------------------------------------------------------------------------------------------
+void le_cfg_QuickDeleteNode
+(
+    const char *path
+)
+{
+    le_cfg_DeleteNode(NULL, path);
+}
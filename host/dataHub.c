@@ -0,0 +1,626 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file dataHub.c
+ *
+ * Host implementation of the Data Hub interfaces declared in host/dhubIO_interface.h and
+ * host/admin_interface.h: a table of resources with their current values, and the push handlers
+ * registered on them.
+ *
+ * The app's resources are created under /app/HOST_APP_NAME.  A push sets the resource's current
+ * value and calls the push handlers registered on its path for the pushed data type, in the
+ * pushing thread, before returning.  Defaults and JSON examples are recorded but have no effect.
+ * The interfaces are only meant to be used from the main thread.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#include "legato.h"
+#include "dhubIO_interface.h"
+#include "admin_interface.h"
+
+/// Name of the app whose namespace the dhubIO paths are relative to.
+#define HOST_APP_NAME "battery"
+
+/// Longest absolute resource path, including the terminator.
+#define MAX_PATH_BYTES 128
+
+/// Largest number of resources.
+#define MAX_RESOURCES 48
+
+/// Largest number of push handlers.
+#define MAX_HANDLERS 64
+
+/// A resource and its current value.
+typedef struct
+{
+    char path[MAX_PATH_BYTES];          ///< Absolute.
+    dhubIO_DataType_t dataType;
+    bool isOutput;
+    bool isOptional;
+    bool hasValue;                      ///< false until a value is pushed.
+    dhubIO_DataType_t valueType;        ///< Data type of the current value.
+    double timestamp;                   ///< Of the current value (seconds since the Epoch).
+    bool booleanValue;
+    double numericValue;
+    char *stringValue;                  ///< String or JSON value (allocated).
+}
+Resource_t;
+
+/// A push handler.
+typedef struct dhubIO_PushHandler
+{
+    char path[MAX_PATH_BYTES];          ///< Absolute.
+    dhubIO_DataType_t dataType;         ///< Data type of the values the handler takes.
+    void (*funcPtr)(void);              ///< Cast to the handler type of dataType.
+    void *contextPtr;
+}
+Handler_t;
+
+static Resource_t Resources[MAX_RESOURCES];
+static size_t NumResources = 0;
+
+static Handler_t Handlers[MAX_HANDLERS];
+static size_t NumHandlers = 0;
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Make the absolute path of one of the app's resources.
+ */
+//--------------------------------------------------------------------------------------------------
+static void AppPath
+(
+    char *absolutePath,     ///< [OUT] MAX_PATH_BYTES long.
+    const char *path        ///< Relative to the app's namespace.
+)
+{
+    int len = snprintf(absolutePath, MAX_PATH_BYTES, "/app/" HOST_APP_NAME "/%s", path);
+    LE_FATAL_IF(len >= MAX_PATH_BYTES, "Resource path too long: '%s'.", path);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Find a resource.
+ *
+ * @return Ptr to the resource, or NULL if it doesn't exist.
+ */
+//--------------------------------------------------------------------------------------------------
+static Resource_t *FindResource
+(
+    const char *absolutePath
+)
+{
+    for (size_t i = 0; i < NumResources; i++)
+    {
+        if (strcmp(Resources[i].path, absolutePath) == 0)
+        {
+            return &Resources[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Find one of the app's resources, which must exist.
+ *
+ * @return Ptr to the resource.
+ */
+//--------------------------------------------------------------------------------------------------
+static Resource_t *GetAppResource
+(
+    const char *path        ///< Relative to the app's namespace.
+)
+{
+    char absolutePath[MAX_PATH_BYTES];
+    AppPath(absolutePath, path);
+
+    Resource_t *resPtr = FindResource(absolutePath);
+    LE_FATAL_IF(resPtr == NULL, "No resource '%s'.", absolutePath);
+
+    return resPtr;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Create one of the app's resources.
+ *
+ * @return
+ *  - LE_OK on success.
+ *  - LE_DUPLICATE if there is already a resource with the path.
+ */
+//--------------------------------------------------------------------------------------------------
+static le_result_t CreateResource
+(
+    const char *path,
+    dhubIO_DataType_t dataType,
+    bool isOutput
+)
+{
+    char absolutePath[MAX_PATH_BYTES];
+    AppPath(absolutePath, path);
+
+    if (FindResource(absolutePath) != NULL)
+    {
+        return LE_DUPLICATE;
+    }
+    LE_FATAL_IF(NumResources >= MAX_RESOURCES, "Too many resources.");
+
+    Resource_t *resPtr = &Resources[NumResources++];
+    memset(resPtr, 0, sizeof(*resPtr));
+    memcpy(resPtr->path, absolutePath, sizeof(resPtr->path));
+    resPtr->dataType = dataType;
+    resPtr->isOutput = isOutput;
+
+    return LE_OK;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Push a value to a resource: make it the current value, and call the handlers of its type.
+ */
+//--------------------------------------------------------------------------------------------------
+static void Push
+(
+    const char *absolutePath,
+    dhubIO_DataType_t valueType,
+    double timestamp,       ///< seconds since the Epoch, or DHUBIO_NOW.
+    bool booleanValue,
+    double numericValue,
+    const char *stringValue ///< For a string or JSON value.
+)
+{
+    Resource_t *resPtr = FindResource(absolutePath);
+    if (resPtr == NULL)
+    {
+        LE_WARN("Push to non-existent resource '%s' ignored.", absolutePath);
+        return;
+    }
+
+    if (timestamp == DHUBIO_NOW)
+    {
+        le_clk_Time_t now = le_clk_GetAbsoluteTime();
+        timestamp = (double)now.sec + (double)now.usec / 1000000;
+    }
+
+    resPtr->hasValue = true;
+    resPtr->valueType = valueType;
+    resPtr->timestamp = timestamp;
+    resPtr->booleanValue = booleanValue;
+    resPtr->numericValue = numericValue;
+    free(resPtr->stringValue);
+    resPtr->stringValue = NULL;
+    if (stringValue != NULL)
+    {
+        resPtr->stringValue = strdup(stringValue);
+        LE_ASSERT(resPtr->stringValue != NULL);
+    }
+
+    // A handler may push in turn, so the value passed to the handlers is the one pushed here.
+    for (size_t i = 0; i < NumHandlers; i++)
+    {
+        const Handler_t *handlerPtr = &Handlers[i];
+        if ((handlerPtr->dataType != valueType) || (strcmp(handlerPtr->path, absolutePath) != 0))
+        {
+            continue;
+        }
+
+        switch (valueType)
+        {
+            case DHUBIO_DATA_TYPE_BOOLEAN:
+                ((dhubIO_BooleanPushHandlerFunc_t)handlerPtr->funcPtr)(timestamp, booleanValue,
+                                                                       handlerPtr->contextPtr);
+                break;
+            case DHUBIO_DATA_TYPE_NUMERIC:
+                ((dhubIO_NumericPushHandlerFunc_t)handlerPtr->funcPtr)(timestamp, numericValue,
+                                                                       handlerPtr->contextPtr);
+                break;
+            case DHUBIO_DATA_TYPE_STRING:
+            case DHUBIO_DATA_TYPE_JSON:
+                ((dhubIO_StringPushHandlerFunc_t)handlerPtr->funcPtr)(timestamp, stringValue,
+                                                                      handlerPtr->contextPtr);
+                break;
+            case DHUBIO_DATA_TYPE_TRIGGER:
+                break;
+        }
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Register a push handler.
+ *
+ * @return Reference to the handler.
+ */
+//--------------------------------------------------------------------------------------------------
+static Handler_t *AddHandler
+(
+    const char *absolutePath,
+    dhubIO_DataType_t dataType,
+    void (*funcPtr)(void),
+    void *contextPtr
+)
+{
+    LE_FATAL_IF(NumHandlers >= MAX_HANDLERS, "Too many push handlers.");
+
+    Handler_t *handlerPtr = &Handlers[NumHandlers++];
+    LE_FATAL_IF(le_utf8_Copy(handlerPtr->path, absolutePath, sizeof(handlerPtr->path), NULL)
+                    != LE_OK,
+                "Resource path too long: '%s'.", absolutePath);
+    handlerPtr->dataType = dataType;
+    handlerPtr->funcPtr = funcPtr;
+    handlerPtr->contextPtr = contextPtr;
+
+    return handlerPtr;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Register a push handler on one of the app's resources.
+ *
+ * @return Reference to the handler.
+ */
+//--------------------------------------------------------------------------------------------------
+static Handler_t *AddAppHandler
+(
+    const char *path,
+    dhubIO_DataType_t dataType,
+    void (*funcPtr)(void),
+    void *contextPtr
+)
+{
+    char absolutePath[MAX_PATH_BYTES];
+    AppPath(absolutePath, path);
+
+    return AddHandler(absolutePath, dataType, funcPtr, contextPtr);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the current value of one of the app's resources.
+ *
+ * @return
+ *  - LE_OK on success.
+ *  - LE_NOT_FOUND if the resource doesn't exist.
+ *  - LE_UNAVAILABLE if nothing has been pushed to it.
+ *  - LE_FORMAT_ERROR if the current value isn't of the data type asked for.
+ */
+//--------------------------------------------------------------------------------------------------
+static le_result_t GetValue
+(
+    const char *path,
+    dhubIO_DataType_t valueType,
+    const Resource_t **resPtrPtr    ///< [OUT]
+)
+{
+    char absolutePath[MAX_PATH_BYTES];
+    AppPath(absolutePath, path);
+
+    const Resource_t *resPtr = FindResource(absolutePath);
+    if (resPtr == NULL)
+    {
+        return LE_NOT_FOUND;
+    }
+    if (!resPtr->hasValue)
+    {
+        return LE_UNAVAILABLE;
+    }
+    if (resPtr->valueType != valueType)
+    {
+        return LE_FORMAT_ERROR;
+    }
+
+    *resPtrPtr = resPtr;
+
+    return LE_OK;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// dhubIO
+//--------------------------------------------------------------------------------------------------
+
+le_result_t dhubIO_CreateInput
+(
+    const char *path,
+    dhubIO_DataType_t dataType,
+    const char *units
+)
+{
+    return CreateResource(path, dataType, false);
+}
+
+
+le_result_t dhubIO_CreateOutput
+(
+    const char *path,
+    dhubIO_DataType_t dataType,
+    const char *units
+)
+{
+    return CreateResource(path, dataType, true);
+}
+
+
+void dhubIO_MarkOptional
+(
+    const char *path
+)
+{
+    GetAppResource(path)->isOptional = true;
+}
+
+
+void dhubIO_SetBooleanDefault
+(
+    const char *path,
+    bool value
+)
+{
+    (void)GetAppResource(path);
+}
+
+
+void dhubIO_SetNumericDefault
+(
+    const char *path,
+    double value
+)
+{
+    (void)GetAppResource(path);
+}
+
+
+void dhubIO_SetStringDefault
+(
+    const char *path,
+    const char *value
+)
+{
+    (void)GetAppResource(path);
+}
+
+
+void dhubIO_SetJsonExample
+(
+    const char *path,
+    const char *example
+)
+{
+    (void)GetAppResource(path);
+}
+
+
+void dhubIO_PushBoolean
+(
+    const char *path,
+    double timestamp,
+    bool value
+)
+{
+    Push(GetAppResource(path)->path, DHUBIO_DATA_TYPE_BOOLEAN, timestamp, value, 0, NULL);
+}
+
+
+void dhubIO_PushNumeric
+(
+    const char *path,
+    double timestamp,
+    double value
+)
+{
+    Push(GetAppResource(path)->path, DHUBIO_DATA_TYPE_NUMERIC, timestamp, false, value, NULL);
+}
+
+
+void dhubIO_PushString
+(
+    const char *path,
+    double timestamp,
+    const char *value
+)
+{
+    Push(GetAppResource(path)->path, DHUBIO_DATA_TYPE_STRING, timestamp, false, 0, value);
+}
+
+
+void dhubIO_PushJson
+(
+    const char *path,
+    double timestamp,
+    const char *value
+)
+{
+    Push(GetAppResource(path)->path, DHUBIO_DATA_TYPE_JSON, timestamp, false, 0, value);
+}
+
+
+dhubIO_BooleanPushHandlerRef_t dhubIO_AddBooleanPushHandler
+(
+    const char *path,
+    dhubIO_BooleanPushHandlerFunc_t callbackPtr,
+    void *contextPtr
+)
+{
+    return AddAppHandler(path, DHUBIO_DATA_TYPE_BOOLEAN, (void (*)(void))callbackPtr, contextPtr);
+}
+
+
+dhubIO_NumericPushHandlerRef_t dhubIO_AddNumericPushHandler
+(
+    const char *path,
+    dhubIO_NumericPushHandlerFunc_t callbackPtr,
+    void *contextPtr
+)
+{
+    return AddAppHandler(path, DHUBIO_DATA_TYPE_NUMERIC, (void (*)(void))callbackPtr, contextPtr);
+}
+
+
+dhubIO_StringPushHandlerRef_t dhubIO_AddStringPushHandler
+(
+    const char *path,
+    dhubIO_StringPushHandlerFunc_t callbackPtr,
+    void *contextPtr
+)
+{
+    return AddAppHandler(path, DHUBIO_DATA_TYPE_STRING, (void (*)(void))callbackPtr, contextPtr);
+}
+
+
+dhubIO_JsonPushHandlerRef_t dhubIO_AddJsonPushHandler
+(
+    const char *path,
+    dhubIO_JsonPushHandlerFunc_t callbackPtr,
+    void *contextPtr
+)
+{
+    return AddAppHandler(path, DHUBIO_DATA_TYPE_JSON, (void (*)(void))callbackPtr, contextPtr);
+}
+
+
+le_result_t dhubIO_GetNumericValue
+(
+    const char *path,
+    double *timestampPtr,
+    double *valuePtr
+)
+{
+    const Resource_t *resPtr;
+    le_result_t result = GetValue(path, DHUBIO_DATA_TYPE_NUMERIC, &resPtr);
+    if (result == LE_OK)
+    {
+        *timestampPtr = resPtr->timestamp;
+        *valuePtr = resPtr->numericValue;
+    }
+
+    return result;
+}
+
+
+le_result_t dhubIO_GetStringValue
+(
+    const char *path,
+    double *timestampPtr,
+    char *value,
+    size_t valueSize
+)
+{
+    const Resource_t *resPtr;
+    le_result_t result = GetValue(path, DHUBIO_DATA_TYPE_STRING, &resPtr);
+    if (result == LE_OK)
+    {
+        *timestampPtr = resPtr->timestamp;
+        result = le_utf8_Copy(value, resPtr->stringValue, valueSize, NULL);
+    }
+
+    return result;
+}
+
+
+le_result_t dhubIO_GetJsonValue
+(
+    const char *path,
+    double *timestampPtr,
+    char *value,
+    size_t valueSize
+)
+{
+    const Resource_t *resPtr;
+    le_result_t result = GetValue(path, DHUBIO_DATA_TYPE_JSON, &resPtr);
+    if (result == LE_OK)
+    {
+        *timestampPtr = resPtr->timestamp;
+        result = le_utf8_Copy(value, resPtr->stringValue, valueSize, NULL);
+    }
+
+    return result;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// admin
+//--------------------------------------------------------------------------------------------------
+
+void admin_PushBoolean
+(
+    const char *path,
+    double timestamp,
+    bool value
+)
+{
+    Push(path, DHUBIO_DATA_TYPE_BOOLEAN, timestamp, value, 0, NULL);
+}
+
+
+void admin_PushNumeric
+(
+    const char *path,
+    double timestamp,
+    double value
+)
+{
+    Push(path, DHUBIO_DATA_TYPE_NUMERIC, timestamp, false, value, NULL);
+}
+
+
+void admin_PushString
+(
+    const char *path,
+    double timestamp,
+    const char *value
+)
+{
+    Push(path, DHUBIO_DATA_TYPE_STRING, timestamp, false, 0, value);
+}
+
+
+dhubIO_BooleanPushHandlerRef_t admin_AddBooleanPushHandler
+(
+    const char *path,
+    dhubIO_BooleanPushHandlerFunc_t callbackPtr,
+    void *contextPtr
+)
+{
+    return AddHandler(path, DHUBIO_DATA_TYPE_BOOLEAN, (void (*)(void))callbackPtr, contextPtr);
+}
+
+
+dhubIO_NumericPushHandlerRef_t admin_AddNumericPushHandler
+(
+    const char *path,
+    dhubIO_NumericPushHandlerFunc_t callbackPtr,
+    void *contextPtr
+)
+{
+    return AddHandler(path, DHUBIO_DATA_TYPE_NUMERIC, (void (*)(void))callbackPtr, contextPtr);
+}
+
+
+dhubIO_StringPushHandlerRef_t admin_AddStringPushHandler
+(
+    const char *path,
+    dhubIO_StringPushHandlerFunc_t callbackPtr,
+    void *contextPtr
+)
+{
+    return AddHandler(path, DHUBIO_DATA_TYPE_STRING, (void (*)(void))callbackPtr, contextPtr);
+}
+
+
+dhubIO_JsonPushHandlerRef_t admin_AddJsonPushHandler
+(
+    const char *path,
+    dhubIO_JsonPushHandlerFunc_t callbackPtr,
+    void *contextPtr
+)
+{
+    return AddHandler(path, DHUBIO_DATA_TYPE_JSON, (void (*)(void))callbackPtr, contextPtr);
+}
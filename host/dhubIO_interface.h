@@ -0,0 +1,73 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file dhubIO_interface.h
+ *
+ * Host stand-in for the client interface of the Data Hub's io.api, as bound to "dhubIO" by the
+ * components that use it.  See host/dataHub.c.
+ *
+ * Only the functions that the Battery Service uses are provided, with Legato's signatures.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#ifndef DHUBIO_INTERFACE_H_INCLUDE_GUARD
+#define DHUBIO_INTERFACE_H_INCLUDE_GUARD
+
+#include "legato.h"
+
+/// Timestamp that means "now".
+#define DHUBIO_NOW 0
+
+/// Longest string or JSON value, excluding the terminator.
+#define DHUBIO_MAX_STRING_VALUE_LEN 50000
+
+typedef enum
+{
+    DHUBIO_DATA_TYPE_TRIGGER = 0,
+    DHUBIO_DATA_TYPE_BOOLEAN = 1,
+    DHUBIO_DATA_TYPE_NUMERIC = 2,
+    DHUBIO_DATA_TYPE_STRING = 3,
+    DHUBIO_DATA_TYPE_JSON = 4
+}
+dhubIO_DataType_t;
+
+typedef struct dhubIO_PushHandler *dhubIO_BooleanPushHandlerRef_t;
+typedef struct dhubIO_PushHandler *dhubIO_NumericPushHandlerRef_t;
+typedef struct dhubIO_PushHandler *dhubIO_StringPushHandlerRef_t;
+typedef struct dhubIO_PushHandler *dhubIO_JsonPushHandlerRef_t;
+
+typedef void (*dhubIO_BooleanPushHandlerFunc_t)(double timestamp, bool value, void *contextPtr);
+typedef void (*dhubIO_NumericPushHandlerFunc_t)(double timestamp, double value, void *contextPtr);
+typedef void (*dhubIO_StringPushHandlerFunc_t)(double timestamp, const char *value,
+                                               void *contextPtr);
+typedef void (*dhubIO_JsonPushHandlerFunc_t)(double timestamp, const char *value,
+                                             void *contextPtr);
+
+le_result_t dhubIO_CreateInput(const char *path, dhubIO_DataType_t dataType, const char *units);
+le_result_t dhubIO_CreateOutput(const char *path, dhubIO_DataType_t dataType, const char *units);
+void dhubIO_MarkOptional(const char *path);
+void dhubIO_SetBooleanDefault(const char *path, bool value);
+void dhubIO_SetNumericDefault(const char *path, double value);
+void dhubIO_SetStringDefault(const char *path, const char *value);
+void dhubIO_SetJsonExample(const char *path, const char *example);
+
+void dhubIO_PushBoolean(const char *path, double timestamp, bool value);
+void dhubIO_PushNumeric(const char *path, double timestamp, double value);
+void dhubIO_PushString(const char *path, double timestamp, const char *value);
+void dhubIO_PushJson(const char *path, double timestamp, const char *value);
+
+dhubIO_BooleanPushHandlerRef_t dhubIO_AddBooleanPushHandler(
+    const char *path, dhubIO_BooleanPushHandlerFunc_t callbackPtr, void *contextPtr);
+dhubIO_NumericPushHandlerRef_t dhubIO_AddNumericPushHandler(
+    const char *path, dhubIO_NumericPushHandlerFunc_t callbackPtr, void *contextPtr);
+dhubIO_StringPushHandlerRef_t dhubIO_AddStringPushHandler(
+    const char *path, dhubIO_StringPushHandlerFunc_t callbackPtr, void *contextPtr);
+dhubIO_JsonPushHandlerRef_t dhubIO_AddJsonPushHandler(
+    const char *path, dhubIO_JsonPushHandlerFunc_t callbackPtr, void *contextPtr);
+
+le_result_t dhubIO_GetNumericValue(const char *path, double *timestampPtr, double *valuePtr);
+le_result_t dhubIO_GetStringValue(const char *path, double *timestampPtr, char *value,
+                                  size_t valueSize);
+le_result_t dhubIO_GetJsonValue(const char *path, double *timestampPtr, char *value,
+                                size_t valueSize);
+
+#endif // DHUBIO_INTERFACE_H_INCLUDE_GUARD
@@ -0,0 +1,167 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file hostTest.c
+ *
+ * Helpers shared by the host tests (see hostTest.h).
+ */
+//--------------------------------------------------------------------------------------------------
+
+#include "legato.h"
+#include "hostTest.h"
+
+int test_NumFailures = 0;
+
+/// Temporary directory used as the sysfs root, or empty if none was created.
+static char SysfsRoot[PATH_MAX] = "";
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Create an empty temporary directory, and point BATTERY_SYSFS_ROOT at it.
+ */
+//--------------------------------------------------------------------------------------------------
+void test_CreateSysfsRoot
+(
+    const char *name    ///< Prefix of the directory's name, e.g., the test's name.
+)
+{
+    snprintf(SysfsRoot, sizeof(SysfsRoot), "/tmp/%s.XXXXXX", name);
+    LE_ASSERT(mkdtemp(SysfsRoot) != NULL);
+    LE_ASSERT(setenv("BATTERY_SYSFS_ROOT", SysfsRoot, 1) == 0);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Write a file under the sysfs root, creating its directory if needed.
+ */
+//--------------------------------------------------------------------------------------------------
+void test_WriteSysfsFile
+(
+    const char *relativePath,
+    const char *contents
+)
+{
+    char path[PATH_MAX];
+
+    int pathLen = snprintf(path, sizeof(path), "%s/%s", SysfsRoot, relativePath);
+    LE_ASSERT(pathLen < sizeof(path));
+    for (char *slashPtr = strchr(path + strlen(SysfsRoot) + 1, '/');
+         slashPtr != NULL;
+         slashPtr = strchr(slashPtr + 1, '/'))
+    {
+        *slashPtr = '\0';
+        LE_ASSERT((mkdir(path, 0755) == 0) || (errno == EEXIST));
+        *slashPtr = '/';
+    }
+
+    FILE *filePtr = fopen(path, "w");
+    LE_ASSERT(filePtr != NULL);
+    LE_ASSERT(fputs(contents, filePtr) >= 0);
+    LE_ASSERT(fclose(filePtr) == 0);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Read an integer from a file under the sysfs root.
+ *
+ * @return The integer.
+ */
+//--------------------------------------------------------------------------------------------------
+int test_ReadSysfsInt
+(
+    const char *relativePath
+)
+{
+    char path[PATH_MAX];
+    int value;
+
+    int pathLen = snprintf(path, sizeof(path), "%s/%s", SysfsRoot, relativePath);
+    LE_ASSERT(pathLen < sizeof(path));
+    FILE *filePtr = fopen(path, "r");
+    LE_ASSERT(filePtr != NULL);
+    LE_ASSERT(fscanf(filePtr, "%d", &value) == 1);
+    LE_ASSERT(fclose(filePtr) == 0);
+
+    return value;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Run the main thread's event loop until nothing is pending.
+ */
+//--------------------------------------------------------------------------------------------------
+void test_ServiceEvents
+(
+    void
+)
+{
+    while (le_event_ServiceLoop() == LE_OK)
+    {
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Run the main thread's event loop, including its timers, until a condition is met.
+ *
+ * @return true if the condition was met, false if the time ran out.
+ */
+//--------------------------------------------------------------------------------------------------
+bool test_RunUntil
+(
+    bool (*conditionFunc)(void),
+    uint32_t timeoutMs
+)
+{
+    le_clk_Time_t startTime = le_clk_GetRelativeTime();
+
+    while (!conditionFunc())
+    {
+        le_clk_Time_t elapsed = le_clk_Sub(le_clk_GetRelativeTime(), startTime);
+        if ((elapsed.sec * 1000 + elapsed.usec / 1000) >= timeoutMs)
+        {
+            return false;
+        }
+
+        if (le_event_ServiceLoop() != LE_OK)
+        {
+            usleep(1000);
+        }
+    }
+
+    return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Remove the sysfs root, and report the result of the checks.
+ *
+ * @return The exit status of the test: EXIT_SUCCESS if all the checks passed.
+ */
+//--------------------------------------------------------------------------------------------------
+int test_Finish
+(
+    void
+)
+{
+    if (SysfsRoot[0] != '\0')
+    {
+        char command[PATH_MAX + 16];
+        snprintf(command, sizeof(command), "rm -rf '%s'", SysfsRoot);
+        LE_ASSERT(system(command) == 0);
+    }
+
+    if (test_NumFailures > 0)
+    {
+        fprintf(stderr, "%d checks failed.\n", test_NumFailures);
+        return EXIT_FAILURE;
+    }
+
+    printf("All tests passed.\n");
+    return EXIT_SUCCESS;
+}
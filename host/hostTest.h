@@ -0,0 +1,51 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file hostTest.h
+ *
+ * Helpers shared by the host tests: checks that count their failures, a temporary sysfs tree that
+ * BATTERY_SYSFS_ROOT points at, and running the main thread's event loop.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include "legato.h"
+
+/// Number of checks that failed.
+extern int test_NumFailures;
+
+/// Check a condition, reporting it if it is false.
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            test_NumFailures++; \
+        } \
+    } \
+    while (0)
+
+/// Check that two results are equal, reporting both if not.
+#define CHECK_RESULT(actual, expected) \
+    do \
+    { \
+        le_result_t actualResult = (actual); \
+        if (actualResult != (expected)) \
+        { \
+            fprintf(stderr, "%s:%d: %s is %s, expected %s\n", __FILE__, __LINE__, #actual, \
+                    LE_RESULT_TXT(actualResult), LE_RESULT_TXT(expected)); \
+            test_NumFailures++; \
+        } \
+    } \
+    while (0)
+
+void test_CreateSysfsRoot(const char *name);
+void test_WriteSysfsFile(const char *relativePath, const char *contents);
+int test_ReadSysfsInt(const char *relativePath);
+void test_ServiceEvents(void);
+bool test_RunUntil(bool (*conditionFunc)(void), uint32_t timeoutMs);
+int test_Finish(void);
+
+#endif // HOST_TEST_H
@@ -0,0 +1,20 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file interfaces.h
+ *
+ * Host stand-in for the interfaces.h that Legato's mk tools generate for each component.  The
+ * same one serves every component: it includes the ma_battery server interface, which batteryCore
+ * provides, the ma_adminbattery server interface, which the Red backend provides, and the Config
+ * Tree and Data Hub client interfaces.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#ifndef __INTERFACES_H_INCLUDE_GUARD__
+#define __INTERFACES_H_INCLUDE_GUARD__
+
+#include "ma_battery_server.h"
+#include "ma_adminbattery_server.h"
+#include "le_cfg_interface.h"
+#include "dhubIO_interface.h"
+
+#endif // __INTERFACES_H_INCLUDE_GUARD__
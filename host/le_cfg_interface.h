@@ -0,0 +1,43 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file le_cfg_interface.h
+ *
+ * Host stand-in for the client interface of Legato's Config Tree (le_cfg.api): an in-memory tree
+ * of integer, floating point and string values, which starts empty in each process.
+ *
+ * Only the functions that the Battery Service uses are provided.  A write transaction's changes
+ * are applied when it is committed, and reads through it see the tree as last committed.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#ifndef LE_CFG_INTERFACE_H_INCLUDE_GUARD
+#define LE_CFG_INTERFACE_H_INCLUDE_GUARD
+
+#include "legato.h"
+
+typedef struct le_cfg_Iterator *le_cfg_IteratorRef_t;
+
+le_cfg_IteratorRef_t le_cfg_CreateReadTxn(const char *basePath);
+le_cfg_IteratorRef_t le_cfg_CreateWriteTxn(const char *basePath);
+void le_cfg_CommitTxn(le_cfg_IteratorRef_t iteratorRef);
+void le_cfg_CancelTxn(le_cfg_IteratorRef_t iteratorRef);
+
+int32_t le_cfg_GetInt(le_cfg_IteratorRef_t iteratorRef, const char *path, int32_t defaultValue);
+void le_cfg_SetInt(le_cfg_IteratorRef_t iteratorRef, const char *path, int32_t value);
+double le_cfg_GetFloat(le_cfg_IteratorRef_t iteratorRef, const char *path, double defaultValue);
+void le_cfg_SetFloat(le_cfg_IteratorRef_t iteratorRef, const char *path, double value);
+le_result_t le_cfg_GetString(le_cfg_IteratorRef_t iteratorRef, const char *path, char *value,
+                             size_t valueSize, const char *defaultValue);
+void le_cfg_SetString(le_cfg_IteratorRef_t iteratorRef, const char *path, const char *value);
+void le_cfg_DeleteNode(le_cfg_IteratorRef_t iteratorRef, const char *path);
+
+int32_t le_cfg_QuickGetInt(const char *path, int32_t defaultValue);
+void le_cfg_QuickSetInt(const char *path, int32_t value);
+double le_cfg_QuickGetFloat(const char *path, double defaultValue);
+void le_cfg_QuickSetFloat(const char *path, double value);
+le_result_t le_cfg_QuickGetString(const char *path, char *value, size_t valueSize,
+                                  const char *defaultValue);
+void le_cfg_QuickSetString(const char *path, const char *value);
+void le_cfg_QuickDeleteNode(const char *path);
+
+#endif // LE_CFG_INTERFACE_H_INCLUDE_GUARD
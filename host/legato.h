@@ -0,0 +1,327 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file legato.h
+ *
+ * Minimal stand-in for the Legato framework, used to build and test the Battery Service's
+ * board-independent components on an ordinary Linux host (see CMakeLists.txt at the top of the
+ * tree).  Only the parts of the le_* API that those components use are provided, with the same
+ * signatures and behaviour as Legato's:
+ *
+ *  - result codes and logging (LE_DEBUG() to LE_FATAL(), filtered by the LE_LOG_LEVEL environment
+ *    variable, which takes DEBUG, INFO, WARNING, ERROR, CRITICAL or EMERGENCY);
+ *  - memory pools, doubly linked lists, safe references, hash maps, the clock and UTF-8 string
+ *    copies;
+ *  - threads, each with an event loop that runs queued functions, timers and file descriptor
+ *    monitors, and semaphores;
+ *  - signal events, received through the event loop of the thread that set their handler;
+ *  - the messaging types that a server's API functions use (but no messaging).
+ *
+ * This is not part of the Legato build, which uses the framework's own legato.h.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#ifndef LEGATO_H_INCLUDE_GUARD
+#define LEGATO_H_INCLUDE_GUARD
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+//--------------------------------------------------------------------------------------------------
+// Basics
+//--------------------------------------------------------------------------------------------------
+
+/// Result codes, with the values Legato gives them.
+typedef enum
+{
+    LE_OK = 0,
+    LE_NOT_FOUND = -1,
+    LE_NOT_POSSIBLE = -2,
+    LE_OUT_OF_RANGE = -3,
+    LE_NO_MEMORY = -4,
+    LE_NOT_PERMITTED = -5,
+    LE_FAULT = -6,
+    LE_COMM_ERROR = -7,
+    LE_TIMEOUT = -8,
+    LE_OVERFLOW = -9,
+    LE_UNDERFLOW = -10,
+    LE_WOULD_BLOCK = -11,
+    LE_DEADLOCK = -12,
+    LE_FORMAT_ERROR = -13,
+    LE_DUPLICATE = -14,
+    LE_BAD_PARAMETER = -15,
+    LE_CLOSED = -16,
+    LE_BUSY = -17,
+    LE_UNSUPPORTED = -18,
+    LE_IO_ERROR = -19,
+    LE_NOT_IMPLEMENTED = -20,
+    LE_UNAVAILABLE = -21,
+    LE_TERMINATED = -22,
+}
+le_result_t;
+
+const char *le_result_ToString(le_result_t result);
+#define LE_RESULT_TXT(v) le_result_ToString(v)
+
+/// Functions shared between components.  Everything is linked statically on the host.
+#define LE_SHARED
+
+/// Each component's initialization function.  COMPONENT_INIT_NAME is set by the build.
+#ifndef COMPONENT_INIT_NAME
+#define COMPONENT_INIT_NAME _component_COMPONENT_INIT
+#endif
+#define COMPONENT_INIT void COMPONENT_INIT_NAME(void)
+
+#define NUM_ARRAY_MEMBERS(array) (sizeof(array) / sizeof((array)[0]))
+#define CONTAINER_OF(memberPtr, type, member) \
+    ((type *)(((uint8_t *)(memberPtr)) - offsetof(type, member)))
+
+#define LE_UNUSED(v) ((void)(v))
+
+//--------------------------------------------------------------------------------------------------
+// Logging
+//--------------------------------------------------------------------------------------------------
+
+/// Severity levels, from least to most severe.
+typedef enum
+{
+    LE_LOG_DEBUG,
+    LE_LOG_INFO,
+    LE_LOG_WARN,
+    LE_LOG_ERR,
+    LE_LOG_CRIT,
+    LE_LOG_EMERG,
+}
+le_log_Level_t;
+
+void _le_log_Send(le_log_Level_t level, const char *file, unsigned int line,
+                  const char *format, ...) __attribute__((format(printf, 4, 5)));
+
+#define _LE_LOG_MSG(level, formatString, ...) \
+    _le_log_Send(level, __FILE__, __LINE__, formatString, ##__VA_ARGS__)
+
+#define LE_DEBUG(formatString, ...) _LE_LOG_MSG(LE_LOG_DEBUG, formatString, ##__VA_ARGS__)
+#define LE_INFO(formatString, ...)  _LE_LOG_MSG(LE_LOG_INFO, formatString, ##__VA_ARGS__)
+#define LE_WARN(formatString, ...)  _LE_LOG_MSG(LE_LOG_WARN, formatString, ##__VA_ARGS__)
+#define LE_ERROR(formatString, ...) _LE_LOG_MSG(LE_LOG_ERR, formatString, ##__VA_ARGS__)
+#define LE_CRIT(formatString, ...)  _LE_LOG_MSG(LE_LOG_CRIT, formatString, ##__VA_ARGS__)
+#define LE_EMERG(formatString, ...) _LE_LOG_MSG(LE_LOG_EMERG, formatString, ##__VA_ARGS__)
+
+#define LE_DEBUG_IF(condition, formatString, ...) \
+    if (condition) { LE_DEBUG(formatString, ##__VA_ARGS__); }
+#define LE_INFO_IF(condition, formatString, ...) \
+    if (condition) { LE_INFO(formatString, ##__VA_ARGS__); }
+#define LE_WARN_IF(condition, formatString, ...) \
+    if (condition) { LE_WARN(formatString, ##__VA_ARGS__); }
+#define LE_ERROR_IF(condition, formatString, ...) \
+    if (condition) { LE_ERROR(formatString, ##__VA_ARGS__); }
+
+#define LE_FATAL(formatString, ...) \
+    do { LE_EMERG(formatString, ##__VA_ARGS__); abort(); } while (0)
+#define LE_FATAL_IF(condition, formatString, ...) \
+    do { if (condition) { LE_FATAL(formatString, ##__VA_ARGS__); } } while (0)
+#define LE_ASSERT(condition) \
+    do { if (!(condition)) { LE_FATAL("Assert Failed: '%s'", #condition); } } while (0)
+#define LE_ASSERT_OK(condition) LE_ASSERT((condition) == LE_OK)
+
+//--------------------------------------------------------------------------------------------------
+// Memory pools
+//--------------------------------------------------------------------------------------------------
+
+typedef struct le_mem_Pool *le_mem_PoolRef_t;
+
+le_mem_PoolRef_t le_mem_CreatePool(const char *name, size_t objSize);
+le_mem_PoolRef_t le_mem_ExpandPool(le_mem_PoolRef_t pool, size_t numObjects);
+void *le_mem_TryAlloc(le_mem_PoolRef_t pool);
+void *le_mem_ForceAlloc(le_mem_PoolRef_t pool);
+void le_mem_AddRef(void *objPtr);
+void le_mem_Release(void *objPtr);
+
+//--------------------------------------------------------------------------------------------------
+// Doubly linked lists
+//--------------------------------------------------------------------------------------------------
+
+typedef struct le_dls_Link
+{
+    struct le_dls_Link *nextPtr;
+    struct le_dls_Link *prevPtr;
+}
+le_dls_Link_t;
+
+/// A list is circular; headLinkPtr is NULL if it is empty.
+typedef struct
+{
+    le_dls_Link_t *headLinkPtr;
+}
+le_dls_List_t;
+
+#define LE_DLS_LIST_INIT (le_dls_List_t){ NULL }
+#define LE_DLS_LINK_INIT (le_dls_Link_t){ NULL, NULL }
+
+void le_dls_Stack(le_dls_List_t *listPtr, le_dls_Link_t *newLinkPtr);
+void le_dls_Queue(le_dls_List_t *listPtr, le_dls_Link_t *newLinkPtr);
+le_dls_Link_t *le_dls_Pop(le_dls_List_t *listPtr);
+le_dls_Link_t *le_dls_PopTail(le_dls_List_t *listPtr);
+void le_dls_Remove(le_dls_List_t *listPtr, le_dls_Link_t *linkToRemovePtr);
+le_dls_Link_t *le_dls_Peek(const le_dls_List_t *listPtr);
+le_dls_Link_t *le_dls_PeekTail(const le_dls_List_t *listPtr);
+le_dls_Link_t *le_dls_PeekNext(const le_dls_List_t *listPtr, const le_dls_Link_t *currentLinkPtr);
+le_dls_Link_t *le_dls_PeekPrev(const le_dls_List_t *listPtr, const le_dls_Link_t *currentLinkPtr);
+bool le_dls_IsEmpty(const le_dls_List_t *listPtr);
+size_t le_dls_NumLinks(const le_dls_List_t *listPtr);
+
+//--------------------------------------------------------------------------------------------------
+// Safe references
+//--------------------------------------------------------------------------------------------------
+
+typedef struct le_ref_Map *le_ref_MapRef_t;
+typedef struct le_ref_Iter *le_ref_IterRef_t;
+
+le_ref_MapRef_t le_ref_CreateMap(const char *name, size_t maxRefs);
+void *le_ref_CreateRef(le_ref_MapRef_t mapRef, void *ptr);
+void *le_ref_Lookup(le_ref_MapRef_t mapRef, void *safeRef);
+void le_ref_DeleteRef(le_ref_MapRef_t mapRef, void *safeRef);
+le_ref_IterRef_t le_ref_GetIterator(le_ref_MapRef_t mapRef);
+le_result_t le_ref_NextNode(le_ref_IterRef_t iteratorRef);
+void *le_ref_GetValue(le_ref_IterRef_t iteratorRef);
+const void *le_ref_GetSafeRef(le_ref_IterRef_t iteratorRef);
+
+//--------------------------------------------------------------------------------------------------
+// Hash maps
+//--------------------------------------------------------------------------------------------------
+
+typedef struct le_hashmap *le_hashmap_Ref_t;
+typedef size_t (*le_hashmap_HashFunc_t)(const void *keyToHashPtr);
+typedef bool (*le_hashmap_EqualsFunc_t)(const void *firstKeyPtr, const void *secondKeyPtr);
+
+le_hashmap_Ref_t le_hashmap_Create(const char *nameStr, size_t capacity,
+                                   le_hashmap_HashFunc_t hashFunc,
+                                   le_hashmap_EqualsFunc_t equalsFunc);
+void *le_hashmap_Put(le_hashmap_Ref_t mapRef, const void *keyPtr, const void *valuePtr);
+void *le_hashmap_Get(le_hashmap_Ref_t mapRef, const void *keyPtr);
+void *le_hashmap_Remove(le_hashmap_Ref_t mapRef, const void *keyPtr);
+size_t le_hashmap_Size(le_hashmap_Ref_t mapRef);
+size_t le_hashmap_HashVoidPointer(const void *voidToHashPtr);
+bool le_hashmap_EqualsVoidPointer(const void *firstVoidPtr, const void *secondVoidPtr);
+
+//--------------------------------------------------------------------------------------------------
+// Clock
+//--------------------------------------------------------------------------------------------------
+
+typedef struct
+{
+    time_t sec;
+    long usec;
+}
+le_clk_Time_t;
+
+le_clk_Time_t le_clk_GetRelativeTime(void);
+le_clk_Time_t le_clk_GetAbsoluteTime(void);
+le_clk_Time_t le_clk_Add(le_clk_Time_t timeA, le_clk_Time_t timeB);
+le_clk_Time_t le_clk_Sub(le_clk_Time_t timeA, le_clk_Time_t timeB);
+bool le_clk_GreaterThan(le_clk_Time_t timeA, le_clk_Time_t timeB);
+
+//--------------------------------------------------------------------------------------------------
+// UTF-8 strings
+//--------------------------------------------------------------------------------------------------
+
+le_result_t le_utf8_Copy(char *destStr, const char *srcStr, const size_t destSize,
+                         size_t *numBytesPtr);
+
+//--------------------------------------------------------------------------------------------------
+// Threads, event loops and semaphores
+//--------------------------------------------------------------------------------------------------
+
+typedef struct le_thread *le_thread_Ref_t;
+typedef void *(*le_thread_MainFunc_t)(void *context);
+
+le_thread_Ref_t le_thread_Create(const char *name, le_thread_MainFunc_t mainFunc, void *context);
+void le_thread_Start(le_thread_Ref_t thread);
+le_thread_Ref_t le_thread_GetCurrent(void);
+
+typedef void (*le_event_DeferredFunc_t)(void *param1Ptr, void *param2Ptr);
+
+void le_event_QueueFunction(le_event_DeferredFunc_t func, void *param1Ptr, void *param2Ptr);
+void le_event_QueueFunctionToThread(le_thread_Ref_t thread, le_event_DeferredFunc_t func,
+                                    void *param1Ptr, void *param2Ptr);
+le_result_t le_event_ServiceLoop(void);
+void le_event_RunLoop(void) __attribute__((noreturn));
+
+typedef struct le_fdMonitor *le_fdMonitor_Ref_t;
+typedef void (*le_fdMonitor_HandlerFunc_t)(int fd, short events);
+
+le_fdMonitor_Ref_t le_fdMonitor_Create(const char *name, int fd,
+                                       le_fdMonitor_HandlerFunc_t handlerFunc, short events);
+void le_fdMonitor_Delete(le_fdMonitor_Ref_t monitorRef);
+
+typedef struct le_sem *le_sem_Ref_t;
+
+le_sem_Ref_t le_sem_Create(const char *name, int32_t initialCount);
+void le_sem_Post(le_sem_Ref_t semaphorePtr);
+void le_sem_Wait(le_sem_Ref_t semaphorePtr);
+
+//--------------------------------------------------------------------------------------------------
+// Timers
+//
+// A timer belongs to the thread that created it, and expires in that thread's event loop.
+//--------------------------------------------------------------------------------------------------
+
+typedef struct le_timer *le_timer_Ref_t;
+typedef void (*le_timer_ExpiryHandler_t)(le_timer_Ref_t timerRef);
+
+le_timer_Ref_t le_timer_Create(const char *nameStr);
+void le_timer_Delete(le_timer_Ref_t timerRef);
+le_result_t le_timer_SetHandler(le_timer_Ref_t timerRef, le_timer_ExpiryHandler_t handlerFunc);
+le_result_t le_timer_SetMsInterval(le_timer_Ref_t timerRef, uint32_t interval);
+le_result_t le_timer_SetRepeat(le_timer_Ref_t timerRef, uint32_t repeatCount);
+le_result_t le_timer_SetContextPtr(le_timer_Ref_t timerRef, void *contextPtr);
+void *le_timer_GetContextPtr(le_timer_Ref_t timerRef);
+le_result_t le_timer_Start(le_timer_Ref_t timerRef);
+le_result_t le_timer_Stop(le_timer_Ref_t timerRef);
+void le_timer_Restart(le_timer_Ref_t timerRef);
+bool le_timer_IsRunning(le_timer_Ref_t timerRef);
+
+//--------------------------------------------------------------------------------------------------
+// Signal events
+//--------------------------------------------------------------------------------------------------
+
+typedef void (*le_sig_EventHandlerFunc_t)(int sigNum);
+
+void le_sig_Block(int sigNum);
+void le_sig_SetEventHandler(int sigNum, le_sig_EventHandlerFunc_t sigEventHandler);
+
+//--------------------------------------------------------------------------------------------------
+// Messaging
+//
+// There is no IPC on the host.  A test that calls a server's API functions directly stands in for
+// the messaging layer, and defines le_msg_AddServiceCloseHandler() along with the server's
+// <api>_GetServiceRef() and <api>_GetClientSessionRef().
+//--------------------------------------------------------------------------------------------------
+
+typedef struct le_msg_Session *le_msg_SessionRef_t;
+typedef struct le_msg_Service *le_msg_ServiceRef_t;
+typedef struct le_msg_SessionEventHandler *le_msg_SessionEventHandlerRef_t;
+typedef void (*le_msg_SessionEventHandler_t)(le_msg_SessionRef_t sessionRef, void *contextPtr);
+
+le_msg_SessionEventHandlerRef_t le_msg_AddServiceCloseHandler(
+    le_msg_ServiceRef_t serviceRef, le_msg_SessionEventHandler_t handlerFunc, void *contextPtr);
+
+#endif // LEGATO_H_INCLUDE_GUARD
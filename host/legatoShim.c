@@ -0,0 +1,1950 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file legatoShim.c
+ *
+ * Host implementation of the parts of the Legato framework declared in host/legato.h.
+ *
+ * Each thread created with le_thread_Create() (and the main thread) has an event loop: a queue of
+ * deferred functions, a pipe that wakes the loop when a function is queued, and the timers and
+ * file descriptor monitors created in that thread.  le_event_ServiceLoop() runs one pending event
+ * without blocking, which lets a test drive the main thread's loop one step at a time.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#include "legato.h"
+#include <poll.h>
+#include <sys/signalfd.h>
+
+/// Largest number of file descriptor monitors per thread.
+#define MAX_FD_MONITORS 8
+
+/// Largest number of signals with an event handler.
+#define MAX_SIG_HANDLERS 4
+
+/// A function queued to a thread's event loop.
+typedef struct QueuedFunc
+{
+    struct QueuedFunc *nextPtr;
+    le_event_DeferredFunc_t func;
+    void *param1Ptr;
+    void *param2Ptr;
+}
+QueuedFunc_t;
+
+/// A file descriptor monitor.
+typedef struct le_fdMonitor
+{
+    int fd;                             ///< -1 if the monitor was deleted.
+    short events;
+    le_fdMonitor_HandlerFunc_t handlerFunc;
+}
+FdMonitor_t;
+
+/// A timer.
+typedef struct le_timer
+{
+    char name[32];
+    struct le_thread *threadPtr;        ///< Thread whose event loop the timer expires in.
+    struct le_timer *nextPtr;           ///< Next timer of the same thread.
+    le_timer_ExpiryHandler_t handlerFunc;
+    void *contextPtr;
+    uint32_t intervalMs;
+    uint32_t repeatCount;               ///< Number of expiries per start, or 0 for no limit.
+    uint32_t expiryCount;               ///< Number of expiries since the timer was started.
+    bool isRunning;
+    le_clk_Time_t expiryTime;           ///< When the timer next expires, if it is running.
+}
+Timer_t;
+
+/// A signal's event handler.
+typedef struct
+{
+    int sigNum;
+    int fd;                             ///< signalfd that receives the signal.
+    le_sig_EventHandlerFunc_t handlerFunc;
+}
+SigHandler_t;
+
+/// A thread and its event loop.
+typedef struct le_thread
+{
+    char name[32];
+    le_thread_MainFunc_t mainFunc;
+    void *context;
+    pthread_mutex_t mutex;              ///< Protects the queue.
+    QueuedFunc_t *queueHeadPtr;
+    QueuedFunc_t *queueTailPtr;
+    int wakeFds[2];                     ///< Pipe written to when a function is queued.
+    FdMonitor_t monitors[MAX_FD_MONITORS];
+    size_t numMonitors;
+    Timer_t *timersPtr;                 ///< Timers created in the thread.
+}
+Thread_t;
+
+/// A semaphore.
+typedef struct le_sem
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int32_t count;
+}
+Sem_t;
+
+/// A memory pool.  Objects are allocated from the heap, preceded by a header.
+typedef struct le_mem_Pool
+{
+    char name[32];
+    size_t objSize;
+}
+Pool_t;
+
+/// Header of a pool object.
+typedef struct
+{
+    Pool_t *poolPtr;
+    int refCount;
+    union { long double d; void *p; uint64_t u; } align[]; ///< The object follows, aligned.
+}
+PoolObjHeader_t;
+
+/// A safe reference and the pointer it stands for.
+typedef struct
+{
+    void *safeRef;
+    void *ptr;
+}
+RefEntry_t;
+
+/// Iterator over a safe reference map.
+typedef struct le_ref_Iter
+{
+    struct le_ref_Map *mapPtr;
+    size_t nextIndex;                   ///< Index of the entry after the current one.
+}
+RefIter_t;
+
+/// A safe reference map.  The entries are kept in creation order, and references are never
+/// reused, so a stale reference is never mistaken for a live one.
+typedef struct le_ref_Map
+{
+    char name[32];
+    RefEntry_t *entries;
+    size_t numEntries;
+    size_t capacity;
+    uintptr_t nextRef;
+    RefIter_t iter;                     ///< The map's one iterator.
+}
+RefMap_t;
+
+/// A key and its value in a hash map.
+typedef struct
+{
+    const void *keyPtr;
+    const void *valuePtr;
+}
+HashEntry_t;
+
+/// A hash map.  Maps on the host only hold a few keys, so they are searched linearly and the
+/// hash function is not used.
+typedef struct le_hashmap
+{
+    char name[32];
+    le_hashmap_EqualsFunc_t equalsFunc;
+    HashEntry_t *entries;
+    size_t numEntries;
+    size_t capacity;
+}
+HashMap_t;
+
+/// The calling thread.
+static __thread Thread_t *CurrentThreadPtr = NULL;
+
+/// Signals with an event handler.
+static SigHandler_t SigHandlers[MAX_SIG_HANDLERS];
+static size_t NumSigHandlers = 0;
+
+/// Least severe level that is logged.
+static le_log_Level_t LogLevel = LE_LOG_INFO;
+static pthread_once_t LogLevelOnce = PTHREAD_ONCE_INIT;
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the name of a result code.
+ *
+ * @return The name, e.g. "LE_OK".
+ */
+//--------------------------------------------------------------------------------------------------
+const char *le_result_ToString
+(
+    le_result_t result
+)
+{
+    static const char *const names[] =
+    {
+        "LE_OK", "LE_NOT_FOUND", "LE_NOT_POSSIBLE", "LE_OUT_OF_RANGE", "LE_NO_MEMORY",
+        "LE_NOT_PERMITTED", "LE_FAULT", "LE_COMM_ERROR", "LE_TIMEOUT", "LE_OVERFLOW",
+        "LE_UNDERFLOW", "LE_WOULD_BLOCK", "LE_DEADLOCK", "LE_FORMAT_ERROR", "LE_DUPLICATE",
+        "LE_BAD_PARAMETER", "LE_CLOSED", "LE_BUSY", "LE_UNSUPPORTED", "LE_IO_ERROR",
+        "LE_NOT_IMPLEMENTED", "LE_UNAVAILABLE", "LE_TERMINATED",
+    };
+
+    if ((result > 0) || (-result >= (int)NUM_ARRAY_MEMBERS(names)))
+    {
+        return "(unknown)";
+    }
+
+    return names[-result];
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Set the log level from the LE_LOG_LEVEL environment variable.
+ */
+//--------------------------------------------------------------------------------------------------
+static void InitLogLevel
+(
+    void
+)
+{
+    static const char *const names[] =
+    {
+        [LE_LOG_DEBUG] = "DEBUG",
+        [LE_LOG_INFO] = "INFO",
+        [LE_LOG_WARN] = "WARNING",
+        [LE_LOG_ERR] = "ERROR",
+        [LE_LOG_CRIT] = "CRITICAL",
+        [LE_LOG_EMERG] = "EMERGENCY",
+    };
+
+    const char *levelStr = getenv("LE_LOG_LEVEL");
+    if (levelStr == NULL)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < NUM_ARRAY_MEMBERS(names); i++)
+    {
+        if (strcmp(levelStr, names[i]) == 0)
+        {
+            LogLevel = (le_log_Level_t)i;
+        }
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Log a message to stderr, if its level is enabled.
+ */
+//--------------------------------------------------------------------------------------------------
+void _le_log_Send
+(
+    le_log_Level_t level,
+    const char *file,
+    unsigned int line,
+    const char *format,
+    ...
+)
+{
+    static const char levelChars[] = "DIWECX";
+
+    int savedErrno = errno;
+    pthread_once(&LogLevelOnce, InitLogLevel);
+
+    if (level < LogLevel)
+    {
+        return;
+    }
+
+    const char *baseName = strrchr(file, '/');
+
+    // %m must see the caller's errno.
+    errno = savedErrno;
+
+    char message[512];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+
+    fprintf(stderr, "%c | %s %u | %s\n",
+            levelChars[level], (baseName != NULL) ? baseName + 1 : file, line, message);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Create a memory pool.
+ *
+ * @return Reference to the pool (never NULL).
+ */
+//--------------------------------------------------------------------------------------------------
+le_mem_PoolRef_t le_mem_CreatePool
+(
+    const char *name,
+    size_t objSize
+)
+{
+    Pool_t *poolPtr = calloc(1, sizeof(Pool_t));
+    LE_ASSERT(poolPtr != NULL);
+
+    snprintf(poolPtr->name, sizeof(poolPtr->name), "%s", name);
+    poolPtr->objSize = objSize;
+
+    return poolPtr;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Pre-allocate objects in a pool.  Objects are allocated as needed on the host, so this does
+ * nothing.
+ *
+ * @return The pool.
+ */
+//--------------------------------------------------------------------------------------------------
+le_mem_PoolRef_t le_mem_ExpandPool
+(
+    le_mem_PoolRef_t pool,
+    size_t numObjects
+)
+{
+    return pool;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Allocate an object from a pool, with a reference count of 1.
+ *
+ * @return Ptr to the object, or NULL if out of memory.
+ */
+//--------------------------------------------------------------------------------------------------
+void *le_mem_TryAlloc
+(
+    le_mem_PoolRef_t pool
+)
+{
+    PoolObjHeader_t *headerPtr = malloc(sizeof(PoolObjHeader_t) + pool->objSize);
+    if (headerPtr == NULL)
+    {
+        return NULL;
+    }
+
+    headerPtr->poolPtr = pool;
+    headerPtr->refCount = 1;
+
+    return headerPtr->align;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Allocate an object from a pool, with a reference count of 1.  Fatal if out of memory.
+ *
+ * @return Ptr to the object.
+ */
+//--------------------------------------------------------------------------------------------------
+void *le_mem_ForceAlloc
+(
+    le_mem_PoolRef_t pool
+)
+{
+    void *objPtr = le_mem_TryAlloc(pool);
+    LE_FATAL_IF(objPtr == NULL, "Out of memory for pool '%s'.", pool->name);
+
+    return objPtr;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Add a reference to a pool object.
+ */
+//--------------------------------------------------------------------------------------------------
+void le_mem_AddRef
+(
+    void *objPtr
+)
+{
+    PoolObjHeader_t *headerPtr = CONTAINER_OF(objPtr, PoolObjHeader_t, align);
+
+    __atomic_add_fetch(&headerPtr->refCount, 1, __ATOMIC_RELAXED);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Release a reference to a pool object, freeing it when the last one is released.
+ */
+//--------------------------------------------------------------------------------------------------
+void le_mem_Release
+(
+    void *objPtr
+)
+{
+    PoolObjHeader_t *headerPtr = CONTAINER_OF(objPtr, PoolObjHeader_t, align);
+
+    int refCount = __atomic_sub_fetch(&headerPtr->refCount, 1, __ATOMIC_ACQ_REL);
+    LE_ASSERT(refCount >= 0);
+
+    if (refCount == 0)
+    {
+        free(headerPtr);
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Add a link at the head of a list.
+ */
+//--------------------------------------------------------------------------------------------------
+void le_dls_Stack
+(
+    le_dls_List_t *listPtr,
+    le_dls_Link_t *newLinkPtr
+)
+{
+    le_dls_Queue(listPtr, newLinkPtr);
+    listPtr->headLinkPtr = newLinkPtr;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Add a link at the tail of a list.
+ */
+//--------------------------------------------------------------------------------------------------
+void le_dls_Queue
+(
+    le_dls_List_t *listPtr,
+    le_dls_Link_t *newLinkPtr
+)
+{
+    le_dls_Link_t *headPtr = listPtr->headLinkPtr;
+
+    if (headPtr == NULL)
+    {
+        newLinkPtr->nextPtr = newLinkPtr;
+        newLinkPtr->prevPtr = newLinkPtr;
+        listPtr->headLinkPtr = newLinkPtr;
+        return;
+    }
+
+    newLinkPtr->nextPtr = headPtr;
+    newLinkPtr->prevPtr = headPtr->prevPtr;
+    headPtr->prevPtr->nextPtr = newLinkPtr;
+    headPtr->prevPtr = newLinkPtr;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Remove a link from a list.
+ */
+//--------------------------------------------------------------------------------------------------
+void le_dls_Remove
+(
+    le_dls_List_t *listPtr,
+    le_dls_Link_t *linkToRemovePtr
+)
+{
+    if (linkToRemovePtr->nextPtr == linkToRemovePtr)
+    {
+        listPtr->headLinkPtr = NULL;
+    }
+    else
+    {
+        linkToRemovePtr->prevPtr->nextPtr = linkToRemovePtr->nextPtr;
+        linkToRemovePtr->nextPtr->prevPtr = linkToRemovePtr->prevPtr;
+
+        if (listPtr->headLinkPtr == linkToRemovePtr)
+        {
+            listPtr->headLinkPtr = linkToRemovePtr->nextPtr;
+        }
+    }
+
+    linkToRemovePtr->nextPtr = NULL;
+    linkToRemovePtr->prevPtr = NULL;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Remove the link at the head of a list.
+ *
+ * @return Ptr to the link, or NULL if the list is empty.
+ */
+//--------------------------------------------------------------------------------------------------
+le_dls_Link_t *le_dls_Pop
+(
+    le_dls_List_t *listPtr
+)
+{
+    le_dls_Link_t *linkPtr = listPtr->headLinkPtr;
+    if (linkPtr != NULL)
+    {
+        le_dls_Remove(listPtr, linkPtr);
+    }
+
+    return linkPtr;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Remove the link at the tail of a list.
+ *
+ * @return Ptr to the link, or NULL if the list is empty.
+ */
+//--------------------------------------------------------------------------------------------------
+le_dls_Link_t *le_dls_PopTail
+(
+    le_dls_List_t *listPtr
+)
+{
+    le_dls_Link_t *linkPtr = le_dls_PeekTail(listPtr);
+    if (linkPtr != NULL)
+    {
+        le_dls_Remove(listPtr, linkPtr);
+    }
+
+    return linkPtr;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * @return Ptr to the link at the head of a list, or NULL if the list is empty.
+ */
+//--------------------------------------------------------------------------------------------------
+le_dls_Link_t *le_dls_Peek
+(
+    const le_dls_List_t *listPtr
+)
+{
+    return listPtr->headLinkPtr;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * @return Ptr to the link at the tail of a list, or NULL if the list is empty.
+ */
+//--------------------------------------------------------------------------------------------------
+le_dls_Link_t *le_dls_PeekTail
+(
+    const le_dls_List_t *listPtr
+)
+{
+    return (listPtr->headLinkPtr == NULL) ? NULL : listPtr->headLinkPtr->prevPtr;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * @return Ptr to the link after a link in a list, or NULL if it is the tail.
+ */
+//--------------------------------------------------------------------------------------------------
+le_dls_Link_t *le_dls_PeekNext
+(
+    const le_dls_List_t *listPtr,
+    const le_dls_Link_t *currentLinkPtr
+)
+{
+    return (currentLinkPtr->nextPtr == listPtr->headLinkPtr) ? NULL : currentLinkPtr->nextPtr;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * @return Ptr to the link before a link in a list, or NULL if it is the head.
+ */
+//--------------------------------------------------------------------------------------------------
+le_dls_Link_t *le_dls_PeekPrev
+(
+    const le_dls_List_t *listPtr,
+    const le_dls_Link_t *currentLinkPtr
+)
+{
+    return (currentLinkPtr == listPtr->headLinkPtr) ? NULL : currentLinkPtr->prevPtr;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * @return true if a list is empty.
+ */
+//--------------------------------------------------------------------------------------------------
+bool le_dls_IsEmpty
+(
+    const le_dls_List_t *listPtr
+)
+{
+    return (listPtr->headLinkPtr == NULL);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * @return The number of links in a list.
+ */
+//--------------------------------------------------------------------------------------------------
+size_t le_dls_NumLinks
+(
+    const le_dls_List_t *listPtr
+)
+{
+    size_t count = 0;
+
+    for (const le_dls_Link_t *linkPtr = le_dls_Peek(listPtr);
+         linkPtr != NULL;
+         linkPtr = le_dls_PeekNext(listPtr, linkPtr))
+    {
+        count++;
+    }
+
+    return count;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Grow an array of entries if it is full.
+ */
+//--------------------------------------------------------------------------------------------------
+static void GrowEntries
+(
+    void **entriesPtrPtr,
+    size_t *capacityPtr,
+    size_t numEntries,
+    size_t entrySize
+)
+{
+    if (numEntries < *capacityPtr)
+    {
+        return;
+    }
+
+    size_t capacity = (*capacityPtr > 0) ? (*capacityPtr * 2) : 4;
+    void *entriesPtr = realloc(*entriesPtrPtr, capacity * entrySize);
+    LE_ASSERT(entriesPtr != NULL);
+
+    *entriesPtrPtr = entriesPtr;
+    *capacityPtr = capacity;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Create a safe reference map.
+ *
+ * @return Reference to the map (never NULL).
+ */
+//--------------------------------------------------------------------------------------------------
+le_ref_MapRef_t le_ref_CreateMap
+(
+    const char *name,
+    size_t maxRefs      ///< Only a hint; the map grows as needed.
+)
+{
+    RefMap_t *mapPtr = calloc(1, sizeof(RefMap_t));
+    LE_ASSERT(mapPtr != NULL);
+
+    snprintf(mapPtr->name, sizeof(mapPtr->name), "%s", name);
+    mapPtr->nextRef = 1;
+    mapPtr->iter.mapPtr = mapPtr;
+
+    return mapPtr;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Find the entry of a safe reference.
+ *
+ * @return Index of the entry, or numEntries if the reference is not in the map.
+ */
+//--------------------------------------------------------------------------------------------------
+static size_t FindRef
+(
+    const RefMap_t *mapPtr,
+    const void *safeRef
+)
+{
+    size_t i;
+
+    for (i = 0; (i < mapPtr->numEntries) && (mapPtr->entries[i].safeRef != safeRef); i++)
+    {
+    }
+
+    return i;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Create a safe reference for a pointer.
+ *
+ * @return The reference, which is odd, like Legato's, so it is never a valid pointer.
+ */
+//--------------------------------------------------------------------------------------------------
+void *le_ref_CreateRef
+(
+    le_ref_MapRef_t mapRef,
+    void *ptr
+)
+{
+    LE_ASSERT(ptr != NULL);
+
+    GrowEntries((void **)&mapRef->entries, &mapRef->capacity, mapRef->numEntries,
+                sizeof(RefEntry_t));
+
+    void *safeRef = (void *)((mapRef->nextRef << 1) | 1);
+    mapRef->nextRef++;
+    mapRef->entries[mapRef->numEntries].safeRef = safeRef;
+    mapRef->entries[mapRef->numEntries].ptr = ptr;
+    mapRef->numEntries++;
+
+    return safeRef;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Look up the pointer that a safe reference stands for.
+ *
+ * @return The pointer, or NULL if the reference is not in the map.
+ */
+//--------------------------------------------------------------------------------------------------
+void *le_ref_Lookup
+(
+    le_ref_MapRef_t mapRef,
+    void *safeRef
+)
+{
+    size_t i = FindRef(mapRef, safeRef);
+
+    return (i < mapRef->numEntries) ? mapRef->entries[i].ptr : NULL;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Delete a safe reference.  The map's iterator stays on the same entry.
+ */
+//--------------------------------------------------------------------------------------------------
+void le_ref_DeleteRef
+(
+    le_ref_MapRef_t mapRef,
+    void *safeRef
+)
+{
+    size_t i = FindRef(mapRef, safeRef);
+    if (i == mapRef->numEntries)
+    {
+        LE_ERROR("Reference %p not found in map '%s'.", safeRef, mapRef->name);
+        return;
+    }
+
+    memmove(&mapRef->entries[i],
+            &mapRef->entries[i + 1],
+            (mapRef->numEntries - i - 1) * sizeof(RefEntry_t));
+    mapRef->numEntries--;
+
+    if (mapRef->iter.nextIndex > i)
+    {
+        mapRef->iter.nextIndex--;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the map's iterator, positioned before the first entry.
+ *
+ * @return The iterator.
+ */
+//--------------------------------------------------------------------------------------------------
+le_ref_IterRef_t le_ref_GetIterator
+(
+    le_ref_MapRef_t mapRef
+)
+{
+    mapRef->iter.nextIndex = 0;
+
+    return &mapRef->iter;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Move an iterator to the next entry.
+ *
+ * @return
+ *      - LE_OK if it moved to an entry.
+ *      - LE_NOT_FOUND if there are no more entries.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t le_ref_NextNode
+(
+    le_ref_IterRef_t iteratorRef
+)
+{
+    if (iteratorRef->nextIndex >= iteratorRef->mapPtr->numEntries)
+    {
+        return LE_NOT_FOUND;
+    }
+
+    iteratorRef->nextIndex++;
+
+    return LE_OK;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the pointer of the iterator's current entry.
+ *
+ * @return The pointer, or NULL if the iterator is not on an entry.
+ */
+//--------------------------------------------------------------------------------------------------
+void *le_ref_GetValue
+(
+    le_ref_IterRef_t iteratorRef
+)
+{
+    size_t i = iteratorRef->nextIndex;
+
+    return ((i > 0) && (i <= iteratorRef->mapPtr->numEntries)) ?
+        iteratorRef->mapPtr->entries[i - 1].ptr : NULL;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the safe reference of the iterator's current entry.
+ *
+ * @return The reference, or NULL if the iterator is not on an entry.
+ */
+//--------------------------------------------------------------------------------------------------
+const void *le_ref_GetSafeRef
+(
+    le_ref_IterRef_t iteratorRef
+)
+{
+    size_t i = iteratorRef->nextIndex;
+
+    return ((i > 0) && (i <= iteratorRef->mapPtr->numEntries)) ?
+        iteratorRef->mapPtr->entries[i - 1].safeRef : NULL;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Create a hash map.
+ *
+ * @return Reference to the map (never NULL).
+ */
+//--------------------------------------------------------------------------------------------------
+le_hashmap_Ref_t le_hashmap_Create
+(
+    const char *nameStr,
+    size_t capacity,                    ///< Only a hint; the map grows as needed.
+    le_hashmap_HashFunc_t hashFunc,     ///< Not used.
+    le_hashmap_EqualsFunc_t equalsFunc
+)
+{
+    HashMap_t *mapPtr = calloc(1, sizeof(HashMap_t));
+    LE_ASSERT(mapPtr != NULL);
+
+    snprintf(mapPtr->name, sizeof(mapPtr->name), "%s", nameStr);
+    mapPtr->equalsFunc = equalsFunc;
+
+    return mapPtr;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Find the entry of a key.
+ *
+ * @return Index of the entry, or numEntries if the key is not in the map.
+ */
+//--------------------------------------------------------------------------------------------------
+static size_t FindKey
+(
+    const HashMap_t *mapPtr,
+    const void *keyPtr
+)
+{
+    size_t i;
+
+    for (i = 0; (i < mapPtr->numEntries) && !mapPtr->equalsFunc(mapPtr->entries[i].keyPtr, keyPtr);
+         i++)
+    {
+    }
+
+    return i;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Add a key and its value to a hash map, replacing the key's old value if it has one.
+ *
+ * @return The old value, or NULL if the key was not in the map.
+ */
+//--------------------------------------------------------------------------------------------------
+void *le_hashmap_Put
+(
+    le_hashmap_Ref_t mapRef,
+    const void *keyPtr,
+    const void *valuePtr
+)
+{
+    size_t i = FindKey(mapRef, keyPtr);
+    if (i < mapRef->numEntries)
+    {
+        void *oldValuePtr = (void *)mapRef->entries[i].valuePtr;
+        mapRef->entries[i].valuePtr = valuePtr;
+        return oldValuePtr;
+    }
+
+    GrowEntries((void **)&mapRef->entries, &mapRef->capacity, mapRef->numEntries,
+                sizeof(HashEntry_t));
+
+    mapRef->entries[i].keyPtr = keyPtr;
+    mapRef->entries[i].valuePtr = valuePtr;
+    mapRef->numEntries++;
+
+    return NULL;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the value of a key in a hash map.
+ *
+ * @return The value, or NULL if the key is not in the map.
+ */
+//--------------------------------------------------------------------------------------------------
+void *le_hashmap_Get
+(
+    le_hashmap_Ref_t mapRef,
+    const void *keyPtr
+)
+{
+    size_t i = FindKey(mapRef, keyPtr);
+
+    return (i < mapRef->numEntries) ? (void *)mapRef->entries[i].valuePtr : NULL;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Remove a key from a hash map.
+ *
+ * @return The key's value, or NULL if the key was not in the map.
+ */
+//--------------------------------------------------------------------------------------------------
+void *le_hashmap_Remove
+(
+    le_hashmap_Ref_t mapRef,
+    const void *keyPtr
+)
+{
+    size_t i = FindKey(mapRef, keyPtr);
+    if (i == mapRef->numEntries)
+    {
+        return NULL;
+    }
+
+    void *valuePtr = (void *)mapRef->entries[i].valuePtr;
+    mapRef->numEntries--;
+    mapRef->entries[i] = mapRef->entries[mapRef->numEntries];
+
+    return valuePtr;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * @return The number of keys in a hash map.
+ */
+//--------------------------------------------------------------------------------------------------
+size_t le_hashmap_Size
+(
+    le_hashmap_Ref_t mapRef
+)
+{
+    return mapRef->numEntries;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Hash function for maps whose keys are pointers, compared by address.
+ *
+ * @return The hash.
+ */
+//--------------------------------------------------------------------------------------------------
+size_t le_hashmap_HashVoidPointer
+(
+    const void *voidToHashPtr
+)
+{
+    return (size_t)(uintptr_t)voidToHashPtr;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Equality function for maps whose keys are pointers, compared by address.
+ *
+ * @return true if the pointers are equal.
+ */
+//--------------------------------------------------------------------------------------------------
+bool le_hashmap_EqualsVoidPointer
+(
+    const void *firstVoidPtr,
+    const void *secondVoidPtr
+)
+{
+    return (firstVoidPtr == secondVoidPtr);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Read a clock.
+ *
+ * @return The time.
+ */
+//--------------------------------------------------------------------------------------------------
+static le_clk_Time_t GetTime
+(
+    clockid_t clockId
+)
+{
+    struct timespec now;
+    LE_ASSERT(clock_gettime(clockId, &now) == 0);
+
+    le_clk_Time_t result = { now.tv_sec, now.tv_nsec / 1000 };
+
+    return result;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * @return The time on the monotonic clock.
+ */
+//--------------------------------------------------------------------------------------------------
+le_clk_Time_t le_clk_GetRelativeTime
+(
+    void
+)
+{
+    return GetTime(CLOCK_MONOTONIC);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * @return The wall-clock time, since the Epoch.
+ */
+//--------------------------------------------------------------------------------------------------
+le_clk_Time_t le_clk_GetAbsoluteTime
+(
+    void
+)
+{
+    return GetTime(CLOCK_REALTIME);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * @return timeA + timeB.
+ */
+//--------------------------------------------------------------------------------------------------
+le_clk_Time_t le_clk_Add
+(
+    le_clk_Time_t timeA,
+    le_clk_Time_t timeB
+)
+{
+    le_clk_Time_t result = { timeA.sec + timeB.sec, timeA.usec + timeB.usec };
+
+    if (result.usec >= 1000000)
+    {
+        result.sec++;
+        result.usec -= 1000000;
+    }
+
+    return result;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * @return timeA - timeB.
+ */
+//--------------------------------------------------------------------------------------------------
+le_clk_Time_t le_clk_Sub
+(
+    le_clk_Time_t timeA,
+    le_clk_Time_t timeB
+)
+{
+    le_clk_Time_t result = { timeA.sec - timeB.sec, timeA.usec - timeB.usec };
+
+    if (result.usec < 0)
+    {
+        result.sec--;
+        result.usec += 1000000;
+    }
+
+    return result;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * @return true if timeA is later than timeB.
+ */
+//--------------------------------------------------------------------------------------------------
+bool le_clk_GreaterThan
+(
+    le_clk_Time_t timeA,
+    le_clk_Time_t timeB
+)
+{
+    return (timeA.sec > timeB.sec) || ((timeA.sec == timeB.sec) && (timeA.usec > timeB.usec));
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Copy a string, truncating it if it doesn't fit.  Unlike Legato's, this doesn't avoid splitting
+ * a multi-byte character, which the Battery Service never copies.
+ *
+ * @return
+ *  - LE_OK on success.
+ *  - LE_OVERFLOW if the string was truncated.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t le_utf8_Copy
+(
+    char *destStr,
+    const char *srcStr,
+    const size_t destSize,
+    size_t *numBytesPtr     ///< [OUT] Number of bytes copied, excluding the terminator.  May be NULL.
+)
+{
+    LE_ASSERT(destSize > 0);
+
+    size_t len = strnlen(srcStr, destSize);
+    le_result_t result = LE_OK;
+
+    if (len == destSize)
+    {
+        len = destSize - 1;
+        result = LE_OVERFLOW;
+    }
+
+    memcpy(destStr, srcStr, len);
+    destStr[len] = '\0';
+
+    if (numBytesPtr != NULL)
+    {
+        *numBytesPtr = len;
+    }
+
+    return result;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Allocate a thread object and its event loop.
+ *
+ * @return Ptr to the thread.
+ */
+//--------------------------------------------------------------------------------------------------
+static Thread_t *NewThread
+(
+    const char *name
+)
+{
+    Thread_t *threadPtr = calloc(1, sizeof(Thread_t));
+    LE_ASSERT(threadPtr != NULL);
+
+    snprintf(threadPtr->name, sizeof(threadPtr->name), "%s", name);
+    LE_ASSERT(pthread_mutex_init(&threadPtr->mutex, NULL) == 0);
+    LE_ASSERT(pipe2(threadPtr->wakeFds, O_CLOEXEC | O_NONBLOCK) == 0);
+
+    return threadPtr;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Get the calling thread, creating the thread object of the main thread on its first call.
+ *
+ * @return Ptr to the thread.
+ */
+//--------------------------------------------------------------------------------------------------
+static Thread_t *GetCurrentThread
+(
+    void
+)
+{
+    if (CurrentThreadPtr == NULL)
+    {
+        CurrentThreadPtr = NewThread("main");
+    }
+
+    return CurrentThreadPtr;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Start routine of the threads created with le_thread_Create().
+ */
+//--------------------------------------------------------------------------------------------------
+static void *ThreadMain
+(
+    void *threadPtr
+)
+{
+    CurrentThreadPtr = threadPtr;
+
+    return CurrentThreadPtr->mainFunc(CurrentThreadPtr->context);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Create a thread.  It is started by le_thread_Start().
+ *
+ * @return Reference to the thread.
+ */
+//--------------------------------------------------------------------------------------------------
+le_thread_Ref_t le_thread_Create
+(
+    const char *name,
+    le_thread_MainFunc_t mainFunc,
+    void *context
+)
+{
+    Thread_t *threadPtr = NewThread(name);
+    threadPtr->mainFunc = mainFunc;
+    threadPtr->context = context;
+
+    return threadPtr;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Start a thread created with le_thread_Create().  It runs detached.
+ */
+//--------------------------------------------------------------------------------------------------
+void le_thread_Start
+(
+    le_thread_Ref_t thread
+)
+{
+    pthread_t pthread;
+    pthread_attr_t attr;
+
+    LE_ASSERT(pthread_attr_init(&attr) == 0);
+    LE_ASSERT(pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED) == 0);
+    LE_ASSERT(pthread_create(&pthread, &attr, ThreadMain, thread) == 0);
+    pthread_attr_destroy(&attr);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * @return Reference to the calling thread.
+ */
+//--------------------------------------------------------------------------------------------------
+le_thread_Ref_t le_thread_GetCurrent
+(
+    void
+)
+{
+    return GetCurrentThread();
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Queue a function to a thread's event loop.  Can be called from any thread.
+ */
+//--------------------------------------------------------------------------------------------------
+void le_event_QueueFunctionToThread
+(
+    le_thread_Ref_t thread,
+    le_event_DeferredFunc_t func,
+    void *param1Ptr,
+    void *param2Ptr
+)
+{
+    QueuedFunc_t *queuedPtr = malloc(sizeof(QueuedFunc_t));
+    LE_ASSERT(queuedPtr != NULL);
+
+    queuedPtr->nextPtr = NULL;
+    queuedPtr->func = func;
+    queuedPtr->param1Ptr = param1Ptr;
+    queuedPtr->param2Ptr = param2Ptr;
+
+    pthread_mutex_lock(&thread->mutex);
+    if (thread->queueTailPtr == NULL)
+    {
+        thread->queueHeadPtr = queuedPtr;
+    }
+    else
+    {
+        thread->queueTailPtr->nextPtr = queuedPtr;
+    }
+    thread->queueTailPtr = queuedPtr;
+    pthread_mutex_unlock(&thread->mutex);
+
+    // A full pipe already wakes the loop.
+    static const char wakeByte = 0;
+    (void)write(thread->wakeFds[1], &wakeByte, 1);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Queue a function to the calling thread's event loop.
+ */
+//--------------------------------------------------------------------------------------------------
+void le_event_QueueFunction
+(
+    le_event_DeferredFunc_t func,
+    void *param1Ptr,
+    void *param2Ptr
+)
+{
+    le_event_QueueFunctionToThread(GetCurrentThread(), func, param1Ptr, param2Ptr);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Find the running timer of a thread that expires first.
+ *
+ * @return Ptr to the timer, or NULL if none of the thread's timers is running.
+ */
+//--------------------------------------------------------------------------------------------------
+static Timer_t *FindNextTimer
+(
+    Thread_t *threadPtr
+)
+{
+    Timer_t *nextPtr = NULL;
+
+    for (Timer_t *timerPtr = threadPtr->timersPtr; timerPtr != NULL; timerPtr = timerPtr->nextPtr)
+    {
+        if (   timerPtr->isRunning
+            && ((nextPtr == NULL) || le_clk_GreaterThan(nextPtr->expiryTime, timerPtr->expiryTime)))
+        {
+            nextPtr = timerPtr;
+        }
+    }
+
+    return nextPtr;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Expire a timer: schedule its next expiry, or stop it if it has expired as often as it was set
+ * to repeat, and call its handler.
+ */
+//--------------------------------------------------------------------------------------------------
+static void ExpireTimer
+(
+    Timer_t *timerPtr
+)
+{
+    timerPtr->expiryCount++;
+
+    if ((timerPtr->repeatCount != 0) && (timerPtr->expiryCount >= timerPtr->repeatCount))
+    {
+        timerPtr->isRunning = false;
+    }
+    else
+    {
+        le_clk_Time_t now = le_clk_GetRelativeTime();
+        le_clk_Time_t interval = { timerPtr->intervalMs / 1000,
+                                   (timerPtr->intervalMs % 1000) * 1000 };
+
+        // Expiries that were missed while the loop was busy are not caught up on.
+        timerPtr->expiryTime = le_clk_Add(timerPtr->expiryTime, interval);
+        if (le_clk_GreaterThan(now, timerPtr->expiryTime))
+        {
+            timerPtr->expiryTime = le_clk_Add(now, interval);
+        }
+    }
+
+    if (timerPtr->handlerFunc != NULL)
+    {
+        timerPtr->handlerFunc(timerPtr);
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Run one event of the calling thread's event loop: the first queued function, or else the
+ * handler of the first timer that has expired, or else the handler of a monitored file descriptor
+ * that is ready.
+ *
+ * @return true if an event was run, false if none was ready within the timeout.
+ */
+//--------------------------------------------------------------------------------------------------
+static bool RunOneEvent
+(
+    int timeoutMs           ///< -1 = wait forever.
+)
+{
+    Thread_t *threadPtr = GetCurrentThread();
+
+    for (;;)
+    {
+        pthread_mutex_lock(&threadPtr->mutex);
+        QueuedFunc_t *queuedPtr = threadPtr->queueHeadPtr;
+        if (queuedPtr != NULL)
+        {
+            threadPtr->queueHeadPtr = queuedPtr->nextPtr;
+            if (threadPtr->queueHeadPtr == NULL)
+            {
+                threadPtr->queueTailPtr = NULL;
+            }
+        }
+        pthread_mutex_unlock(&threadPtr->mutex);
+
+        if (queuedPtr != NULL)
+        {
+            QueuedFunc_t queued = *queuedPtr;
+            free(queuedPtr);
+
+            queued.func(queued.param1Ptr, queued.param2Ptr);
+            return true;
+        }
+
+        // Wait no longer than until the next timer expires.
+        Timer_t *timerPtr = FindNextTimer(threadPtr);
+        int pollTimeoutMs = timeoutMs;
+        if (timerPtr != NULL)
+        {
+            le_clk_Time_t now = le_clk_GetRelativeTime();
+            if (!le_clk_GreaterThan(timerPtr->expiryTime, now))
+            {
+                ExpireTimer(timerPtr);
+                return true;
+            }
+
+            le_clk_Time_t untilExpiry = le_clk_Sub(timerPtr->expiryTime, now);
+            int expiryMs = (int)(untilExpiry.sec * 1000 + (untilExpiry.usec + 999) / 1000);
+            if ((timeoutMs < 0) || (expiryMs < timeoutMs))
+            {
+                pollTimeoutMs = expiryMs;
+            }
+        }
+
+        struct pollfd pollFds[1 + MAX_FD_MONITORS];
+        pollFds[0].fd = threadPtr->wakeFds[0];
+        pollFds[0].events = POLLIN;
+        for (size_t i = 0; i < threadPtr->numMonitors; i++)
+        {
+            pollFds[1 + i].fd = threadPtr->monitors[i].fd;
+            pollFds[1 + i].events = threadPtr->monitors[i].events;
+        }
+
+        int numReady = poll(pollFds, 1 + threadPtr->numMonitors, pollTimeoutMs);
+        if ((numReady < 0) && (errno == EINTR))
+        {
+            continue;
+        }
+        LE_ASSERT(numReady >= 0);
+        if (numReady == 0)
+        {
+            if (pollTimeoutMs != timeoutMs)
+            {
+                // The wait ended because the timer is due.
+                continue;
+            }
+            return false;
+        }
+
+        for (size_t i = 0; i < threadPtr->numMonitors; i++)
+        {
+            if (pollFds[1 + i].revents != 0)
+            {
+                threadPtr->monitors[i].handlerFunc(pollFds[1 + i].fd, pollFds[1 + i].revents);
+                return true;
+            }
+        }
+
+        // Only woken up: drain the pipe, and look at the queue again.
+        char drain[64];
+        while (read(threadPtr->wakeFds[0], drain, sizeof(drain)) > 0)
+        {
+        }
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Run one pending event of the calling thread's event loop, without waiting.
+ *
+ * @return
+ *  - LE_OK if an event was run (there may be more).
+ *  - LE_WOULD_BLOCK if there were no pending events.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t le_event_ServiceLoop
+(
+    void
+)
+{
+    return RunOneEvent(0) ? LE_OK : LE_WOULD_BLOCK;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Run the calling thread's event loop.  Never returns.
+ */
+//--------------------------------------------------------------------------------------------------
+void le_event_RunLoop
+(
+    void
+)
+{
+    for (;;)
+    {
+        RunOneEvent(-1);
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Monitor a file descriptor from the calling thread's event loop.
+ *
+ * @return Reference to the monitor.
+ */
+//--------------------------------------------------------------------------------------------------
+le_fdMonitor_Ref_t le_fdMonitor_Create
+(
+    const char *name,
+    int fd,
+    le_fdMonitor_HandlerFunc_t handlerFunc,
+    short events
+)
+{
+    Thread_t *threadPtr = GetCurrentThread();
+    LE_FATAL_IF(threadPtr->numMonitors >= MAX_FD_MONITORS, "Too many fd monitors ('%s').", name);
+
+    FdMonitor_t *monitorPtr = &threadPtr->monitors[threadPtr->numMonitors++];
+    monitorPtr->fd = fd;
+    monitorPtr->events = events;
+    monitorPtr->handlerFunc = handlerFunc;
+
+    return monitorPtr;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Stop monitoring a file descriptor.  Must be called from the thread that created the monitor.
+ */
+//--------------------------------------------------------------------------------------------------
+void le_fdMonitor_Delete
+(
+    le_fdMonitor_Ref_t monitorRef
+)
+{
+    Thread_t *threadPtr = GetCurrentThread();
+    size_t index = monitorRef - threadPtr->monitors;
+    LE_ASSERT(index < threadPtr->numMonitors);
+
+    memmove(monitorRef, monitorRef + 1, (threadPtr->numMonitors - index - 1) * sizeof(*monitorRef));
+    threadPtr->numMonitors--;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Create a semaphore.
+ *
+ * @return Reference to the semaphore.
+ */
+//--------------------------------------------------------------------------------------------------
+le_sem_Ref_t le_sem_Create
+(
+    const char *name,
+    int32_t initialCount
+)
+{
+    Sem_t *semPtr = calloc(1, sizeof(Sem_t));
+    LE_ASSERT(semPtr != NULL);
+
+    LE_ASSERT(pthread_mutex_init(&semPtr->mutex, NULL) == 0);
+    LE_ASSERT(pthread_cond_init(&semPtr->cond, NULL) == 0);
+    semPtr->count = initialCount;
+
+    return semPtr;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Increment a semaphore, waking up a thread waiting on it.
+ */
+//--------------------------------------------------------------------------------------------------
+void le_sem_Post
+(
+    le_sem_Ref_t semaphorePtr
+)
+{
+    pthread_mutex_lock(&semaphorePtr->mutex);
+    semaphorePtr->count++;
+    pthread_cond_signal(&semaphorePtr->cond);
+    pthread_mutex_unlock(&semaphorePtr->mutex);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Wait until a semaphore is positive, and decrement it.
+ */
+//--------------------------------------------------------------------------------------------------
+void le_sem_Wait
+(
+    le_sem_Ref_t semaphorePtr
+)
+{
+    pthread_mutex_lock(&semaphorePtr->mutex);
+    while (semaphorePtr->count <= 0)
+    {
+        pthread_cond_wait(&semaphorePtr->cond, &semaphorePtr->mutex);
+    }
+    semaphorePtr->count--;
+    pthread_mutex_unlock(&semaphorePtr->mutex);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Create a timer in the calling thread.  It expires once, after 1 s, unless set otherwise.
+ *
+ * @return Reference to the timer.
+ */
+//--------------------------------------------------------------------------------------------------
+le_timer_Ref_t le_timer_Create
+(
+    const char *nameStr
+)
+{
+    Timer_t *timerPtr = calloc(1, sizeof(Timer_t));
+    LE_ASSERT(timerPtr != NULL);
+
+    snprintf(timerPtr->name, sizeof(timerPtr->name), "%s", nameStr);
+    timerPtr->intervalMs = 1000;
+    timerPtr->repeatCount = 1;
+
+    Thread_t *threadPtr = GetCurrentThread();
+    timerPtr->threadPtr = threadPtr;
+    timerPtr->nextPtr = threadPtr->timersPtr;
+    threadPtr->timersPtr = timerPtr;
+
+    return timerPtr;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Delete a timer.  Must be called from the thread that created it.
+ */
+//--------------------------------------------------------------------------------------------------
+void le_timer_Delete
+(
+    le_timer_Ref_t timerRef
+)
+{
+    Timer_t **linkPtr = &timerRef->threadPtr->timersPtr;
+    while (*linkPtr != timerRef)
+    {
+        LE_ASSERT(*linkPtr != NULL);
+        linkPtr = &(*linkPtr)->nextPtr;
+    }
+    *linkPtr = timerRef->nextPtr;
+
+    free(timerRef);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Set the function called when a timer expires.
+ *
+ * @return LE_OK.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t le_timer_SetHandler
+(
+    le_timer_Ref_t timerRef,
+    le_timer_ExpiryHandler_t handlerFunc
+)
+{
+    timerRef->handlerFunc = handlerFunc;
+
+    return LE_OK;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Set a timer's interval.  If the timer is running, it is restarted with the new interval.
+ *
+ * @return LE_OK.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t le_timer_SetMsInterval
+(
+    le_timer_Ref_t timerRef,
+    uint32_t interval       ///< ms
+)
+{
+    timerRef->intervalMs = interval;
+
+    if (timerRef->isRunning)
+    {
+        le_timer_Restart(timerRef);
+    }
+
+    return LE_OK;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Set how many times a timer expires each time it is started.
+ *
+ * @return LE_OK.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t le_timer_SetRepeat
+(
+    le_timer_Ref_t timerRef,
+    uint32_t repeatCount    ///< 0 = repeat until stopped.
+)
+{
+    timerRef->repeatCount = repeatCount;
+
+    return LE_OK;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Set the context pointer of a timer, for its handler to get with le_timer_GetContextPtr().
+ *
+ * @return LE_OK.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t le_timer_SetContextPtr
+(
+    le_timer_Ref_t timerRef,
+    void *contextPtr
+)
+{
+    timerRef->contextPtr = contextPtr;
+
+    return LE_OK;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * @return The context pointer of a timer.
+ */
+//--------------------------------------------------------------------------------------------------
+void *le_timer_GetContextPtr
+(
+    le_timer_Ref_t timerRef
+)
+{
+    return timerRef->contextPtr;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Start a timer.  It first expires one interval from now.
+ *
+ * @return
+ *  - LE_OK on success.
+ *  - LE_BUSY if the timer was already running.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t le_timer_Start
+(
+    le_timer_Ref_t timerRef
+)
+{
+    if (timerRef->isRunning)
+    {
+        return LE_BUSY;
+    }
+
+    le_clk_Time_t interval = { timerRef->intervalMs / 1000, (timerRef->intervalMs % 1000) * 1000 };
+
+    timerRef->expiryTime = le_clk_Add(le_clk_GetRelativeTime(), interval);
+    timerRef->expiryCount = 0;
+    timerRef->isRunning = true;
+
+    return LE_OK;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Stop a timer.
+ *
+ * @return
+ *  - LE_OK on success.
+ *  - LE_FAULT if the timer wasn't running.
+ */
+//--------------------------------------------------------------------------------------------------
+le_result_t le_timer_Stop
+(
+    le_timer_Ref_t timerRef
+)
+{
+    if (!timerRef->isRunning)
+    {
+        return LE_FAULT;
+    }
+
+    timerRef->isRunning = false;
+
+    return LE_OK;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Start a timer again, whether or not it is running.
+ */
+//--------------------------------------------------------------------------------------------------
+void le_timer_Restart
+(
+    le_timer_Ref_t timerRef
+)
+{
+    timerRef->isRunning = false;
+    (void)le_timer_Start(timerRef);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * @return true if a timer is running.
+ */
+//--------------------------------------------------------------------------------------------------
+bool le_timer_IsRunning
+(
+    le_timer_Ref_t timerRef
+)
+{
+    return timerRef->isRunning;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Block a signal in the calling thread, and in the threads it creates afterwards, so that it can
+ * only be received through le_sig_SetEventHandler().
+ */
+//--------------------------------------------------------------------------------------------------
+void le_sig_Block
+(
+    int sigNum
+)
+{
+    sigset_t sigSet;
+
+    sigemptyset(&sigSet);
+    sigaddset(&sigSet, sigNum);
+    LE_ASSERT(pthread_sigmask(SIG_BLOCK, &sigSet, NULL) == 0);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Call the event handler of the signal received on a signalfd.
+ */
+//--------------------------------------------------------------------------------------------------
+static void SigFdHandler
+(
+    int fd,
+    short events
+)
+{
+    struct signalfd_siginfo info;
+    if (read(fd, &info, sizeof(info)) != sizeof(info))
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < NumSigHandlers; i++)
+    {
+        if (SigHandlers[i].fd == fd)
+        {
+            SigHandlers[i].handlerFunc(SigHandlers[i].sigNum);
+        }
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Set the handler that a blocked signal is received by, in the calling thread's event loop.
+ */
+//--------------------------------------------------------------------------------------------------
+void le_sig_SetEventHandler
+(
+    int sigNum,
+    le_sig_EventHandlerFunc_t sigEventHandler
+)
+{
+    LE_FATAL_IF(NumSigHandlers >= MAX_SIG_HANDLERS, "Too many signal handlers.");
+
+    sigset_t sigSet;
+    sigemptyset(&sigSet);
+    sigaddset(&sigSet, sigNum);
+
+    SigHandler_t *handlerPtr = &SigHandlers[NumSigHandlers++];
+    handlerPtr->sigNum = sigNum;
+    handlerPtr->fd = signalfd(-1, &sigSet, SFD_CLOEXEC | SFD_NONBLOCK);
+    LE_ASSERT(handlerPtr->fd >= 0);
+    handlerPtr->handlerFunc = sigEventHandler;
+
+    le_fdMonitor_Create("signal", handlerPtr->fd, SigFdHandler, POLLIN);
+}
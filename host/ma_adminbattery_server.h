@@ -0,0 +1,17 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file ma_adminbattery_server.h
+ *
+ * Host stand-in for the server interface that Legato's ifgen generates from ma_adminbattery.api:
+ * the function that the server implements.  Keep it in step with ma_adminbattery.api.
+ */
+//--------------------------------------------------------------------------------------------------
+
+#ifndef MA_ADMINBATTERY_INTERFACE_H_INCLUDE_GUARD
+#define MA_ADMINBATTERY_INTERFACE_H_INCLUDE_GUARD
+
+#include "legato.h"
+
+void ma_adminbattery_SetTechnology(const char *type, uint32_t maH, uint32_t voltage);
+
+#endif // MA_ADMINBATTERY_INTERFACE_H_INCLUDE_GUARD
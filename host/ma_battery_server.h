@@ -0,0 +1,205 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file ma_battery_server.h
+ *
+ * Host stand-in for the server interface that Legato's ifgen generates from ma_battery.api: the
+ * types, and the functions that the server implements.  Keep it in step with ma_battery.api.
+ *
+ * There is no IPC on the host, so the test that calls the functions defines
+ * ma_battery_GetServiceRef() and ma_battery_GetClientSessionRef() (see legato.h).
+ */
+//--------------------------------------------------------------------------------------------------
+
+#ifndef MA_BATTERY_INTERFACE_H_INCLUDE_GUARD
+#define MA_BATTERY_INTERFACE_H_INCLUDE_GUARD
+
+#include "legato.h"
+
+//--------------------------------------------------------------------------------------------------
+// Types
+//--------------------------------------------------------------------------------------------------
+
+#define MA_BATTERY_MAX_BATT_TYPE_STR_LEN 128
+#define MA_BATTERY_MAX_HISTORY_SAMPLES 32
+#define MA_BATTERY_MAX_SUPPLY_NAME_LEN 31
+
+typedef enum
+{
+    MA_BATTERY_DISCHARGING = 0,
+    MA_BATTERY_CHARGING = 1,
+    MA_BATTERY_NOT_CHARGING = 2,
+    MA_BATTERY_FULL = 3,
+    MA_BATTERY_CHARGING_UNKNOWN = 4,
+    MA_BATTERY_CHARGING_ERROR = 5
+}
+ma_battery_ChargingStatus_t;
+
+typedef enum
+{
+    MA_BATTERY_OVERVOLTAGE = 0,
+    MA_BATTERY_GOOD = 1,
+    MA_BATTERY_COLD = 2,
+    MA_BATTERY_HOT = 3,
+    MA_BATTERY_DISCONNECTED = 4,
+    MA_BATTERY_HEALTH_UNKNOWN = 5,
+    MA_BATTERY_HEALTH_ERROR = 6
+}
+ma_battery_HealthStatus_t;
+
+typedef enum
+{
+    MA_BATTERY_FIELD_CHARGING_STATUS = 0x1,
+    MA_BATTERY_FIELD_HEALTH = 0x2,
+    MA_BATTERY_FIELD_VOLTAGE = 0x4,
+    MA_BATTERY_FIELD_CURRENT = 0x8,
+    MA_BATTERY_FIELD_TEMP = 0x10,
+    MA_BATTERY_FIELD_PERCENT = 0x20,
+    MA_BATTERY_FIELD_CHARGE = 0x40
+}
+ma_battery_SnapshotField_t;
+
+typedef enum
+{
+    MA_BATTERY_SUPPLY_BATTERY = 0,
+    MA_BATTERY_SUPPLY_MAINS = 1,
+    MA_BATTERY_SUPPLY_USB = 2,
+    MA_BATTERY_SUPPLY_OTHER = 3
+}
+ma_battery_SupplyType_t;
+
+typedef struct ma_battery_LevelPercentageHandler *ma_battery_LevelPercentageHandlerRef_t;
+typedef struct ma_battery_HealthChangeHandler *ma_battery_HealthChangeHandlerRef_t;
+typedef struct ma_battery_ChargingStatusChangeHandler *ma_battery_ChargingStatusChangeHandlerRef_t;
+typedef struct ma_battery_SupplyStatusChangeHandler *ma_battery_SupplyStatusChangeHandlerRef_t;
+typedef struct ma_battery_SupplyLevelPercentageHandler
+    *ma_battery_SupplyLevelPercentageHandlerRef_t;
+
+typedef void (*ma_battery_LevelPercentageHandlerFunc_t)(uint8_t percentage,
+                                                        uint8_t percentageTrigger,
+                                                        bool isHighLevel,
+                                                        void *contextPtr);
+typedef void (*ma_battery_HealthHandlerFunc_t)(ma_battery_HealthStatus_t health,
+                                               void *contextPtr);
+typedef void (*ma_battery_ChargingStatusHandlerFunc_t)(ma_battery_ChargingStatus_t condition,
+                                                       void *contextPtr);
+typedef void (*ma_battery_SupplyStatusHandlerFunc_t)(uint32_t index,
+                                                     bool isOnline,
+                                                     ma_battery_ChargingStatus_t chargingStatus,
+                                                     ma_battery_HealthStatus_t health,
+                                                     void *contextPtr);
+typedef void (*ma_battery_SupplyLevelPercentageHandlerFunc_t)(uint32_t index,
+                                                              uint8_t percentage,
+                                                              uint8_t percentageTrigger,
+                                                              bool isHighLevel,
+                                                              void *contextPtr);
+
+//--------------------------------------------------------------------------------------------------
+// Service and sessions
+//--------------------------------------------------------------------------------------------------
+
+le_msg_ServiceRef_t ma_battery_GetServiceRef(void);
+le_msg_SessionRef_t ma_battery_GetClientSessionRef(void);
+
+//--------------------------------------------------------------------------------------------------
+// Functions implemented by the server
+//--------------------------------------------------------------------------------------------------
+
+ma_battery_ChargingStatus_t ma_battery_GetChargingStatus(void);
+ma_battery_HealthStatus_t ma_battery_GetHealthStatus(void);
+le_result_t ma_battery_GetVoltage(double *voltagePtr);
+le_result_t ma_battery_GetCurrent(double *currentPtr);
+le_result_t ma_battery_GetTemp(double *tempPtr);
+le_result_t ma_battery_GetPercentRemaining(uint16_t *percentPtr);
+le_result_t ma_battery_GetPercentConfidence(uint8_t *confidencePtr);
+le_result_t ma_battery_GetChargeRemaining(uint16_t *chargePtr);
+le_result_t ma_battery_GetTimeToEmpty(uint32_t *secondsPtr);
+le_result_t ma_battery_GetTimeToFull(uint32_t *secondsPtr);
+le_result_t ma_battery_GetStateOfHealth(uint8_t *healthPtr, uint16_t *fullCapacityPtr);
+le_result_t ma_battery_GetCycleCount(uint32_t *cyclesPtr);
+
+le_result_t ma_battery_GetSnapshot(uint32_t maxAge,
+                                   uint64_t *timestampPtr,
+                                   ma_battery_SnapshotField_t *validFieldsPtr,
+                                   ma_battery_ChargingStatus_t *chargingStatusPtr,
+                                   ma_battery_HealthStatus_t *healthPtr,
+                                   double *voltagePtr,
+                                   double *currentPtr,
+                                   double *tempPtr,
+                                   uint16_t *percentPtr,
+                                   uint16_t *chargePtr);
+
+le_result_t ma_battery_GetHistory(uint64_t startTime,
+                                  uint64_t endTime,
+                                  uint64_t *timestampPtr, size_t *timestampSizePtr,
+                                  uint8_t *percentPtr, size_t *percentSizePtr,
+                                  uint16_t *chargePtr, size_t *chargeSizePtr,
+                                  double *currentPtr, size_t *currentSizePtr,
+                                  double *voltagePtr, size_t *voltageSizePtr,
+                                  double *tempPtr, size_t *tempSizePtr,
+                                  uint8_t *chargingStatusPtr, size_t *chargingStatusSizePtr,
+                                  uint8_t *healthPtr, size_t *healthSizePtr);
+
+le_result_t ma_battery_GetRecentHistory(uint64_t *timestampPtr, size_t *timestampSizePtr,
+                                        uint8_t *percentPtr, size_t *percentSizePtr,
+                                        uint16_t *chargePtr, size_t *chargeSizePtr,
+                                        double *currentPtr, size_t *currentSizePtr,
+                                        double *voltagePtr, size_t *voltageSizePtr,
+                                        double *tempPtr, size_t *tempSizePtr,
+                                        uint8_t *chargingStatusPtr, size_t *chargingStatusSizePtr,
+                                        uint8_t *healthPtr, size_t *healthSizePtr);
+
+uint32_t ma_battery_GetSupplyCount(void);
+
+le_result_t ma_battery_GetSupplyInfo(uint32_t index,
+                                     char *name,
+                                     size_t nameSize,
+                                     ma_battery_SupplyType_t *typePtr,
+                                     bool *isOnlinePtr);
+
+le_result_t ma_battery_GetSupplySnapshot(uint32_t index,
+                                         uint32_t maxAge,
+                                         uint64_t *timestampPtr,
+                                         ma_battery_SnapshotField_t *validFieldsPtr,
+                                         ma_battery_ChargingStatus_t *chargingStatusPtr,
+                                         ma_battery_HealthStatus_t *healthPtr,
+                                         double *voltagePtr,
+                                         double *currentPtr,
+                                         double *tempPtr,
+                                         uint16_t *percentPtr,
+                                         uint16_t *chargePtr);
+
+le_result_t ma_battery_GetSupplyPercentRemaining(uint32_t index, uint16_t *percentPtr);
+le_result_t ma_battery_GetSupplyChargeRemaining(uint32_t index, uint16_t *chargePtr);
+
+le_result_t ma_battery_GetAggregate(uint32_t *numBatteriesPtr,
+                                    uint16_t *percentPtr,
+                                    uint32_t *chargePtr,
+                                    uint32_t *fullChargePtr,
+                                    bool *isExternalPowerPtr);
+
+ma_battery_LevelPercentageHandlerRef_t ma_battery_AddLevelPercentageHandler(
+    uint8_t levelLow, uint8_t levelHigh, ma_battery_LevelPercentageHandlerFunc_t handlerPtr,
+    void *contextPtr);
+void ma_battery_RemoveLevelPercentageHandler(ma_battery_LevelPercentageHandlerRef_t handlerRef);
+
+ma_battery_HealthChangeHandlerRef_t ma_battery_AddHealthChangeHandler(
+    ma_battery_HealthHandlerFunc_t handlerPtr, void *contextPtr);
+void ma_battery_RemoveHealthChangeHandler(ma_battery_HealthChangeHandlerRef_t handlerRef);
+
+ma_battery_ChargingStatusChangeHandlerRef_t ma_battery_AddChargingStatusChangeHandler(
+    ma_battery_ChargingStatusHandlerFunc_t handlerPtr, void *contextPtr);
+void ma_battery_RemoveChargingStatusChangeHandler(
+    ma_battery_ChargingStatusChangeHandlerRef_t handlerRef);
+
+ma_battery_SupplyStatusChangeHandlerRef_t ma_battery_AddSupplyStatusChangeHandler(
+    ma_battery_SupplyStatusHandlerFunc_t handlerPtr, void *contextPtr);
+void ma_battery_RemoveSupplyStatusChangeHandler(
+    ma_battery_SupplyStatusChangeHandlerRef_t handlerRef);
+
+ma_battery_SupplyLevelPercentageHandlerRef_t ma_battery_AddSupplyLevelPercentageHandler(
+    uint32_t index, uint8_t levelLow, uint8_t levelHigh,
+    ma_battery_SupplyLevelPercentageHandlerFunc_t handlerPtr, void *contextPtr);
+void ma_battery_RemoveSupplyLevelPercentageHandler(
+    ma_battery_SupplyLevelPercentageHandlerRef_t handlerRef);
+
+#endif // MA_BATTERY_INTERFACE_H_INCLUDE_GUARD
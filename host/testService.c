@@ -0,0 +1,62 @@
+//--------------------------------------------------------------------------------------------------
+/**
+ * @file testService.c
+ *
+ * Stand-in for the messaging layer of the ma_battery service, for the host tests of the backends,
+ * which call the API functions directly from a single client session.  (The test of batteryCore
+ * defines its own, to play several sessions.)
+ */
+//--------------------------------------------------------------------------------------------------
+
+#include "legato.h"
+#include "interfaces.h"
+
+/// Stand-ins for the ma_battery service and its client session.
+static int Service;
+static int Session;
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * @return The stand-in service.
+ */
+//--------------------------------------------------------------------------------------------------
+le_msg_ServiceRef_t ma_battery_GetServiceRef
+(
+    void
+)
+{
+    return (le_msg_ServiceRef_t)&Service;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * @return The stand-in client session.
+ */
+//--------------------------------------------------------------------------------------------------
+le_msg_SessionRef_t ma_battery_GetClientSessionRef
+(
+    void
+)
+{
+    return (le_msg_SessionRef_t)&Session;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/**
+ * Accept the handler for the closing of client sessions.  The session is never closed.
+ *
+ * @return A reference to the handler.
+ */
+//--------------------------------------------------------------------------------------------------
+le_msg_SessionEventHandlerRef_t le_msg_AddServiceCloseHandler
+(
+    le_msg_ServiceRef_t serviceRef,
+    le_msg_SessionEventHandler_t handlerFunc,
+    void *contextPtr
+)
+{
+    return (le_msg_SessionEventHandlerRef_t)handlerFunc;
+}